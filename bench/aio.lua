@@ -0,0 +1,86 @@
+-- Compares reading the metadata and the first bytes of many files with std.fs and io against std.aio.
+-- usage: lua bench/aio.lua [number of files]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local aio = require 'std.aio'
+local fs = require 'std.fs'
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 20000
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d files %10.1f ms %12.0f files/s'):format(label, n, dt / 1e6, n / (dt / 1e9)))
+end
+
+local root = os.tmpname()
+os.remove(root)
+assert(fs.create_directory(root))
+local files = {}
+for i = 1, count do
+  files[i] = path.combine(root, ('file%07d'):format(i))
+  local f = assert(io.open(files[i], 'wb'))
+  f:write(string.rep('x', 1024))
+  f:close()
+end
+
+measure('fs.metadata + io.open/read', function()
+  local n = 0
+  for i = 1, count do
+    assert(fs.metadata(files[i]))
+    local f = assert(io.open(files[i], 'rb'))
+    f:read(512)
+    f:close()
+    n = n + 1
+  end
+  return n
+end)
+
+-- Runs the steps stat, open, read and close of each file as a chain of operations, with up to
+-- `depth` files in progress.
+local function chain(ring, depth)
+  local next_file, done = 1, 0
+  local function start()
+    if next_file <= count then
+      assert(ring:submit({op = 'stat', path = files[next_file], tag = next_file}))
+      next_file = next_file + 1
+    end
+  end
+  for _ = 1, depth do
+    start()
+  end
+  while ring:pending() > 0 do
+    for _, r in ipairs(ring:wait(1)) do
+      assert(not r.err, r.err)
+      if r.op == 'stat' then
+        ring:submit({op = 'open', path = files[r.tag], tag = r.tag})
+      elseif r.op == 'open' then
+        ring:submit({op = 'read', fd = r.result, length = 512, offset = 0, tag = r.result})
+      elseif r.op == 'read' then
+        ring:submit({op = 'close', fd = r.tag})
+      else
+        done = done + 1
+        start()
+      end
+    end
+  end
+  return done
+end
+
+for _, backend in ipairs({'threads', 'io_uring'}) do
+  local ring = aio.new({backend = backend, entries = 512})
+  if ring then
+    for _, depth in ipairs({1, 64, 256}) do
+      measure(('aio %s (depth %d)'):format(backend, depth), function()
+        return chain(ring, depth)
+      end)
+    end
+    ring:close()
+  end
+end
+
+os.execute("rm -rf '" .. root .. "'")
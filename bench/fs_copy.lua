@@ -0,0 +1,61 @@
+-- Compares fs.copy_file against an 8 KiB read/write loop, the strategy used before the kernel copy tiers.
+-- usage: lua bench/fs_copy.lua [size in MiB]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local time = require 'std.time'
+
+local size = (tonumber(arg and arg[1]) or 256) * 1024 * 1024
+
+local function temp_file()
+  local filename = os.tmpname()
+  os.remove(filename)
+  return filename
+end
+
+local function loop_copy(src, dst)
+  local fin = assert(io.open(src, 'rb'))
+  local fout = assert(io.open(dst, 'wb'))
+  fout:setvbuf('no')
+  while true do
+    local block = fin:read(8192)
+    if not block then
+      break
+    end
+    fout:write(block)
+  end
+  fin:close()
+  fout:close()
+  return true
+end
+
+local function measure(label, f, src, dst)
+  os.remove(dst)
+  local t0 = time.perf_counter_ns()
+  assert(f(src, dst))
+  local dt = time.perf_counter_ns() - t0
+  print(('%-32s %8d MiB %10.1f ms %10.1f MiB/s'):format(label, size >> 20, dt / 1e6, (size >> 20) / (dt / 1e9)))
+end
+
+local src, dst = temp_file(), temp_file()
+do
+  local f = assert(io.open(src, 'wb'))
+  local block = string.rep('0123456789abcdef', 65536)
+  for _ = 1, size // #block do
+    f:write(block)
+  end
+  f:close()
+end
+
+measure('8 KiB read/write loop', loop_copy, src, dst)
+measure('fs.copy_file', fs.copy_file, src, dst)
+measure('fs.copy_file (sparse)', function(s, d)
+  return fs.copy_file(s, d, {sparse = true})
+end, src, dst)
+measure('fs.copy_file (progress 1 MiB)', function(s, d)
+  return fs.copy_file(s, d, {progress = function() end, progress_interval = 1 << 20})
+end, src, dst)
+
+os.remove(src)
+os.remove(dst)
@@ -0,0 +1,53 @@
+-- Compares fs.metadata in a loop against fs.metadata_many, with all the fields and with a field mask.
+-- usage: lua bench/fs_metadata.lua [number of files]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 20000
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d paths %10.1f ms %12.0f paths/s'):format(label, count, dt / 1e6, count / (dt / 1e9)))
+end
+
+local root = os.tmpname()
+os.remove(root)
+assert(fs.create_directory(root))
+local paths = {}
+for i = 1, count do
+  paths[i] = path.combine(root, ('file%07d'):format(i))
+  local f = assert(io.open(paths[i], 'wb'))
+  f:close()
+end
+
+local mtime = {fields = 'modified'}
+measure('fs.metadata', function()
+  for i = 1, count do
+    fs.metadata(paths[i]):modified()
+  end
+end)
+measure('fs.metadata (modified)', function()
+  for i = 1, count do
+    fs.metadata(paths[i], mtime):modified()
+  end
+end)
+measure('fs.metadata_many', function()
+  local ms = fs.metadata_many(paths)
+  for i = 1, count do
+    ms[i]:modified()
+  end
+end)
+measure('fs.metadata_many (modified)', function()
+  local ms = fs.metadata_many(paths, mtime)
+  for i = 1, count do
+    ms[i]:modified()
+  end
+end)
+
+os.execute("rm -rf '" .. root .. "'")
@@ -0,0 +1,53 @@
+-- Compares scanning a file through fs.mmap with iox.read_lines and iox.read_all.
+-- usage: lua bench/fs_mmap.lua [size in MiB]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local iox = require 'std.iox'
+local time = require 'std.time'
+
+local size = (tonumber(arg and arg[1]) or 64) * 1024 * 1024
+
+local function measure(label, f)
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-36s %10d %10.1f ms %10.1f MiB/s %10d KiB'):format(label, n, dt / 1e6, (size >> 20) / (dt / 1e9),
+    collectgarbage('count') // 1))
+end
+
+local filename = os.tmpname()
+do
+  local f = assert(io.open(filename, 'wb'))
+  local line = string.rep('x', 99) .. '\n'
+  local block = string.rep(line, 1000)
+  for _ = 1, size // #block do
+    f:write(block)
+  end
+  f:write('needle\n')
+  f:close()
+end
+
+measure('iox.read_lines (count lines)', function()
+  return #iox.read_lines(filename)
+end)
+measure('fs.mmap lines (count lines)', function()
+  local m <close> = assert(fs.mmap(filename))
+  m:advise('sequential')
+  local n = 0
+  for _ in m:lines() do
+    n = n + 1
+  end
+  return n
+end)
+measure('iox.read_all + string.find', function()
+  return assert(iox.read_all(filename):find('needle', 1, true))
+end)
+measure('fs.mmap + find', function()
+  local m <close> = assert(fs.mmap(filename))
+  return assert(m:find('needle'))
+end)
+
+os.remove(filename)
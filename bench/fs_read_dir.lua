@@ -0,0 +1,64 @@
+-- Compares fs.read_dir against fs.entries on a directory with many files.
+-- usage: lua bench/fs_read_dir.lua [number of files]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 100000
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d entries %10.1f ms %12.0f entries/s'):format(label, n, dt / 1e6, n / (dt / 1e9)))
+end
+
+local root = os.tmpname()
+os.remove(root)
+assert(fs.create_directory(root))
+for i = 1, count do
+  local f = assert(io.open(path.combine(root, ('file%07d'):format(i)), 'wb'))
+  f:close()
+end
+
+measure('fs.entries', function()
+  local n = 0
+  for _ in fs.entries(root) do
+    n = n + 1
+  end
+  return n - 2
+end)
+measure('fs.entries + fs.is_file', function()
+  local n = 0
+  for name in fs.entries(root) do
+    if fs.is_file(path.combine(root, name)) then
+      n = n + 1
+    end
+  end
+  return n
+end)
+for _, batch in ipairs({1, 64, 1024}) do
+  measure(('fs.read_dir (batch %d)'):format(batch), function()
+    local n = 0
+    for records, k in fs.read_dir(root, {batch = batch}) do
+      for i = 1, k do
+        if records[i].type == 'file' then
+          n = n + 1
+        end
+      end
+    end
+    return n
+  end)
+end
+measure('fs.read_dir (batch 1024, with_stat)', function()
+  local n = 0
+  for _, k in fs.read_dir(root, {batch = 1024, with_stat = true}) do
+    n = n + k
+  end
+  return n
+end)
+
+os.execute("rm -rf '" .. root .. "'")
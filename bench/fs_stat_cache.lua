@@ -0,0 +1,52 @@
+-- Compares chained fs predicates with and without a stat cache.
+-- usage: lua bench/fs_stat_cache.lua [number of files] [rounds]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 5000
+local rounds = tonumber(arg and arg[2]) or 4
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  local calls = count * rounds * 3
+  print(('%-32s %10d calls %10.1f ms %12.0f calls/s'):format(label, calls, dt / 1e6, calls / (dt / 1e9)))
+end
+
+local root = os.tmpname()
+os.remove(root)
+assert(fs.create_directory(root))
+local paths = {}
+for i = 1, count do
+  paths[i] = path.combine(root, ('file%07d'):format(i))
+  local f = assert(io.open(paths[i], 'wb'))
+  f:close()
+end
+
+local function check(cache)
+  for _ = 1, rounds do
+    for i = 1, count do
+      local p = paths[i]
+      if fs.exists(p, cache) and fs.is_file(p, cache) then
+        fs.metadata(p, cache and {cache = cache})
+      end
+    end
+  end
+end
+
+measure('exists + is_file + metadata', function()
+  check(nil)
+end)
+local cache = fs.stat_cache()
+measure('... with a stat cache', function()
+  check(cache)
+end)
+local stats = cache:stats()
+print(('hits %d, misses %d'):format(stats.hits, stats.misses))
+
+os.execute("rm -rf '" .. root .. "'")
@@ -0,0 +1,58 @@
+-- Compares fs.walk against a recursive walk built on fs.entries and fs.is_directory.
+-- usage: lua bench/fs_walk.lua [directory]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local fs = require 'std.fs'
+local path = require 'std.path'
+local time = require 'std.time'
+
+local root = arg and arg[1] or '/usr'
+
+local function lua_walk(dir)
+  local n = 0
+  local ok, iter, state, init, closing = pcall(fs.entries, dir)
+  if not (ok and iter) then
+    return n
+  end
+  for name in iter, state, init, closing do
+    if name == '.' or name == '..' then
+      goto continue
+    end
+    local p = path.combine(dir, name)
+    n = n + 1
+    local ok, is_directory = pcall(fs.is_directory, p)
+    if ok and is_directory and not fs.is_symlink(p) then
+      n = n + lua_walk(p)
+    end
+    ::continue::
+  end
+  return n
+end
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-32s %10d entries %10.1f ms %12.0f entries/s'):format(label, n, dt / 1e6, n / (dt / 1e9)))
+end
+
+measure('fs.entries + fs.is_directory', function()
+  return lua_walk(root)
+end)
+measure('fs.walk', function()
+  local n = 0
+  for _ in fs.walk(root) do
+    n = n + 1
+  end
+  return n
+end)
+for _, threads in ipairs({2, 4, 8}) do
+  measure(('fs.walk (%d threads, batch 256)'):format(threads), function()
+    local n = 0
+    for paths in fs.walk(root, {threads = threads, batch = 256}) do
+      n = n + #paths
+    end
+    return n
+  end)
+end
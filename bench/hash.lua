@@ -0,0 +1,54 @@
+-- Compares the std.hash string engine against the previous 64 characters sampler.
+-- usage: lua bench/hash.lua
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local hash = require 'std.hash'
+local time = require 'std.time'
+
+-- the sampler used by hash.hash before the full-length engine
+local function sampler(s)
+  local len = #s
+  local step = (len >> 6) + 1
+  local h = len & 0xffffffff
+  for i = 1, len, step do
+    h = ((h << 2) + (h >> 2) + s:byte(i)) & 0xffffffff
+  end
+  return h
+end
+
+local function throughput(label, f, s, iterations)
+  local t0 = time.perf_counter_ns()
+  for _ = 1, iterations do
+    f(s)
+  end
+  local dt = time.perf_counter_ns() - t0
+  print(('%-28s %8d bytes %10.3f GB/s %10.1f ns/call'):format(label, #s, #s * iterations / dt, dt / iterations))
+end
+
+local function collisions(label, f, keys)
+  local seen, n = {}, 0
+  for i = 1, #keys do
+    local h = f(keys[i]) & 0xffffffff
+    if seen[h] then
+      n = n + 1
+    end
+    seen[h] = true
+  end
+  print(('%-28s %8d keys %10d collisions'):format(label, #keys, n))
+end
+
+for _, size in ipairs {16, 64, 256, 4096, 65536, 1 << 20} do
+  local s = ('x'):rep(size)
+  local iterations = math.max(10, (1 << 28) // size // 16)
+  throughput('hash.string', hash.string, s, iterations)
+  throughput('sampler', sampler, s, iterations // 16 + 1)
+end
+
+local keys = {}
+local prefix = 'https://example.com/a/rather/long/and/shared/prefix/for/every/key/in/the/set/'
+for i = 1, 100000 do
+  keys[i] = prefix .. i
+end
+collisions('hash.hash', hash.hash, keys)
+collisions('sampler', sampler, keys)
@@ -0,0 +1,60 @@
+-- Compares array.distinct with a custom comparer against its hashed version and a std.hashmap set.
+-- usage: lua bench/hashmap.lua
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local array = require 'std.array'
+local hash = require 'std.hash'
+local hashmap = require 'std.hashmap'
+local tablex = require 'std.tablex'
+local time = require 'std.time'
+
+local function measure(label, n, f)
+  local t0 = time.perf_counter_ns()
+  local r = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-32s %8d items %8d distinct %12.3f ms'):format(label, n, #r, dt / 1e6))
+end
+
+local function points(n)
+  local a = {}
+  for i = 1, n do
+    a[i] = {x = i % (n // 2), y = 0}
+  end
+  return a
+end
+
+for _, n in ipairs({1000, 10000, 100000}) do
+  local a = points(n)
+  if n <= 1000 then
+    measure('distinct (eq)', n, function()
+      return array.distinct(a, tablex.eq)
+    end)
+  end
+  measure('distinct (hasher)', n, function()
+    return array.distinct(a, tablex.eq, hash.deep)
+  end)
+  measure('hashmap.set', n, function()
+    local set, r = hashmap.set({eq = tablex.eq, hash = hash.deep, capacity = n}), {}
+    for i = 1, n do
+      if set:add(a[i]) then
+        r[#r + 1] = a[i]
+      end
+    end
+    return r
+  end)
+end
+
+local m = hashmap.map()
+local n = 1000000
+local t0 = time.perf_counter_ns()
+for i = 1, n do
+  m:put(i, i)
+end
+for i = 1, n do
+  m:get(i)
+end
+local dt = time.perf_counter_ns() - t0
+local stats = m:stats()
+print(('%-32s %8d items %10.1f ns/op  load %.2f  max probe %d  mean probe %.2f'):format('hashmap.map put+get', n,
+  dt / (2 * n), stats.load_factor, stats.max_probe, stats.mean_probe))
@@ -0,0 +1,51 @@
+-- Compares the latency percentiles of std.histogram against sorting the samples in Lua.
+-- usage: lua bench/histogram.lua [samples]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local histogram = require 'std.histogram'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 1000000
+
+-- log-normal latencies around 100 microseconds
+math.randomseed(42)
+local samples = {}
+for i = 1, count do
+  local u1, u2 = math.random(), math.random()
+  local z = math.sqrt(-2 * math.log(1 - u1)) * math.cos(2 * math.pi * u2)
+  samples[i] = math.floor(100000 * math.exp(z * 0.5))
+end
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local kb0 = collectgarbage('count')
+  local t0 = time.perf_counter_ns()
+  local p50, p99, p999 = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-28s %10.1f ms %8.1f ns/sample %10d kB  p50 %d p99 %d p99.9 %d'):format(label, dt / 1e6, dt / count,
+    math.floor(collectgarbage('count') - kb0), p50, p99, p999))
+end
+
+measure('table + table.sort', function()
+  local t = {}
+  for i = 1, count do
+    t[i] = samples[i]
+  end
+  table.sort(t)
+  local function at(p)
+    return t[math.max(1, math.ceil(#t * p / 100))]
+  end
+  return at(50), at(99), at(99.9)
+end)
+
+measure('histogram', function()
+  local h = histogram.new()
+  local record = h.record
+  for i = 1, count do
+    record(h, samples[i])
+  end
+  local p50, p99, p999 = h:percentile(50, 99, 99.9)
+  return p50, p99, p999
+end)
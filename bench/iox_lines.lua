@@ -0,0 +1,59 @@
+-- Compares iox.lines_chunked against io.lines and iox.read_lines on a large text file.
+-- usage: lua bench/iox_lines.lua [size in MiB]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local iox = require 'std.iox'
+local time = require 'std.time'
+
+local size = (tonumber(arg and arg[1]) or 256) * 1024 * 1024
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d lines %10.1f ms %8.1f MiB/s'):format(label, n, dt / 1e6, size / 1048576 / (dt / 1e9)))
+end
+
+local filename = os.tmpname()
+do
+  local lines = {}
+  for i = 1, 1000 do
+    lines[i] = ('%d,%s,%d'):format(i, string.rep(string.char(97 + i % 26), i % 120), i * 7)
+  end
+  local block = table.concat(lines, '\n') .. '\n'
+  local f = assert(io.open(filename, 'wb'))
+  for _ = 1, size // #block do
+    f:write(block)
+  end
+  f:close()
+end
+
+measure('io.lines', function()
+  local n = 0
+  for _ in io.lines(filename) do
+    n = n + 1
+  end
+  return n
+end)
+measure('iox.read_lines', function()
+  return #assert(iox.read_lines(filename))
+end)
+measure('iox.lines_chunked', function()
+  local n = 0
+  for _ in iox.lines_chunked(filename) do
+    n = n + 1
+  end
+  return n
+end)
+for _, batch in ipairs({64, 1024}) do
+  measure(('iox.lines_chunked (batch %d)'):format(batch), function()
+    local n = 0
+    for _, k in iox.lines_chunked(filename, {batch = batch}) do
+      n = n + k
+    end
+    return n
+  end)
+end
+
+os.remove(filename)
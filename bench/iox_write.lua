@@ -0,0 +1,47 @@
+-- Compares iox.write_lines against writing the lines one at a time with file:write.
+-- usage: lua bench/iox_write.lua [number of lines]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local iox = require 'std.iox'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 2000000
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d lines %10.1f ms %12.0f lines/s'):format(label, count, dt / 1e6, count / (dt / 1e9)))
+end
+
+local lines = {}
+for i = 1, count do
+  lines[i] = ('%d,%s,%d'):format(i, string.rep(string.char(97 + i % 26), i % 60), i * 7)
+end
+
+local filename = os.tmpname()
+
+measure('file:write per line', function()
+  local fh <close> = assert(io.open(filename, 'w'))
+  for i = 1, #lines do
+    fh:write(lines[i], '\n')
+  end
+end)
+measure('iox.write_lines', function()
+  assert(iox.write_lines(filename, lines))
+end)
+measure('iox.write_lines (hwm 64 KiB)', function()
+  assert(iox.write_lines(filename, lines, {hwm = 64 * 1024}))
+end)
+measure('iox.write_lines (atomic)', function()
+  assert(iox.write_lines(filename, lines, {atomic = true}))
+end)
+measure('iox.write_lines (sync data)', function()
+  assert(iox.write_lines(filename, lines, {sync = 'data'}))
+end)
+measure('iox.write_lines (sync direct)', function()
+  assert(iox.write_lines(filename, lines, {sync = 'direct'}))
+end)
+
+os.remove(filename)
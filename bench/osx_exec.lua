@@ -0,0 +1,61 @@
+-- Compares running commands through os.execute and temporary files against std.osx.exec and exec_many.
+-- usage: lua bench/osx_exec.lua [commands]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local osx = require 'std.osx'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 200
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-36s %10.1f ms %10.1f us/command'):format(label, dt / 1e6, dt / count / 1e3))
+end
+
+-- the former implementation of osx.exec
+local function exec_shell(name, args)
+  local out_file, err_file = os.tmpname(), os.tmpname()
+  local ok = os.execute(name .. ' ' .. args .. ' >' .. out_file .. ' 2>' .. err_file)
+  local f = assert(io.open(out_file))
+  local out = f:read('a')
+  f:close()
+  f = assert(io.open(err_file))
+  local err = f:read('a')
+  f:close()
+  os.remove(out_file)
+  os.remove(err_file)
+  return ok, out, err
+end
+
+measure('os.execute + temporary files', function()
+  for i = 1, count do
+    assert(exec_shell('echo', tostring(i)))
+  end
+end)
+
+measure('osx.exec (shell)', function()
+  for i = 1, count do
+    assert(osx.exec({name = 'echo', args = tostring(i)}))
+  end
+end)
+
+measure('osx.exec (argument list)', function()
+  for i = 1, count do
+    assert(osx.exec({name = 'echo', arg_list = {tostring(i)}}))
+  end
+end)
+
+for _, concurrency in ipairs({1, 4, 16}) do
+  local cmds = {}
+  for i = 1, count do
+    cmds[i] = {name = 'echo', arg_list = {tostring(i)}}
+  end
+  measure(('osx.exec_many (concurrency %d)'):format(concurrency), function()
+    for _, r in ipairs(osx.exec_many(cmds, {concurrency = concurrency})) do
+      assert(r.ok)
+    end
+  end)
+end
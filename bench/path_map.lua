@@ -0,0 +1,47 @@
+-- Compares path.normalize, path.full_path and path.combine called for each path of a manifest
+-- against path.map over the whole manifest.
+-- usage: lua bench/path_map.lua [paths]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 200000
+
+-- relative paths of a source tree, some of them not normalized
+math.randomseed(42)
+local dirs = {'src', 'lib', 'include', 'test', 'docs', 'vendor', 'build', 'tools'}
+local paths = {}
+for i = 1, count do
+  local parts = {}
+  for j = 1, math.random(2, 6) do
+    parts[j] = dirs[math.random(#dirs)]
+  end
+  parts[#parts + 1] = ('file%d.c'):format(i)
+  local sep = i % 4 == 0 and '//' or '/'
+  paths[i] = table.concat(parts, sep)
+end
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-32s %10.1f ms %8.1f ns/path'):format(label, dt / 1e6, dt / count))
+end
+
+for _, op in ipairs({'normalize', 'full_path', 'combine'}) do
+  local f = path[op]
+  local arg = op == 'combine' and 'out' or nil
+  measure(('path.%s (loop)'):format(op), function()
+    local results = {}
+    for i = 1, count do
+      results[i] = f(paths[i], arg)
+    end
+  end)
+  measure(('path.map(%q)'):format(op), function()
+    path.map(op, paths, arg)
+  end)
+end
@@ -0,0 +1,95 @@
+-- Compares walking up the directories of paths and reading their parts with the path functions on
+-- strings against Path objects.
+-- usage: lua bench/path_object.lua [paths]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 200000
+
+-- the files of a build graph, in a few hundred directories
+math.randomseed(42)
+local names = {'src', 'lib', 'core', 'net', 'io', 'util', 'test', 'gen'}
+local files = {}
+for i = 1, count do
+  local parts = {'', 'work', 'project'}
+  for j = 1, math.random(2, 5) do
+    parts[#parts + 1] = names[math.random(#names)]
+  end
+  parts[#parts + 1] = ('unit%d.%s'):format(i, i % 3 == 0 and 'h' or 'c')
+  files[i] = table.concat(parts, path.DIRSEP)
+end
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-34s %10.1f ms %8.1f ns/path %10d'):format(label, dt / 1e6, dt / count, n))
+end
+
+-- the number of directories of each file and the number of headers
+measure('strings: parent, extension', function()
+  local n = 0
+  for i = 1, count do
+    local p = files[i]
+    if path.extension(p) == 'h' then n = n + 1 end
+    local dir = path.parent(p)
+    while dir do
+      n = n + 1
+      dir = path.parent(dir)
+    end
+  end
+  return n
+end)
+
+local paths = {}
+measure('Path: new', function()
+  for i = 1, count do
+    paths[i] = path.new(files[i])
+  end
+  return #paths
+end)
+
+for round = 1, 2 do
+  measure(('Path: parent, extension (%d)'):format(round), function()
+    local n = 0
+    for i = 1, count do
+      local p = paths[i]
+      if p:extension() == 'h' then n = n + 1 end
+      local dir = p:parent()
+      while dir do
+        n = n + 1
+        dir = dir:parent()
+      end
+    end
+    return n
+  end)
+end
+
+measure('strings: file name of the parent', function()
+  local n = 0
+  for i = 1, count do
+    n = n + #path.file_name(path.parent(files[i]))
+  end
+  return n
+end)
+
+measure('Path: file name of the parent', function()
+  local n = 0
+  for i = 1, count do
+    n = n + #paths[i]:parent():file_name()
+  end
+  return n
+end)
+
+measure('Path: segment', function()
+  local n = 0
+  for i = 1, count do
+    n = n + #paths[i]:part(-2)
+  end
+  return n
+end)
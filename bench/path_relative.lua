@@ -0,0 +1,99 @@
+-- Compares path.relative, path.relative_all and path.common_prefix with their Lua equivalents
+-- splitting the paths into tables of segments.
+-- usage: lua bench/path_relative.lua [paths]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 100000
+
+math.randomseed(42)
+local words = {'src', 'include', 'lib', 'test', 'internal', 'platform', 'generated', 'resources'}
+local base = '/home/builder/workspace/project/src'
+local paths = {}
+for i = 1, count do
+  local parts = {base}
+  if i % 4 == 0 then
+    parts[1] = '/home/builder/workspace/vendor'
+  end
+  for _ = 1, math.random(1, 6) do
+    parts[#parts + 1] = words[math.random(#words)]
+  end
+  parts[#parts + 1] = ('module_%d.c'):format(i)
+  paths[i] = table.concat(parts, '/')
+end
+
+local function split(p)
+  local segments = {}
+  for segment in p:gmatch('[^/]+') do
+    segments[#segments + 1] = segment
+  end
+  return segments
+end
+
+local function lua_relative(from, to)
+  local a, b = split(from), split(to)
+  local i = 1
+  while a[i] and a[i] == b[i] do
+    i = i + 1
+  end
+  local result = {}
+  for _ = i, #a do
+    result[#result + 1] = '..'
+  end
+  for j = i, #b do
+    result[#result + 1] = b[j]
+  end
+  return #result > 0 and table.concat(result, '/') or '.'
+end
+
+local function lua_common_prefix(list)
+  local prefix = split(list[1])
+  local n = #prefix
+  for i = 2, #list do
+    local segments = split(list[i])
+    local j = 1
+    while j <= n and prefix[j] == segments[j] do
+      j = j + 1
+    end
+    n = j - 1
+  end
+  return '/' .. table.concat(prefix, '/', 1, n)
+end
+
+for i = 1, 100 do
+  assert(path.relative(base, paths[i]) == lua_relative(base, paths[i]))
+end
+assert(path.common_prefix(paths) == lua_common_prefix(paths))
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-28s %10.1f ms %8.1f ns/path'):format(label, dt / 1e6, dt / count))
+end
+
+print(('%d paths'):format(count))
+measure('relative (Lua)', function()
+  for i = 1, count do
+    lua_relative(base, paths[i])
+  end
+end)
+measure('relative', function()
+  for i = 1, count do
+    path.relative(base, paths[i])
+  end
+end)
+measure('relative_all', function()
+  path.relative_all(base, paths)
+end)
+measure('common_prefix (Lua)', function()
+  lua_common_prefix(paths)
+end)
+measure('common_prefix', function()
+  path.common_prefix(paths)
+end)
@@ -0,0 +1,53 @@
+-- Compares the physical resolution of paths by path.canonicalize, path.resolve without and with a
+-- cache, and the lexical one, over the files of a tree reached through a symbolic link.
+-- usage: lua bench/path_resolve.lua [files]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 10000
+
+local root = path.canonicalize(path.parent(os.tmpname())) .. '/' .. path.random_file_name()
+local dirs = math.max(1, math.floor(math.sqrt(count / 100)))
+local paths = {}
+os.execute(("mkdir -p '%s/releases/v1' && ln -s releases/v1 '%s/current'"):format(root, root))
+for i = 1, count do
+  local dir = ('src/pkg%d/mod%d'):format(i % dirs, i // dirs % dirs)
+  if i <= dirs * dirs then
+    os.execute(("mkdir -p '%s/releases/v1/%s'"):format(root, dir))
+  end
+  local file = ('%s/file%d.c'):format(dir, i)
+  assert(io.open(('%s/releases/v1/%s'):format(root, file), 'w')):close()
+  paths[i] = ('%s/current/./%s'):format(root, file)
+end
+print(('%d files in %d directories'):format(count, dirs * dirs))
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  for i = 1, count do
+    assert(f(paths[i]))
+  end
+  local dt = time.perf_counter_ns() - t0
+  print(('%-24s %10.1f ms %8.1f ns/path'):format(label, dt / 1e6, dt / count))
+end
+
+local cache = path.resolve_cache()
+measure('canonicalize', path.canonicalize)
+measure('resolve', path.resolve)
+measure('resolve (cache)', function(p)
+  return path.resolve(p, {cache = cache})
+end)
+measure('resolve (warm cache)', function(p)
+  return path.resolve(p, {cache = cache})
+end)
+measure('resolve (lexical)', function(p)
+  return path.resolve(p, {lexical = true})
+end)
+local stats = cache:stats()
+print(('cache: %d entries, %d hits, %d misses'):format(stats.entries, stats.hits, stats.misses))
+
+os.execute(("rm -rf '%s'"):format(root))
@@ -0,0 +1,57 @@
+-- Measures the std.path functions that scan the separators, the dots and the invalid characters,
+-- over a corpus of paths like those of a source tree and of a package cache.
+-- usage: lua bench/path_scan.lua [paths]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local path = require 'std.path'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 100000
+
+math.randomseed(42)
+local words = {'src', 'include', 'node_modules', 'lib', 'test', 'internal', 'platform', 'generated', 'v1.2.3',
+  'com.example.service', 'resources', '.cache'}
+local paths = {}
+for i = 1, count do
+  local parts = {'', 'home', 'builder', 'workspace'}
+  for _ = 1, math.random(2, 9) do
+    parts[#parts + 1] = words[math.random(#words)]
+  end
+  parts[#parts + 1] = ('module_%d.%s'):format(i, i % 2 == 0 and 'tar.gz' or 'cpp')
+  local p = table.concat(parts, '/')
+  if i % 8 == 0 then
+    p = p:gsub('/lib/', '/lib/../lib//./')
+  end
+  paths[i] = p
+end
+
+local total = 0
+for i = 1, count do
+  total = total + #paths[i]
+end
+print(('%d paths, %.1f bytes on average'):format(count, total / count))
+
+local function measure(label, f)
+  collectgarbage()
+  collectgarbage()
+  local t0 = time.perf_counter_ns()
+  for i = 1, count do
+    f(paths[i])
+  end
+  local dt = time.perf_counter_ns() - t0
+  print(('%-24s %10.1f ms %8.1f ns/path'):format(label, dt / 1e6, dt / count))
+end
+
+measure('is_valid_path', path.is_valid_path)
+measure('extension', path.extension)
+measure('parent', path.parent)
+measure('file_name', path.file_name)
+measure('normalize', path.normalize)
+measure('full_path', path.full_path)
+measure('starts_with', function(p)
+  return path.starts_with(p, '/home/builder/workspace/src')
+end)
+measure('ends_with', function(p)
+  return path.ends_with(p, 'lib/module.cpp')
+end)
@@ -0,0 +1,67 @@
+-- Measures the overhead of std.profile on CPU-bound Lua code, per mode and interval.
+-- usage: lua bench/profile.lua [rounds]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local profile = require 'std.profile'
+local time = require 'std.time'
+
+local rounds = tonumber(arg and arg[1]) or 5
+
+local function fib(n)
+  if n < 2 then
+    return n
+  end
+  return fib(n - 1) + fib(n - 2)
+end
+
+local function words(n)
+  local t = {}
+  for i = 1, n do
+    t[#t + 1] = ('%x'):format(i * 7919)
+  end
+  table.sort(t)
+  return table.concat(t, ' ')
+end
+
+local function workload()
+  for _ = 1, 4 do
+    fib(24)
+    words(20000)
+  end
+end
+
+-- the best time of some rounds, to leave out the noise
+local function run(opts)
+  local best = math.huge
+  for _ = 1, rounds do
+    if opts then
+      profile.reset()
+      profile.start(opts)
+    end
+    local t0 = time.perf_counter_ns()
+    workload()
+    local dt = time.perf_counter_ns() - t0
+    if opts then
+      profile.stop()
+    end
+    best = math.min(best, dt)
+  end
+  return best
+end
+
+local baseline = run()
+print(('%-32s %10.1f ms'):format('no profiler', baseline / 1e6))
+
+local function measure(label, opts)
+  local dt = run(opts)
+  local _, samples = profile.report()
+  print(('%-32s %10.1f ms %+8.2f %% %8d samples'):format(label, dt / 1e6, (dt - baseline) * 100 / baseline, samples))
+end
+
+measure('timer, 10 ms', {interval = 10000})
+measure('timer, 1 ms', {interval = 1000})
+measure('timer, 100 us', {interval = 100})
+measure('count, 1000000 instructions', {mode = 'count', interval = 1000000})
+measure('count, 100000 instructions', {mode = 'count', interval = 100000})
+measure('count, 1000 instructions', {mode = 'count', interval = 1000})
@@ -0,0 +1,76 @@
+-- Measures the timer churn of std.sched: adding, cancelling and expiring many timers, and sleeping tasks.
+-- usage: lua bench/sched_timers.lua [number of timers]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local sched = require 'std.sched'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 100000
+
+local function measure(label, f)
+  local t0 = time.perf_counter_ns()
+  local n = f()
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d ops %10.1f ms %12.0f ops/s'):format(label, n, dt / 1e6, n / (dt / 1e9)))
+end
+
+local function noop()
+end
+
+-- the deadlines are spread over the first three levels of the wheel
+local function delay(i)
+  return (i * 7919) % 600000 + 1
+end
+
+local s = sched.new()
+local ids = {}
+
+measure('after', function()
+  for i = 1, count do
+    ids[i] = s:after(delay(i), noop)
+  end
+  return count
+end)
+
+measure('cancel', function()
+  for i = 1, count do
+    s:cancel(ids[i])
+  end
+  return count
+end)
+
+measure('after + cancel, ' .. count .. ' pending', function()
+  for i = 1, count do
+    ids[i] = s:after(delay(i), noop)
+  end
+  local n = count * 10
+  for i = 1, n do
+    local j = i % count + 1
+    s:cancel(ids[j])
+    ids[j] = s:after(delay(i), noop)
+  end
+  for i = 1, count do
+    s:cancel(ids[i])
+  end
+  return n * 2
+end)
+
+measure('after + run, 0-50 ms', function()
+  for i = 1, count do
+    s:after(i % 50, noop)
+  end
+  s:run()
+  return count
+end)
+
+measure('spawn + sleep + run, 0-50 ms', function()
+  for i = 1, count do
+    s:spawn(function()
+      sched.sleep(i % 50)
+      sched.sleep(1)
+    end)
+  end
+  s:run()
+  return count * 2
+end)
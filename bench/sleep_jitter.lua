@@ -0,0 +1,60 @@
+-- Measures how late the sleeps of std.sleep wake up, per mode and timer slack.
+-- usage: lua bench/sleep_jitter.lua [iterations]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local sleep = require 'std.sleep'
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 1000
+
+local function percentile(sorted, p)
+  return sorted[math.max(1, math.ceil(#sorted * p))]
+end
+
+local function measure(label, wait, f)
+  local overshoots = {}
+  for i = 1, count do
+    overshoots[i] = f(wait)
+  end
+  table.sort(overshoots)
+  print(('%-36s %8d us %10.1f us p50 %10.1f us p99 %10.1f us max'):format(label, wait // 1000,
+    percentile(overshoots, 0.5) / 1e3, percentile(overshoots, 0.99) / 1e3, overshoots[#overshoots] / 1e3))
+end
+
+local function relative(wait)
+  local t0 = time.monotonic_ns()
+  sleep.sleep_ns(wait)
+  return time.monotonic_ns() - t0 - wait
+end
+
+local function absolute(mode)
+  return function(wait)
+    return sleep.until_ns(time.monotonic_ns() + wait, mode)
+  end
+end
+
+local default_slack = sleep.timer_slack()
+for _, wait in ipairs({20000, 100000, 1000000}) do
+  measure('sleep_ns', wait, relative)
+  for _, mode in ipairs({'sleep', 'hybrid', 'spin'}) do
+    measure('until_ns ' .. mode, wait, absolute(mode))
+  end
+  if default_slack and sleep.set_timer_slack(1) then
+    measure('sleep_ns, 1 ns slack', wait, relative)
+    measure('until_ns sleep, 1 ns slack', wait, absolute('sleep'))
+    sleep.set_timer_slack(default_slack)
+  end
+end
+
+-- a periodic loop: the deadlines advance by the period, whatever the overshoots
+local period = 1000000
+local t0 = time.monotonic_ns()
+local deadline = t0
+for _ = 1, count do
+  deadline = deadline + period
+  sleep.until_ns(deadline)
+end
+local drift = time.monotonic_ns() - t0 - count * period
+print(('%-36s %8d us %10.1f us drift over %d periods'):format('periodic until_ns sleep', period // 1000, drift / 1e3,
+  count))
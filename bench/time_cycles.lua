@@ -0,0 +1,38 @@
+-- Compares the overhead of reading the clocks of std.time against the cycle counter.
+-- usage: lua bench/time_cycles.lua [iterations]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local time = require 'std.time'
+
+local count = tonumber(arg and arg[1]) or 5000000
+
+local function measure(label, f)
+  f() -- the cycle counter is calibrated on the first call
+  local t0 = time.perf_counter_ns()
+  for _ = 1, count do
+    f()
+  end
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d calls %10.1f ms %10.1f ns/call'):format(label, count, dt / 1e6, dt / count))
+end
+
+local frequency, source = time.cycles_frequency()
+print(('cycle counter: %s at %.3f MHz'):format(source, frequency / 1e6))
+
+measure('empty loop', function()
+end)
+measure('os.clock', os.clock)
+measure('time.monotonic_ns', time.monotonic_ns)
+measure('time.perf_counter_ns', time.perf_counter_ns)
+measure('time.cycles', time.cycles)
+
+-- the cost of a timed section, converting the cycles to nanoseconds
+measure('perf_counter_ns pair', function()
+  local t0 = time.perf_counter_ns()
+  return time.perf_counter_ns() - t0
+end)
+measure('cycles pair + cycles_to_ns', function()
+  local c0 = time.cycles()
+  return time.cycles_to_ns(time.cycles() - c0)
+end)
@@ -0,0 +1,50 @@
+-- Measures the overhead of the spans of std.trace, against a stopwatch timing the same code.
+-- usage: lua bench/trace.lua [iterations]
+package.path = './src/?.lua;./src/?/init.lua;' .. package.path
+package.cpath = './?.so;./?/?.so;' .. package.cpath
+
+local stopwatch = require 'std.stopwatch'
+local time = require 'std.time'
+local trace = require 'std.trace'
+
+local count = tonumber(arg and arg[1]) or 2000000
+
+local function measure(label, f)
+  f()
+  local t0 = time.perf_counter_ns()
+  for _ = 1, count do
+    f()
+  end
+  local dt = time.perf_counter_ns() - t0
+  print(('%-40s %10d spans %10.1f ms %10.1f ns/span'):format(label, count, dt / 1e6, dt / count))
+end
+
+local tracer = trace.new()
+local quiet = trace.new({capacity = 0})
+local sw = stopwatch.start()
+
+measure('empty function', function()
+end)
+measure('stopwatch start/stop', function()
+  sw:start()
+  sw:stop()
+end)
+measure('time.cycles pair', function()
+  return time.cycles() - time.cycles()
+end)
+measure('tracer begin/finish', function()
+  tracer:begin('span')
+  tracer:finish()
+end)
+measure('tracer begin/finish, no events', function()
+  quiet:begin('span')
+  quiet:finish()
+end)
+measure('tracer span <close>', function()
+  local _ <close> = tracer:span('span')
+end)
+tracer:begin('outer')
+measure('tracer nested span <close>', function()
+  local _ <close> = tracer:span('inner')
+end)
+tracer:finish()
@@ -0,0 +1,187 @@
+#include "std.h"
+
+#if defined(_STD_UNIX)
+#include "libaio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libaio_pool.c"
+#if defined(_STD_LINUX)
+#include "libaio_uring.c"
+#endif
+
+struct aio_engine_s
+{
+    int backend;
+    size_t entries;   // the most requests in flight
+    size_t in_flight; // the requests submitted and not reaped yet
+    aio_pool_t *pool;
+#if defined(_STD_URING)
+    aio_uring_t *uring;
+#endif
+};
+
+void aioL_execute(aio_request_t *req)
+{
+    ssize_t n;
+    req->result = 0;
+    req->err = 0;
+    switch (req->op)
+    {
+        case AIO_OP_OPEN:
+            req->result = open(req->path, req->flags | O_CLOEXEC, req->mode);
+            break;
+        case AIO_OP_CLOSE:
+            req->result = close(req->fd);
+            break;
+        case AIO_OP_READ:
+            req->buf = (char *)malloc(req->len > 0 ? req->len : 1);
+            if (req->buf == NULL)
+            {
+                req->result = -1;
+                break;
+            }
+            do
+            {
+                n = req->offset < 0 ? read(req->fd, req->buf, req->len)
+                                    : pread(req->fd, req->buf, req->len, (off_t)req->offset);
+            } while (n == -1 && errno == EINTR);
+            req->result = n;
+            break;
+        case AIO_OP_WRITE:
+            do
+            {
+                n = req->offset < 0 ? write(req->fd, req->data, req->len)
+                                    : pwrite(req->fd, req->data, req->len, (off_t)req->offset);
+            } while (n == -1 && errno == EINTR);
+            req->result = n;
+            break;
+        case AIO_OP_FSYNC:
+            req->result = fsync(req->fd);
+            break;
+        case AIO_OP_STAT:
+            req->metadata = malloc(fsL_metadata_size());
+            req->result = req->metadata != NULL && fsL_metadata_at(AT_FDCWD, req->path, &req->stat_opts, req->metadata)
+                              ? 0
+                              : -1;
+            break;
+        case AIO_OP_RENAME:
+            req->result = fsL_rename(NULL, req->path, req->path2, true) ? 0 : -1;
+            break;
+        default:
+            req->result = -1;
+            errno = EINVAL;
+            break;
+    }
+    if (req->result < 0) req->err = errno;
+}
+
+aio_engine_t *aioL_open(int backend, unsigned int entries, int threads)
+{
+    aio_engine_t *e = (aio_engine_t *)calloc(1, sizeof(aio_engine_t));
+    if (e == NULL) return NULL;
+    e->entries = entries;
+
+#if defined(_STD_URING)
+    if (backend != AIO_BACKEND_THREADS)
+    {
+        e->uring = uring_open(entries);
+        if (e->uring != NULL)
+        {
+            e->backend = AIO_BACKEND_URING;
+            return e;
+        }
+        // the kernel may be too old, or io_uring may be disabled
+        if (backend == AIO_BACKEND_URING) goto ERROR;
+    }
+#else
+    if (backend == AIO_BACKEND_URING)
+    {
+        errno = ENOSYS;
+        goto ERROR;
+    }
+#endif
+
+    e->pool = pool_open(threads);
+    if (e->pool == NULL) goto ERROR;
+    e->backend = AIO_BACKEND_THREADS;
+    return e;
+
+ERROR:;
+    int err = errno;
+    free(e);
+    errno = err;
+    return NULL;
+}
+
+const char *aioL_backend(aio_engine_t *e)
+{
+    return e->backend == AIO_BACKEND_URING ? "io_uring" : "threads";
+}
+
+bool aioL_submit(aio_engine_t *e, aio_request_t *req)
+{
+    req->next = NULL;
+    req->result = 0;
+    req->err = 0;
+    req->buf = NULL;
+    req->metadata = NULL;
+    req->scratch = NULL;
+    if (e->in_flight >= e->entries)
+    {
+        errno = EAGAIN;
+        return false;
+    }
+#if defined(_STD_URING)
+    if (e->uring != NULL)
+    {
+        if (!uring_submit(e->uring, req)) return false;
+        e->in_flight++;
+        return true;
+    }
+#endif
+    pool_submit(e->pool, req);
+    e->in_flight++;
+    return true;
+}
+
+size_t aioL_reap(aio_engine_t *e, aio_request_t **out, size_t max, size_t min, int64_t timeout)
+{
+    if (min > e->in_flight) min = e->in_flight;
+    if (min > max) min = max;
+    size_t n;
+#if defined(_STD_URING)
+    if (e->uring != NULL)
+        n = uring_reap(e->uring, out, max, min, timeout);
+    else
+#endif
+        n = pool_reap(e->pool, out, max, min, timeout);
+    e->in_flight -= n;
+    return n;
+}
+
+size_t aioL_in_flight(aio_engine_t *e)
+{
+    return e->in_flight;
+}
+
+void aioL_close(aio_engine_t *e, void (*free_request)(aio_request_t *req))
+{
+    aio_request_t *reaped[64];
+    while (e->in_flight > 0)
+    {
+        size_t n = aioL_reap(e, reaped, 64, 1, -1);
+        // the ring failed: leak the requests rather than free buffers the kernel may still use
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) free_request(reaped[i]);
+    }
+#if defined(_STD_URING)
+    if (e->uring != NULL) uring_close(e->uring);
+#endif
+    if (e->pool != NULL) pool_close(e->pool);
+    free(e);
+}
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "std.h"
+#include "libfs.h"
+
+#include <lua.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_STD_UNIX)
+#include <sys/types.h>
+
+enum
+{
+    AIO_OP_OPEN,
+    AIO_OP_CLOSE,
+    AIO_OP_READ,
+    AIO_OP_WRITE,
+    AIO_OP_FSYNC,
+    AIO_OP_STAT,
+    AIO_OP_RENAME,
+    AIO_OP_COUNT
+};
+
+enum
+{
+    AIO_BACKEND_AUTO,
+    AIO_BACKEND_URING,
+    AIO_BACKEND_THREADS
+};
+
+typedef struct aio_request_s
+{
+    struct aio_request_s *next; // used by the engine
+    int op;
+    lua_Integer id;
+    // the arguments; the strings and the data to write are owned by the caller
+    int fd;
+    const char *path;
+    const char *path2;
+    int flags;
+    mode_t mode;
+    const char *data;
+    size_t len;
+    int64_t offset; // -1 for the current position
+    metadata_opts_t stat_opts;
+    // the results
+    int64_t result; // the descriptor opened or the bytes transferred
+    int err;        // 0 if the operation succeeded, otherwise the errno value
+    char *buf;      // the bytes read, allocated by the engine
+    void *metadata; // the metadata read, fsL_metadata_size() bytes allocated by the engine
+    void *scratch;  // used by the engine
+} aio_request_t;
+
+typedef struct aio_engine_s aio_engine_t;
+
+// Returns NULL, with errno set, if the engine cannot be created.
+aio_engine_t *aioL_open(int backend, unsigned int entries, int threads);
+const char *aioL_backend(aio_engine_t *e);
+// Queues a request, allocated by the caller; fails with EAGAIN if `entries` requests are in flight.
+bool aioL_submit(aio_engine_t *e, aio_request_t *req);
+// Waits up to `timeout` nanoseconds, or forever if negative, for at least `min` completed requests,
+// and returns up to `max` of them in `out`.
+size_t aioL_reap(aio_engine_t *e, aio_request_t **out, size_t max, size_t min, int64_t timeout);
+size_t aioL_in_flight(aio_engine_t *e);
+// Waits for the requests in flight, frees them, and then frees the engine.
+void aioL_close(aio_engine_t *e, void (*free_request)(aio_request_t *req));
+
+// Runs a request synchronously; used by the thread pool.
+void aioL_execute(aio_request_t *req);
+#endif
@@ -0,0 +1,172 @@
+#include "libaio.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The thread pool backend: the requests are run synchronously by worker threads. Regular files are
+// always "ready" for epoll and friends, so the completions are signalled with a condition variable.
+
+#define POOL_MAX_THREADS 256
+
+typedef struct
+{
+    pthread_t *threads;
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    aio_request_t *queue_head;
+    aio_request_t *queue_tail;
+    aio_request_t *done_head;
+    aio_request_t *done_tail;
+    size_t done_count;
+    size_t wanted; // the completions a waiting reaper needs, or 0
+    bool stopping;
+} aio_pool_t;
+
+#if defined(_STD_APPLE)
+// pthread_condattr_setclock is not available
+#define POOL_CLOCK CLOCK_REALTIME
+#else
+#define POOL_CLOCK CLOCK_MONOTONIC
+#endif
+
+static void *pool_worker(void *arg)
+{
+    aio_pool_t *p = (aio_pool_t *)arg;
+    pthread_mutex_lock(&p->lock);
+    for (;;)
+    {
+        while (p->queue_head == NULL && !p->stopping)
+        {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+        }
+        if (p->queue_head == NULL) break;
+
+        aio_request_t *req = p->queue_head;
+        p->queue_head = req->next;
+        if (p->queue_head == NULL) p->queue_tail = NULL;
+        pthread_mutex_unlock(&p->lock);
+
+        aioL_execute(req);
+
+        pthread_mutex_lock(&p->lock);
+        req->next = NULL;
+        if (p->done_tail != NULL)
+            p->done_tail->next = req;
+        else
+            p->done_head = req;
+        p->done_tail = req;
+        p->done_count++;
+        if (p->wanted > 0 && p->done_count >= p->wanted) pthread_cond_signal(&p->done_cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void pool_stop(aio_pool_t *p, int started)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < started; i++) pthread_join(p->threads[i], NULL);
+}
+
+static void pool_close(aio_pool_t *p)
+{
+    pool_stop(p, p->thread_count);
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_mutex_destroy(&p->lock);
+    free(p->threads);
+    free(p);
+}
+
+static aio_pool_t *pool_open(int threads)
+{
+    if (threads < 1) threads = 1;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    aio_pool_t *p = (aio_pool_t *)calloc(1, sizeof(aio_pool_t));
+    if (p == NULL) return NULL;
+    p->threads = (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+    if (p->threads == NULL)
+    {
+        free(p);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#if !defined(_STD_APPLE)
+    pthread_condattr_setclock(&attr, POOL_CLOCK);
+#endif
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (int i = 0; i < threads; i++)
+    {
+        int err = pthread_create(&p->threads[i], NULL, pool_worker, p);
+        if (err != 0)
+        {
+            p->thread_count = i;
+            pool_close(p);
+            errno = err;
+            return NULL;
+        }
+    }
+    p->thread_count = threads;
+    return p;
+}
+
+static void pool_submit(aio_pool_t *p, aio_request_t *req)
+{
+    pthread_mutex_lock(&p->lock);
+    if (p->queue_tail != NULL)
+        p->queue_tail->next = req;
+    else
+        p->queue_head = req;
+    p->queue_tail = req;
+    pthread_cond_signal(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static size_t pool_reap(aio_pool_t *p, aio_request_t **out, size_t max, size_t min, int64_t timeout)
+{
+    struct timespec deadline;
+    if (timeout > 0)
+    {
+        clock_gettime(POOL_CLOCK, &deadline);
+        int64_t nanos = (int64_t)deadline.tv_nsec + timeout % 1000000000;
+        deadline.tv_sec += (time_t)(timeout / 1000000000 + nanos / 1000000000);
+        deadline.tv_nsec = (long)(nanos % 1000000000);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    while (p->done_count < min && timeout != 0)
+    {
+        p->wanted = min;
+        int err = timeout < 0 ? pthread_cond_wait(&p->done_cond, &p->lock)
+                              : pthread_cond_timedwait(&p->done_cond, &p->lock, &deadline);
+        p->wanted = 0;
+        if (err == ETIMEDOUT) break;
+    }
+
+    size_t n = 0;
+    while (n < max && p->done_head != NULL)
+    {
+        aio_request_t *req = p->done_head;
+        p->done_head = req->next;
+        out[n++] = req;
+    }
+    if (p->done_head == NULL) p->done_tail = NULL;
+    p->done_count -= n;
+    pthread_mutex_unlock(&p->lock);
+    return n;
+}
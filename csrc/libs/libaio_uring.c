@@ -0,0 +1,295 @@
+#include "libaio.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// The io_uring backend, driven by the raw system calls. It needs the operations and the
+// timed waits of Linux 5.11; the thread pool is used on older kernels.
+#if defined(IORING_FEAT_EXT_ARG) && defined(STATX_BASIC_STATS) && defined(__NR_io_uring_setup)
+#define _STD_URING
+
+typedef struct
+{
+    int fd;
+    unsigned int sq_entries;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring; // the same as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned int to_submit; // the entries queued and not submitted yet
+} aio_uring_t;
+
+static const int uring_ops[AIO_OP_COUNT] = {
+    [AIO_OP_OPEN] = IORING_OP_OPENAT, [AIO_OP_CLOSE] = IORING_OP_CLOSE,   [AIO_OP_READ] = IORING_OP_READ,
+    [AIO_OP_WRITE] = IORING_OP_WRITE, [AIO_OP_FSYNC] = IORING_OP_FSYNC,   [AIO_OP_STAT] = IORING_OP_STATX,
+    [AIO_OP_RENAME] = IORING_OP_RENAMEAT,
+};
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg,
+                       size_t arg_size)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static bool uring_supports_ops(int fd)
+{
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, size);
+    if (probe == NULL) return false;
+    bool ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (int i = 0; ok && i < AIO_OP_COUNT; i++)
+    {
+        int op = uring_ops[i];
+        ok = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!ok) errno = ENOSYS;
+    return ok;
+}
+
+static void uring_close(aio_uring_t *u)
+{
+    if (u->sqes != NULL) munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != u->sq_ring) munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != NULL) munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+    free(u);
+}
+
+static aio_uring_t *uring_open(unsigned int entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd == -1) return NULL;
+
+    const unsigned int required = IORING_FEAT_EXT_ARG | IORING_FEAT_RW_CUR_POS | IORING_FEAT_NODROP;
+    if ((params.features & required) != required || !uring_supports_ops(fd))
+    {
+        close(fd);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    aio_uring_t *u = (aio_uring_t *)calloc(1, sizeof(aio_uring_t));
+    if (u == NULL)
+    {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    u->fd = fd;
+    u->sq_entries = params.sq_entries;
+    u->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    u->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && u->cq_ring_size > u->sq_ring_size) u->sq_ring_size = u->cq_ring_size;
+
+    void *sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) goto ERROR;
+    u->sq_ring = sq_ring;
+    if (single_mmap)
+    {
+        u->cq_ring = sq_ring;
+    }
+    else
+    {
+        void *cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                             IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) goto ERROR;
+        u->cq_ring = cq_ring;
+    }
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) goto ERROR;
+    u->sqes = (struct io_uring_sqe *)sqes;
+
+    char *sq = (char *)u->sq_ring;
+    u->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    u->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    u->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    u->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    char *cq = (char *)u->cq_ring;
+    u->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    u->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    u->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return u;
+
+ERROR:;
+    int err = errno;
+    uring_close(u);
+    errno = err;
+    return NULL;
+}
+
+// Hands the queued entries over to the kernel.
+static bool uring_flush(aio_uring_t *u)
+{
+    while (u->to_submit > 0)
+    {
+        int n = uring_enter(u->fd, u->to_submit, 0, 0, NULL, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        u->to_submit -= (unsigned int)n;
+    }
+    return true;
+}
+
+static bool uring_submit(aio_uring_t *u, aio_request_t *req)
+{
+    unsigned int tail = *u->sq_tail;
+    if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries && !uring_flush(u)) return false;
+
+    unsigned int index = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (__u8)uring_ops[req->op];
+    sqe->user_data = (__u64)(uintptr_t)req;
+    switch (req->op)
+    {
+        case AIO_OP_OPEN:
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (__u64)(uintptr_t)req->path;
+            sqe->len = req->mode;
+            sqe->open_flags = (__u32)(req->flags | O_CLOEXEC);
+            break;
+        case AIO_OP_CLOSE:
+        case AIO_OP_FSYNC:
+            sqe->fd = req->fd;
+            break;
+        case AIO_OP_READ:
+            req->buf = (char *)malloc(req->len > 0 ? req->len : 1);
+            if (req->buf == NULL) return false;
+            sqe->fd = req->fd;
+            sqe->addr = (__u64)(uintptr_t)req->buf;
+            sqe->len = (__u32)req->len;
+            sqe->off = req->offset < 0 ? (__u64)-1 : (__u64)req->offset;
+            break;
+        case AIO_OP_WRITE:
+            sqe->fd = req->fd;
+            sqe->addr = (__u64)(uintptr_t)req->data;
+            sqe->len = (__u32)req->len;
+            sqe->off = req->offset < 0 ? (__u64)-1 : (__u64)req->offset;
+            break;
+        case AIO_OP_STAT:
+            req->scratch = malloc(sizeof(struct statx));
+            if (req->scratch == NULL) return false;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (__u64)(uintptr_t)req->path;
+            sqe->len = fsL_statx_mask(req->stat_opts.fields);
+            sqe->off = (__u64)(uintptr_t)req->scratch;
+            sqe->statx_flags = req->stat_opts.follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+            break;
+        case AIO_OP_RENAME:
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (__u64)(uintptr_t)req->path;
+            sqe->len = (__u32)AT_FDCWD;
+            sqe->addr2 = (__u64)(uintptr_t)req->path2;
+            break;
+    }
+    u->sq_array[index] = index;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+    return true;
+}
+
+static void uring_complete(aio_request_t *req, int res)
+{
+    req->result = res < 0 ? -1 : res;
+    req->err = res < 0 ? -res : 0;
+    if (req->op == AIO_OP_STAT)
+    {
+        if (res >= 0)
+        {
+            req->metadata = malloc(fsL_metadata_size());
+            if (req->metadata != NULL)
+                fsL_metadata_from_statx((const struct statx *)req->scratch, req->stat_opts.fields, req->metadata);
+            else
+            {
+                req->result = -1;
+                req->err = ENOMEM;
+            }
+        }
+        free(req->scratch);
+        req->scratch = NULL;
+    }
+}
+
+static size_t uring_drain(aio_uring_t *u, aio_request_t **out, size_t n, size_t max)
+{
+    unsigned int head = *u->cq_head;
+    unsigned int tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    while (n < max && head != tail)
+    {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        aio_request_t *req = (aio_request_t *)(uintptr_t)cqe->user_data;
+        uring_complete(req, cqe->res);
+        out[n++] = req;
+        head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+static int64_t uring_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t uring_reap(aio_uring_t *u, aio_request_t **out, size_t max, size_t min, int64_t timeout)
+{
+    int64_t deadline = timeout > 0 ? uring_now() + timeout : 0;
+    size_t n = uring_drain(u, out, 0, max);
+    if (n >= min || timeout == 0)
+    {
+        // nothing to wait for: just submit the queued entries, and drain what they completed
+        if (u->to_submit > 0 && uring_flush(u)) n = uring_drain(u, out, n, max);
+        return n;
+    }
+
+    while (n < min)
+    {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeout > 0)
+        {
+            int64_t left = deadline - uring_now();
+            if (left < 0) left = 0;
+            ts.tv_sec = left / 1000000000;
+            ts.tv_nsec = left % 1000000000;
+            arg.ts = (__u64)(uintptr_t)&ts;
+        }
+        int r = uring_enter(u->fd, u->to_submit, (unsigned int)(min - n), IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                            &arg, sizeof(arg));
+        if (r >= 0) u->to_submit -= (unsigned int)r;
+        n = uring_drain(u, out, n, max);
+        if (r < 0 && errno != EINTR) break; // ETIME when the timeout expires
+    }
+    return n;
+}
+#endif
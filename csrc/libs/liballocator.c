@@ -6,14 +6,78 @@
 #include <stdint.h>
 #include <string.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 size_t __liballocator_size;
 
-#define _LIBALLOCATOR_SIZE_MAX (SIZE_MAX >> 1)
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+// the volatile accesses have the acquire and release semantics
+#define LOAD_ACQUIRE(p) (*(p))
+#define INCREMENT_RELEASE(p) _InterlockedIncrement(p)
+#else
+#define THREAD_LOCAL _Thread_local
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define INCREMENT_RELEASE(p) __atomic_add_fetch((p), 1, __ATOMIC_RELEASE)
+#endif
+
+#define _LIBALLOCATOR_SIZE_MAX (SIZE_MAX >> 2)
+
+// the state is shared by all the modules linking this library through the registry
+#define STATE_KEY "std.allocator.state"
+#define STATE_METATABLE_NAME "std.allocator"
+
+#define KIND_STACK 0
+#define KIND_HEAP 1
+#define KIND_SCRATCH 2
+#define KIND_SCRATCH_FREED 3
+
+// scratch blocks are aligned to this boundary and are preceded by a scratch_link_t
+#define SCRATCH_ALIGN 16
+#define SCRATCH_LINK_SIZE (2 * SCRATCH_ALIGN - _LIBALLOCATOR_HEADER_SIZE)
+#define SCRATCH_MIN_CAPACITY (16 * 1024)
+// scratch blocks allocated deeper than this in the call stack are only released by allocatorL_free
+#define SCRATCH_MAX_LEVELS 32
+
+// the number of copies of this library, one per module, which can cache a state
+#define MAX_COPIES 64
+
+// heap blocks whose size is a power of two in [2^POOL_MIN_SHIFT, 2^POOL_MAX_SHIFT] are pooled
+#define POOL_MIN_SHIFT 6
+#define POOL_MAX_SHIFT 16
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_MAX_BLOCKS 16
+
+// The owner of a scratch block: the call of the C function allocating it, identified by its depth in
+// the call stack of its Lua thread.
+typedef struct
+{
+    size_t prev; // 1 + the offset of the previous block, or 0
+    lua_State *L;
+    int depth; // 0 if the block was not allocated by a C function called by Lua, or too deep
+} scratch_link_t;
+
+typedef struct
+{
+    bool closed;
+    volatile long *generations[MAX_COPIES]; // the generations of the copies caching the state
+    int generation_count;
+    char *scratch;
+    size_t scratch_capacity;
+    size_t scratch_top;
+    size_t scratch_last;  // 1 + the offset of the last scratch block, or 0
+    size_t scratch_want;  // the capacity needed to serve the largest overflowing request
+    void *pools[POOL_CLASSES];
+    size_t pool_len[POOL_CLASSES];
+    allocator_stats_t stats;
+} allocator_state_t;
 
 size_t allocatorL_check_size(lua_State *L, size_t size)
 {
     if (size == 0) return 0;
-    if (size > _LIBALLOCATOR_SIZE_MAX - _LIBALLOCATOR_HEADER_SIZE)
+    if (size > _LIBALLOCATOR_SIZE_MAX - SCRATCH_ALIGN)
     {
         luaL_error(L, "memory allocation error: block too big");
     }
@@ -23,95 +87,389 @@ size_t allocatorL_check_size(lua_State *L, size_t size)
 size_t allocatorL_check_size2(lua_State *L, size_t n, size_t size)
 {
     if (n == 0 || size == 0) return 0;
-    if ((n * size) > UINTPTR_MAX || size > (_LIBALLOCATOR_SIZE_MAX - _LIBALLOCATOR_HEADER_SIZE) / n)
+    if ((n * size) > UINTPTR_MAX || size > (_LIBALLOCATOR_SIZE_MAX - SCRATCH_ALIGN) / n)
     {
         luaL_error(L, "memory allocation error: block too big");
     }
     return n * size;
 }
 
-static void *block_unwrap(void *block, size_t *size, int *on_heap)
+static void *block_unwrap(void *block, size_t *size, int *kind)
 {
     assert(block != NULL);
     void **p = (void **)block - 1;
-    *on_heap = (int)((uintptr_t)*p & 1);
-    *size = (size_t)((uintptr_t)*p >> 1);
+    *kind = (int)((uintptr_t)*p & 3);
+    *size = (size_t)((uintptr_t)*p >> 2);
     return (void *)p;
 }
 
-static void *block_wrap(void *block, size_t size, int on_heap)
+static void *block_wrap(void *block, size_t size, int kind)
 {
     void **p = (void **)block;
-    *p = (void *)(uintptr_t)((size << 1) | (size_t)on_heap);
+    *p = (void *)(uintptr_t)((size << 2) | (size_t)kind);
     return (void *)(p + 1);
 }
 
-static void *do_realloc0(lua_State *L, void *block, size_t old_size, size_t new_size)
+static void block_set_kind(void *block, int kind)
+{
+    void **p = (void **)block - 1;
+    *p = (void *)(((uintptr_t)*p & ~(uintptr_t)3) | (uintptr_t)kind);
+}
+
+static int state_gc(lua_State *L);
+
+// Each module links its own copy of this library, which caches the state last used by each thread to
+// spare the lookup in the registry; closing a state bumps the generation of the copies caching it, so
+// that a cache never outlives its state.
+static volatile long generation;
+static THREAD_LOCAL struct
+{
+    const void *registry;
+    long generation;
+    allocator_state_t *state;
+} cache;
+
+// Returns true if the generation of this copy is bumped when the state is closed.
+static bool watch_state(allocator_state_t *state)
+{
+    for (int i = 0; i < state->generation_count; i++)
+    {
+        if (state->generations[i] == &generation) return true;
+    }
+    if (state->generation_count == MAX_COPIES) return false;
+    state->generations[state->generation_count++] = &generation;
+    return true;
+}
+
+// Returns the allocator state of `L`, creating it if needed, or NULL if it is not available.
+static allocator_state_t *get_state(lua_State *L)
+{
+    const void *registry = lua_topointer(L, LUA_REGISTRYINDEX);
+    long current = LOAD_ACQUIRE(&generation);
+    if (cache.state != NULL && cache.registry == registry && cache.generation == current) return cache.state;
+    if (!lua_checkstack(L, 3)) return NULL;
+
+    allocator_state_t *state = NULL;
+    if (lua_getfield(L, LUA_REGISTRYINDEX, STATE_KEY) == LUA_TUSERDATA) // state
+    {
+        state = (allocator_state_t *)lua_touserdata(L, -1);
+        lua_pop(L, 1);
+        if (state->closed) return NULL;
+    }
+    else
+    {
+        lua_pop(L, 1);
+        state = (allocator_state_t *)lua_newuserdatauv(L, sizeof(allocator_state_t), 0); // state
+        memset(state, 0, sizeof(allocator_state_t));
+        if (luaL_newmetatable(L, STATE_METATABLE_NAME)) // state mt
+        {
+            lua_pushcfunction(L, state_gc); // state mt gc
+            lua_setfield(L, -2, "__gc");    // state mt
+        }
+        lua_setmetatable(L, -2);                       // state
+        lua_setfield(L, LUA_REGISTRYINDEX, STATE_KEY); //
+    }
+    if (watch_state(state))
+    {
+        cache.registry = registry;
+        cache.generation = current;
+        cache.state = state;
+    }
+    return state;
+}
+
+static void *do_realloc0(lua_State *L, allocator_state_t *state, void *block, size_t old_size, size_t new_size);
+
+static void do_free(lua_State *L, void *block, size_t size)
+{
+    void *ud;
+    lua_Alloc alloc = lua_getallocf(L, &ud);
+    alloc(ud, block, size, 0);
+}
+
+static void trim_pools(lua_State *L, allocator_state_t *state)
+{
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        size_t size = (size_t)1 << (i + POOL_MIN_SHIFT);
+        void *p = state->pools[i];
+        while (p != NULL)
+        {
+            void *next = *(void **)p;
+            do_free(L, p, size);
+            p = next;
+        }
+        state->stats.pooled_bytes -= state->pool_len[i] * size;
+        state->pools[i] = NULL;
+        state->pool_len[i] = 0;
+    }
+}
+
+static int state_gc(lua_State *L)
+{
+    allocator_state_t *state = (allocator_state_t *)lua_touserdata(L, 1);
+    if (state->closed) return 0;
+
+    trim_pools(L, state);
+    if (state->scratch != NULL) do_free(L, state->scratch, state->scratch_capacity);
+    state->scratch = NULL;
+    state->scratch_capacity = 0;
+    state->closed = true;
+    for (int i = 0; i < state->generation_count; i++)
+    {
+        INCREMENT_RELEASE(state->generations[i]);
+    }
+    return 0;
+}
+
+static void *do_realloc0(lua_State *L, allocator_state_t *state, void *block, size_t old_size, size_t new_size)
 {
     assert(new_size > 0);
 
     void *ud;
     lua_Alloc alloc = lua_getallocf(L, &ud);
-    block = alloc(ud, block, old_size, new_size);
-    if (block == NULL)
+    void *new_block = alloc(ud, block, old_size, new_size);
+    if (new_block == NULL && state != NULL)
+    {
+        // give the memory cached by the pools back before trying harder
+        trim_pools(L, state);
+        new_block = alloc(ud, block, old_size, new_size);
+    }
+    if (new_block == NULL)
     {
         lua_gc(L, LUA_GCCOLLECT, 0);
-        block = alloc(ud, block, old_size, new_size);
-        if (block == NULL)
+        new_block = alloc(ud, block, old_size, new_size);
+        if (new_block == NULL)
         {
             luaL_error(L, "memory allocation error: not enough memory");
         }
     }
-    return block;
+    if (state != NULL) state->stats.fallbacks++;
+    return new_block;
 }
 
-static void do_free(lua_State *L, void *block, size_t size)
+static inline void track_alloc(allocator_state_t *state, size_t size)
 {
-    void *ud;
-    lua_Alloc alloc = lua_getallocf(L, &ud);
-    alloc(ud, block, size, 0);
+    if (state == NULL) return;
+    state->stats.allocations++;
+    state->stats.bytes_allocated += size;
+    state->stats.bytes_in_use += size;
+    if (state->stats.bytes_in_use > state->stats.peak_bytes) state->stats.peak_bytes = state->stats.bytes_in_use;
 }
 
-static void *do_malloc(lua_State *L, size_t size)
+static inline void track_free(allocator_state_t *state, size_t size)
 {
-    void *block = do_realloc0(L, NULL, LUA_TNONE, size);
-    return block_wrap(block, size, 1);
+    if (state != NULL) state->stats.bytes_in_use -= size;
+}
+
+// Returns the pool class of a block size, or -1 if blocks of that size are not pooled.
+static int pool_class(size_t size)
+{
+    if (size < ((size_t)1 << POOL_MIN_SHIFT) || size > ((size_t)1 << POOL_MAX_SHIFT) || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+    int shift = 0;
+    while (((size_t)1 << shift) < size) shift++;
+    return shift - POOL_MIN_SHIFT;
+}
+
+static size_t pool_size(size_t size)
+{
+    size_t n = (size_t)1 << POOL_MIN_SHIFT;
+    while (n < size) n <<= 1;
+    return n;
+}
+
+// `size` includes the header.
+static void *do_malloc(lua_State *L, allocator_state_t *state, size_t size)
+{
+    if (state != NULL && size <= ((size_t)1 << POOL_MAX_SHIFT))
+    {
+        size = pool_size(size);
+        int i = pool_class(size);
+        void *block = state->pools[i];
+        if (block != NULL)
+        {
+            state->pools[i] = *(void **)block;
+            state->pool_len[i]--;
+            state->stats.pooled_bytes -= size;
+            state->stats.pool_hits++;
+            track_alloc(state, size);
+            return block_wrap(block, size, KIND_HEAP);
+        }
+    }
+
+    void *block = do_realloc0(L, state, NULL, LUA_TNONE, size);
+    track_alloc(state, size);
+    return block_wrap(block, size, KIND_HEAP);
+}
+
+static void heap_free(lua_State *L, allocator_state_t *state, void *block, size_t size)
+{
+    track_free(state, size);
+    int i = state != NULL ? pool_class(size) : -1;
+    if (i >= 0 && state->pool_len[i] < POOL_MAX_BLOCKS)
+    {
+        *(void **)block = state->pools[i];
+        state->pools[i] = block;
+        state->pool_len[i]++;
+        state->stats.pooled_bytes += size;
+        return;
+    }
+    do_free(L, block, size);
+}
+
+// Returns the number of calls in the call stack of `L`, or 0 if there are more than SCRATCH_MAX_LEVELS.
+static int call_depth(lua_State *L)
+{
+    lua_Debug ar;
+    if (lua_getstack(L, SCRATCH_MAX_LEVELS, &ar)) return 0;
+    // the level `low` - 1 exists, the level `high` does not
+    int low = 0, high = SCRATCH_MAX_LEVELS;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (lua_getstack(L, mid, &ar)) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Releases the last block of the arena if it was freed, or if `L` is given and the C function which
+// allocated the block on `L` has returned since: it was leaked by an error. That call is known to
+// have returned once the call stack of `L` is shallower than it was, so a block leaked by a call is
+// only released by an allocation of one of its callers, not by the next call at the same depth.
+static bool scratch_pop(allocator_state_t *state, lua_State *L)
+{
+    size_t offset = state->scratch_last - 1;
+    scratch_link_t *link = (scratch_link_t *)(void *)(state->scratch + offset);
+    size_t size;
+    int kind;
+    block_unwrap(state->scratch + offset + SCRATCH_LINK_SIZE + _LIBALLOCATOR_HEADER_SIZE, &size, &kind);
+    if (kind != KIND_SCRATCH_FREED)
+    {
+        lua_Debug ar;
+        if (L == NULL || link->L != L || link->depth == 0 || lua_getstack(L, link->depth - 1, &ar)) return false;
+        track_free(state, size);
+    }
+    state->scratch_top = offset;
+    state->scratch_last = link->prev;
+    return true;
+}
+
+// `size` includes the header; returns NULL if the arena cannot serve the request.
+static void *scratch_alloc(lua_State *L, allocator_state_t *state, size_t size)
+{
+    size_t need = (SCRATCH_LINK_SIZE + size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+    if (need > _LIBALLOCATOR_SCRATCH_MAX) return NULL;
+
+    while (state->scratch_last != 0 && scratch_pop(state, L))
+    {
+    }
+
+    if (state->scratch_top + need > state->scratch_capacity)
+    {
+        if (state->scratch_top + need > state->scratch_want) state->scratch_want = state->scratch_top + need;
+        // the arena is only moved while it is empty
+        if (state->scratch_top > 0) return NULL;
+
+        size_t capacity = state->scratch_capacity < SCRATCH_MIN_CAPACITY ? SCRATCH_MIN_CAPACITY
+                                                                          : state->scratch_capacity;
+        while (capacity < state->scratch_want && capacity < _LIBALLOCATOR_SCRATCH_MAX) capacity *= 2;
+        if (capacity > _LIBALLOCATOR_SCRATCH_MAX) capacity = _LIBALLOCATOR_SCRATCH_MAX;
+
+        char *scratch = (char *)do_realloc0(L, state, state->scratch, state->scratch_capacity, capacity);
+        state->scratch = scratch;
+        state->scratch_capacity = capacity;
+        state->stats.scratch_capacity = capacity;
+    }
+
+    size_t offset = state->scratch_top;
+    char *p = state->scratch + offset;
+    scratch_link_t *link = (scratch_link_t *)(void *)p;
+    link->prev = state->scratch_last;
+    link->L = L;
+    link->depth = call_depth(L);
+    state->scratch_last = offset + 1;
+    state->scratch_top = offset + need;
+    if (state->scratch_top > state->stats.scratch_peak) state->stats.scratch_peak = state->scratch_top;
+    track_alloc(state, size);
+    return block_wrap(p + SCRATCH_LINK_SIZE, size, KIND_SCRATCH);
+}
+
+// Releases a scratch block; the arena is truncated when the last block is released, and a block freed
+// before the blocks allocated after it is released with them.
+static void scratch_free(allocator_state_t *state, void *block, size_t size)
+{
+    track_free(state, size);
+    block_set_kind((char *)block + _LIBALLOCATOR_HEADER_SIZE, KIND_SCRATCH_FREED);
+    while (state->scratch_last != 0 && scratch_pop(state, NULL))
+    {
+    }
 }
 
 static void *do_realloc(lua_State *L, void *block, size_t size)
 {
+    allocator_state_t *state = get_state(L);
     if (block == NULL)
     {
-        return do_malloc(L, size);
+        return do_malloc(L, state, size);
     }
 
-    int on_heap;
+    int kind;
     size_t old_size;
-    block = block_unwrap(block, &old_size, &on_heap);
+    block = block_unwrap(block, &old_size, &kind);
 
-    void *new_block;
-    if (on_heap)
+    if (kind == KIND_HEAP)
     {
-        new_block = do_realloc0(L, block, old_size, size);
+        if (state != NULL && pool_class(old_size) >= 0 && size <= old_size)
+        {
+            return block_wrap(block, old_size, KIND_HEAP);
+        }
+        void *new_block = do_realloc0(L, state, block, old_size, size);
+        track_free(state, old_size);
+        track_alloc(state, size);
+        return block_wrap(new_block, size, KIND_HEAP);
     }
-    else
+
+    if (kind == KIND_SCRATCH && state != NULL)
     {
-        new_block = do_realloc0(L, NULL, LUA_TNONE, size);
-#if defined(_STD_WINDOWS)
-        memcpy_s(new_block, size, block, old_size < size ? old_size : size);
-#else
-        memcpy(new_block, block, old_size < size ? old_size : size);
-#endif
-        do_free(L, block, old_size);
+        // the last block of the arena is grown in place
+        char *p = (char *)block - SCRATCH_LINK_SIZE;
+        size_t offset = (size_t)(p - state->scratch);
+        size_t need = (SCRATCH_LINK_SIZE + size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+        if (offset + 1 == state->scratch_last && offset + need <= state->scratch_capacity)
+        {
+            state->scratch_top = offset + need;
+            if (state->scratch_top > state->stats.scratch_peak) state->stats.scratch_peak = state->scratch_top;
+            track_free(state, old_size);
+            track_alloc(state, size);
+            return block_wrap(block, size, KIND_SCRATCH);
+        }
     }
 
-    return block_wrap(new_block, size, 1);
+    void *new_block = do_malloc(L, state, size);
+    memcpy(new_block, (char *)block + _LIBALLOCATOR_HEADER_SIZE,
+           (old_size < size ? old_size : size) - _LIBALLOCATOR_HEADER_SIZE);
+    if (kind == KIND_SCRATCH && state != NULL) scratch_free(state, block, old_size);
+    return new_block;
 }
 
 void *allocatorL_init(lua_State *L, void *block, size_t size)
 {
-    int on_heap = block == NULL;
-    return on_heap ? do_malloc(L, size) : block_wrap(block, size, on_heap);
+    if (block != NULL) return block_wrap(block, size, KIND_STACK);
+
+    allocator_state_t *state = get_state(L);
+    if (state != NULL)
+    {
+        block = scratch_alloc(L, state, size);
+        if (block != NULL) return block;
+    }
+    // the arena is full or the block is too big for it
+    block = do_realloc0(L, state, NULL, LUA_TNONE, size);
+    track_alloc(state, size);
+    return block_wrap(block, size, KIND_HEAP);
 }
 
 void *allocatorL_realloc(lua_State *L, void *block, size_t size)
@@ -128,22 +486,44 @@ void *allocatorL_realloc(lua_State *L, void *block, size_t size)
 void *allocatorL_malloc(lua_State *L, size_t size)
 {
     size = allocatorL_check_size(L, size);
-    return size > 0 ? do_malloc(L, size + _LIBALLOCATOR_HEADER_SIZE) : NULL;
+    return size > 0 ? do_malloc(L, get_state(L), size + _LIBALLOCATOR_HEADER_SIZE) : NULL;
 }
 
 void allocatorL_free(lua_State *L, void *block)
 {
     if (block == NULL) return;
 
-    int on_heap;
+    int kind;
     size_t size;
-    block = block_unwrap(block, &size, &on_heap);
-    if (on_heap) do_free(L, block, size);
+    block = block_unwrap(block, &size, &kind);
+    if (kind == KIND_STACK) return;
+
+    allocator_state_t *state = get_state(L);
+    if (kind == KIND_HEAP)
+    {
+        heap_free(L, state, block, size);
+    }
+    else if (state != NULL)
+    {
+        scratch_free(state, block, size);
+    }
 }
 
 size_t allocatorL_size(void *block)
 {
     if (block == NULL) return 0;
     void **p = (void **)block - 1;
-    return (size_t)((uintptr_t)*p >> 1);
+    return (size_t)((uintptr_t)*p >> 2);
+}
+
+allocator_stats_t allocatorL_stats(lua_State *L)
+{
+    allocator_state_t *state = get_state(L);
+    if (state == NULL)
+    {
+        allocator_stats_t stats;
+        memset(&stats, 0, sizeof(stats));
+        return stats;
+    }
+    return state->stats;
 }
@@ -14,6 +14,21 @@
 
 #define _LIBALLOCATOR_HEAP_THRESHOLD 1024
 #define _LIBALLOCATOR_HEADER_SIZE sizeof(void *)
+// blocks bigger than this are never served by the scratch arena
+#define _LIBALLOCATOR_SCRATCH_MAX (1024 * 1024)
+
+typedef struct
+{
+    size_t allocations;      // number of blocks served by the arena, the pools or the heap
+    size_t bytes_allocated;  // total size of the blocks served
+    size_t bytes_in_use;     // size of the blocks not freed yet
+    size_t peak_bytes;       // highest value of bytes_in_use
+    size_t fallbacks;        // number of requests that reached the Lua allocator
+    size_t pool_hits;        // number of blocks reused from the pools
+    size_t pooled_bytes;     // size of the blocks cached by the pools
+    size_t scratch_capacity; // size of the scratch arena
+    size_t scratch_peak;     // highest number of bytes used in the scratch arena
+} allocator_stats_t;
 
 extern size_t __liballocator_size;
 
@@ -31,6 +46,14 @@ void *allocatorL_realloc(lua_State *L, void *block, size_t size);
     (__liballocator_size = allocatorL_check_size2(L, size, sizeof(T)), \
      allocatorL_realloc(L, block, __liballocator_size))
 
+// Temporary blocks: small ones live on the stack, bigger ones in a scratch arena shared by all the
+// modules of a Lua state. They must be freed before the C function allocating them returns, and not
+// be used across a yield. The arena is a stack: a block freed before the blocks allocated after it is
+// only reclaimed with them. A block left by a C function which raised an error is reclaimed by the
+// next allocation on the same Lua thread made by a shallower call, such as the caller of the pcall
+// which caught the error; blocks leaked again and again at the same depth, by a pcall in a loop, stay
+// pinned until then. The arena does not grow while it holds blocks, so they pin at most
+// _LIBALLOCATOR_SCRATCH_MAX bytes, and the requests it cannot serve above them fall back to the heap.
 #define allocatorL_alloc(L, size)                                                      \
     (__liballocator_size = allocatorL_check_size(L, size) + _LIBALLOCATOR_HEADER_SIZE, \
      __liballocator_size < _LIBALLOCATOR_HEAP_THRESHOLD                                \
@@ -45,3 +68,5 @@ void *allocatorL_realloc(lua_State *L, void *block, size_t size);
 
 void allocatorL_free(lua_State *L, void *block);
 size_t allocatorL_size(void *block);
+
+allocator_stats_t allocatorL_stats(lua_State *L);
@@ -4,8 +4,13 @@
 #include "libfs_win.c"
 #include "libfs_meta_win.c"
 #include "libfs_entries_win.c"
+#include "libfs_mmap_win.c"
+#include "libfs_write_win.c"
 #else
 #include "libfs_unix.c"
 #include "libfs_meta_unix.c"
 #include "libfs_entries_unix.c"
+#include "libfs_mmap_unix.c"
+#include "libfs_walk_unix.c"
+#include "libfs_write_unix.c"
 #endif
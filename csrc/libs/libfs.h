@@ -17,8 +17,18 @@ typedef struct open_opts_s
     bool exclusive : 1;
 } open_opts_t;
 
+typedef struct copy_opts_s
+{
+    bool overwrite : 1;
+    bool permissions : 1;
+    bool timestamps : 1;
+    bool sparse : 1;
+    int progress;                // the stack index of the progress function, or 0
+    uint64_t progress_interval; // the number of bytes between two calls to the progress function
+} copy_opts_t;
+
 bool fsL_rename(lua_State *L, const char *src, const char *dst, bool overwrite);
-bool fsL_copy_file(lua_State *L, const char *src, const char *dst, bool overwrite);
+bool fsL_copy_file(lua_State *L, const char *src, const char *dst, const copy_opts_t *opts);
 
 bool fsL_link(lua_State *L, const char *src, const char *dst);
 
@@ -47,12 +57,34 @@ bool fsL_is_fifo(lua_State *L, const char *path, bool *result);
 // userdata
 
 // metadata
-bool fsL_metadata(lua_State *L, const char *path);
+// the fields of the metadata; the type and the device are always read
+enum
+{
+    FS_FIELD_TYPE = 0x0001,
+    FS_FIELD_MODE = 0x0002,
+    FS_FIELD_LINKS = 0x0004,
+    FS_FIELD_INODE = 0x0008,
+    FS_FIELD_DEVICE = 0x0010,
+    FS_FIELD_LENGTH = 0x0020,
+    FS_FIELD_BLOCKS = 0x0040,
+    FS_FIELD_ACCESSED = 0x0080,
+    FS_FIELD_MODIFIED = 0x0100,
+    FS_FIELD_CHANGED = 0x0200,
+    FS_FIELD_CREATED = 0x0400,
+    FS_FIELD_ALL = 0x07FF
+};
+
+typedef struct metadata_opts_s
+{
+    unsigned int fields; // a combination of FS_FIELD_* values
+    bool follow_symlinks;
+} metadata_opts_t;
 
-lua_Integer fsL_metadata_length(void *ud);
-lua_Integer fsL_metadata_accessed(void *ud);
-lua_Integer fsL_metadata_modified(void *ud);
-lua_Integer fsL_metadata_created(void *ud);
+bool fsL_metadata(lua_State *L, const char *path, const metadata_opts_t *opts);
+
+// Returns false if the field was not requested or is not supported; times are in nanoseconds
+// since the Unix Epoch.
+bool fsL_metadata_field(void *ud, int field, lua_Integer *value);
 
 bool fsL_metadata_is_directory(void *ud);
 bool fsL_metadata_is_file(void *ud);
@@ -67,7 +99,130 @@ bool fsL_metadata_is_socket(void *ud);
 bool fsL_metadata_is_fifo(void *ud);
 #endif
 
+// entry types
+enum
+{
+    FS_TYPE_UNKNOWN,
+    FS_TYPE_FILE,
+    FS_TYPE_DIRECTORY,
+    FS_TYPE_SYMLINK,
+    FS_TYPE_BLOCK_DEVICE,
+    FS_TYPE_CHAR_DEVICE,
+    FS_TYPE_FIFO,
+    FS_TYPE_SOCKET
+};
+
+#if defined(_STD_UNIX)
+#include <sys/types.h>
+
+const char *fsL_type_name(int type);
+
+// metadata read without a Lua state, by the worker threads of std.aio; the metadata are copied
+// into a userdata of fsL_metadata_size() bytes to become a std.fs metadata object
+size_t fsL_metadata_size(void);
+bool fsL_metadata_at(int dir_fd, const char *path, const metadata_opts_t *opts, void *m);
+#if defined(_STD_LINUX)
+struct statx;
+unsigned int fsL_statx_mask(unsigned int fields);
+void fsL_metadata_from_statx(const struct statx *stx, unsigned int fields, void *m);
+#endif
+
+int fsL_type_from_mode(mode_t mode);
+int fsL_type_from_dirent(unsigned char d_type);
+
+// walk
+typedef struct walk_opts_s
+{
+    int max_depth; // -1 for no limit
+    bool follow_symlinks;
+    bool strict; // stop at the first unreadable directory
+    int threads;
+    const char *const *include;
+    size_t include_count;
+    const char *const *exclude;
+    size_t exclude_count;
+} walk_opts_t;
+
+typedef struct walk_entry_s
+{
+    const char *path; // valid until the next call to fsL_walk_next
+    size_t path_len;
+    int type;
+    int depth;
+} walk_entry_t;
+
+typedef struct fs_walk_s fs_walk_t;
+
+fs_walk_t *fsL_walk_open(const char *root, const walk_opts_t *opts);
+int fsL_walk_next(fs_walk_t *w, walk_entry_t *entry);
+const char *fsL_walk_error(fs_walk_t *w);
+void fsL_walk_close(fs_walk_t *w);
+#endif
+
+// memory mappings
+typedef struct fs_mapping_s
+{
+    const char *data; // NULL for an empty file
+    size_t size;
+} fs_mapping_t;
+
+enum
+{
+    FS_ADVICE_NORMAL,
+    FS_ADVICE_SEQUENTIAL,
+    FS_ADVICE_RANDOM,
+    FS_ADVICE_WILLNEED,
+    FS_ADVICE_DONTNEED
+};
+
+bool fsL_mmap(lua_State *L, const char *path, fs_mapping_t *m);
+bool fsL_munmap(fs_mapping_t *m);
+bool fsL_madvise(fs_mapping_t *m, int advice);
+
+// bulk writes
+typedef struct fs_buffer_s
+{
+    const char *data;
+    size_t len;
+} fs_buffer_t;
+
+enum
+{
+    FS_SYNC_NONE,   // leave the data in the system cache
+    FS_SYNC_DATA,   // flush the data to the device before closing
+    FS_SYNC_DIRECT, // bypass the system cache, where supported, and flush the data before closing
+};
+
+typedef struct fs_writer_s fs_writer_t;
+
+// Creates or truncates `path`; with `atomic`, writes to a temporary file next to it, which
+// replaces `path` when the writer is committed.
+fs_writer_t *fsL_writer_open(lua_State *L, const char *path, int sync, bool atomic);
+bool fsL_writer_write(fs_writer_t *w, const fs_buffer_t *bufs, size_t count);
+// Closes and frees the writer; without `commit`, removes the temporary file of an atomic writer
+// and preserves the last error.
+bool fsL_writer_close(lua_State *L, fs_writer_t *w, bool commit);
+
 // entries
 bool fsL_read_dir(lua_State *L, const char *path);
 int read_dir_next(lua_State *L, void *ud);
 bool read_dir_close(lua_State *L, void *ud);
+
+#if defined(_STD_UNIX)
+// batched directory reads
+typedef struct dir_entry_s
+{
+    const char *name; // valid until the next call to fsL_dir_next
+    size_t name_len;
+    int type;
+    uint64_t ino;
+} dir_entry_t;
+
+typedef struct fs_dir_s fs_dir_t;
+
+fs_dir_t *fsL_dir_open(const char *path);
+int fsL_dir_next(fs_dir_t *d, dir_entry_t *entry, bool resolve_unknown);
+bool fsL_dir_metadata(lua_State *L, fs_dir_t *d, const char *name, int reuse);
+int fsL_metadata_type(void *ud);
+bool fsL_dir_close(fs_dir_t *d);
+#endif
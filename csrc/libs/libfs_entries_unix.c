@@ -5,6 +5,12 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_STD_LINUX)
+#include <sys/syscall.h>
+#endif
 
 typedef struct entries_s
 {
@@ -56,3 +62,153 @@ bool fsL_read_dir(lua_State *L, const char *path)
     ud->dir = dir;
     return true;
 }
+
+// the size of the buffer filled by each getdents64 call
+#define DIR_BUFFER_SIZE 32768
+
+#if defined(_STD_LINUX) && defined(SYS_getdents64)
+#define _STD_USE_GETDENTS64
+
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+struct fs_dir_s
+{
+    int fd;
+#if defined(_STD_USE_GETDENTS64)
+    size_t pos;
+    size_t len;
+    char buf[DIR_BUFFER_SIZE];
+#else
+    DIR *dir;
+#endif
+};
+
+static bool is_dot_or_dotdot(const char *name)
+{
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+fs_dir_t *fsL_dir_open(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    fs_dir_t *d = (fs_dir_t *)malloc(sizeof(fs_dir_t));
+    if (d == NULL)
+    {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    d->fd = fd;
+#if defined(_STD_USE_GETDENTS64)
+    d->pos = d->len = 0;
+#else
+    d->dir = fdopendir(fd);
+    if (d->dir == NULL)
+    {
+        int err = errno;
+        close(fd);
+        free(d);
+        errno = err;
+        return NULL;
+    }
+#endif
+    return d;
+}
+
+// Returns 1 and fills `entry` with the next entry, skipping `.` and `..`; returns 0 at the end of the
+// directory and -1 on error. When `resolve_unknown` is set, entries whose type the file system does not
+// report are stat-ed.
+int fsL_dir_next(fs_dir_t *d, dir_entry_t *entry, bool resolve_unknown)
+{
+    const char *name;
+    unsigned char d_type;
+    for (;;)
+    {
+#if defined(_STD_USE_GETDENTS64)
+        if (d->pos >= d->len)
+        {
+            long n = syscall(SYS_getdents64, d->fd, d->buf, sizeof(d->buf));
+            if (n < 0) return -1;
+            if (n == 0) return 0;
+            d->pos = 0;
+            d->len = (size_t)n;
+        }
+        struct linux_dirent64 *de = (struct linux_dirent64 *)(d->buf + d->pos);
+        d->pos += de->d_reclen;
+        name = de->d_name;
+        d_type = de->d_type;
+        entry->ino = de->d_ino;
+#else
+        errno = 0;
+        struct dirent *de = readdir(d->dir);
+        if (de == NULL) return errno != 0 ? -1 : 0;
+        name = de->d_name;
+#if defined(DT_UNKNOWN)
+        d_type = de->d_type;
+#else
+        d_type = 0;
+#endif
+        entry->ino = (uint64_t)de->d_ino;
+#endif
+        if (!is_dot_or_dotdot(name)) break;
+    }
+
+    entry->name = name;
+    entry->name_len = strlen(name);
+    entry->type = fsL_type_from_dirent(d_type);
+    if (entry->type == FS_TYPE_UNKNOWN && resolve_unknown)
+    {
+        struct stat st;
+        if (fstatat(d->fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) entry->type = fsL_type_from_mode(st.st_mode);
+    }
+    return 1;
+}
+
+// Pushes the metadata of the entry `name`, relative to the directory; when the value at `reuse` is a
+// metadata userdata it is overwritten and pushed again instead of allocating a new one.
+bool fsL_dir_metadata(lua_State *L, fs_dir_t *d, const char *name, int reuse)
+{
+    metadata_t m;
+    if (!metadata_at(d->fd, name, false, FS_FIELD_ALL, &m)) return false;
+
+    void *ud = lua_touserdata(L, reuse);
+    if (ud != NULL && lua_rawlen(L, reuse) == sizeof(m))
+    {
+        lua_pushvalue(L, reuse);
+    }
+    else
+    {
+        ud = lua_newuserdata(L, sizeof(m));
+        if (ud == NULL) return false;
+    }
+    memcpy(ud, &m, sizeof(m));
+    return true;
+}
+
+int fsL_metadata_type(void *ud)
+{
+    metadata_t *m = (metadata_t *)ud;
+    return fsL_type_from_mode(m->mode);
+}
+
+bool fsL_dir_close(fs_dir_t *d)
+{
+    if (d == NULL) return true;
+#if defined(_STD_USE_GETDENTS64)
+    bool ok = close(d->fd) == 0;
+#else
+    bool ok = closedir(d->dir) == 0;
+#endif
+    free(d);
+    return ok;
+}
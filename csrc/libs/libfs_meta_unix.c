@@ -8,98 +8,242 @@
 #include <fcntl.h>
 #include <string.h>
 
+// statx is available from glibc 2.28 and Linux 4.11
+#if defined(_STD_LINUX) && defined(STATX_BASIC_STATS)
+#define _STD_USE_STATX
+#include <sys/sysmacros.h>
+#endif
 
-bool fsL_metadata(lua_State *L, const char *path)
+typedef struct metadata_s
 {
-    struct stat st;
-    if (lstat(path, &st)) return false;
-    void *ud = lua_newuserdata(L, sizeof(st));
-    if (ud == NULL) return false;
-    memcpy(ud, &st, sizeof(st));
-    return true;
+    unsigned int fields; // the FS_FIELD_* values available
+    mode_t mode;
+    lua_Integer links;
+    lua_Integer inode;
+    lua_Integer device;
+    lua_Integer length;
+    lua_Integer blocks;
+    lua_Integer accessed; // nanoseconds since the Unix Epoch
+    lua_Integer modified;
+    lua_Integer changed;
+    lua_Integer created;
+} metadata_t;
+
+#define timespec_to_nanos(sec, nsec) ((lua_Integer)(sec) * NANOS_PER_SECOND + (lua_Integer)(nsec))
+
+#if defined(_STD_USE_STATX)
+static unsigned int to_statx_mask(unsigned int fields)
+{
+    unsigned int mask = STATX_TYPE | STATX_MODE;
+    if (fields & FS_FIELD_LINKS) mask |= STATX_NLINK;
+    if (fields & FS_FIELD_INODE) mask |= STATX_INO;
+    if (fields & FS_FIELD_LENGTH) mask |= STATX_SIZE;
+    if (fields & FS_FIELD_BLOCKS) mask |= STATX_BLOCKS;
+    if (fields & FS_FIELD_ACCESSED) mask |= STATX_ATIME;
+    if (fields & FS_FIELD_MODIFIED) mask |= STATX_MTIME;
+    if (fields & FS_FIELD_CHANGED) mask |= STATX_CTIME;
+    if (fields & FS_FIELD_CREATED) mask |= STATX_BTIME;
+    return mask;
 }
 
-lua_Integer fsL_metadata_length(void *ud)
+static void from_statx(const struct statx *stx, metadata_t *m)
 {
-    struct stat *st = (struct stat *)ud;
-    return st->st_size;
+    unsigned int mask = stx->stx_mask;
+    m->fields = FS_FIELD_DEVICE;
+    m->device = (lua_Integer)makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    if (mask & STATX_TYPE) m->fields |= FS_FIELD_TYPE;
+    if (mask & STATX_MODE) m->fields |= FS_FIELD_MODE;
+    m->mode = stx->stx_mode;
+#define XX(bit, field, member, value)   \
+    if (mask & bit)                     \
+    {                                   \
+        m->fields |= field;             \
+        m->member = (lua_Integer)value; \
+    }
+    XX(STATX_NLINK, FS_FIELD_LINKS, links, stx->stx_nlink)
+    XX(STATX_INO, FS_FIELD_INODE, inode, stx->stx_ino)
+    XX(STATX_SIZE, FS_FIELD_LENGTH, length, stx->stx_size)
+    XX(STATX_BLOCKS, FS_FIELD_BLOCKS, blocks, stx->stx_blocks)
+    XX(STATX_ATIME, FS_FIELD_ACCESSED, accessed, timespec_to_nanos(stx->stx_atime.tv_sec, stx->stx_atime.tv_nsec))
+    XX(STATX_MTIME, FS_FIELD_MODIFIED, modified, timespec_to_nanos(stx->stx_mtime.tv_sec, stx->stx_mtime.tv_nsec))
+    XX(STATX_CTIME, FS_FIELD_CHANGED, changed, timespec_to_nanos(stx->stx_ctime.tv_sec, stx->stx_ctime.tv_nsec))
+    XX(STATX_BTIME, FS_FIELD_CREATED, created, timespec_to_nanos(stx->stx_btime.tv_sec, stx->stx_btime.tv_nsec))
+#undef XX
 }
+#endif
 
-lua_Integer fsL_metadata_accessed(void *ud)
+static void from_stat(const struct stat *st, metadata_t *m)
 {
-    struct stat *st = (struct stat *)ud;
-#ifdef _STD_APPLE
-    return timespec_to_millis(st->st_atimespec);
+    m->fields = FS_FIELD_ALL;
+    m->mode = st->st_mode;
+    m->links = (lua_Integer)st->st_nlink;
+    m->inode = (lua_Integer)st->st_ino;
+    m->device = (lua_Integer)st->st_dev;
+    m->length = (lua_Integer)st->st_size;
+    m->blocks = (lua_Integer)st->st_blocks;
+#if defined(_STD_APPLE)
+    m->accessed = timespec_to_nanos(st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec);
+    m->modified = timespec_to_nanos(st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec);
+    m->changed = timespec_to_nanos(st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec);
+    m->created = timespec_to_nanos(st->st_birthtimespec.tv_sec, st->st_birthtimespec.tv_nsec);
 #else
-    return timespec_to_millis(st->st_atim);
+    m->accessed = timespec_to_nanos(st->st_atim.tv_sec, st->st_atim.tv_nsec);
+    m->modified = timespec_to_nanos(st->st_mtim.tv_sec, st->st_mtim.tv_nsec);
+    m->changed = timespec_to_nanos(st->st_ctim.tv_sec, st->st_ctim.tv_nsec);
+#if defined(__FreeBSD__) || defined(__NetBSD__)
+    m->created = timespec_to_nanos(st->st_birthtim.tv_sec, st->st_birthtim.tv_nsec);
+#else
+    // struct stat has no birth time here
+    m->fields &= ~FS_FIELD_CREATED;
+#endif
 #endif
 }
 
-lua_Integer fsL_metadata_modified(void *ud)
+// Reads the metadata of `path`, relative to the directory `dir_fd`, with the fields `fields`.
+static bool metadata_at(int dir_fd, const char *path, bool follow_symlinks, unsigned int fields, metadata_t *m)
 {
-    struct stat *st = (struct stat *)ud;
-#ifdef _STD_APPLE
-    return timespec_to_millis(st->st_mtimespec);
-#else
-    return timespec_to_millis(st->st_mtim);
+    int flags = follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+#if defined(_STD_USE_STATX)
+    // read and written by the worker threads of fs.walk and std.aio too
+    static int has_statx = 1;
+    if (__atomic_load_n(&has_statx, __ATOMIC_RELAXED))
+    {
+        struct statx stx;
+        if (statx(dir_fd, path, flags, to_statx_mask(fields), &stx) == 0)
+        {
+            from_statx(&stx, m);
+            m->fields &= fields | FS_FIELD_TYPE | FS_FIELD_MODE | FS_FIELD_DEVICE;
+            return true;
+        }
+        // the kernel or a seccomp filter may not allow statx
+        if (errno != ENOSYS && errno != EPERM) return false;
+        __atomic_store_n(&has_statx, 0, __ATOMIC_RELAXED);
+    }
 #endif
+    struct stat st;
+    if (fstatat(dir_fd, path, &st, flags)) return false;
+    from_stat(&st, m);
+    m->fields &= fields | FS_FIELD_TYPE | FS_FIELD_MODE | FS_FIELD_DEVICE;
+    return true;
 }
 
-lua_Integer fsL_metadata_created(void *ud)
+bool fsL_metadata(lua_State *L, const char *path, const metadata_opts_t *opts)
 {
-    struct stat *st = (struct stat *)ud;
-#ifdef _STD_APPLE
-    return timespec_to_millis(st->st_ctimespec);
-#else
-    return timespec_to_millis(st->st_ctim);
+    metadata_t m;
+    if (!metadata_at(AT_FDCWD, path, opts->follow_symlinks, opts->fields, &m)) return false;
+    void *ud = lua_newuserdata(L, sizeof(m));
+    if (ud == NULL) return false;
+    memcpy(ud, &m, sizeof(m));
+    return true;
+}
+
+size_t fsL_metadata_size(void)
+{
+    return sizeof(metadata_t);
+}
+
+bool fsL_metadata_at(int dir_fd, const char *path, const metadata_opts_t *opts, void *m)
+{
+    return metadata_at(dir_fd, path, opts->follow_symlinks, opts->fields, (metadata_t *)m);
+}
+
+#if defined(_STD_USE_STATX)
+unsigned int fsL_statx_mask(unsigned int fields)
+{
+    return to_statx_mask(fields);
+}
+
+void fsL_metadata_from_statx(const struct statx *stx, unsigned int fields, void *ud)
+{
+    metadata_t *m = (metadata_t *)ud;
+    from_statx(stx, m);
+    m->fields &= fields | FS_FIELD_TYPE | FS_FIELD_MODE | FS_FIELD_DEVICE;
+}
 #endif
+
+bool fsL_metadata_field(void *ud, int field, lua_Integer *value)
+{
+    metadata_t *m = (metadata_t *)ud;
+    if ((m->fields & field) == 0) return false;
+    switch (field)
+    {
+        case FS_FIELD_LINKS:
+            *value = m->links;
+            return true;
+        case FS_FIELD_INODE:
+            *value = m->inode;
+            return true;
+        case FS_FIELD_DEVICE:
+            *value = m->device;
+            return true;
+        case FS_FIELD_LENGTH:
+            *value = m->length;
+            return true;
+        case FS_FIELD_BLOCKS:
+            *value = m->blocks;
+            return true;
+        case FS_FIELD_ACCESSED:
+            *value = m->accessed;
+            return true;
+        case FS_FIELD_MODIFIED:
+            *value = m->modified;
+            return true;
+        case FS_FIELD_CHANGED:
+            *value = m->changed;
+            return true;
+        case FS_FIELD_CREATED:
+            *value = m->created;
+            return true;
+        default:
+            return false;
+    }
 }
 
 bool fsL_metadata_is_directory(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISDIR(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISDIR(m->mode);
 }
 
 bool fsL_metadata_is_file(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISREG(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISREG(m->mode);
 }
 
 bool fsL_metadata_is_symlink(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISLNK(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISLNK(m->mode);
 }
 
 bool fsL_metadata_is_readonly(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
+    metadata_t *m = (metadata_t *)ud;
     const mode_t write_mask = S_IWUSR | S_IWGRP | S_IWOTH;
-    return (st->st_mode & write_mask) == 0;
+    return (m->mode & write_mask) == 0;
 }
 
 bool fsL_metadata_is_block_device(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISBLK(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISBLK(m->mode);
 }
 
 bool fsL_metadata_is_char_device(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISCHR(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISCHR(m->mode);
 }
 
 bool fsL_metadata_is_socket(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISSOCK(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISSOCK(m->mode);
 }
 
 bool fsL_metadata_is_fifo(void *ud)
 {
-    struct stat *st = (struct stat *)ud;
-    return S_ISFIFO(st->st_mode);
+    metadata_t *m = (metadata_t *)ud;
+    return S_ISFIFO(m->mode);
 }
@@ -15,8 +15,10 @@
 #include <windows.h>
 #include <wchar.h>
 
-bool fsL_metadata(lua_State *L, const char *path)
+bool fsL_metadata(lua_State *L, const char *path, const metadata_opts_t *opts)
 {
+    // GetFileAttributesExW reads all the fields at once and does not follow symbolic links
+    (void)opts;
     const WCHAR *path16 = utfL_to_utf16(L, path);
     WIN32_FILE_ATTRIBUTE_DATA file_attribute_data;
     bool b = GetFileAttributesExW(path16, GetFileExInfoStandard, &file_attribute_data);
@@ -29,29 +31,35 @@ bool fsL_metadata(lua_State *L, const char *path)
     return true;
 }
 
-lua_Integer fsL_metadata_length(void *ud)
+static lua_Integer to_unix_nanos(FILETIME ft)
 {
-    WIN32_FILE_ATTRIBUTE_DATA *file_attribute_data = (WIN32_FILE_ATTRIBUTE_DATA *)ud;
-    LARGE_INTEGER li = {.LowPart = file_attribute_data->nFileSizeLow, .HighPart = file_attribute_data->nFileSizeHigh};
-    return (lua_Integer)li.QuadPart;
-}
-
-lua_Integer fsL_metadata_accessed(void *ud)
-{
-    WIN32_FILE_ATTRIBUTE_DATA *file_attribute_data = (WIN32_FILE_ATTRIBUTE_DATA *)ud;
-    return to_unix_time(file_attribute_data->ftLastAccessTime);
-}
-
-lua_Integer fsL_metadata_modified(void *ud)
-{
-    WIN32_FILE_ATTRIBUTE_DATA *file_attribute_data = (WIN32_FILE_ATTRIBUTE_DATA *)ud;
-    return to_unix_time(file_attribute_data->ftLastWriteTime);
+    LARGE_INTEGER li = {.HighPart = ft.dwHighDateTime, .LowPart = ft.dwLowDateTime};
+    return (li.QuadPart - TIME_TICKS_TO_UNIX_EPOCH) * 100;
 }
 
-lua_Integer fsL_metadata_created(void *ud)
+bool fsL_metadata_field(void *ud, int field, lua_Integer *value)
 {
     WIN32_FILE_ATTRIBUTE_DATA *file_attribute_data = (WIN32_FILE_ATTRIBUTE_DATA *)ud;
-    return to_unix_time(file_attribute_data->ftCreationTime);
+    switch (field)
+    {
+        case FS_FIELD_LENGTH:
+        {
+            LARGE_INTEGER li = {.LowPart = file_attribute_data->nFileSizeLow, .HighPart = file_attribute_data->nFileSizeHigh};
+            *value = (lua_Integer)li.QuadPart;
+            return true;
+        }
+        case FS_FIELD_ACCESSED:
+            *value = to_unix_nanos(file_attribute_data->ftLastAccessTime);
+            return true;
+        case FS_FIELD_MODIFIED:
+            *value = to_unix_nanos(file_attribute_data->ftLastWriteTime);
+            return true;
+        case FS_FIELD_CREATED:
+            *value = to_unix_nanos(file_attribute_data->ftCreationTime);
+            return true;
+        default:
+            return false;
+    }
 }
 
 bool fsL_metadata_is_directory(void *ud)
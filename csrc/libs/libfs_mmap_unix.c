@@ -0,0 +1,79 @@
+#include "libfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool fsL_mmap(lua_State *L, const char *path, fs_mapping_t *m)
+{
+    m->data = NULL;
+    m->size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) goto ERROR;
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = S_ISDIR(st.st_mode) ? EISDIR : ENODEV;
+        goto ERROR;
+    }
+
+    // mmap rejects empty mappings
+    if (st.st_size > 0)
+    {
+        if ((uint64_t)st.st_size > SIZE_MAX)
+        {
+            errno = EFBIG;
+            goto ERROR;
+        }
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) goto ERROR;
+        m->data = (const char *)data;
+        m->size = (size_t)st.st_size;
+    }
+    close(fd);
+    return true;
+
+ERROR:;
+    int err = errno;
+    close(fd);
+    errno = err;
+    return false;
+}
+
+bool fsL_munmap(fs_mapping_t *m)
+{
+    bool ok = m->data == NULL || munmap((void *)m->data, m->size) == 0;
+    m->data = NULL;
+    m->size = 0;
+    return ok;
+}
+
+bool fsL_madvise(fs_mapping_t *m, int advice)
+{
+    if (m->data == NULL) return true;
+    int flags;
+    switch (advice)
+    {
+        case FS_ADVICE_SEQUENTIAL:
+            flags = MADV_SEQUENTIAL;
+            break;
+        case FS_ADVICE_RANDOM:
+            flags = MADV_RANDOM;
+            break;
+        case FS_ADVICE_WILLNEED:
+            flags = MADV_WILLNEED;
+            break;
+        case FS_ADVICE_DONTNEED:
+            flags = MADV_DONTNEED;
+            break;
+        default:
+            flags = MADV_NORMAL;
+            break;
+    }
+    return madvise((void *)m->data, m->size, flags) == 0;
+}
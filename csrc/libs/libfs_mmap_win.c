@@ -0,0 +1,72 @@
+#include "libfs.h"
+
+#include "libutf.h"
+
+#include <windows.h>
+
+bool fsL_mmap(lua_State *L, const char *path, fs_mapping_t *m)
+{
+    m->data = NULL;
+    m->size = 0;
+
+    const WCHAR *path16 = utfL_to_utf16(L, path);
+    HANDLE file = CreateFileW(path16, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    utfL_free(L, path16);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) goto ERROR;
+
+    // CreateFileMapping rejects empty files
+    if (size.QuadPart > 0)
+    {
+        if ((ULONGLONG)size.QuadPart > SIZE_MAX)
+        {
+            SetLastError(ERROR_FILE_TOO_LARGE);
+            goto ERROR;
+        }
+        HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) goto ERROR;
+        // the view keeps the mapping alive
+        const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        DWORD err = GetLastError();
+        CloseHandle(mapping);
+        if (data == NULL)
+        {
+            SetLastError(err);
+            goto ERROR;
+        }
+        m->data = (const char *)data;
+        m->size = (size_t)size.QuadPart;
+    }
+    CloseHandle(file);
+    return true;
+
+ERROR:;
+    DWORD err = GetLastError();
+    CloseHandle(file);
+    SetLastError(err);
+    return false;
+}
+
+bool fsL_munmap(fs_mapping_t *m)
+{
+    bool ok = m->data == NULL || UnmapViewOfFile(m->data);
+    m->data = NULL;
+    m->size = 0;
+    return ok;
+}
+
+bool fsL_madvise(fs_mapping_t *m, int advice)
+{
+    // only the prefetch hint has an equivalent
+#if _WIN32_WINNT >= 0x0602
+    if (m->data != NULL && advice == FS_ADVICE_WILLNEED)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = {.VirtualAddress = (PVOID)m->data, .NumberOfBytes = m->size};
+        return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "libfs.h"
 #include "libfs_unix.h"
 #include "libtime.h"
+#include "liballocator.h"
 
 #include <dirent.h>
 #include <unistd.h>
@@ -8,6 +9,13 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <string.h>
+
+#if defined(_STD_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
 
 #ifdef _STD_APPLE
 #include <copyfile.h>
@@ -15,40 +23,304 @@
 #endif
 
 #ifdef _STD_APPLE
-bool fsL_copy_file(lua_State *L, const char *src, const char *dst, bool overwrite)
+bool fsL_copy_file(lua_State *L, const char *src, const char *dst, const copy_opts_t *opts)
 {
     copyfile_state_t state = copyfile_state_alloc();
-    copyfile_flags_t flags = COPYFILE_ALL;
-    if (!overwrite) flags |= COPYFILE_EXCL;
+    copyfile_flags_t flags = COPYFILE_DATA | COPYFILE_CLONE;
+    if (opts->permissions) flags |= COPYFILE_SECURITY;
+    if (opts->timestamps) flags |= COPYFILE_METADATA;
+    if (opts->sparse) flags |= COPYFILE_DATA_SPARSE;
+    if (!opts->overwrite) flags |= COPYFILE_EXCL;
     int r = copyfile(src, dst, state, flags);
     copyfile_state_free(state);
-    return r == 0;
+    if (r != 0 || opts->progress == 0) return r == 0;
+
+    struct stat st;
+    if (stat(dst, &st) != 0) return false;
+    lua_pushvalue(L, opts->progress);
+    lua_pushinteger(L, (lua_Integer)st.st_size);
+    lua_pushinteger(L, (lua_Integer)st.st_size);
+    lua_call(L, 2, 0);
+    return true;
 }
 #else
-bool fsL_copy_file(lua_State *L, const char *src, const char *dst, bool overwrite)
+
+#define COPY_BUFFER_SIZE (256 * 1024)
+// the largest request passed to a single system call when no progress interval is given
+#define COPY_CHUNK_SIZE ((size_t)1 << 30)
+
+enum
+{
+    TIER_COPY_FILE_RANGE,
+    TIER_SENDFILE,
+    TIER_BUFFER
+};
+
+typedef struct
+{
+    lua_State *L;
+    const copy_opts_t *opts;
+    int src_fd;
+    int dst_fd;
+    int tier;
+    bool failed_callback;
+    size_t chunk;
+    uint64_t total;
+    uint64_t copied;
+    uint64_t next_report;
+    char *buffer;
+} copy_t;
+
+// Calls the progress function when due; leaves the error on the stack if it raises one.
+static bool copy_report(copy_t *c)
+{
+    const copy_opts_t *opts = c->opts;
+    if (opts->progress == 0 || (c->copied < c->next_report && c->copied != c->total)) return true;
+
+    lua_State *L = c->L;
+    c->next_report = c->copied + (opts->progress_interval > 0 ? opts->progress_interval : 1);
+    lua_pushvalue(L, opts->progress);
+    lua_pushinteger(L, (lua_Integer)c->copied);
+    lua_pushinteger(L, (lua_Integer)c->total);
+    if (lua_pcall(L, 2, 1, 0) != LUA_OK)
+    {
+        c->failed_callback = true;
+        return false;
+    }
+    bool cancelled = lua_isboolean(L, -1) && !lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    if (cancelled)
+    {
+        errno = ECANCELED;
+        return false;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const char *buf, size_t len, off_t off, bool positional)
+{
+    while (len > 0)
+    {
+        ssize_t n = positional ? pwrite(fd, buf, len, off) : write(fd, buf, len);
+        if (n == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return true;
+}
+
+// The buffer is allocated on the heap: it outlives this frame, which allocatorL_alloc blocks must not.
+static bool copy_use_buffer(copy_t *c)
 {
-    bool result = false;
+    c->tier = TIER_BUFFER;
+    if (c->buffer == NULL) c->buffer = (char *)allocatorL_malloc(c->L, COPY_BUFFER_SIZE);
+    return true;
+}
 
-    int src_fd = open(src, O_RDONLY);
-    if (src_fd == -1) goto ERROR;
+#if defined(_STD_LINUX)
+static bool is_unsupported(int err)
+{
+    return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP || err == ENOTSUP || err == EPERM ||
+           err == ETXTBSY || err == EBADF;
+}
+#endif
 
-    int flags = O_WRONLY | O_CREAT;
-    if (!overwrite) flags |= O_EXCL;
-    int dst_fd = open(dst, flags);
-    if (dst_fd == -1) goto ERROR;
+// Copies `len` bytes at offset `off`, moving to a slower tier when the current one is not supported.
+static bool copy_range(copy_t *c, off_t off, uint64_t len)
+{
+    bool seeked = false;
+    while (len > 0)
+    {
+        size_t n = len > c->chunk ? c->chunk : (size_t)len;
+        ssize_t r;
+        switch (c->tier)
+        {
+#if defined(_STD_LINUX)
+            case TIER_COPY_FILE_RANGE:
+            {
+                off_t in = off, out = off;
+                r = copy_file_range(c->src_fd, &in, c->dst_fd, &out, n, 0);
+                if (r == -1 && is_unsupported(errno))
+                {
+                    c->tier = TIER_SENDFILE;
+                    continue;
+                }
+                break;
+            }
+            case TIER_SENDFILE:
+            {
+                if (!seeked)
+                {
+                    if (lseek(c->dst_fd, off, SEEK_SET) == -1) return false;
+                    seeked = true;
+                }
+                off_t in = off;
+                r = sendfile(c->dst_fd, c->src_fd, &in, n);
+                if (r == -1 && is_unsupported(errno))
+                {
+                    copy_use_buffer(c);
+                    continue;
+                }
+                break;
+            }
+#endif
+            default:
+            {
+                if (n > COPY_BUFFER_SIZE) n = COPY_BUFFER_SIZE;
+                r = pread(c->src_fd, c->buffer, n, off);
+                if (r > 0 && !write_all(c->dst_fd, c->buffer, (size_t)r, off, true)) return false;
+                break;
+            }
+        }
 
-    char buf[8192];
-    while(true)
+        if (r == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (r == 0) break; // the source was truncated while copying
+
+        off += r;
+        len -= (uint64_t)r;
+        c->copied += (uint64_t)r;
+        if (!copy_report(c)) return false;
+    }
+    return true;
+}
+
+// Copies the data segments of the source, leaving holes in the destination.
+static bool copy_sparse(copy_t *c)
+{
+    off_t off = 0, end = (off_t)c->total;
+    while (off < end)
     {
-        ssize_t n = read(src_fd, buf, sizeof(buf));
-        if (n == 0) break;
-        if (n == -1 || write(dst_fd, buf, n) == -1) goto ERROR;
+        off_t data = lseek(c->src_fd, off, SEEK_DATA);
+        if (data == -1)
+        {
+            if (errno == ENXIO) break; // the rest of the file is a hole
+            if (errno != EINVAL) return false;
+            // holes are not supported by the file system
+            return copy_range(c, off, (uint64_t)(end - off));
+        }
+        off_t hole = lseek(c->src_fd, data, SEEK_HOLE);
+        if (hole == -1 || hole > end) hole = end;
+
+        c->copied += (uint64_t)(data - off);
+        if (!copy_range(c, data, (uint64_t)(hole - data))) return false;
+        off = hole;
+    }
+    c->copied = c->total;
+    return ftruncate(c->dst_fd, end) == 0 && copy_report(c);
+}
+
+// Copies a source that is not a regular file until the end of its data.
+static bool copy_stream(copy_t *c)
+{
+    copy_use_buffer(c);
+    while (true)
+    {
+        ssize_t n = read(c->src_fd, c->buffer, COPY_BUFFER_SIZE);
+        if (n == 0) return true;
+        if (n == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (!write_all(c->dst_fd, c->buffer, (size_t)n, 0, false)) return false;
+        c->copied += (uint64_t)n;
+        c->total = c->copied;
+        if (!copy_report(c)) return false;
+    }
+}
+
+static bool copy_data(copy_t *c, const struct stat *src_st)
+{
+    if (!S_ISREG(src_st->st_mode)) return copy_stream(c);
+
+#if defined(_STD_LINUX) && defined(FICLONE)
+    // a reflink shares the blocks of the source and preserves its holes
+    if (ioctl(c->dst_fd, FICLONE, c->src_fd) == 0)
+    {
+        c->copied = c->total;
+        return copy_report(c);
+    }
+#endif
+
+    bool ok = c->opts->sparse ? copy_sparse(c) : copy_range(c, 0, c->total);
+    return ok && (c->total > 0 || copy_report(c));
+}
+
+bool fsL_copy_file(lua_State *L, const char *src, const char *dst, const copy_opts_t *opts)
+{
+    bool result = false, truncated = false;
+    copy_t c = {0};
+    c.L = L;
+    c.opts = opts;
+    c.dst_fd = -1;
+    c.chunk = opts->progress != 0 && opts->progress_interval > 0 && opts->progress_interval < COPY_CHUNK_SIZE
+                  ? (size_t)opts->progress_interval
+                  : COPY_CHUNK_SIZE;
+#if defined(_STD_LINUX)
+    c.tier = TIER_COPY_FILE_RANGE;
+#else
+    copy_use_buffer(&c);
+#endif
+
+    c.src_fd = open(src, O_RDONLY | O_CLOEXEC);
+    if (c.src_fd == -1) goto ERROR;
+
+    struct stat src_st;
+    if (fstat(c.src_fd, &src_st) == -1) goto ERROR;
+    c.total = S_ISREG(src_st.st_mode) ? (uint64_t)src_st.st_size : 0;
+
+    // the destination is truncated after checking that it is not the source
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (!opts->overwrite) flags |= O_EXCL;
+    // without `permissions`, a new destination gets the permissions of a file created by open
+    mode_t mode = opts->permissions ? src_st.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO) : 0666;
+    c.dst_fd = open(dst, flags, mode);
+    if (c.dst_fd == -1) goto ERROR;
+
+    struct stat dst_st;
+    if (fstat(c.dst_fd, &dst_st) == -1) goto ERROR;
+    if (dst_st.st_dev == src_st.st_dev && dst_st.st_ino == src_st.st_ino)
+    {
+        errno = EINVAL;
+        goto ERROR;
+    }
+    if (S_ISREG(dst_st.st_mode) && ftruncate(c.dst_fd, 0) == -1) goto ERROR;
+    truncated = S_ISREG(dst_st.st_mode);
+
+    if (!copy_data(&c, &src_st)) goto ERROR;
+
+    if (opts->permissions && fchmod(c.dst_fd, src_st.st_mode & 07777) == -1) goto ERROR;
+    if (opts->timestamps)
+    {
+        struct timespec times[2] = {src_st.st_atim, src_st.st_mtim};
+        if (futimens(c.dst_fd, times) == -1) goto ERROR;
     }
     result = true;
 
 ERROR:
-    if (src_fd != -1) close(src_fd);
-    if (dst_fd != -1) close(dst_fd);
+{
+    int err = errno;
+    if (c.buffer != NULL) allocatorL_free(L, c.buffer);
+    if (c.src_fd != -1) close(c.src_fd);
+    if (c.dst_fd != -1 && close(c.dst_fd) == -1 && result)
+    {
+        err = errno;
+        result = false;
+    }
+    // do not leave a partial copy behind
+    if (!result && truncated) unlink(dst);
+    if (c.failed_callback) lua_error(L);
+    errno = err;
+}
     return result;
 }
 #endif
@@ -71,22 +343,13 @@ bool fsL_create_directory(lua_State *L, const char *path)
     return mkdir(path, ACCESSPERMS) == 0;
 }
 
-#ifdef _STD_APPLE
-static bool remove_directory(lua_State *L, const char *path, bool recursive)
-{
-    removefile_state_t state = removefile_state_alloc();
-    removefile_flags_t flags = REMOVEFILE_SECURE_7_PASS;
-    if (recursive) flags |= REMOVEFILE_RECURSIVE;
-    int r = removefile(path, state, flags);
-    removefile_state_free(state);
-    return r == 0;
-}
-
+// rmdir fails with ENOTDIR on anything but a directory
 bool fsL_remove_directory(lua_State *L, const char *path)
 {
-    return remove_directory(L, path, false);
+    return rmdir(path) == 0;
 }
 
+#ifdef _STD_APPLE
 bool fsL_remove_file(lua_State *L, const char *path)
 {
     removefile_state_t state = removefile_state_alloc();
@@ -96,14 +359,9 @@ bool fsL_remove_file(lua_State *L, const char *path)
     return r == 0;
 }
 #else
-bool fsL_remove_directory(lua_State *L, const char *path)
-{
-    return remove(path) == 0;
-}
-
-bool fsL_delete_file(lua_State *L, const char *path)
+bool fsL_remove_file(lua_State *L, const char *path)
 {
-    return remove(path) == 0;
+    return unlink(path) == 0;
 }
 #endif
 
@@ -112,7 +370,7 @@ bool fsL_exists(lua_State *L, const char *path, bool *exists)
     struct stat st;
     int err = lstat(path, &st);
     *exists = err == 0;
-    return err == 0 || err == ENOENT;
+    return err == 0 || errno == ENOENT;
 }
 
 bool fsL_directory_exists(lua_State *L, const char *path, bool *exists)
@@ -120,15 +378,15 @@ bool fsL_directory_exists(lua_State *L, const char *path, bool *exists)
     struct stat st;
     int err = lstat(path, &st);
     *exists = err == 0 && S_ISDIR(st.st_mode);
-    return err == 0 || err == ENOENT;
+    return err == 0 || errno == ENOENT;
 }
 
 bool fsL_file_exists(lua_State *L, const char *path, bool *exists)
 {
     struct stat st;
     int err = lstat(path, &st);
-    *exists = err  == 0 && S_ISREG(st.st_mode);
-    return err == 0 || err == ENOENT;
+    *exists = err == 0 && S_ISREG(st.st_mode);
+    return err == 0 || errno == ENOENT;
 }
 
 bool fsL_file_length(lua_State *L, const char *path, lua_Integer *length)
@@ -159,7 +417,7 @@ bool fsL_is_readonly(lua_State *L, const char *path, bool *result)
 {
     struct stat st;
     if (lstat(path, &st)) return false;
-    *result = S_ISREG(st.st_mode);
+    *result = (st.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)) == 0;
     return true;
 }
 
@@ -167,7 +425,7 @@ bool fsL_is_symlink(lua_State *L, const char *path, bool *result)
 {
     struct stat st;
     if (lstat(path, &st)) return false;
-    *result = S_ISREG(st.st_mode);
+    *result = S_ISLNK(st.st_mode);
     return true;
 }
 
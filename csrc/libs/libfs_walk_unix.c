@@ -0,0 +1,810 @@
+#include "libfs.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the number of entries handed over by a worker thread at once
+#define WALK_BATCH_SIZE 256
+// the number of batches the workers can queue before waiting for the consumer
+#define WALK_MAX_BATCHES 64
+
+typedef struct
+{
+    DIR *dir;
+    size_t path_len;
+    int depth;
+} walk_frame_t;
+
+// A directory read by a worker, kept open while its subdirectories queued are not opened yet.
+typedef struct
+{
+    DIR *dir;
+    int refs;
+} walk_dir_t;
+
+typedef struct
+{
+    char *path;
+    size_t name_offset;
+    int depth;
+    walk_dir_t *parent; // NULL for the root
+} walk_item_t;
+
+typedef struct
+{
+    size_t offset;
+    size_t len;
+    int type;
+    int depth;
+} walk_record_t;
+
+typedef struct walk_batch_s
+{
+    struct walk_batch_s *next;
+    size_t count;
+    size_t next_record;
+    walk_record_t records[WALK_BATCH_SIZE];
+    char *buf;
+    size_t buf_len;
+    size_t buf_cap;
+} walk_batch_t;
+
+typedef struct
+{
+    dev_t dev;
+    ino_t ino;
+    bool used;
+} walk_id_t;
+
+struct fs_walk_s
+{
+    int max_depth;
+    bool follow_symlinks;
+    bool strict;
+    char **include;
+    size_t include_count;
+    char **exclude;
+    size_t exclude_count;
+    size_t root_len;
+    char error[256];
+    bool failed;
+
+    // directories already visited, when following symbolic links: an open addressing hash set
+    walk_id_t *visited;
+    size_t visited_count;
+    size_t visited_cap; // a power of 2
+
+    // sequential walk
+    walk_frame_t *frames;
+    size_t frames_count;
+    size_t frames_cap;
+    char *path;
+    size_t path_cap;
+
+    // parallel walk
+    int threads;
+    pthread_t *workers;
+    int workers_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t result_cond;
+    pthread_cond_t space_cond;
+    walk_item_t *queue;
+    size_t queue_count;
+    size_t queue_cap;
+    int busy;
+    bool done;
+    bool cancelled;
+    walk_batch_t *results_head;
+    walk_batch_t *results_tail;
+    size_t results_count;
+    walk_batch_t *current;
+};
+
+const char *fsL_type_name(int type)
+{
+    switch (type)
+    {
+        case FS_TYPE_FILE:
+            return "file";
+        case FS_TYPE_DIRECTORY:
+            return "directory";
+        case FS_TYPE_SYMLINK:
+            return "symlink";
+        case FS_TYPE_BLOCK_DEVICE:
+            return "block_device";
+        case FS_TYPE_CHAR_DEVICE:
+            return "char_device";
+        case FS_TYPE_FIFO:
+            return "fifo";
+        case FS_TYPE_SOCKET:
+            return "socket";
+        default:
+            return "unknown";
+    }
+}
+
+int fsL_type_from_mode(mode_t mode)
+{
+    if (S_ISREG(mode)) return FS_TYPE_FILE;
+    if (S_ISDIR(mode)) return FS_TYPE_DIRECTORY;
+    if (S_ISLNK(mode)) return FS_TYPE_SYMLINK;
+    if (S_ISBLK(mode)) return FS_TYPE_BLOCK_DEVICE;
+    if (S_ISCHR(mode)) return FS_TYPE_CHAR_DEVICE;
+    if (S_ISFIFO(mode)) return FS_TYPE_FIFO;
+    if (S_ISSOCK(mode)) return FS_TYPE_SOCKET;
+    return FS_TYPE_UNKNOWN;
+}
+
+int fsL_type_from_dirent(unsigned char d_type)
+{
+#if defined(DT_UNKNOWN)
+    switch (d_type)
+    {
+        case DT_REG:
+            return FS_TYPE_FILE;
+        case DT_DIR:
+            return FS_TYPE_DIRECTORY;
+        case DT_LNK:
+            return FS_TYPE_SYMLINK;
+        case DT_BLK:
+            return FS_TYPE_BLOCK_DEVICE;
+        case DT_CHR:
+            return FS_TYPE_CHAR_DEVICE;
+        case DT_FIFO:
+            return FS_TYPE_FIFO;
+        case DT_SOCK:
+            return FS_TYPE_SOCKET;
+        default:
+            break;
+    }
+#endif
+    return FS_TYPE_UNKNOWN;
+}
+
+static bool grow(void **p, size_t *cap, size_t count, size_t size)
+{
+    if (count < *cap) return true;
+    size_t new_cap = *cap == 0 ? 16 : *cap * 2;
+    void *q = realloc(*p, new_cap * size);
+    if (q == NULL) return false;
+    *p = q;
+    *cap = new_cap;
+    return true;
+}
+
+static bool matches_any(char *const *patterns, size_t count, const char *name, const char *rel)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *pattern = patterns[i];
+        bool by_path = strchr(pattern, '/') != NULL;
+        if (fnmatch(pattern, by_path ? rel : name, by_path ? FNM_PATHNAME : 0) == 0) return true;
+    }
+    return false;
+}
+
+// `cancelled` and `failed` are read by the threads without the lock, so they are always accessed
+// atomically; the error is written before `failed` is set, and only once.
+static bool is_cancelled(const fs_walk_t *w)
+{
+    return __atomic_load_n(&w->cancelled, __ATOMIC_ACQUIRE);
+}
+
+static bool has_failed(const fs_walk_t *w)
+{
+    return __atomic_load_n(&w->failed, __ATOMIC_ACQUIRE);
+}
+
+static void set_error(fs_walk_t *w, const char *path, int err)
+{
+    if (has_failed(w)) return;
+    snprintf(w->error, sizeof(w->error), "%s: %s", path, strerror(err));
+    __atomic_store_n(&w->failed, true, __ATOMIC_RELEASE);
+}
+
+static size_t hash_id(dev_t dev, ino_t ino)
+{
+    uint64_t h = ((uint64_t)ino ^ ((uint64_t)dev << 32 | (uint64_t)dev >> 32)) * UINT64_C(0x9e3779b97f4a7c15);
+    return (size_t)(h ^ h >> 32);
+}
+
+static walk_id_t *find_id(walk_id_t *ids, size_t cap, dev_t dev, ino_t ino)
+{
+    size_t i = hash_id(dev, ino) & (cap - 1);
+    while (ids[i].used && !(ids[i].dev == dev && ids[i].ino == ino))
+    {
+        i = (i + 1) & (cap - 1);
+    }
+    return &ids[i];
+}
+
+// Returns true if the directory was not visited yet and records it.
+static bool visit(fs_walk_t *w, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) return false;
+    if ((w->visited_count + 1) * 2 > w->visited_cap)
+    {
+        size_t cap = w->visited_cap == 0 ? 64 : w->visited_cap * 2;
+        walk_id_t *ids = (walk_id_t *)calloc(cap, sizeof(walk_id_t));
+        if (ids == NULL) return false;
+        for (size_t i = 0; i < w->visited_cap; i++)
+        {
+            if (w->visited[i].used) *find_id(ids, cap, w->visited[i].dev, w->visited[i].ino) = w->visited[i];
+        }
+        free(w->visited);
+        w->visited = ids;
+        w->visited_cap = cap;
+    }
+    walk_id_t *id = find_id(w->visited, w->visited_cap, st.st_dev, st.st_ino);
+    if (id->used) return false;
+    id->dev = st.st_dev;
+    id->ino = st.st_ino;
+    id->used = true;
+    w->visited_count++;
+    return true;
+}
+
+// Determines the type of an entry, using d_type when possible.
+static int entry_type(fs_walk_t *w, int dir_fd, const struct dirent *d)
+{
+    int type = fsL_type_from_dirent(d->d_type);
+    if (type != FS_TYPE_UNKNOWN && !(type == FS_TYPE_SYMLINK && w->follow_symlinks)) return type;
+
+    struct stat st;
+    if (fstatat(dir_fd, d->d_name, &st, w->follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0)
+    {
+        return fsL_type_from_mode(st.st_mode);
+    }
+    // a dangling symbolic link
+    return type;
+}
+
+// Opens a subdirectory to descend into; returns -1 if it must be skipped.
+static int open_subdir(fs_walk_t *w, int dir_fd, const char *name)
+{
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (!w->follow_symlinks) flags |= O_NOFOLLOW;
+    return openat(dir_fd, name, flags);
+}
+
+static bool should_descend(const fs_walk_t *w, int type, int depth)
+{
+    return type == FS_TYPE_DIRECTORY && (w->max_depth < 0 || depth < w->max_depth);
+}
+
+// sequential walk
+
+static bool push_frame(fs_walk_t *w, int fd, size_t path_len, int depth)
+{
+    if (!grow((void **)&w->frames, &w->frames_cap, w->frames_count, sizeof(walk_frame_t))) return false;
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) return false;
+    walk_frame_t *f = &w->frames[w->frames_count++];
+    f->dir = dir;
+    f->path_len = path_len;
+    f->depth = depth;
+    return true;
+}
+
+static bool append_name(fs_walk_t *w, size_t path_len, const char *name, size_t name_len)
+{
+    size_t need = path_len + 1 + name_len + 1;
+    if (need > w->path_cap)
+    {
+        size_t cap = w->path_cap * 2 > need ? w->path_cap * 2 : need;
+        char *p = realloc(w->path, cap);
+        if (p == NULL) return false;
+        w->path = p;
+        w->path_cap = cap;
+    }
+    char *p = w->path + path_len;
+    if (path_len > 0 && w->path[path_len - 1] != '/') *p++ = '/';
+    memcpy(p, name, name_len + 1);
+    return true;
+}
+
+static int walk_next_sequential(fs_walk_t *w, walk_entry_t *entry)
+{
+    while (w->frames_count > 0)
+    {
+        walk_frame_t *f = &w->frames[w->frames_count - 1];
+        errno = 0;
+        struct dirent *d = readdir(f->dir);
+        if (d == NULL)
+        {
+            if (errno != 0)
+            {
+                w->path[f->path_len] = '\0';
+                set_error(w, w->path, errno);
+                if (w->strict) return -1;
+            }
+            closedir(f->dir);
+            w->frames_count--;
+            continue;
+        }
+        if (is_dot_or_dotdot(d->d_name)) continue;
+
+        size_t name_len = strlen(d->d_name);
+        if (!append_name(w, f->path_len, d->d_name, name_len)) return -1;
+        size_t path_len = strlen(w->path);
+        const char *rel = w->path + w->root_len + (w->path[w->root_len] == '/' ? 1 : 0);
+        if (matches_any(w->exclude, w->exclude_count, d->d_name, rel)) continue;
+
+        int dir_fd = dirfd(f->dir);
+        int depth = f->depth + 1;
+        int type = entry_type(w, dir_fd, d);
+        if (should_descend(w, type, depth))
+        {
+            int fd = open_subdir(w, dir_fd, d->d_name);
+            if (fd == -1)
+            {
+                set_error(w, w->path, errno);
+                if (w->strict) return -1;
+            }
+            else if (w->follow_symlinks && !visit(w, fd))
+            {
+                close(fd);
+            }
+            else if (!push_frame(w, fd, path_len, depth))
+            {
+                close(fd);
+                set_error(w, w->path, errno);
+                if (w->strict) return -1;
+            }
+        }
+
+        if (w->include_count > 0 && !matches_any(w->include, w->include_count, d->d_name, rel)) continue;
+        entry->path = w->path;
+        entry->path_len = path_len;
+        entry->type = type;
+        entry->depth = depth;
+        return 1;
+    }
+    return 0;
+}
+
+// parallel walk
+
+static walk_batch_t *new_batch(void)
+{
+    walk_batch_t *b = (walk_batch_t *)calloc(1, sizeof(walk_batch_t));
+    return b;
+}
+
+static void free_batch(walk_batch_t *b)
+{
+    if (b == NULL) return;
+    free(b->buf);
+    free(b);
+}
+
+static bool batch_add(walk_batch_t *b, const char *path, size_t len, int type, int depth)
+{
+    if (b->buf_len + len + 1 > b->buf_cap)
+    {
+        size_t cap = b->buf_cap == 0 ? 16384 : b->buf_cap * 2;
+        while (cap < b->buf_len + len + 1) cap *= 2;
+        char *buf = realloc(b->buf, cap);
+        if (buf == NULL) return false;
+        b->buf = buf;
+        b->buf_cap = cap;
+    }
+    walk_record_t *r = &b->records[b->count++];
+    r->offset = b->buf_len;
+    r->len = len;
+    r->type = type;
+    r->depth = depth;
+    memcpy(b->buf + b->buf_len, path, len + 1);
+    b->buf_len += len + 1;
+    return true;
+}
+
+// Hands a batch over to the consumer; called with the lock held.
+static void publish_batch(fs_walk_t *w, walk_batch_t *b)
+{
+    while (w->results_count >= WALK_MAX_BATCHES && !is_cancelled(w))
+    {
+        pthread_cond_wait(&w->space_cond, &w->lock);
+    }
+    if (is_cancelled(w))
+    {
+        free_batch(b);
+        return;
+    }
+    if (w->results_tail != NULL)
+        w->results_tail->next = b;
+    else
+        w->results_head = b;
+    w->results_tail = b;
+    w->results_count++;
+    pthread_cond_signal(&w->result_cond);
+}
+
+static void fail_locked(fs_walk_t *w, const char *path, int err)
+{
+    set_error(w, path, err);
+    if (w->strict)
+    {
+        __atomic_store_n(&w->cancelled, true, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&w->work_cond);
+        pthread_cond_broadcast(&w->space_cond);
+        pthread_cond_broadcast(&w->result_cond);
+    }
+}
+
+static void release_dir(walk_dir_t *d)
+{
+    if (d != NULL && __atomic_sub_fetch(&d->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        closedir(d->dir);
+        free(d);
+    }
+}
+
+static void process_directory(fs_walk_t *w, walk_item_t item)
+{
+    // opened from its parent, without resolving the path again
+    int fd = item.parent == NULL ? open(item.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+                                 : open_subdir(w, dirfd(item.parent->dir), item.path + item.name_offset);
+    walk_dir_t *self = fd == -1 ? NULL : (walk_dir_t *)malloc(sizeof(walk_dir_t));
+    DIR *dir = self == NULL ? NULL : fdopendir(fd);
+    if (dir == NULL)
+    {
+        int err = errno;
+        if (fd != -1) close(fd);
+        free(self);
+        pthread_mutex_lock(&w->lock);
+        fail_locked(w, item.path, err);
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+    self->dir = dir;
+    self->refs = 1;
+
+    size_t base_len = strlen(item.path);
+    char *path = NULL;
+    size_t path_cap = 0;
+    walk_batch_t *batch = NULL;
+    walk_item_t *subdirs = NULL;
+    size_t subdirs_count = 0, subdirs_cap = 0;
+    int depth = item.depth + 1;
+    int err = 0;
+
+    while (!is_cancelled(w))
+    {
+        errno = 0;
+        struct dirent *d = readdir(dir);
+        if (d == NULL)
+        {
+            err = errno;
+            break;
+        }
+        if (is_dot_or_dotdot(d->d_name)) continue;
+
+        size_t name_len = strlen(d->d_name);
+        size_t path_len = base_len + 1 + name_len;
+        if (path_len + 1 > path_cap)
+        {
+            path_cap = (path_len + 1) * 2;
+            char *p = realloc(path, path_cap);
+            if (p == NULL)
+            {
+                err = ENOMEM;
+                break;
+            }
+            path = p;
+        }
+        memcpy(path, item.path, base_len);
+        if (base_len > 0 && item.path[base_len - 1] == '/') path_len--;
+        else path[base_len] = '/';
+        memcpy(path + path_len - name_len, d->d_name, name_len + 1);
+
+        const char *rel = path + w->root_len + (path[w->root_len] == '/' ? 1 : 0);
+        if (matches_any(w->exclude, w->exclude_count, d->d_name, rel)) continue;
+
+        int type = entry_type(w, dirfd(dir), d);
+        if (should_descend(w, type, depth))
+        {
+            bool descend = true;
+            if (w->follow_symlinks)
+            {
+                int sub_fd = open_subdir(w, dirfd(dir), d->d_name);
+                pthread_mutex_lock(&w->lock);
+                descend = sub_fd != -1 && visit(w, sub_fd);
+                pthread_mutex_unlock(&w->lock);
+                if (sub_fd != -1) close(sub_fd);
+            }
+            if (descend)
+            {
+                char *sub = strdup(path);
+                if (sub == NULL || !grow((void **)&subdirs, &subdirs_cap, subdirs_count, sizeof(walk_item_t)))
+                {
+                    free(sub);
+                    err = ENOMEM;
+                    break;
+                }
+                subdirs[subdirs_count].path = sub;
+                subdirs[subdirs_count].name_offset = path_len - name_len;
+                subdirs[subdirs_count].depth = depth;
+                subdirs[subdirs_count].parent = self;
+                subdirs_count++;
+            }
+        }
+
+        if (w->include_count > 0 && !matches_any(w->include, w->include_count, d->d_name, rel)) continue;
+        if (batch == NULL && (batch = new_batch()) == NULL)
+        {
+            err = ENOMEM;
+            break;
+        }
+        if (!batch_add(batch, path, path_len, type, depth))
+        {
+            err = ENOMEM;
+            break;
+        }
+        if (batch->count == WALK_BATCH_SIZE)
+        {
+            pthread_mutex_lock(&w->lock);
+            publish_batch(w, batch);
+            pthread_mutex_unlock(&w->lock);
+            batch = NULL;
+        }
+    }
+    free(path);
+
+    pthread_mutex_lock(&w->lock);
+    if (err != 0) fail_locked(w, item.path, err);
+    if (batch != NULL) publish_batch(w, batch);
+    for (size_t i = 0; i < subdirs_count; i++)
+    {
+        if (!is_cancelled(w) && grow((void **)&w->queue, &w->queue_cap, w->queue_count, sizeof(walk_item_t)))
+        {
+            w->queue[w->queue_count++] = subdirs[i];
+            __atomic_add_fetch(&self->refs, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            free(subdirs[i].path);
+        }
+    }
+    if (subdirs_count > 0) pthread_cond_broadcast(&w->work_cond);
+    pthread_mutex_unlock(&w->lock);
+    free(subdirs);
+    release_dir(self);
+}
+
+static void *worker(void *arg)
+{
+    fs_walk_t *w = (fs_walk_t *)arg;
+    pthread_mutex_lock(&w->lock);
+    while (!is_cancelled(w))
+    {
+        if (w->queue_count > 0)
+        {
+            walk_item_t item = w->queue[--w->queue_count];
+            w->busy++;
+            pthread_mutex_unlock(&w->lock);
+            process_directory(w, item);
+            release_dir(item.parent);
+            free(item.path);
+            pthread_mutex_lock(&w->lock);
+            w->busy--;
+            continue;
+        }
+        if (w->busy == 0)
+        {
+            w->done = true;
+            pthread_cond_broadcast(&w->work_cond);
+            pthread_cond_broadcast(&w->result_cond);
+            break;
+        }
+        pthread_cond_wait(&w->work_cond, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static int walk_next_parallel(fs_walk_t *w, walk_entry_t *entry)
+{
+    walk_batch_t *b = w->current;
+    if (b == NULL || b->next_record == b->count)
+    {
+        free_batch(b);
+        w->current = NULL;
+
+        pthread_mutex_lock(&w->lock);
+        while (w->results_head == NULL && !w->done && !is_cancelled(w))
+        {
+            pthread_cond_wait(&w->result_cond, &w->lock);
+        }
+        b = w->results_head;
+        if (b != NULL)
+        {
+            w->results_head = b->next;
+            if (w->results_head == NULL) w->results_tail = NULL;
+            w->results_count--;
+            pthread_cond_signal(&w->space_cond);
+        }
+        bool failed = has_failed(w) && w->strict;
+        pthread_mutex_unlock(&w->lock);
+
+        if (failed)
+        {
+            free_batch(b);
+            return -1;
+        }
+        if (b == NULL) return 0;
+        w->current = b;
+    }
+
+    walk_record_t *r = &b->records[b->next_record++];
+    entry->path = b->buf + r->offset;
+    entry->path_len = r->len;
+    entry->type = r->type;
+    entry->depth = r->depth;
+    return 1;
+}
+
+static void free_patterns(char **patterns, size_t count)
+{
+    if (patterns == NULL) return;
+    for (size_t i = 0; i < count; i++) free(patterns[i]);
+    free(patterns);
+}
+
+// Returns a copy of the patterns, or NULL if there are none or the memory is exhausted.
+static char **copy_patterns(const char *const *patterns, size_t count)
+{
+    if (count == 0) return NULL;
+    char **copy = (char **)calloc(count, sizeof(char *));
+    if (copy == NULL) return NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        copy[i] = strdup(patterns[i]);
+        if (copy[i] == NULL)
+        {
+            free_patterns(copy, i);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+fs_walk_t *fsL_walk_open(const char *root, const walk_opts_t *opts)
+{
+    int fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+
+    fs_walk_t *w = (fs_walk_t *)calloc(1, sizeof(fs_walk_t));
+    if (w == NULL) goto ERROR;
+
+    w->max_depth = opts->max_depth;
+    w->follow_symlinks = opts->follow_symlinks;
+    w->strict = opts->strict;
+    w->include_count = opts->include_count;
+    w->exclude_count = opts->exclude_count;
+    w->include = copy_patterns(opts->include, opts->include_count);
+    w->exclude = copy_patterns(opts->exclude, opts->exclude_count);
+    if ((opts->include_count > 0 && w->include == NULL) || (opts->exclude_count > 0 && w->exclude == NULL))
+    {
+        goto ERROR;
+    }
+    w->root_len = strlen(root);
+    if (w->follow_symlinks && !visit(w, fd)) goto ERROR;
+
+    if (opts->threads <= 1)
+    {
+        w->path_cap = w->root_len + 256;
+        w->path = (char *)malloc(w->path_cap);
+        if (w->path == NULL) goto ERROR;
+        memcpy(w->path, root, w->root_len + 1);
+        if (!push_frame(w, fd, w->root_len, 0)) goto ERROR;
+        return w;
+    }
+
+    close(fd);
+    fd = -1;
+    w->threads = opts->threads;
+    w->queue_cap = 16;
+    w->queue = (walk_item_t *)malloc(w->queue_cap * sizeof(walk_item_t));
+    w->workers = (pthread_t *)malloc((size_t)w->threads * sizeof(pthread_t));
+    if (w->queue == NULL || w->workers == NULL) goto ERROR;
+    w->queue[0].path = strdup(root);
+    w->queue[0].name_offset = 0;
+    w->queue[0].depth = 0;
+    w->queue[0].parent = NULL;
+    if (w->queue[0].path == NULL) goto ERROR;
+    w->queue_count = 1;
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work_cond, NULL);
+    pthread_cond_init(&w->result_cond, NULL);
+    pthread_cond_init(&w->space_cond, NULL);
+    for (int i = 0; i < w->threads; i++)
+    {
+        int err = pthread_create(&w->workers[i], NULL, worker, w);
+        if (err != 0)
+        {
+            if (i > 0) break;
+            errno = err;
+            pthread_cond_destroy(&w->space_cond);
+            pthread_cond_destroy(&w->result_cond);
+            pthread_cond_destroy(&w->work_cond);
+            pthread_mutex_destroy(&w->lock);
+            goto ERROR;
+        }
+        w->workers_count++;
+    }
+    return w;
+
+ERROR:
+{
+    int err = errno;
+    if (fd != -1 && (w == NULL || w->frames_count == 0)) close(fd);
+    fsL_walk_close(w);
+    errno = err;
+    return NULL;
+}
+}
+
+int fsL_walk_next(fs_walk_t *w, walk_entry_t *entry)
+{
+    return w->workers_count > 0 ? walk_next_parallel(w, entry) : walk_next_sequential(w, entry);
+}
+
+const char *fsL_walk_error(fs_walk_t *w)
+{
+    return has_failed(w) ? w->error : NULL;
+}
+
+void fsL_walk_close(fs_walk_t *w)
+{
+    if (w == NULL) return;
+
+    if (w->workers_count > 0)
+    {
+        pthread_mutex_lock(&w->lock);
+        __atomic_store_n(&w->cancelled, true, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&w->work_cond);
+        pthread_cond_broadcast(&w->space_cond);
+        pthread_mutex_unlock(&w->lock);
+        for (int i = 0; i < w->workers_count; i++) pthread_join(w->workers[i], NULL);
+        pthread_cond_destroy(&w->space_cond);
+        pthread_cond_destroy(&w->result_cond);
+        pthread_cond_destroy(&w->work_cond);
+        pthread_mutex_destroy(&w->lock);
+    }
+    for (size_t i = 0; i < w->queue_count; i++)
+    {
+        release_dir(w->queue[i].parent);
+        free(w->queue[i].path);
+    }
+    free(w->queue);
+    free(w->workers);
+    free_batch(w->current);
+    for (walk_batch_t *b = w->results_head; b != NULL;)
+    {
+        walk_batch_t *next = b->next;
+        free_batch(b);
+        b = next;
+    }
+
+    for (size_t i = 0; i < w->frames_count; i++) closedir(w->frames[i].dir);
+    free(w->frames);
+    free(w->path);
+    free(w->visited);
+    free_patterns(w->include, w->include_count);
+    free_patterns(w->exclude, w->exclude_count);
+    free(w);
+}
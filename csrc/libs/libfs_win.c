@@ -22,14 +22,24 @@ lua_Integer to_unix_time(FILETIME ft)
     return (li.QuadPart - TIME_TICKS_TO_UNIX_EPOCH) / TIME_TICKS_PER_MILLIS;
 }
 
-bool fsL_copy_file(lua_State *L, const char *src, const char *dst, bool overwrite)
+bool fsL_copy_file(lua_State *L, const char *src, const char *dst, const copy_opts_t *opts)
 {
     const WCHAR *src16 = utfL_to_utf16(L, src);
     const WCHAR *dst16 = utfL_to_utf16(L, dst);
-    BOOL r = CopyFileW(src16, dst16, !overwrite);
+    // CopyFile preserves the attributes and the last write time
+    BOOL r = CopyFileW(src16, dst16, !opts->overwrite);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (r && opts->progress != 0) r = GetFileAttributesExW(dst16, GetFileExInfoStandard, &data);
     utfL_free(L, dst16);
     utfL_free(L, src16);
-    return r;
+    if (!r || opts->progress == 0) return r;
+
+    lua_Integer size = ((lua_Integer)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    lua_pushvalue(L, opts->progress);
+    lua_pushinteger(L, size);
+    lua_pushinteger(L, size);
+    lua_call(L, 2, 0);
+    return true;
 }
 
 bool fsL_rename(lua_State *L, const char *src, const char *dst, bool overwrite)
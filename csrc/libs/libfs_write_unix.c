@@ -0,0 +1,257 @@
+#include "libfs.h"
+#include "libtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if !defined(IOV_MAX)
+#define IOV_MAX 1024
+#endif
+
+// the alignment of the buffers, offsets and lengths of O_DIRECT writes
+#define DIRECT_ALIGNMENT 4096
+#define DIRECT_STAGE_SIZE (1 << 20)
+
+struct fs_writer_s
+{
+    int fd;
+    int sync;
+    char *path;
+    char *temp;     // the temporary file of an atomic writer, or NULL
+    char *stage;    // the aligned buffer of O_DIRECT writes, or NULL
+    size_t staged;  // the bytes in the stage
+    off_t length;   // the bytes written, without the padding of O_DIRECT writes
+};
+
+// Writes all the buffers in `iov`, resuming after short writes; `iov` is changed.
+static bool writev_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return true;
+}
+
+static bool sync_fd(int fd)
+{
+#if defined(_STD_APPLE)
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+// Makes the rename of the temporary file durable.
+static bool sync_parent(const char *path)
+{
+    const char *sep = strrchr(path, '/');
+    char *dir = sep == NULL ? strdup(".") : strndup(path, sep == path ? 1 : (size_t)(sep - path));
+    if (dir == NULL) return false;
+    int fd = open(dir, O_RDONLY | O_CLOEXEC);
+    free(dir);
+    if (fd == -1) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// Creates a new file, named after `path`, with the permissions of a file created by open.
+static int create_temp(const char *path, char **temp)
+{
+    size_t len = strlen(path) + 16;
+    char *name = (char *)malloc(len);
+    if (name == NULL) return -1;
+
+    lua_Integer seed = 0;
+    timeL_monotonic_time(&seed);
+    unsigned int r = (unsigned int)seed ^ ((unsigned int)getpid() << 16);
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        r = r * 1103515245u + 12345u;
+        snprintf(name, len, "%s.%06x.tmp", path, r & 0xFFFFFF);
+        int fd = open(name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd != -1)
+        {
+            *temp = name;
+            return fd;
+        }
+        if (errno != EEXIST) break;
+    }
+    int err = errno;
+    free(name);
+    errno = err;
+    return -1;
+}
+
+// Gives the temporary file the owner and the permissions of the regular file it replaces, if any.
+// If the process is not allowed to give the file to its owner, the set-user-ID and set-group-ID
+// bits are not copied; a symbolic link, which the rename replaces, keeps the defaults of open.
+static bool copy_target_attributes(fs_writer_t *w)
+{
+    struct stat st;
+    if (lstat(w->path, &st) != 0) return errno == ENOENT;
+    if (!S_ISREG(st.st_mode)) return true;
+    mode_t mode = st.st_mode & 07777;
+    if (fchown(w->fd, st.st_uid, st.st_gid) != 0)
+    {
+        if (errno != EPERM) return false;
+        mode &= ~(mode_t)(S_ISUID | S_ISGID);
+    }
+    // after fchown, which clears the set-user-ID and set-group-ID bits
+    return fchmod(w->fd, mode) == 0;
+}
+
+static bool enable_direct(fs_writer_t *w)
+{
+#if defined(O_DIRECT)
+    // file systems without direct I/O, like tmpfs, reject the flag: fall back to cached writes
+    int flags = fcntl(w->fd, F_GETFL);
+    if (flags == -1 || fcntl(w->fd, F_SETFL, flags | O_DIRECT) == -1) return true;
+    void *stage;
+    if ((errno = posix_memalign(&stage, DIRECT_ALIGNMENT, DIRECT_STAGE_SIZE)) != 0) return false;
+    w->stage = (char *)stage;
+#elif defined(F_NOCACHE)
+    fcntl(w->fd, F_NOCACHE, 1);
+#endif
+    return true;
+}
+
+fs_writer_t *fsL_writer_open(lua_State *L, const char *path, int sync, bool atomic)
+{
+    fs_writer_t *w = (fs_writer_t *)calloc(1, sizeof(fs_writer_t));
+    if (w == NULL) return NULL;
+    w->sync = sync;
+    w->path = strdup(path);
+    if (w->path == NULL) goto ERROR;
+
+    w->fd = atomic ? create_temp(path, &w->temp) : open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (w->fd == -1) goto ERROR;
+    if (sync == FS_SYNC_DIRECT && !enable_direct(w))
+    {
+        fsL_writer_close(L, w, false);
+        return NULL;
+    }
+    return w;
+
+ERROR:;
+    int err = errno;
+    free(w->path);
+    free(w);
+    errno = err;
+    return NULL;
+}
+
+static bool writer_stage(fs_writer_t *w, const fs_buffer_t *bufs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *data = bufs[i].data;
+        size_t len = bufs[i].len;
+        while (len > 0)
+        {
+            size_t n = DIRECT_STAGE_SIZE - w->staged;
+            if (n > len) n = len;
+            memcpy(w->stage + w->staged, data, n);
+            w->staged += n;
+            data += n;
+            len -= n;
+            if (w->staged == DIRECT_STAGE_SIZE)
+            {
+                if (!write_all(w->fd, w->stage, DIRECT_STAGE_SIZE, 0, false)) return false;
+                w->staged = 0;
+            }
+        }
+    }
+    return true;
+}
+
+bool fsL_writer_write(fs_writer_t *w, const fs_buffer_t *bufs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) w->length += (off_t)bufs[i].len;
+    if (w->stage != NULL) return writer_stage(w, bufs, count);
+
+    struct iovec iov[IOV_MAX < 1024 ? IOV_MAX : 1024];
+    const size_t max = sizeof(iov) / sizeof(iov[0]);
+    while (count > 0)
+    {
+        size_t n = count < max ? count : max;
+        for (size_t i = 0; i < n; i++)
+        {
+            iov[i].iov_base = (void *)bufs[i].data;
+            iov[i].iov_len = bufs[i].len;
+        }
+        if (!writev_all(w->fd, iov, (int)n)) return false;
+        bufs += n;
+        count -= n;
+    }
+    return true;
+}
+
+// Writes the last, partial block of an O_DIRECT writer padded to the alignment, and then cuts the
+// padding.
+static bool writer_flush_stage(fs_writer_t *w)
+{
+    if (w->staged == 0) return true;
+    size_t padded = (w->staged + DIRECT_ALIGNMENT - 1) & ~(size_t)(DIRECT_ALIGNMENT - 1);
+    memset(w->stage + w->staged, 0, padded - w->staged);
+    if (!write_all(w->fd, w->stage, padded, 0, false)) return false;
+    w->staged = 0;
+    return ftruncate(w->fd, w->length) == 0;
+}
+
+bool fsL_writer_close(lua_State *L, fs_writer_t *w, bool commit)
+{
+    int err = errno;
+    bool ok = true;
+    if (commit)
+    {
+        if (w->stage != NULL) ok = writer_flush_stage(w);
+        if (ok && w->temp != NULL) ok = copy_target_attributes(w);
+        if (ok && w->sync != FS_SYNC_NONE) ok = sync_fd(w->fd);
+    }
+    if (close(w->fd) != 0) ok = false;
+    if (w->temp != NULL)
+    {
+        if (ok && commit)
+        {
+            ok = fsL_rename(L, w->temp, w->path, true);
+            if (ok && w->sync != FS_SYNC_NONE) ok = sync_parent(w->path);
+        }
+        if (!ok || !commit)
+        {
+            int rename_err = errno;
+            unlink(w->temp);
+            errno = rename_err;
+        }
+    }
+    if (!commit) errno = err;
+    free(w->stage);
+    free(w->temp);
+    free(w->path);
+    free(w);
+    return ok && commit;
+}
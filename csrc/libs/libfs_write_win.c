@@ -0,0 +1,125 @@
+#include "libfs.h"
+
+#include "libutf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+struct fs_writer_s
+{
+    HANDLE file;
+    int sync;
+    char *path;
+    char *temp; // the temporary file of an atomic writer, or NULL
+};
+
+static HANDLE create_file(lua_State *L, const char *path, DWORD disposition, DWORD flags)
+{
+    const WCHAR *path16 = utfL_to_utf16(L, path);
+    HANDLE file = CreateFileW(path16, GENERIC_WRITE, 0, NULL, disposition, flags, NULL);
+    utfL_free(L, path16);
+    return file;
+}
+
+static HANDLE create_temp(lua_State *L, const char *path, DWORD flags, char **temp)
+{
+    size_t len = strlen(path) + 16;
+    char *name = (char *)malloc(len);
+    if (name == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    unsigned int r = (unsigned int)GetTickCount64() ^ ((unsigned int)GetCurrentProcessId() << 16);
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        r = r * 1103515245u + 12345u;
+        snprintf(name, len, "%s.%06x.tmp", path, r & 0xFFFFFF);
+        HANDLE file = create_file(L, name, CREATE_NEW, flags);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            *temp = name;
+            return file;
+        }
+        if (GetLastError() != ERROR_FILE_EXISTS) break;
+    }
+    DWORD err = GetLastError();
+    free(name);
+    SetLastError(err);
+    return INVALID_HANDLE_VALUE;
+}
+
+fs_writer_t *fsL_writer_open(lua_State *L, const char *path, int sync, bool atomic)
+{
+    fs_writer_t *w = (fs_writer_t *)calloc(1, sizeof(fs_writer_t));
+    if (w == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    w->sync = sync;
+    w->path = _strdup(path);
+    if (w->path == NULL)
+    {
+        free(w);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    // unbuffered writes need sector-aligned buffers: write through the cache instead
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | (sync == FS_SYNC_DIRECT ? FILE_FLAG_WRITE_THROUGH : 0);
+    w->file = atomic ? create_temp(L, path, flags, &w->temp) : create_file(L, path, CREATE_ALWAYS, flags);
+    if (w->file == INVALID_HANDLE_VALUE)
+    {
+        DWORD err = GetLastError();
+        free(w->path);
+        free(w);
+        SetLastError(err);
+        return NULL;
+    }
+    return w;
+}
+
+bool fsL_writer_write(fs_writer_t *w, const fs_buffer_t *bufs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *data = bufs[i].data;
+        size_t len = bufs[i].len;
+        while (len > 0)
+        {
+            DWORD n = len > MAXDWORD ? MAXDWORD : (DWORD)len;
+            DWORD written;
+            if (!WriteFile(w->file, data, n, &written, NULL)) return false;
+            data += written;
+            len -= written;
+        }
+    }
+    return true;
+}
+
+bool fsL_writer_close(lua_State *L, fs_writer_t *w, bool commit)
+{
+    DWORD err = GetLastError();
+    bool ok = true;
+    if (commit && w->sync != FS_SYNC_NONE) ok = FlushFileBuffers(w->file);
+    if (!CloseHandle(w->file)) ok = false;
+    if (w->temp != NULL)
+    {
+        if (ok && commit) ok = fsL_rename(L, w->temp, w->path, true);
+        if (!ok || !commit)
+        {
+            DWORD rename_err = GetLastError();
+            fsL_remove_file(L, w->temp);
+            SetLastError(rename_err);
+        }
+    }
+    if (!commit) SetLastError(err);
+    free(w->temp);
+    free(w->path);
+    free(w);
+    return ok && commit;
+}
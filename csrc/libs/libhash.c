@@ -0,0 +1,237 @@
+#include "libhash.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_STD_WINDOWS)
+#include <intrin.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+// The engine is derived from wyhash (https://github.com/wangyi-fudan/wyhash), released into the public domain.
+
+#define S0 0x2d358dccaa6c78a5ULL
+#define S1 0x8bb84b93962eacc9ULL
+#define S2 0x4b33a62ed433d4a3ULL
+#define S3 0x4d5a2da51de1aa47ULL
+
+static inline void mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+uint64_t hashL_mix(uint64_t a, uint64_t b)
+{
+    mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t r8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if _STD_BYTE_ORDER == _STD_ORDER_BIG_ENDIAN
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t r4(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if _STD_BYTE_ORDER == _STD_ORDER_BIG_ENDIAN
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t r3(const unsigned char *p, size_t len)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+static inline uint64_t finish(uint64_t a, uint64_t b, uint64_t seed, uint64_t len)
+{
+    a ^= S1;
+    b ^= seed;
+    mum(&a, &b);
+    return hashL_mix(a ^ S0 ^ len, b ^ S1);
+}
+
+static inline uint64_t finish_short(const unsigned char *p, size_t len, uint64_t seed)
+{
+    uint64_t a = 0, b = 0;
+    if (len >= 4)
+    {
+        size_t k = (len >> 3) << 2;
+        a = (r4(p) << 32) | r4(p + k);
+        b = (r4(p + len - 4) << 32) | r4(p + len - 4 - k);
+    }
+    else if (len > 0)
+    {
+        a = r3(p, len);
+    }
+    return finish(a, b, seed, len);
+}
+
+// Hashes the last 1..48 bytes of a message longer than 16 bytes; `p - 16` must be readable.
+static inline uint64_t finish_long(const unsigned char *p, size_t i, uint64_t len, uint64_t seed)
+{
+    while (i > 16)
+    {
+        seed = hashL_mix(r8(p) ^ S1, r8(p + 8) ^ seed);
+        i -= 16;
+        p += 16;
+    }
+    return finish(r8(p + i - 16), r8(p + i - 8), seed, len);
+}
+
+static inline void consume_block(const unsigned char *p, uint64_t *seed, uint64_t *see1, uint64_t *see2)
+{
+    *seed = hashL_mix(r8(p) ^ S1, r8(p + 8) ^ *seed);
+    *see1 = hashL_mix(r8(p + 16) ^ S2, r8(p + 24) ^ *see1);
+    *see2 = hashL_mix(r8(p + 32) ^ S3, r8(p + 40) ^ *see2);
+}
+
+static inline uint64_t mix_seed(uint64_t seed)
+{
+    return seed ^ hashL_mix(seed ^ S0, S1);
+}
+
+uint64_t hashL_bytes(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    seed = mix_seed(seed);
+    if (len <= 16) return finish_short(p, len, seed);
+
+    size_t i = len;
+    if (i > _LIBHASH_BLOCK_SIZE)
+    {
+        uint64_t see1 = seed, see2 = seed;
+        do
+        {
+            consume_block(p, &seed, &see1, &see2);
+            p += _LIBHASH_BLOCK_SIZE;
+            i -= _LIBHASH_BLOCK_SIZE;
+        } while (i > _LIBHASH_BLOCK_SIZE);
+        seed ^= see1 ^ see2;
+    }
+    return finish_long(p, i, len, seed);
+}
+
+void hashL_init(hash_state_t *state, uint64_t seed)
+{
+    state->seed = state->see1 = state->see2 = mix_seed(seed);
+    state->length = 0;
+    state->buf_len = 0;
+}
+
+// A block is consumed only once more input follows it, so that the digest always sees the last 1..48 bytes.
+void hashL_update(hash_state_t *state, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned char *block = state->buf + _LIBHASH_TAIL_SIZE;
+
+    state->length += len;
+    while (len > 0)
+    {
+        if (state->buf_len == _LIBHASH_BLOCK_SIZE)
+        {
+            consume_block(block, &state->seed, &state->see1, &state->see2);
+            memcpy(state->buf, block + _LIBHASH_BLOCK_SIZE - _LIBHASH_TAIL_SIZE, _LIBHASH_TAIL_SIZE);
+            state->buf_len = 0;
+        }
+
+        if (state->buf_len == 0 && len > _LIBHASH_BLOCK_SIZE)
+        {
+            do
+            {
+                consume_block(p, &state->seed, &state->see1, &state->see2);
+                p += _LIBHASH_BLOCK_SIZE;
+                len -= _LIBHASH_BLOCK_SIZE;
+            } while (len > _LIBHASH_BLOCK_SIZE);
+            memcpy(state->buf, p - _LIBHASH_TAIL_SIZE, _LIBHASH_TAIL_SIZE);
+        }
+
+        size_t n = _LIBHASH_BLOCK_SIZE - state->buf_len;
+        if (n > len) n = len;
+        memcpy(block + state->buf_len, p, n);
+        state->buf_len += n;
+        p += n;
+        len -= n;
+    }
+}
+
+uint64_t hashL_digest(const hash_state_t *state)
+{
+    const unsigned char *block = state->buf + _LIBHASH_TAIL_SIZE;
+    if (state->length <= 16) return finish_short(block, state->buf_len, state->seed);
+    if (state->length <= _LIBHASH_BLOCK_SIZE) return finish_long(block, state->buf_len, state->length, state->seed);
+    return finish_long(block, state->buf_len, state->length, state->seed ^ state->see1 ^ state->see2);
+}
+
+static uint64_t __libhash_seed = 0;
+
+static uint64_t make_seed(void)
+{
+    const char *s = getenv("STD_HASH_SEED");
+    if (s != NULL && *s != '\0')
+    {
+        char *end;
+        uint64_t seed = (uint64_t)strtoull(s, &end, 0);
+        if (*end == '\0') return seed;
+    }
+
+    uint64_t entropy[4];
+    entropy[0] = (uint64_t)time(NULL);
+    entropy[1] = (uint64_t)clock();
+    entropy[2] = (uint64_t)(uintptr_t)&entropy;
+    entropy[3] = (uint64_t)getpid();
+    return hashL_bytes(entropy, sizeof(entropy), (uint64_t)(uintptr_t)&make_seed);
+}
+
+// Returns the per-process seed; set the STD_HASH_SEED environment variable to make hashes reproducible.
+uint64_t hashL_seed(void)
+{
+#if defined(_MSC_VER)
+    uint64_t seed = (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)&__libhash_seed, 0, 0);
+#else
+    uint64_t seed = __atomic_load_n(&__libhash_seed, __ATOMIC_ACQUIRE);
+#endif
+    if (seed != 0) return seed;
+
+    seed = make_seed();
+    if (seed == 0) seed = S0;
+
+    uint64_t expected = 0;
+#if defined(_MSC_VER)
+    expected = (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)&__libhash_seed, (__int64)seed, 0);
+    return expected == 0 ? seed : expected;
+#else
+    if (__atomic_compare_exchange_n(&__libhash_seed, &expected, seed, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return seed;
+    }
+    return expected;
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "std.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define _LIBHASH_BLOCK_SIZE 48
+#define _LIBHASH_TAIL_SIZE 16
+
+typedef struct
+{
+    uint64_t seed;
+    uint64_t see1;
+    uint64_t see2;
+    uint64_t length;
+    size_t buf_len;
+    // the first 16 bytes hold the tail of the last block consumed
+    unsigned char buf[_LIBHASH_TAIL_SIZE + _LIBHASH_BLOCK_SIZE];
+} hash_state_t;
+
+uint64_t hashL_seed(void);
+uint64_t hashL_bytes(const void *data, size_t len, uint64_t seed);
+uint64_t hashL_mix(uint64_t a, uint64_t b);
+
+void hashL_init(hash_state_t *state, uint64_t seed);
+void hashL_update(hash_state_t *state, const void *data, size_t len);
+uint64_t hashL_digest(const hash_state_t *state);
+
+#define hashL_fold32(h) ((uint32_t)((h) ^ ((h) >> 32)))
@@ -18,20 +18,12 @@ bool pathL_is_rooted(const char *path, size_t path_len, bool *verbatim)
 
 bool pathL_is_valid_path(const char *path, size_t path_len)
 {
-    for (size_t i = path_len; i--;)
-    {
-        if (!is_valid_path_char(*path++)) return false;
-    }
-    return true;
+    return scan_invalid_path_char(path, path_len) == path_len;
 }
 
 bool pathL_is_valid_file_name(const char *path, size_t path_len)
 {
-    for (size_t i = path_len; i--;)
-    {
-        if (!is_valid_file_name_char(*path++)) return false;
-    }
-    return true;
+    return scan_invalid_file_name_char(path, path_len) == path_len;
 }
 
 bool pathL_is_empty(const char *path, size_t path_len)
@@ -43,11 +35,16 @@ bool pathL_is_empty(const char *path, size_t path_len)
     return true;
 }
 
+// Paths are compared without case on Windows only, as their file systems do.
 int pathL_compare(const char *path, size_t path_len, const char *other_path, size_t other_path_len)
 {
     if (path_len > other_path_len) return 1;
     if (path_len < other_path_len) return -1;
+#if defined(_STD_WINDOWS)
     return strncasecmp(path, other_path, path_len);
+#else
+    return memcmp(path, other_path, path_len);
+#endif
 }
 
 const char *pathL_checklpath(lua_State *L, int arg, size_t *size)
@@ -98,14 +95,12 @@ path_components_t pathL_split_path(const char *path, size_t path_len)
     bool verbatim;
     size_t root_len = pathL_root_length(path, path_len, &verbatim);
 
+    // the last separator after the first character following the root
     size_t file_offset = root_len;
-    for (size_t i = path_len; --i > root_len;)
+    if (path_len > root_len + 1)
     {
-        if (pathL_is_dirsep(path[i], verbatim))
-        {
-            file_offset = i + 1;
-            break;
-        }
+        size_t end = scan_dirsep_back(path + root_len + 1, path_len - root_len - 1, verbatim);
+        if (end > 0) file_offset = root_len + 1 + end;
     }
 
     size_t dir_len = file_offset;
@@ -114,14 +109,12 @@ path_components_t pathL_split_path(const char *path, size_t path_len)
         dir_len--;
     }
 
+    // the last dot after the first two characters of the file name
     size_t ext_offset = 0;
-    for (size_t i = path_len; --i > file_offset + 1;)
+    if (path_len > file_offset + 2)
     {
-        if (path[i] == '.')
-        {
-            ext_offset = i + 1;
-            break;
-        }
+        size_t end = scan_char_back(path + file_offset + 2, path_len - file_offset - 2, '.');
+        if (end > 0) ext_offset = file_offset + 2 + end;
     }
 
     path_components_t components;
@@ -141,30 +134,16 @@ path_components_t pathL_split_path(const char *path, size_t path_len)
     return components;
 }
 
-struct path_tokenizer
-{
-    const char *path;
-    size_t remaining;
-    bool verbatim;
-};
-
-path_tokenizer_t *path_tokenizer_new(lua_State *L, const char *path, size_t path_len, bool verbatim)
+void path_tokenizer_init(path_tokenizer_t *tokenizer, const char *path, size_t path_len, bool verbatim)
 {
     for (; path_len && pathL_is_dirsep(*path, verbatim); path++, path_len--)
         ;
     for (; path_len && pathL_is_dirsep(path[path_len - 1], verbatim); path_len--)
         ;
 
-    path_tokenizer_t *tokenizer = allocatorL_malloc(L, sizeof(path_tokenizer_t));
     tokenizer->path = path;
     tokenizer->remaining = path_len;
     tokenizer->verbatim = verbatim;
-    return tokenizer;
-}
-
-void path_tokenizer_free(lua_State *L, path_tokenizer_t *tokenizer)
-{
-    allocatorL_free(L, tokenizer);
 }
 
 const char *path_tokenizer_next(path_tokenizer_t *tokenizer, size_t *token_length)
@@ -183,8 +162,9 @@ const char *path_tokenizer_next(path_tokenizer_t *tokenizer, size_t *token_lengt
         if (!n) break;
 
         const char *q = p;
-        for (; n && !pathL_is_dirsep(*p, verbatim); p++, n--)
-            ;
+        size_t token_len = scan_dirsep(p, n, verbatim);
+        p += token_len;
+        n -= token_len;
 
         if (*q != '.' || p != q + 1 || n == 0 || verbatim)
         {
@@ -219,8 +199,9 @@ const char *path_tokenizer_next_back(path_tokenizer_t *tokenizer, size_t *token_
         if (!n) break;
 
         const char *q = p;
-        for (; n && !pathL_is_dirsep(p[-1], verbatim); p--, n--)
-            ;
+        size_t start = scan_dirsep_back(p - n, n, verbatim);
+        p -= n - start;
+        n = start;
 
         if (*p != '.' || q != p + 1 || n == 0 || verbatim)
         {
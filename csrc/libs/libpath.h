@@ -18,6 +18,34 @@ int pathL_full_path(lua_State *L, const char *path, size_t path_len);
 int pathL_root(lua_State *L, const char *path, size_t path_len);
 int pathL_normalize(lua_State *L, const char *path, size_t path_len);
 int pathL_canonicalize(lua_State *L, const char *path, size_t path_len);
+size_t pathL_normalize_into(char *dst, const char *path, size_t path_len);
+
+// The state shared by the paths of a batch: the working directory, read once, and the buffers for
+// the longest path of the batch, kept on the stack by pathL_batch_init.
+typedef struct
+{
+    const char *cwd;
+    size_t cwd_len;
+    char *joined;
+    char *scratch;
+} path_batch_t;
+
+bool pathL_batch_init(lua_State *L, path_batch_t *batch, size_t max_path_len, size_t base_path_len, bool needs_cwd);
+int pathL_batch_full_path(lua_State *L, path_batch_t *batch, const char *base_path, size_t base_path_len,
+                          const char *path, size_t path_len);
+
+// The counters of a cache of pathL_resolve_physical, whose entries are in a table: the kind of the
+// directories resolved, and the target of the links, by their physical path.
+typedef struct
+{
+    lua_Integer generation;
+    lua_Integer hits;
+    lua_Integer misses;
+} path_resolve_cache_t;
+
+int pathL_resolve_lexical(lua_State *L, const char *path, size_t path_len);
+int pathL_resolve_physical(lua_State *L, const char *path, size_t path_len, path_resolve_cache_t *cache,
+                           int entries);
 
 bool pathL_is_fully_qualified(const char *path, size_t path_len);
 bool pathL_is_dirsep(const char c, bool verbatim);
@@ -51,9 +79,14 @@ const char *pathL_optlpath(lua_State *L, int arg, const char *def, size_t *size)
 #define _PATH_OPTPATH(name, arg, def) \
     const char *name = pathL_optlpath(L, arg, def, NULL);
 
-typedef struct path_tokenizer path_tokenizer_t;
-path_tokenizer_t *path_tokenizer_new(lua_State *L, const char *path, size_t path_len, bool verbatim);
-void path_tokenizer_free(lua_State *L, path_tokenizer_t *tokenizer);
+typedef struct
+{
+    const char *path;
+    size_t remaining;
+    bool verbatim;
+} path_tokenizer_t;
+
+void path_tokenizer_init(path_tokenizer_t *tokenizer, const char *path, size_t path_len, bool verbatim);
 
 const char *path_tokenizer_next(path_tokenizer_t *tokenizer, size_t *token_length);
 const char *path_tokenizer_next_back(path_tokenizer_t *tokenizer, size_t *token_length);
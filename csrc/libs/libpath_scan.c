@@ -0,0 +1,262 @@
+// Scans paths a block of bytes at a time, for the separators, the dots and the invalid characters.
+// Included by the platform files, after their character tests, which handle the bytes left after
+// the last block; the blocks are 16 bytes with SSE2 (x86_64) and NEON (arm64), which are always
+// available there.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_STD_CPU_X86_64)
+#include <emmintrin.h>
+#define SCAN_SSE2
+#elif defined(_STD_CPU_ARM64)
+#include <arm_neon.h>
+#define SCAN_NEON
+#endif
+
+#if defined(_MSC_VER) && (defined(SCAN_SSE2) || defined(SCAN_NEON))
+#include <intrin.h>
+#endif
+
+#if defined(SCAN_SSE2) || defined(SCAN_NEON)
+#define SCAN_BLOCK 16
+
+#if defined(SCAN_SSE2)
+typedef __m128i block_t;
+
+// the number of bits for each byte in a mask
+#define MASK_BITS 1
+
+static inline block_t block_load(const char *p)
+{
+    return _mm_loadu_si128((const __m128i *)(const void *)p);
+}
+
+static inline block_t block_eq(block_t v, char c)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+// the bytes of `v` lower than or equal to `c`, as signed chars
+static inline block_t block_le(block_t v, char c)
+{
+    return _mm_xor_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(c)), _mm_set1_epi8(-1));
+}
+
+static inline block_t block_or(block_t a, block_t b)
+{
+    return _mm_or_si128(a, b);
+}
+
+static inline block_t block_and(block_t a, block_t b)
+{
+    return _mm_and_si128(a, b);
+}
+
+static inline uint64_t block_mask(block_t v)
+{
+    return (uint64_t)_mm_movemask_epi8(v);
+}
+#else
+typedef uint8x16_t block_t;
+
+#define MASK_BITS 4
+
+static inline block_t block_load(const char *p)
+{
+    return vld1q_u8((const uint8_t *)p);
+}
+
+static inline block_t block_eq(block_t v, char c)
+{
+    return vceqq_u8(v, vdupq_n_u8((uint8_t)c));
+}
+
+static inline block_t block_le(block_t v, char c)
+{
+    return vcleq_s8(vreinterpretq_s8_u8(v), vdupq_n_s8((int8_t)c));
+}
+
+static inline block_t block_or(block_t a, block_t b)
+{
+    return vorrq_u8(a, b);
+}
+
+static inline block_t block_and(block_t a, block_t b)
+{
+    return vandq_u8(a, b);
+}
+
+// NEON has no movemask: the comparison is narrowed to 4 bits for each byte
+static inline uint64_t block_mask(block_t v)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+#endif
+
+// the index of the first byte set in a mask that is not 0
+static inline size_t mask_first(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (size_t)index / MASK_BITS;
+#else
+    return (size_t)__builtin_ctzll(mask) / MASK_BITS;
+#endif
+}
+
+// the index of the last byte set in a mask that is not 0
+static inline size_t mask_last(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, mask);
+    return (size_t)index / MASK_BITS;
+#else
+    return (size_t)(63 - __builtin_clzll(mask)) / MASK_BITS;
+#endif
+}
+
+static inline block_t block_dirsep(block_t v, bool verbatim)
+{
+#if defined(_STD_WINDOWS)
+    block_t sep = block_eq(v, _STD_PATH_DIRSEP);
+    return verbatim ? sep : block_or(sep, block_eq(v, _STD_PATH_ALTDIRSEP));
+#else
+    (void)verbatim;
+    return block_eq(v, _STD_PATH_DIRSEP);
+#endif
+}
+
+// as is_valid_path_char
+static inline block_t block_invalid_path_char(block_t v)
+{
+#if defined(_STD_WINDOWS)
+    return block_or(block_le(v, 31), block_eq(v, '|'));
+#else
+    return block_eq(v, '\0');
+#endif
+}
+
+// as is_valid_file_name_char
+static inline block_t block_invalid_file_name_char(block_t v)
+{
+#if defined(_STD_WINDOWS)
+    block_t invalid = block_or(block_invalid_path_char(v), block_eq(v, '"'));
+    invalid = block_or(invalid, block_or(block_eq(v, '*'), block_eq(v, '/')));
+    invalid = block_or(invalid, block_or(block_eq(v, ':'), block_eq(v, '<')));
+    invalid = block_or(invalid, block_or(block_eq(v, '>'), block_eq(v, '?')));
+    return block_or(invalid, block_eq(v, '\\'));
+#else
+    return block_or(block_eq(v, '\0'), block_eq(v, '/'));
+#endif
+}
+#endif
+
+// Returns the index of the first directory separator of a path, or its length.
+static size_t scan_dirsep(const char *path, size_t path_len, bool verbatim)
+{
+    size_t i = 0;
+#if defined(SCAN_BLOCK)
+    for (; i + SCAN_BLOCK <= path_len; i += SCAN_BLOCK)
+    {
+        uint64_t mask = block_mask(block_dirsep(block_load(path + i), verbatim));
+        if (mask != 0) return i + mask_first(mask);
+    }
+#endif
+    for (; i < path_len && !pathL_is_dirsep(path[i], verbatim); i++)
+        ;
+    return i;
+}
+
+// Returns the index after the last directory separator of a path, or 0.
+static size_t scan_dirsep_back(const char *path, size_t path_len, bool verbatim)
+{
+    size_t i = path_len;
+#if defined(SCAN_BLOCK)
+    for (; i >= SCAN_BLOCK; i -= SCAN_BLOCK)
+    {
+        uint64_t mask = block_mask(block_dirsep(block_load(path + i - SCAN_BLOCK), verbatim));
+        if (mask != 0) return i - SCAN_BLOCK + mask_last(mask) + 1;
+    }
+#endif
+    for (; i > 0 && !pathL_is_dirsep(path[i - 1], verbatim); i--)
+        ;
+    return i;
+}
+
+// Returns the index after the last `c` of a path, or 0.
+static size_t scan_char_back(const char *path, size_t path_len, char c)
+{
+    size_t i = path_len;
+#if defined(SCAN_BLOCK)
+    for (; i >= SCAN_BLOCK; i -= SCAN_BLOCK)
+    {
+        uint64_t mask = block_mask(block_eq(block_load(path + i - SCAN_BLOCK), c));
+        if (mask != 0) return i - SCAN_BLOCK + mask_last(mask) + 1;
+    }
+#endif
+    for (; i > 0 && path[i - 1] != c; i--)
+        ;
+    return i;
+}
+
+// Returns the index of the first directory separator followed by another one, or by a dot if
+// `dot`; or the length of the path.
+static size_t scan_dirsep_pair(const char *path, size_t path_len, bool verbatim, bool dot)
+{
+    size_t i = 0;
+#if defined(SCAN_BLOCK)
+    // each block is compared with the block starting a byte after
+    for (; i + SCAN_BLOCK < path_len; i += SCAN_BLOCK)
+    {
+        block_t next = block_load(path + i + 1);
+        block_t follows = block_dirsep(next, verbatim);
+        if (dot) follows = block_or(follows, block_eq(next, '.'));
+        uint64_t mask = block_mask(block_and(block_dirsep(block_load(path + i), verbatim), follows));
+        if (mask != 0) return i + mask_first(mask);
+    }
+#endif
+    for (; i + 1 < path_len; i++)
+    {
+        if (pathL_is_dirsep(path[i], verbatim)
+            && (pathL_is_dirsep(path[i + 1], verbatim) || (dot && path[i + 1] == '.')))
+        {
+            return i;
+        }
+    }
+    return path_len;
+}
+
+// Returns the index of the first character not valid in a path, or the length of the path.
+static size_t scan_invalid_path_char(const char *path, size_t path_len)
+{
+    size_t i = 0;
+#if defined(SCAN_BLOCK)
+    for (; i + SCAN_BLOCK <= path_len; i += SCAN_BLOCK)
+    {
+        uint64_t mask = block_mask(block_invalid_path_char(block_load(path + i)));
+        if (mask != 0) return i + mask_first(mask);
+    }
+#endif
+    for (; i < path_len && is_valid_path_char(path[i]); i++)
+        ;
+    return i;
+}
+
+// Returns the index of the first character not valid in a file name, or the length of the name.
+static size_t scan_invalid_file_name_char(const char *path, size_t path_len)
+{
+    size_t i = 0;
+#if defined(SCAN_BLOCK)
+    for (; i + SCAN_BLOCK <= path_len; i += SCAN_BLOCK)
+    {
+        uint64_t mask = block_mask(block_invalid_file_name_char(block_load(path + i)));
+        if (mask != 0) return i + mask_first(mask);
+    }
+#endif
+    for (; i < path_len && is_valid_file_name_char(path[i]); i++)
+        ;
+    return i;
+}
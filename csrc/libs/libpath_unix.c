@@ -6,6 +6,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <lauxlib.h>
 #include <stdbool.h>
 
@@ -15,9 +16,14 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 
 #define BUF_SIZE 1024
 
+#if !defined(MAXSYMLINKS)
+#define MAXSYMLINKS 32
+#endif
+
 static inline bool is_valid_file_name_char(const char c)
 {
     return c != '\0' && c != '/';
@@ -33,6 +39,8 @@ bool pathL_is_dirsep(const char c, bool verbatim)
     return c == _STD_PATH_DIRSEP;
 }
 
+#include "libpath_scan.c"
+
 bool pathL_is_verbatim(const char *path, size_t path_len)
 {
     return false;
@@ -51,14 +59,7 @@ int pathL_is_absolute(const char *path, size_t path_len)
 
 bool pathL_is_normalized(const char *path, size_t path_len)
 {
-    for (size_t i = 1; i < path_len; i++)
-    {
-        if (pathL_is_dirsep(path[i], false) && pathL_is_dirsep(path[i - 1], false))
-        {
-            return false;
-        }
-    }
-    return true;
+    return scan_dirsep_pair(path, path_len, false, false) == path_len;
 }
 
 bool pathL_is_partially_qualified(const char *path, size_t path_len)
@@ -101,121 +102,188 @@ static bool push_cwd(lua_State *L)
     }
 }
 
-int pathL_full_path(lua_State *L, const char *path, size_t path_len)
+// Writes the full path of the rooted path `path` into `tmp`, which holds at least `path_len` bytes,
+// and returns its length.
+static size_t resolve_full_path(char *tmp, const char *path, size_t path_len)
 {
-    if (!pathL_is_rooted(path, path_len, NULL))
-    {
-        luaL_Buffer b;
-        luaL_buffinit(L, &b);
-        if (!push_cwd(L))
-        {
-            _STD_RETURN_NIL_ERROR;
-        }
-        luaL_addvalue(&b);
-        luaL_addchar(&b, _STD_PATH_DIRSEP);
-        luaL_addlstring(&b, path, path_len);
-        luaL_pushresult(&b);
-
-        path = lua_tolstring(L, -1, &path_len);
-    }
-
     size_t root_len = pathL_root_length(path, path_len, NULL);
     assert(root_len > 0);
 
     size_t tmp_len = 0;
-    char *tmp = allocatorL_allocT(L, char, path_len);
-    memset(tmp, 0, path_len);
-
     size_t skip = root_len;
     if (pathL_is_dirsep(path[skip - 1], false))
     {
         skip--;
     }
 
-    for (size_t i = 0; i < skip; i++)
-    {
-        tmp[tmp_len++] = path[i];
-    }
+    memcpy(tmp, path, skip);
+    tmp_len = skip;
 
-    // printf("  skip %zd\n", skip);
-    // printf("  tmp_len %zd\n", tmp_len);
-
-    for (size_t i = skip; i < path_len; i++)
+    size_t i = skip;
+    while (i < path_len)
     {
-        char c = path[i];
-        if (pathL_is_dirsep(c, false) && i + 1 < path_len)
+        // copy the segments up to a separator followed by another one or by a dot
+        size_t next = i + scan_dirsep_pair(path + i, path_len - i, false, true);
+        memcpy(tmp + tmp_len, path + i, next - i);
+        tmp_len += next - i;
+        i = next;
+        if (i == path_len) break;
+
+        // skip //
+        if (pathL_is_dirsep(path[i + 1], false))
         {
-            // skip //
-            if (pathL_is_dirsep(path[i + 1], false)) continue;
+            i++;
+            continue;
+        }
 
-            // skip /./
-            if ((i + 2 == path_len || pathL_is_dirsep(path[i + 2], false)) && path[i + 1] == '.')
-            {
-                i++;
-                continue;
-            }
+        // skip /./
+        if (i + 2 == path_len || pathL_is_dirsep(path[i + 2], false))
+        {
+            i += 2;
+            continue;
+        }
 
-            // rewind on /../
-            if (i + 2 < path_len && (i + 3 == path_len || pathL_is_dirsep(path[i + 3], false)) && path[i + 1] == '.'
-                && path[i + 2] == '.')
+        // rewind on /../
+        if (path[i + 2] == '.' && (i + 3 == path_len || pathL_is_dirsep(path[i + 3], false)))
+        {
+            size_t new_tmp_len = skip;
+            if (tmp_len > root_len)
             {
-                size_t new_tmp_len = skip;
-                for (size_t j = tmp_len; j-- > root_len;)
-                {
-                    if (pathL_is_dirsep(tmp[j], false))
-                    {
-                        new_tmp_len = j;
-                        break;
-                    }
-                }
-
-                tmp_len = new_tmp_len < skip ? skip : new_tmp_len;
-                // printf("    tmp_len %zd\n", tmp_len);
-
-                i += 2;
-                continue;
+                size_t j = root_len + scan_dirsep_back(tmp + root_len, tmp_len - root_len, false);
+                if (j > root_len) new_tmp_len = j - 1;
             }
 
-            tmp[tmp_len++] = c;
+            tmp_len = new_tmp_len < skip ? skip : new_tmp_len;
+            i += 3;
             continue;
         }
 
-        tmp[tmp_len++] = c;
+        // "/.name"
+        tmp[tmp_len++] = path[i++];
     }
     if (skip != root_len && tmp_len < root_len)
     {
         tmp[tmp_len++] = path[root_len - 1];
     }
+    return tmp_len;
+}
 
+// Pushes the full path of `path`, without its trailing separator if `trim`.
+static int push_full_path(lua_State *L, const char *path, size_t path_len, bool trim)
+{
+    if (!pathL_is_rooted(path, path_len, NULL))
+    {
+        luaL_Buffer b;
+        luaL_buffinit(L, &b);
+        if (!push_cwd(L))
+        {
+            _STD_RETURN_NIL_ERROR;
+        }
+        luaL_addvalue(&b);
+        luaL_addchar(&b, _STD_PATH_DIRSEP);
+        luaL_addlstring(&b, path, path_len);
+        luaL_pushresult(&b);
+
+        path = lua_tolstring(L, -1, &path_len);
+    }
+
+    char *tmp = allocatorL_allocT(L, char, path_len);
+    size_t tmp_len = resolve_full_path(tmp, path, path_len);
+    if (trim && tmp_len > 1 && pathL_is_dirsep(tmp[tmp_len - 1], false))
+    {
+        tmp_len--;
+    }
     lua_pushlstring(L, tmp, tmp_len);
     allocatorL_free(L, tmp);
     return 1;
 }
 
-int pathL_normalize(lua_State *L, const char *path, size_t path_len)
+int pathL_full_path(lua_State *L, const char *path, size_t path_len)
 {
-    if (pathL_is_normalized(path, path_len))
+    return push_full_path(L, path, path_len, false);
+}
+
+int pathL_resolve_lexical(lua_State *L, const char *path, size_t path_len)
+{
+    return push_full_path(L, path, path_len, true);
+}
+
+bool pathL_batch_init(lua_State *L, path_batch_t *batch, size_t max_path_len, size_t base_path_len, bool needs_cwd)
+{
+    batch->cwd = NULL;
+    batch->cwd_len = 0;
+    if (needs_cwd)
     {
-        lua_settop(L, 1);
-        return 1;
+        if (!push_cwd(L)) return false;
+        batch->cwd = lua_tolstring(L, -1, &batch->cwd_len);
     }
 
-    size_t tmp_len = 0;
-    char *tmp = allocatorL_allocT(L, char, path_len);
-    bool skip_sep = 0;
-    for (size_t i = 0; i < path_len; i++)
+    // the joined path, and its full path
+    size_t prefix_len = base_path_len > batch->cwd_len ? base_path_len : batch->cwd_len;
+    size_t size = prefix_len + 1 + max_path_len + 1;
+    batch->joined = (char *)lua_newuserdatauv(L, 2 * size, 0);
+    batch->scratch = batch->joined + size;
+    return true;
+}
+
+int pathL_batch_full_path(lua_State *L, path_batch_t *batch, const char *base_path, size_t base_path_len,
+                          const char *path, size_t path_len)
+{
+    if (!pathL_is_rooted(path, path_len, NULL))
     {
-        if (!pathL_is_dirsep(path[i], false))
+        if (base_path == NULL)
         {
-            skip_sep = false;
-            tmp[tmp_len++] = path[i];
+            base_path = batch->cwd;
+            base_path_len = batch->cwd_len;
         }
-        else if (!skip_sep)
+        else if (path_len == 0)
         {
-            skip_sep = true;
-            tmp[tmp_len++] = path[i];
+            path = base_path;
+            path_len = base_path_len;
+            base_path = NULL;
         }
+
+        if (base_path != NULL)
+        {
+            memcpy(batch->joined, base_path, base_path_len);
+            batch->joined[base_path_len] = _STD_PATH_DIRSEP;
+            memcpy(batch->joined + base_path_len + 1, path, path_len);
+            path = batch->joined;
+            path_len += base_path_len + 1;
+        }
+    }
+
+    lua_pushlstring(L, batch->scratch, resolve_full_path(batch->scratch, path, path_len));
+    return 1;
+}
+
+size_t pathL_normalize_into(char *dst, const char *path, size_t path_len)
+{
+    size_t len = 0;
+    size_t i = 0;
+    while (i < path_len)
+    {
+        // copy up to the first separator of a run
+        size_t next = i + scan_dirsep_pair(path + i, path_len - i, false, false);
+        size_t end = next < path_len ? next + 1 : path_len;
+        memcpy(dst + len, path + i, end - i);
+        len += end - i;
+        for (i = end; i < path_len && pathL_is_dirsep(path[i], false); i++)
+            ;
     }
+    return len;
+}
+
+int pathL_normalize(lua_State *L, const char *path, size_t path_len)
+{
+    if (pathL_is_normalized(path, path_len))
+    {
+        lua_settop(L, 1);
+        return 1;
+    }
+
+    char *tmp = allocatorL_allocT(L, char, path_len);
+    size_t tmp_len = pathL_normalize_into(tmp, path, path_len);
     lua_pushlstring(L, tmp, tmp_len);
     allocatorL_free(L, tmp);
     return 1;
@@ -231,3 +299,186 @@ int pathL_canonicalize(lua_State *L, const char *path, size_t path_len)
     }
     _STD_RETURN_NIL_ERROR
 }
+
+enum
+{
+    KIND_LINK,
+    KIND_NOT_LINK,
+};
+
+// Returns whether the file at the physical path `prefix` is a link, with its target copied into
+// `target`, from the cache if any, or from the file system; returns -1, with errno set, if the file
+// cannot be read. As realpath, the links are read directly: reading the other files fails.
+// The links, and the directories, followed by other segments, are cached; the last segments of the
+// paths, seldom resolved twice, are not.
+static int read_kind(lua_State *L, const char *prefix, size_t prefix_len, bool is_directory,
+                     path_resolve_cache_t *cache, int entries, char *target, size_t *target_len)
+{
+    if (cache != NULL)
+    {
+        lua_pushlstring(L, prefix, prefix_len);
+        int type = lua_rawget(L, entries);
+        if (type != LUA_TNIL)
+        {
+            cache->hits++;
+            int kind = KIND_NOT_LINK;
+            if (type == LUA_TSTRING)
+            {
+                const char *s = lua_tolstring(L, -1, target_len);
+                memcpy(target, s, *target_len);
+                kind = KIND_LINK;
+            }
+            lua_pop(L, 1);
+            return kind;
+        }
+        lua_pop(L, 1);
+        cache->misses++;
+    }
+
+    ssize_t n = readlink(prefix, target, MAXPATHLEN);
+    if (n < 0)
+    {
+        if (errno != EINVAL) return -1;
+        if (cache == NULL || !is_directory) return KIND_NOT_LINK;
+
+        lua_pushlstring(L, prefix, prefix_len);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, entries);
+        return KIND_NOT_LINK;
+    }
+    if (n >= MAXPATHLEN)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    *target_len = (size_t)n;
+    if (cache == NULL) return KIND_LINK;
+
+    lua_pushlstring(L, prefix, prefix_len);
+    lua_pushlstring(L, target, *target_len);
+    lua_rawset(L, entries);
+    return KIND_LINK;
+}
+
+// Returns whether the segments left start with a name, other than `.` and `..`: reading it then
+// fails if the segment before is not a directory.
+static bool starts_with_name(const char *left, size_t left_len)
+{
+    size_t i = 0;
+    while (i < left_len)
+    {
+        size_t end = i + scan_dirsep(left + i, left_len - i, false);
+        size_t n = end - i;
+        if (n == 2 && left[i] == '.' && left[i + 1] == '.') return false;
+        if (n > 1 || (n == 1 && left[i] != '.')) return true;
+        i = end + 1;
+    }
+    return false;
+}
+
+int pathL_resolve_physical(lua_State *L, const char *path, size_t path_len, path_resolve_cache_t *cache,
+                           int entries)
+{
+    // the path resolved so far, which has no links, and the segments left to resolve
+    char resolved[MAXPATHLEN];
+    char left[MAXPATHLEN];
+    char target[MAXPATHLEN];
+    size_t resolved_len;
+    size_t left_len = path_len;
+    int links = 0;
+
+    if (path_len >= MAXPATHLEN)
+    {
+        errno = ENAMETOOLONG;
+        _STD_RETURN_NIL_ERROR
+    }
+    memcpy(left, path, path_len);
+
+    if (pathL_is_rooted(path, path_len, NULL))
+    {
+        resolved[0] = _STD_PATH_DIRSEP;
+        resolved_len = 1;
+    }
+    else
+    {
+        if (!getcwd(resolved, MAXPATHLEN))
+        {
+            _STD_RETURN_NIL_ERROR
+        }
+        resolved_len = strlen(resolved);
+    }
+
+    size_t i = 0;
+    while (i < left_len)
+    {
+        size_t end = i + scan_dirsep(left + i, left_len - i, false);
+        const char *segment = left + i;
+        size_t segment_len = end - i;
+        i = end < left_len ? end + 1 : end;
+
+        if (segment_len == 0 || (segment_len == 1 && segment[0] == '.'))
+        {
+            continue;
+        }
+        if (segment_len == 2 && segment[0] == '.' && segment[1] == '.')
+        {
+            size_t j = scan_dirsep_back(resolved, resolved_len, false);
+            resolved_len = j > 1 ? j - 1 : 1;
+            continue;
+        }
+
+        size_t parent_len = resolved_len;
+        if (resolved_len + 1 + segment_len >= MAXPATHLEN)
+        {
+            errno = ENAMETOOLONG;
+            _STD_RETURN_NIL_ERROR
+        }
+        if (!pathL_is_dirsep(resolved[resolved_len - 1], false))
+        {
+            resolved[resolved_len++] = _STD_PATH_DIRSEP;
+        }
+        memcpy(resolved + resolved_len, segment, segment_len);
+        resolved_len += segment_len;
+        resolved[resolved_len] = '\0';
+
+        size_t target_len = 0;
+        int kind = read_kind(L, resolved, resolved_len, end < left_len, cache, entries, target, &target_len);
+        if (kind < 0)
+        {
+            _STD_RETURN_NIL_ERROR
+        }
+        if (kind == KIND_NOT_LINK)
+        {
+            struct stat st;
+            if (end == left_len || starts_with_name(left + i, left_len - i)) continue;
+            if (stat(resolved, &st) != 0)
+            {
+                _STD_RETURN_NIL_ERROR
+            }
+            if (S_ISDIR(st.st_mode)) continue;
+            errno = ENOTDIR;
+            _STD_RETURN_NIL_ERROR
+        }
+
+        // a link: its target takes its place in the segments left, from its directory or the root
+        if (++links > MAXSYMLINKS)
+        {
+            errno = ELOOP;
+            _STD_RETURN_NIL_ERROR
+        }
+        size_t rest_len = left_len - end;
+        if (target_len + rest_len >= MAXPATHLEN)
+        {
+            errno = ENAMETOOLONG;
+            _STD_RETURN_NIL_ERROR
+        }
+        memmove(left + target_len, left + end, rest_len);
+        memcpy(left, target, target_len);
+        left_len = target_len + rest_len;
+        i = 0;
+        resolved_len = target_len > 0 && pathL_is_dirsep(target[0], false) ? 1 : parent_len;
+    }
+
+    lua_pushlstring(L, resolved, resolved_len);
+    return 1;
+}
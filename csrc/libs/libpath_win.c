@@ -75,6 +75,8 @@ bool pathL_is_dirsep(const char c, bool verbatim)
     return c == _STD_PATH_DIRSEP || (!verbatim && c == _STD_PATH_ALTDIRSEP);
 }
 
+#include "libpath_scan.c"
+
 bool pathL_is_verbatim(const char *path, size_t path_len)
 {
     return path_len >= VERBATIM_PREFIX_LEN && str_eq4(path, VERBATIM_PREFIX);
@@ -230,6 +232,41 @@ int pathL_full_path(lua_State *L, const char *path, size_t path_len)
     }
 }
 
+bool pathL_batch_init(lua_State *L, path_batch_t *batch, size_t max_path_len, size_t base_path_len, bool needs_cwd)
+{
+    // GetFullPathNameW reads the working directory itself
+    batch->cwd = NULL;
+    batch->cwd_len = 0;
+    size_t size = base_path_len + 1 + max_path_len + 1;
+    batch->joined = (char *)lua_newuserdatauv(L, 2 * size, 0);
+    batch->scratch = batch->joined + size;
+    return true;
+}
+
+int pathL_batch_full_path(lua_State *L, path_batch_t *batch, const char *base_path, size_t base_path_len,
+                          const char *path, size_t path_len)
+{
+    if (base_path != NULL && !pathL_is_fully_qualified(path, path_len))
+    {
+        if (path_len == 0)
+        {
+            path = base_path;
+            path_len = base_path_len;
+        }
+        else
+        {
+            // NUL-terminated for utfL_to_utf16x
+            memcpy(batch->joined, base_path, base_path_len);
+            batch->joined[base_path_len] = _STD_PATH_DIRSEP;
+            memcpy(batch->joined + base_path_len + 1, path, path_len);
+            path_len += base_path_len + 1;
+            batch->joined[path_len] = '\0';
+            path = batch->joined;
+        }
+    }
+    return pathL_full_path(L, path, path_len);
+}
+
 void pathL_get_random_bytes(char *bytes)
 {
     LARGE_INTEGER li;
@@ -239,14 +276,12 @@ void pathL_get_random_bytes(char *bytes)
     memcpy(bytes, &bits, sizeof(uint64_t));
 }
 
-int pathL_normalize(lua_State *L, const char *path, size_t path_len)
+size_t pathL_normalize_into(char *dst, const char *path, size_t path_len)
 {
-    char *normalized = allocatorL_allocT(L, char, path_len);
-
     size_t i = 0;
     if (pathL_is_dirsep(path[0], false))
     {
-        normalized[0] = _STD_PATH_DIRSEP;
+        dst[0] = _STD_PATH_DIRSEP;
         i = 1;
     }
 
@@ -257,15 +292,22 @@ int pathL_normalize(lua_State *L, const char *path, size_t path_len)
         char c = path[i++];
         if (!pathL_is_dirsep(c, false))
         {
-            normalized[len++] = c;
+            dst[len++] = c;
             skip_sep = 0;
         }
         else if (!skip_sep)
         {
-            normalized[len++] = _STD_PATH_DIRSEP;
+            dst[len++] = _STD_PATH_DIRSEP;
             skip_sep = 1;
         }
     }
+    return len;
+}
+
+int pathL_normalize(lua_State *L, const char *path, size_t path_len)
+{
+    char *normalized = allocatorL_allocT(L, char, path_len);
+    size_t len = pathL_normalize_into(normalized, path, path_len);
     lua_pushlstring(L, normalized, len);
     allocatorL_free(L, normalized);
     return 1;
@@ -306,3 +348,27 @@ int pathL_canonicalize(lua_State *L, const char *path, size_t path_len)
     if (ok) return 1;
     _STD_RETURN_NIL_ERROR
 }
+
+int pathL_resolve_lexical(lua_State *L, const char *path, size_t path_len)
+{
+    // GetFullPathNameW resolves the path without reading the file system
+    if (pathL_full_path(L, path, path_len) != 1) return 2;
+
+    size_t full_path_len;
+    const char *full_path = lua_tolstring(L, -1, &full_path_len);
+    if (full_path_len > pathL_root_length(full_path, full_path_len, NULL)
+        && pathL_is_dirsep(full_path[full_path_len - 1], false))
+    {
+        lua_pushlstring(L, full_path, full_path_len - 1);
+    }
+    return 1;
+}
+
+int pathL_resolve_physical(lua_State *L, const char *path, size_t path_len, path_resolve_cache_t *cache,
+                           int entries)
+{
+    // the reparse points are resolved by the system, through a handle on the file
+    (void)cache;
+    (void)entries;
+    return pathL_canonicalize(L, path, path_len);
+}
@@ -4,3 +4,35 @@
 #else
 #include "libsleep_unix.c"
 #endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Hints the processor that the thread is spinning, sparing power and the sibling hyperthread.
+static void cpu_relax(void)
+{
+#if defined(_MSC_VER) && defined(_STD_CPU_X86)
+    _mm_pause();
+#elif defined(_MSC_VER) && defined(_STD_CPU_ARM)
+    __yield();
+#elif defined(_STD_CPU_X86)
+    __builtin_ia32_pause();
+#elif defined(_STD_CPU_ARM)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void sleepL_spin_until(lua_Integer deadline, lua_Integer spin)
+{
+    lua_Integer now;
+    if (!timeL_monotonic_time(&now)) return;
+    if (deadline - now > spin)
+    {
+        sleepL_sleep_until(deadline - spin);
+    }
+    while (timeL_monotonic_time(&now) && now < deadline)
+    {
+        cpu_relax();
+    }
+}
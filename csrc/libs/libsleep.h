@@ -1,5 +1,19 @@
 #pragma once
 
 #include <lua.h>
+#include <stdbool.h>
+
+// the waits shorter than this are spun by sleepL_spin_until: a sleep of the kernel overshoots them by
+// the timer slack and the wakeup latency, tens of microseconds
+#define SLEEP_SPIN_NANOS 100000LL
 
 void sleepL_sleep(lua_Integer millis);
+// Suspends the thread for `nanos` nanoseconds, resuming the sleep when interrupted by a signal.
+void sleepL_sleep_ns(lua_Integer nanos);
+// Suspends the thread until timeL_monotonic_time reaches `deadline`, in nanoseconds.
+void sleepL_sleep_until(lua_Integer deadline);
+// Sleeps until `spin` nanoseconds before `deadline`, then busy-waits until timeL_monotonic_time reaches it.
+void sleepL_spin_until(lua_Integer deadline, lua_Integer spin);
+// Gets and sets the timer slack of the thread: how late the kernel may wake it up, in nanoseconds.
+bool sleepL_timer_slack(lua_Integer *nanos);
+bool sleepL_set_timer_slack(lua_Integer nanos);
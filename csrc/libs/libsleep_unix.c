@@ -2,15 +2,72 @@
 #include "libtime.h"
 #include "libsleep.h"
 
+#include <errno.h>
 #include <lauxlib.h>
 #include <limits.h>
 #include <math.h>
 #include <time.h>
 
+#if defined(_STD_LINUX)
+#include <sys/prctl.h>
+#endif
+
 void sleepL_sleep(lua_Integer millis)
+{
+    sleepL_sleep_ns(millis * NANOS_PER_MILLI);
+}
+
+void sleepL_sleep_ns(lua_Integer nanos)
 {
     struct timespec rqtp, rmtp;
-    rqtp.tv_sec = millis / 1000;
-    rqtp.tv_nsec = (millis % 1000) * 1000000;
-    nanosleep(&rqtp, &rmtp);
+    rqtp.tv_sec = (time_t)(nanos / NANOS_PER_SECOND);
+    rqtp.tv_nsec = (long)(nanos % NANOS_PER_SECOND);
+    while (nanosleep(&rqtp, &rmtp) == -1 && errno == EINTR)
+    {
+        rqtp = rmtp;
+    }
+}
+
+void sleepL_sleep_until(lua_Integer deadline)
+{
+#if defined(_STD_APPLE)
+    // there is no clock_nanosleep
+    lua_Integer now;
+    if (!timeL_monotonic_time(&now) || deadline <= now) return;
+    sleepL_sleep_ns(deadline - now);
+#else
+    // an absolute sleep is resumed after a signal without drifting
+    if (deadline <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / NANOS_PER_SECOND);
+    ts.tv_nsec = (long)(deadline % NANOS_PER_SECOND);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+#endif
+}
+
+bool sleepL_timer_slack(lua_Integer *nanos)
+{
+#if defined(_STD_LINUX)
+    int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    if (slack == -1) return false;
+    *nanos = slack;
+    return true;
+#else
+    (void)nanos;
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
+bool sleepL_set_timer_slack(lua_Integer nanos)
+{
+#if defined(_STD_LINUX)
+    return prctl(PR_SET_TIMERSLACK, (unsigned long)nanos, 0, 0, 0) == 0;
+#else
+    (void)nanos;
+    errno = ENOTSUP;
+    return false;
+#endif
 }
@@ -1,5 +1,6 @@
 #include "std.h"
 #include "libtime.h"
+#include "libsleep.h"
 
 #include <lauxlib.h>
 #include <userenv.h>
@@ -8,3 +9,30 @@ void sleepL_sleep(lua_Integer millis)
 {
     Sleep((DWORD)millis);
 }
+
+// Sleep only has the resolution of the system timer, a millisecond at best.
+void sleepL_sleep_ns(lua_Integer nanos)
+{
+    Sleep((DWORD)((nanos + NANOS_PER_MILLI - 1) / NANOS_PER_MILLI));
+}
+
+void sleepL_sleep_until(lua_Integer deadline)
+{
+    lua_Integer now;
+    if (!timeL_monotonic_time(&now) || deadline <= now) return;
+    Sleep((DWORD)((deadline - now + NANOS_PER_MILLI - 1) / NANOS_PER_MILLI));
+}
+
+bool sleepL_timer_slack(lua_Integer *nanos)
+{
+    (void)nanos;
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return false;
+}
+
+bool sleepL_set_timer_slack(lua_Integer nanos)
+{
+    (void)nanos;
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return false;
+}
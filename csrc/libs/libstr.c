@@ -18,7 +18,7 @@ const size_t cstr_length(const cstr_t s)
 
 const cstr_t cstr_alloc(lua_State *L, size_t size)
 {
-    char *s = allocatorL_allocT(L, char, size);
+    char *s = allocatorL_mallocT(L, char, size);
     return (cstr_t) {.ptr = s, .info = 1};
 }
 
@@ -4,3 +4,4 @@
 #else
 #include "libtime_unix.c"
 #endif
+#include "libtime_cycles.c"
@@ -12,3 +12,17 @@ bool timeL_perf_counter(lua_Integer *result);
 bool timeL_process_time(lua_Integer *result);
 bool timeL_system_time(lua_Integer *result);
 bool timeL_monotonic_time(lua_Integer *result);
+
+// the sources of timeL_cycles
+enum
+{
+    TIME_CYCLES_PERF_COUNTER, // the nanoseconds of timeL_perf_counter
+    TIME_CYCLES_TSC,          // the invariant time stamp counter of x86
+    TIME_CYCLES_CNTVCT        // the virtual counter of arm64
+};
+
+// Returns the value of the cycle counter, the cheapest clock of the processor.
+lua_Integer timeL_cycles(void);
+// Returns the frequency of the cycle counter in Hz, calibrated on the first call, and sets `source`.
+lua_Integer timeL_cycles_frequency(int *source);
+lua_Integer timeL_cycles_to_ns(lua_Integer cycles);
@@ -0,0 +1,180 @@
+#include "std.h"
+#include "libtime.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <windows.h>
+#elif defined(_STD_CPU_X86)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// The cycle counter: the time stamp counter on x86 if it is invariant (it ticks at a constant rate
+// whatever the frequency and the sleep states of the cores), the virtual counter on arm64, and
+// timeL_perf_counter elsewhere. Its frequency is calibrated against timeL_perf_counter on the
+// first call, published once by whichever thread gets there first.
+
+#define CALIBRATION_NANOS 2000000LL
+
+enum
+{
+    CYCLES_UNINITIALIZED,
+    CYCLES_INITIALIZING,
+    CYCLES_READY
+};
+
+static volatile long cycles_state = CYCLES_UNINITIALIZED;
+static int cycles_source;
+static lua_Integer cycles_frequency;
+
+#if defined(_MSC_VER)
+// the volatile accesses have the acquire and release semantics
+#define LOAD_ACQUIRE(p) (*(p))
+#define STORE_RELEASE(p, v) (*(p) = (v))
+#else
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+// Returns true if the calling thread is the one to initialize the counter.
+static bool claim_init(void)
+{
+#if defined(_MSC_VER)
+    return InterlockedCompareExchange(&cycles_state, CYCLES_INITIALIZING, CYCLES_UNINITIALIZED) ==
+           CYCLES_UNINITIALIZED;
+#else
+    long expected = CYCLES_UNINITIALIZED;
+    return __atomic_compare_exchange_n(&cycles_state, &expected, CYCLES_INITIALIZING, false, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+#endif
+}
+
+_STD_PRIVATE bool has_invariant_tsc(void)
+{
+#if defined(_STD_CPU_X86) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000007) return false;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#elif defined(_STD_CPU_X86)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007) return false;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+    return (edx & (1 << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+static lua_Integer read_counter(int source)
+{
+    switch (source)
+    {
+#if defined(_STD_CPU_X86)
+        case TIME_CYCLES_TSC:
+            return (lua_Integer)__rdtsc();
+#endif
+#if defined(_STD_CPU_ARM64) && !defined(_MSC_VER)
+        case TIME_CYCLES_CNTVCT:
+        {
+            uint64_t value;
+            __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(value));
+            return (lua_Integer)value;
+        }
+#endif
+        default:
+        {
+            lua_Integer now = 0;
+            timeL_perf_counter(&now);
+            return now;
+        }
+    }
+}
+
+// Reads the counter and the reference clock together, retrying until the reads of the clock
+// around the counter are close.
+static void sample(int source, lua_Integer *cycles, lua_Integer *nanos)
+{
+    lua_Integer best = LUA_MAXINTEGER;
+    *cycles = *nanos = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        lua_Integer before, after;
+        timeL_perf_counter(&before);
+        lua_Integer c = read_counter(source);
+        timeL_perf_counter(&after);
+        if (after - before < best)
+        {
+            best = after - before;
+            *cycles = c;
+            *nanos = before + (after - before) / 2;
+        }
+    }
+}
+
+_STD_PRIVATE lua_Integer calibrate(int source)
+{
+    lua_Integer c0, t0, c1, t1;
+    sample(source, &c0, &t0);
+    do
+    {
+        sample(source, &c1, &t1);
+    } while (t1 - t0 < CALIBRATION_NANOS);
+    return (lua_Integer)((double)(c1 - c0) * NANOS_PER_SECOND / (double)(t1 - t0) + 0.5);
+}
+
+static void init_cycles(void)
+{
+    if (LOAD_ACQUIRE(&cycles_state) == CYCLES_READY) return;
+    if (!claim_init())
+    {
+        // another thread is calibrating
+        while (LOAD_ACQUIRE(&cycles_state) != CYCLES_READY)
+        {
+        }
+        return;
+    }
+
+    int source = TIME_CYCLES_PERF_COUNTER;
+    lua_Integer frequency = NANOS_PER_SECOND;
+#if defined(_STD_CPU_X86)
+    if (has_invariant_tsc())
+    {
+        source = TIME_CYCLES_TSC;
+        frequency = calibrate(source);
+    }
+#elif defined(_STD_CPU_ARM64) && !defined(_MSC_VER)
+    uint64_t cntfrq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(cntfrq));
+    if (cntfrq > 0)
+    {
+        source = TIME_CYCLES_CNTVCT;
+        frequency = (lua_Integer)cntfrq;
+    }
+#endif
+    cycles_source = source;
+    cycles_frequency = frequency > 0 ? frequency : NANOS_PER_SECOND;
+    STORE_RELEASE(&cycles_state, CYCLES_READY);
+}
+
+lua_Integer timeL_cycles(void)
+{
+    if (LOAD_ACQUIRE(&cycles_state) != CYCLES_READY) init_cycles();
+    return read_counter(cycles_source);
+}
+
+lua_Integer timeL_cycles_frequency(int *source)
+{
+    init_cycles();
+    if (source != NULL) *source = cycles_source;
+    return cycles_frequency;
+}
+
+lua_Integer timeL_cycles_to_ns(lua_Integer cycles)
+{
+    lua_Integer frequency = timeL_cycles_frequency(NULL);
+    lua_Integer q = cycles / frequency;
+    lua_Integer r = cycles % frequency;
+    return q * NANOS_PER_SECOND + r * NANOS_PER_SECOND / frequency;
+}
@@ -26,22 +26,19 @@ bool timeL_perf_counter(lua_Integer *result)
     return timeL_monotonic_time(result);
 }
 
-// Returns the number of nanoseconds since an unknown point in time
+// Returns the number of nanoseconds since an unknown point in time, the same in every module: the
+// deadlines computed by one module can be waited for by another.
 bool timeL_monotonic_time(lua_Integer *result)
 {
-    static int64_t t0 = 0;
 #if defined(_STD_APPLE)
     int64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
     if (now < 0) return false;
-    if (t0 == 0) t0 = now;
-    *result = now - t0;
+    *result = now;
     return true;
 #else
     struct timespec ts;
     if (clock_gettime(CLOCK_MONOTONIC, &ts)) return false;
-    int64_t now = ts.tv_sec * NANOS_PER_SECOND + ts.tv_nsec;
-    if (t0 == 0) t0 = now;
-    *result = now - t0;
+    *result = ts.tv_sec * NANOS_PER_SECOND + ts.tv_nsec;
     return true;
 #endif
 }
@@ -31,18 +31,14 @@ static LONGLONG mul_div(LONGLONG value, LONGLONG numer, LONGLONG denom)
 
 static bool get_windows_perf_counter(lua_Integer *result)
 {
-    static LARGE_INTEGER frequency = {0};
-    static LARGE_INTEGER t0 = {0};
-
-    if (frequency.QuadPart == 0)
-    {
-        QueryPerformanceFrequency(&frequency);
-    }
+    // the frequency is fixed at boot, and cheap to read: reading it every time spares a shared
+    // static written by every thread
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
 
     LARGE_INTEGER now;
     if (!QueryPerformanceCounter(&now)) return false;
-    if (t0.QuadPart == 0) t0 = now;
-    *result = (lua_Integer)mul_div(now.QuadPart - t0.QuadPart, NANOS_PER_SECOND, frequency.QuadPart);
+    *result = (lua_Integer)mul_div(now.QuadPart, NANOS_PER_SECOND, frequency.QuadPart);
     return true;
 }
 
@@ -52,13 +48,10 @@ bool timeL_perf_counter(lua_Integer *result)
     return get_windows_perf_counter(result);
 }
 
-// Returns the number of nanoseconds since an unknown point in time
+// Returns the number of nanoseconds since the system was started, the same in every module.
 bool timeL_monotonic_time(lua_Integer *result)
 {
-    static uint64_t t0 = 0;
-    uint64_t now = GetTickCount64();
-    if (t0 == 0) t0 = now;
-    *result = (lua_Integer)((now - t0) * NANOS_PER_MILLI);
+    *result = (lua_Integer)(GetTickCount64() * NANOS_PER_MILLI);
     return true;
 }
 
@@ -72,7 +72,7 @@ WCHAR *utfL_cat16(lua_State *L, const WCHAR *x, const WCHAR *y, size_t *len)
 {
     size_t x_len = wcslen(x);
     size_t y_len = wcslen(y);
-    WCHAR *s = allocatorL_allocT(L, WCHAR, x_len + y_len + 1);
+    WCHAR *s = allocatorL_mallocT(L, WCHAR, x_len + y_len + 1);
     wcsncpy_s(s, x_len + y_len, x, x_len);
     wcsncpy_s(s + x_len, y_len, y, y_len);
     s[x_len + y_len] = L'\0';
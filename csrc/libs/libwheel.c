@@ -0,0 +1,258 @@
+#include "std.h"
+#include "libwheel.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define WHEEL_NIL UINT32_MAX
+#define WHEEL_WORDS (WHEEL_SLOTS / 64)
+#define WHEEL_SLOT_MASK (WHEEL_SLOTS - 1)
+// the farthest expiration the levels can hold: the timers beyond are parked in the last level
+#define WHEEL_RANGE ((UINT64_C(1) << (WHEEL_SLOT_BITS * WHEEL_LEVELS)) - 1)
+#define WHEEL_MAX_NODES INT32_MAX
+
+// The timers are the nodes of circular doubly linked lists, one per slot, indexed rather than
+// pointed to so that the array of nodes may grow. An identifier pairs the index of a node with
+// a generation bumped whenever the node is released, so a stale identifier cannot cancel the
+// timer reusing its node.
+struct wheel_node_s
+{
+    uint64_t expires;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t gen;
+    uint32_t list; // the slot (level * WHEEL_SLOTS + slot) of the node, or WHEEL_NIL if it is free
+};
+
+static int count_trailing_zeros(uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Returns the distance from `start` to the first occupied slot of a level, searching circularly,
+// or -1 if the level is empty.
+static int next_slot(const uint64_t *occupied, uint32_t start)
+{
+    uint32_t first = start / 64;
+    for (uint32_t k = 0; k <= WHEEL_WORDS; k++)
+    {
+        uint32_t word = (first + k) % WHEEL_WORDS;
+        uint64_t bits = occupied[word];
+        if (k == 0)
+            bits &= ~UINT64_C(0) << (start % 64);
+        else if (k == WHEEL_WORDS)
+            bits &= (UINT64_C(1) << (start % 64)) - 1;
+        if (bits != 0)
+        {
+            uint32_t slot = word * 64 + (uint32_t)count_trailing_zeros(bits);
+            return (int)((slot - start) & WHEEL_SLOT_MASK);
+        }
+    }
+    return -1;
+}
+
+static void link_node(wheel_t *w, uint32_t i)
+{
+    wheel_node_t *node = &w->nodes[i];
+    uint64_t expires = node->expires;
+    uint64_t delta = expires > w->now ? expires - w->now : 0;
+    if (delta > WHEEL_RANGE)
+    {
+        expires = w->now + WHEEL_RANGE;
+        delta = WHEEL_RANGE;
+    }
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (UINT64_C(1) << (WHEEL_SLOT_BITS * (level + 1)))) level++;
+    uint32_t slot = (uint32_t)(expires >> (WHEEL_SLOT_BITS * level)) & WHEEL_SLOT_MASK;
+
+    uint32_t *head = &w->heads[level][slot];
+    node->list = (uint32_t)level * WHEEL_SLOTS + slot;
+    if (*head == WHEEL_NIL)
+    {
+        node->prev = node->next = i;
+        *head = i;
+        w->occupied[level][slot / 64] |= UINT64_C(1) << (slot % 64);
+    }
+    else
+    {
+        uint32_t last = w->nodes[*head].prev;
+        node->prev = last;
+        node->next = *head;
+        w->nodes[last].next = i;
+        w->nodes[*head].prev = i;
+    }
+}
+
+static void unlink_node(wheel_t *w, uint32_t i)
+{
+    wheel_node_t *node = &w->nodes[i];
+    uint32_t level = node->list / WHEEL_SLOTS;
+    uint32_t slot = node->list % WHEEL_SLOTS;
+    uint32_t *head = &w->heads[level][slot];
+    if (node->next == i)
+    {
+        *head = WHEEL_NIL;
+        w->occupied[level][slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+    }
+    else
+    {
+        w->nodes[node->prev].next = node->next;
+        w->nodes[node->next].prev = node->prev;
+        if (*head == i) *head = node->next;
+    }
+}
+
+static void release_node(wheel_t *w, uint32_t i)
+{
+    wheel_node_t *node = &w->nodes[i];
+    node->gen = node->gen == INT32_MAX ? 1 : node->gen + 1;
+    node->list = WHEEL_NIL;
+    node->next = w->free;
+    w->free = i;
+    w->count--;
+}
+
+static bool grow(wheel_t *w)
+{
+    if (w->capacity >= WHEEL_MAX_NODES) return false;
+    uint32_t capacity = w->capacity == 0 ? 64 : w->capacity * 2;
+    if (capacity > WHEEL_MAX_NODES) capacity = WHEEL_MAX_NODES;
+    wheel_node_t *nodes = (wheel_node_t *)realloc(w->nodes, capacity * sizeof(wheel_node_t));
+    if (nodes == NULL) return false;
+    // chain the new nodes in the free list, lowest index first
+    for (uint32_t i = w->capacity; i < capacity; i++)
+    {
+        nodes[i].gen = 1;
+        nodes[i].list = WHEEL_NIL;
+        nodes[i].next = i + 1 < capacity ? i + 1 : w->free;
+    }
+    w->free = w->capacity;
+    w->nodes = nodes;
+    w->capacity = capacity;
+    return true;
+}
+
+void wheelL_init(wheel_t *w, uint64_t now)
+{
+    w->now = now;
+    w->count = 0;
+    w->nodes = NULL;
+    w->capacity = 0;
+    w->free = WHEEL_NIL;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) w->heads[level][slot] = WHEEL_NIL;
+        for (int word = 0; word < WHEEL_WORDS; word++) w->occupied[level][word] = 0;
+    }
+}
+
+void wheelL_free(wheel_t *w)
+{
+    free(w->nodes);
+    wheelL_init(w, w->now);
+}
+
+int64_t wheelL_add(wheel_t *w, uint64_t expires)
+{
+    if (w->free == WHEEL_NIL && !grow(w))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    uint32_t i = w->free;
+    wheel_node_t *node = &w->nodes[i];
+    w->free = node->next;
+    node->expires = expires > w->now ? expires : w->now + 1;
+    link_node(w, i);
+    w->count++;
+    return ((int64_t)node->gen << 32) | i;
+}
+
+bool wheelL_cancel(wheel_t *w, int64_t id)
+{
+    if (id < 0) return false;
+    uint32_t i = (uint32_t)(id & UINT32_MAX);
+    uint32_t gen = (uint32_t)(id >> 32);
+    if (i >= w->capacity || w->nodes[i].gen != gen || w->nodes[i].list == WHEEL_NIL) return false;
+    unlink_node(w, i);
+    release_node(w, i);
+    return true;
+}
+
+bool wheelL_next(const wheel_t *w, uint64_t *tick)
+{
+    if (w->count == 0) return false;
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+    {
+        // the slots of level 0 expire at their tick, the others are moved down at their start
+        int shift = WHEEL_SLOT_BITS * level;
+        uint64_t base = (w->now >> shift) + 1;
+        int distance = next_slot(w->occupied[level], (uint32_t)base & WHEEL_SLOT_MASK);
+        if (distance < 0) continue;
+        uint64_t candidate = (base + (uint64_t)distance) << shift;
+        if (candidate < next) next = candidate;
+    }
+    *tick = next;
+    return true;
+}
+
+// Moves the timers of a slot down the levels.
+static void cascade(wheel_t *w, int level, uint32_t slot)
+{
+    uint32_t head = w->heads[level][slot];
+    if (head == WHEEL_NIL) return;
+    w->heads[level][slot] = WHEEL_NIL;
+    w->occupied[level][slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+    uint32_t i = head;
+    bool last;
+    do
+    {
+        uint32_t next = w->nodes[i].next;
+        last = next == head;
+        link_node(w, i);
+        i = next;
+    } while (!last);
+}
+
+void wheelL_advance(wheel_t *w, uint64_t now, wheel_expire_t expire, void *ctx)
+{
+    while (w->now < now)
+    {
+        // the ticks before the next one neither expire timers nor have slots to move down
+        uint64_t next;
+        if (!wheelL_next(w, &next) || next > now)
+        {
+            w->now = now;
+            break;
+        }
+        w->now = next;
+        for (int level = 1; level < WHEEL_LEVELS; level++)
+        {
+            int shift = WHEEL_SLOT_BITS * level;
+            if ((next & ((UINT64_C(1) << shift) - 1)) != 0) break;
+            cascade(w, level, (uint32_t)(next >> shift) & WHEEL_SLOT_MASK);
+        }
+
+        // the callback may add timers, which never go to the current slot, and reallocate the nodes
+        uint32_t *head = &w->heads[0][next & WHEEL_SLOT_MASK];
+        while (*head != WHEEL_NIL)
+        {
+            uint32_t i = *head;
+            int64_t id = ((int64_t)w->nodes[i].gen << 32) | i;
+            unlink_node(w, i);
+            release_node(w, i);
+            expire(ctx, id);
+        }
+    }
+}
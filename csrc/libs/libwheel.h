@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A hierarchical timer wheel. The timers are kept in WHEEL_LEVELS levels of WHEEL_SLOTS slots:
+// a slot of level 0 holds the timers expiring at a single tick, and a slot of level n the timers
+// of 256^n ticks, which are moved down the levels when the wheel reaches them. Adding and
+// cancelling a timer take a constant time, whatever the number of timers.
+
+#define WHEEL_SLOT_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS 4
+
+typedef struct wheel_node_s wheel_node_t;
+
+typedef struct
+{
+    uint64_t now; // the last tick processed
+    size_t count; // the pending timers
+    wheel_node_t *nodes;
+    uint32_t capacity;
+    uint32_t free; // the first node of the free list
+    uint32_t heads[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS][WHEEL_SLOTS / 64];
+} wheel_t;
+
+typedef void (*wheel_expire_t)(void *ctx, int64_t id);
+
+void wheelL_init(wheel_t *w, uint64_t now);
+void wheelL_free(wheel_t *w);
+// Adds a timer expiring at the tick `expires`, or at the next tick if it is not in the future.
+// Returns the positive identifier of the timer, or -1 if the memory is exhausted.
+int64_t wheelL_add(wheel_t *w, uint64_t expires);
+// Removes a pending timer. Returns false if it has already expired or been cancelled.
+bool wheelL_cancel(wheel_t *w, int64_t id);
+// Sets `tick` to the tick by which the wheel must be advanced next: the first timer may expire then,
+// or must be moved down the levels. Returns false if there are no pending timers.
+bool wheelL_next(const wheel_t *w, uint64_t *tick);
+// Processes the ticks up to `now`, calling `expire` for each timer expiring in the meantime, in the
+// order of their expiration. `expire` may add and cancel timers.
+void wheelL_advance(wheel_t *w, uint64_t now, wheel_expire_t expire, void *ctx);
@@ -0,0 +1,587 @@
+/***
+ * Asynchronous file operations.
+ *
+ * A @{Ring} runs file operations in the background: they are submitted with @{Ring:submit}, which
+ * returns at once, and their results are collected later as completion records with
+ * @{Ring:wait} or @{Ring:poll}. On Linux 5.11 and later the operations are run by the kernel
+ * through io_uring; elsewhere they are run by a pool of threads.
+ *
+ * The module is not tied to a particular event loop: the identifiers of the operations let a
+ * loop resume the coroutine waiting for each of them.
+ *
+ * @usage
+ * local ring = aio.new()
+ * local waiting = {}
+ *
+ * local function await(op)
+ *   local id = assert(ring:submit(op))
+ *   waiting[id] = coroutine.running()
+ *   local record = coroutine.yield()
+ *   return record.result, record.err
+ * end
+ *
+ * for _, path in ipairs(paths) do
+ *   coroutine.wrap(function()
+ *     local fd = assert(await({op = 'open', path = path}))
+ *     local head = await({op = 'read', fd = fd, length = 512, offset = 0})
+ *     await({op = 'close', fd = fd})
+ *     print(path, #head)
+ *   end)()
+ * end
+ *
+ * while ring:pending() > 0 do
+ *   for _, record in ipairs(ring:wait(1)) do
+ *     local co = waiting[record.id]
+ *     waiting[record.id] = nil
+ *     coroutine.resume(co, record)
+ *   end
+ * end
+ *
+ * @module std.aio
+ */
+#include "std.h"
+#include "fs.h"
+#include "libaio.h"
+#include "libsyserror.h"
+#include "libtime.h"
+#include "libutil.h"
+
+#include <lauxlib.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RingMetatableName "std.aio.ring"
+
+#define DEFAULT_ENTRIES 256
+#define MAX_ENTRIES 32768
+#define DEFAULT_THREADS 4
+// the most completion records returned by a call
+#define MAX_REAPED 256
+
+#if defined(_STD_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+
+// the uservalues of a ring, keyed by the identifiers of the requests in flight
+enum
+{
+    UV_TAGS = 1,    // the tags of the requests
+    UV_ANCHORS = 2, // the strings used by the requests
+    UV_ANCHORS2 = 3,
+    UV_COUNT = 3
+};
+
+typedef struct
+{
+    aio_engine_t *engine;
+    lua_Integer next_id;
+    // the requests reaped whose records are not pushed yet, linked by `next`
+    aio_request_t *pending;
+    aio_request_t *pending_tail;
+} ring_t;
+
+static const char *const op_names[] = {"open", "close", "read", "write", "fsync", "stat", "rename", NULL};
+
+static ring_t *check_ring(lua_State *L, int arg)
+{
+    ring_t *ring = (ring_t *)luaL_checkudata(L, arg, RingMetatableName);
+    if (ring->engine == NULL) luaL_error(L, "attempt to use a closed ring");
+    return ring;
+}
+
+static void free_request(aio_request_t *req)
+{
+    free(req->buf);
+    free(req->metadata);
+    free(req);
+}
+
+// Frees a request whose completion was never handed to Lua, closing the file it opened.
+static void discard_request(aio_request_t *req)
+{
+    if (req->op == AIO_OP_OPEN && req->err == 0 && req->result >= 0) close((int)req->result);
+    free_request(req);
+}
+
+static int aio_ring_close(lua_State *L)
+{
+    ring_t *ring = (ring_t *)luaL_checkudata(L, 1, RingMetatableName);
+    if (ring->engine != NULL)
+    {
+        while (ring->pending != NULL)
+        {
+            aio_request_t *req = ring->pending;
+            ring->pending = req->next;
+            discard_request(req);
+        }
+        ring->pending_tail = NULL;
+        aioL_close(ring->engine, discard_request);
+        ring->engine = NULL;
+    }
+    return 0;
+}
+
+// Returns the string field `name` of the table at `arg`, anchored in the uservalue `uv` of the
+// ring at 1 under the identifier `id`.
+static const char *anchor_string(lua_State *L, int arg, const char *name, int uv, lua_Integer id, size_t *len)
+{
+    lua_getfield(L, arg, name);
+    if (!lua_isstring(L, -1))
+    {
+        luaL_error(L, "bad field '%s' (string expected, got %s)", name, luaL_typename(L, -1));
+    }
+    const char *s = lua_tolstring(L, -1, len);
+    lua_getiuservalue(L, 1, uv);
+    lua_pushvalue(L, -2);
+    lua_rawseti(L, -2, id);
+    lua_pop(L, 2);
+    return s;
+}
+
+static lua_Integer opt_integer_field(lua_State *L, int arg, const char *name, lua_Integer def)
+{
+    lua_getfield(L, arg, name);
+    lua_Integer value = lua_isnil(L, -1) ? def : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+    return value;
+}
+
+static int check_fd_field(lua_State *L, int arg)
+{
+    lua_Integer fd = opt_integer_field(L, arg, "fd", -1);
+    luaL_argcheck(L, fd >= 0 && fd <= INT_MAX, arg, "fd must be a file descriptor");
+    return (int)fd;
+}
+
+// Translates a mode of io.open into the flags of open.
+static int check_open_mode(lua_State *L, int arg)
+{
+    lua_getfield(L, arg, "mode");
+    const char *mode = luaL_optstring(L, -1, "r");
+    lua_pop(L, 1);
+    int flags;
+    switch (mode[0])
+    {
+        case 'r':
+            flags = 0;
+            break;
+        case 'w':
+            flags = O_CREAT | O_TRUNC;
+            break;
+        case 'a':
+            flags = O_CREAT | O_APPEND;
+            break;
+        default:
+            return luaL_argerror(L, arg, "invalid mode");
+    }
+    const char *rest = mode + 1;
+    bool plus = *rest == '+';
+    if (plus) rest++;
+    if (*rest == 'b') rest++;
+    luaL_argcheck(L, *rest == '\0', arg, "invalid mode");
+    if (plus) return flags | O_RDWR;
+    return flags | (mode[0] == 'r' ? O_RDONLY : O_WRONLY);
+}
+
+static void check_request(lua_State *L, int arg, lua_Integer id, aio_request_t *req)
+{
+    lua_getfield(L, arg, "op");
+    req->op = luaL_checkoption(L, -1, NULL, op_names);
+    lua_pop(L, 1);
+    req->id = id;
+    req->fd = -1;
+    req->path = req->path2 = req->data = NULL;
+    req->len = 0;
+    req->offset = -1;
+    switch (req->op)
+    {
+        case AIO_OP_OPEN:
+            req->path = anchor_string(L, arg, "path", UV_ANCHORS, id, NULL);
+            req->flags = check_open_mode(L, arg);
+            req->mode = (mode_t)opt_integer_field(L, arg, "permissions", 0666);
+            break;
+        case AIO_OP_CLOSE:
+        case AIO_OP_FSYNC:
+            req->fd = check_fd_field(L, arg);
+            break;
+        case AIO_OP_READ:
+        {
+            req->fd = check_fd_field(L, arg);
+            lua_Integer len = opt_integer_field(L, arg, "length", -1);
+            luaL_argcheck(L, len >= 0 && len <= INT_MAX, arg, "length out of range");
+            req->len = (size_t)len;
+            req->offset = opt_integer_field(L, arg, "offset", -1);
+            break;
+        }
+        case AIO_OP_WRITE:
+            req->fd = check_fd_field(L, arg);
+            req->data = anchor_string(L, arg, "data", UV_ANCHORS, id, &req->len);
+            luaL_argcheck(L, req->len <= INT_MAX, arg, "data too long");
+            req->offset = opt_integer_field(L, arg, "offset", -1);
+            break;
+        case AIO_OP_STAT:
+            req->path = anchor_string(L, arg, "path", UV_ANCHORS, id, NULL);
+            req->stat_opts.fields = FS_FIELD_ALL;
+            lua_getfield(L, arg, "follow_symlinks");
+            req->stat_opts.follow_symlinks = lua_toboolean(L, -1);
+            lua_pop(L, 1);
+            break;
+        case AIO_OP_RENAME:
+            req->path = anchor_string(L, arg, "path", UV_ANCHORS, id, NULL);
+            req->path2 = anchor_string(L, arg, "to", UV_ANCHORS2, id, NULL);
+            break;
+    }
+}
+
+// Removes the values of the request `id` from the uservalues of the ring at 1.
+static void release_request(lua_State *L, lua_Integer id)
+{
+    for (int uv = 1; uv <= UV_COUNT; uv++)
+    {
+        lua_getiuservalue(L, 1, uv);
+        lua_pushnil(L);
+        lua_rawseti(L, -2, id);
+        lua_pop(L, 1);
+    }
+}
+
+static void push_result(lua_State *L, aio_request_t *req)
+{
+    switch (req->op)
+    {
+        case AIO_OP_OPEN:
+        case AIO_OP_WRITE:
+            lua_pushinteger(L, (lua_Integer)req->result);
+            break;
+        case AIO_OP_READ:
+            lua_pushlstring(L, req->buf, (size_t)req->result);
+            break;
+        case AIO_OP_STAT:
+        {
+            size_t size = fsL_metadata_size();
+            void *ud = lua_newuserdatauv(L, size, 0);
+            memcpy(ud, req->metadata, size);
+            luaL_setmetatable(L, AttributesMetatableName);
+            break;
+        }
+        default:
+            lua_pushboolean(L, 1);
+            break;
+    }
+}
+
+// Pushes the completion record of `req`.
+static void push_record(lua_State *L, aio_request_t *req)
+{
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, req->id);
+    lua_setfield(L, -2, "id");
+    lua_pushstring(L, op_names[req->op]);
+    lua_setfield(L, -2, "op");
+    lua_getiuservalue(L, 1, UV_TAGS);
+    lua_rawgeti(L, -1, req->id);
+    lua_setfield(L, -3, "tag");
+    lua_pop(L, 1);
+    if (req->err == 0)
+    {
+        push_result(L, req);
+        lua_setfield(L, -2, "result");
+    }
+    else
+    {
+        syserrL_push_error(L, NULL, req->err);
+        lua_setfield(L, -2, "err");
+    }
+    release_request(L, req->id);
+}
+
+static int reap(lua_State *L, size_t min, int64_t timeout)
+{
+    ring_t *ring = check_ring(L, 1);
+    aio_request_t *reaped[MAX_REAPED];
+    size_t n = aioL_reap(ring->engine, reaped, MAX_REAPED, min, timeout);
+    // the requests stay on the ring until their records are pushed, so that none is lost, and no
+    // file opened is leaked, if pushing a record raises an error
+    for (size_t i = 0; i < n; i++)
+    {
+        reaped[i]->next = NULL;
+        if (ring->pending_tail != NULL)
+        {
+            ring->pending_tail->next = reaped[i];
+        }
+        else
+        {
+            ring->pending = reaped[i];
+        }
+        ring->pending_tail = reaped[i];
+    }
+    lua_createtable(L, (int)n, 0);
+    lua_Integer i = 0;
+    while (ring->pending != NULL)
+    {
+        aio_request_t *req = ring->pending;
+        push_record(L, req);
+        lua_rawseti(L, -2, ++i);
+        ring->pending = req->next;
+        if (ring->pending == NULL) ring->pending_tail = NULL;
+        free_request(req);
+    }
+    return 1;
+}
+
+/***
+ * @type Ring
+ * A queue of asynchronous file operations; see @{new}.
+ */
+
+/***
+ * Submits a file operation.
+ *
+ * The operation is described by a table with the field `op`, naming the operation, the fields
+ * of its arguments, and an optional field `tag`, a value returned with its completion record:
+ *
+ * - `"open"`: opens the file `path` with the `mode` of `io.open`, `"r"` by default; creating a
+ *   file, it gets the `permissions`, `0666` by default, less the umask. The result is the file
+ *   descriptor.
+ * - `"close"`: closes the file descriptor `fd`.
+ * - `"read"`: reads up to `length` bytes from the file descriptor `fd`, at `offset` or at the
+ *   current position if `offset` is not given. The result is the string of the bytes read,
+ *   empty at the end of the file.
+ * - `"write"`: writes the string `data` to the file descriptor `fd`, at `offset` or at the current
+ *   position. The result is the number of bytes written.
+ * - `"fsync"`: flushes the file descriptor `fd` to the device.
+ * - `"stat"`: reads the metadata of `path`, following symbolic links if `follow_symlinks` is set.
+ *   The result is a @{std.fs.Metadata} object.
+ * - `"rename"`: renames `path` to `to`, replacing `to` if it exists.
+ *
+ * With io_uring the operations are handed over to the kernel in batches, at the latest by the next
+ * call to @{wait} or @{poll}.
+ *
+ * @function submit
+ * @tparam table op the operation.
+ * @treturn integer the identifier of the operation if the function succeeded; otherwise `nil`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed, for example because `entries` operations are already in flight.
+ * @raise If the operation is not valid.
+ */
+static int aio_ring_submit(lua_State *L)
+{
+    ring_t *ring = check_ring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+    lua_Integer id = ring->next_id;
+    // checked on the stack first, so that nothing leaks if the operation is not valid
+    aio_request_t request;
+    check_request(L, 2, id, &request);
+    aio_request_t *req = (aio_request_t *)malloc(sizeof(aio_request_t));
+    if (req == NULL) return luaL_error(L, "not enough memory");
+    *req = request;
+    if (!aioL_submit(ring->engine, req))
+    {
+        int err = syserrL_errno();
+        release_request(L, id);
+        free_request(req);
+        lua_pushnil(L);
+        syserrL_push_error(L, NULL, err);
+        return 2;
+    }
+    ring->next_id++;
+
+    lua_getiuservalue(L, 1, UV_TAGS);
+    lua_getfield(L, 2, "tag");
+    lua_rawseti(L, -2, id);
+    lua_pop(L, 1);
+    lua_pushinteger(L, id);
+    return 1;
+}
+
+/***
+ * Waits for operations to complete.
+ *
+ * @function wait
+ * @tparam[opt=1] integer n the number of operations to wait for; it is capped to the number of
+ * operations in flight.
+ * @tparam[opt] integer timeout the longest time to wait in milliseconds. Defaults to no limit.
+ * @treturn table an array of at least `n` completion records, unless the timeout expired. A record
+ * has the fields `id`, `op` and `tag` of the operation, and either `result` or `err`, an error message.
+ */
+static int aio_ring_wait(lua_State *L)
+{
+    lua_Integer n = luaL_optinteger(L, 2, 1);
+    luaL_argcheck(L, n >= 0 && n <= MAX_REAPED, 2, "count out of range");
+    lua_Integer timeout = -1;
+    if (!lua_isnoneornil(L, 3))
+    {
+        timeout = luaL_checkinteger(L, 3);
+        luaL_argcheck(L, timeout >= 0 && timeout <= LUA_MAXINTEGER / NANOS_PER_MILLI, 3, "timeout out of range");
+        timeout *= NANOS_PER_MILLI;
+    }
+    lua_settop(L, 1);
+    return reap(L, (size_t)n, (int64_t)timeout);
+}
+
+/***
+ * Returns the operations completed, without waiting.
+ *
+ * @function poll
+ * @treturn table an array of completion records, as @{wait}.
+ */
+static int aio_ring_poll(lua_State *L)
+{
+    lua_settop(L, 1);
+    return reap(L, 0, 0);
+}
+
+/***
+ * Returns the number of operations in flight: submitted, and not returned by @{wait} or @{poll}.
+ *
+ * @function pending
+ * @treturn integer the number of operations in flight.
+ */
+static int aio_ring_pending(lua_State *L)
+{
+    ring_t *ring = check_ring(L, 1);
+    lua_pushinteger(L, (lua_Integer)aioL_in_flight(ring->engine));
+    return 1;
+}
+
+/***
+ * Returns how the operations are run.
+ *
+ * @function backend
+ * @treturn string `"io_uring"` or `"threads"`.
+ */
+static int aio_ring_backend(lua_State *L)
+{
+    ring_t *ring = check_ring(L, 1);
+    lua_pushstring(L, aioL_backend(ring->engine));
+    return 1;
+}
+
+/***
+ * Waits for the operations in flight, discarding their results, and releases the ring.
+ *
+ * A ring is also closed when it is garbage collected, or goes out of scope as a to-be-closed variable.
+ *
+ * @function close
+ */
+
+/*** @section end */
+
+static void create_ring_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg ring_funcs[] = {
+#define XX(name) {#name, aio_ring_##name},
+        XX(backend)
+        XX(close)
+        XX(pending)
+        XX(poll)
+        XX(submit)
+        XX(wait)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg ring_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", aio_ring_close},
+        {"__close", aio_ring_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, RingMetatableName); // mt
+    luaL_setfuncs(L, ring_meta_methods, 0);  // mt
+    luaL_newlibtable(L, ring_funcs);         // mt t
+    luaL_setfuncs(L, ring_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");          // mt
+    lua_pop(L, 1);                           //
+}
+
+/***
+ * Creates a ring of asynchronous file operations.
+ *
+ * The following options are supported:
+ *
+ * - `entries` (integer): the most operations in flight. Defaults to 256.
+ * - `backend` (string): `"io_uring"`, `"threads"`, or `"auto"` to use io_uring where the
+ *   kernel supports it and the threads elsewhere. Defaults to `"auto"`.
+ * - `threads` (integer): the number of threads of the `"threads"` backend. Defaults to 4.
+ *
+ * @function new
+ * @tparam[opt] table opts the options of the ring.
+ * @treturn Ring the new ring if the function succeeded; otherwise `nil`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @raise If an option is not valid.
+ */
+static int aio_new(lua_State *L)
+{
+    static const char *const backends[] = {"auto", "io_uring", "threads", NULL};
+    lua_Integer entries = DEFAULT_ENTRIES;
+    lua_Integer threads = DEFAULT_THREADS;
+    int backend = AIO_BACKEND_AUTO;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        entries = opt_integer_field(L, 1, "entries", entries);
+        luaL_argcheck(L, entries > 0 && entries <= MAX_ENTRIES, 1, "entries out of range");
+        threads = opt_integer_field(L, 1, "threads", threads);
+        luaL_argcheck(L, threads > 0 && threads <= 256, 1, "threads out of range");
+        lua_getfield(L, 1, "backend");
+        backend = luaL_checkoption(L, -1, "auto", backends);
+        lua_pop(L, 1);
+    }
+
+    ring_t *ring = (ring_t *)lua_newuserdatauv(L, sizeof(ring_t), UV_COUNT);
+    ring->engine = NULL;
+    ring->next_id = 1;
+    ring->pending = ring->pending_tail = NULL;
+    luaL_setmetatable(L, RingMetatableName);
+    for (int uv = 1; uv <= UV_COUNT; uv++)
+    {
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, uv);
+    }
+    ring->engine = aioL_open(backend, (unsigned int)entries, (int)threads);
+    if (ring->engine == NULL)
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+    return 1;
+}
+#else
+#include <windows.h>
+
+static int aio_new(lua_State *L)
+{
+    lua_pushnil(L);
+    syserrL_push_error(L, NULL, ERROR_NOT_SUPPORTED);
+    return 2;
+}
+#endif
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "new", aio_new },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_aio(lua_State *L)
+{
+#if defined(_STD_UNIX)
+    // the metatable of the metadata returned by the stat operations
+    lua_getglobal(L, "require");
+    lua_pushliteral(L, "std.fs.native");
+    lua_call(L, 1, 0);
+    create_ring_metatable(L);
+#endif
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
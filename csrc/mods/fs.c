@@ -9,6 +9,7 @@
 #include <lauxlib.h>
 #include <string.h>
 
+#include "fs_cache.c"
 #if defined(_STD_UNIX)
 #include "fs_unix.c"
 #else
@@ -19,6 +20,10 @@
 #include "fs_dir.c"
 #include "fs_meta.c"
 #include "fs_entries.c"
+#include "fs_mmap.c"
+#if defined(_STD_UNIX)
+#include "fs_walk.c"
+#endif
 
 
 /***
@@ -39,20 +44,23 @@ static int fs_rename(lua_State *L)
     const char *from = luaL_checkstring(L, 1);
     const char *to = luaL_checkstring(L, 2);
     int overwrite = lua_toboolean(L, 3);
+    stat_caches_invalidate(L, from, true);
+    stat_caches_invalidate(L, to, true);
     _STD_RETURN_OK_ERROR(fsL_rename(L, from, to, overwrite))
 }
 
-#define XX(name)                                   \
-    static int fs_##name(lua_State *L)             \
-    {                                              \
-        const char *path = luaL_checkstring(L, 1); \
-        bool result;                               \
-        if (fsL_##name(L, path, &result))          \
-        {                                          \
-            lua_pushboolean(L, result);            \
-            return 1;                              \
-        }                                          \
-        _STD_RETURN_NIL_ERROR                      \
+#define XX(name)                                                                              \
+    static int fs_##name(lua_State *L)                                                        \
+    {                                                                                         \
+        const char *path = luaL_checkstring(L, 1);                                            \
+        bool result;                                                                          \
+        if (lua_isnoneornil(L, 2) ? fsL_##name(L, path, &result)                              \
+                                  : stat_cache_##name(L, 2, path, &result))                   \
+        {                                                                                     \
+            lua_pushboolean(L, result);                                                       \
+            return 1;                                                                         \
+        }                                                                                     \
+        _STD_RETURN_NIL_ERROR                                                                 \
     }
 
 /***
@@ -61,6 +69,7 @@ static int fs_rename(lua_State *L)
  * @function exists
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path exists, otherwise `false`.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -74,6 +83,7 @@ XX(exists)
  * @function directory_exists
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path exists and is a directory, otherwise `false`.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -87,6 +97,7 @@ XX(directory_exists)
  * @function file_exists
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path exists and is a file, otherwise `false`.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -100,6 +111,7 @@ XX(file_exists)
  * @function is_symlink
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path is a symbolic link, otherwise `false`.
  * @treturn string `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -113,6 +125,7 @@ XX(is_symlink)
  * @function is_directory
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path is a directory, otherwise `false`.
  * @treturn string `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -126,6 +139,7 @@ XX(is_directory)
  * @function is_file
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path is a regular file, otherwise `false`.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
@@ -164,12 +178,19 @@ extern int luaopen_std_fs_native(lua_State *L)
 {
     create_entries_metatable(L);
     create_metadata_metatable(L);
+    create_stat_cache_metatable(L);
+    create_mapping_metatable(L);
+#if defined(_STD_UNIX)
+    create_dir_reader_metatable(L);
+    create_walker_metatable(L);
+#endif
 
     // clang-format off
     const struct luaL_Reg funcs[] = {
     #define XX(name) { #name, fs_##name },
         XX(rename)
         XX(copy_file)
+        XX(mmap)
 
         XX(exists)
         XX(file_exists)
@@ -193,7 +214,13 @@ extern int luaopen_std_fs_native(lua_State *L)
         XX(remove_file)
 
         XX(metadata)
+        XX(metadata_many)
+        XX(stat_cache)
         XX(entries)
+#if defined(_STD_UNIX)
+        XX(read_dir)
+        XX(walk)
+#endif
 
         {NULL,NULL},
     #undef XX
@@ -3,5 +3,9 @@
 #include "libfs.h"
 
 #define AttributesMetatableName "std.fs.metadata"
+#define DirReaderMetatableName "std.fs.dir_reader"
 #define EntriesMetatableName "std.fs.entries"
 #define FileMetatableName "std.fs.file"
+#define MappingMetatableName "std.fs.mapping"
+#define StatCacheMetatableName "std.fs.stat_cache"
+#define WalkerMetatableName "std.fs.walker"
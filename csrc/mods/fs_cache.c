@@ -0,0 +1,354 @@
+/***
+ * @module std.fs
+ */
+
+#include "fs.h"
+#include "libpath.h"
+#include "libsyserror.h"
+#include "libtime.h"
+#include "libutil.h"
+
+#include <lauxlib.h>
+#include <string.h>
+
+// the registry key of the weak table of the live caches
+#define StatCachesKey "std.fs.stat_caches"
+
+typedef struct
+{
+    lua_Integer ttl; // nanoseconds, 0 for no expiration
+    lua_Integer generation;
+    lua_Integer hits;
+    lua_Integer misses;
+} stat_cache_t;
+
+static stat_cache_t *check_stat_cache(lua_State *L, int arg)
+{
+    return (stat_cache_t *)luaL_checkudata(L, arg, StatCacheMetatableName);
+}
+
+static bool is_not_found(int err)
+{
+#if defined(_STD_WINDOWS)
+    return err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND;
+#else
+    return err == ENOENT;
+#endif
+}
+
+static void set_last_error(int err)
+{
+#if defined(_STD_WINDOWS)
+    SetLastError((DWORD)err);
+#else
+    errno = err;
+#endif
+}
+
+// Returns the metadata of `path` from the cache at `arg`, reading and caching them on a miss; returns
+// `NULL`, with the error of the read as the last error, if the metadata cannot be read.
+// The metadata are kept alive by the cache, so nothing is left on the stack.
+static void *stat_cache_get(lua_State *L, int arg, const char *path)
+{
+    stat_cache_t *cache = check_stat_cache(L, arg);
+    lua_Integer now = 0;
+    if (cache->ttl > 0) timeL_monotonic_time(&now);
+
+    lua_getiuservalue(L, arg, 1); // entries
+    int type = lua_getfield(L, -1, path);
+    if (type != LUA_TNIL)
+    {
+        bool valid = true;
+        if (cache->ttl > 0)
+        {
+            lua_getiuservalue(L, arg, 2); // entries entry stamps
+            lua_getfield(L, -1, path);    // entries entry stamps stamp
+            valid = now - lua_tointeger(L, -1) < cache->ttl;
+            lua_pop(L, 2); // entries entry
+        }
+        if (valid)
+        {
+            cache->hits++;
+            void *ud = lua_touserdata(L, -1);
+            int err = (int)lua_tointeger(L, -1);
+            lua_pop(L, 2);
+            if (ud == NULL) set_last_error(err);
+            return ud;
+        }
+    }
+    lua_pop(L, 1); // entries
+
+    cache->misses++;
+    const metadata_opts_t opts = {.fields = FS_FIELD_ALL, .follow_symlinks = false};
+    void *ud = NULL;
+    int err = 0;
+    if (fsL_metadata(L, path, &opts))
+    {
+        luaL_setmetatable(L, AttributesMetatableName);
+        ud = lua_touserdata(L, -1);
+    }
+    else
+    {
+        err = syserrL_errno();
+        lua_pushinteger(L, err);
+    }
+    lua_setfield(L, -2, path); // entries
+    lua_pop(L, 1);
+    if (cache->ttl > 0)
+    {
+        lua_getiuservalue(L, arg, 2);
+        lua_pushinteger(L, now);
+        lua_setfield(L, -2, path);
+        lua_pop(L, 1);
+    }
+    if (ud == NULL) set_last_error(err);
+    return ud;
+}
+
+static void stat_cache_reset(lua_State *L, int arg)
+{
+    lua_newtable(L);
+    lua_setiuservalue(L, arg, 1);
+    lua_newtable(L);
+    lua_setiuservalue(L, arg, 2);
+}
+
+// Removes `path` from the table at the top of the stack; with `prefix`, removes also the paths
+// under it.
+static void remove_path(lua_State *L, const char *path, size_t len, bool prefix)
+{
+    lua_pushnil(L);
+    lua_setfield(L, -2, path);
+    if (!prefix) return;
+
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        size_t key_len;
+        const char *key = lua_tolstring(L, -1, &key_len);
+        if (key_len > len && memcmp(key, path, len) == 0 && pathL_is_dirsep(key[len], false))
+        {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, -4);
+        }
+    }
+}
+
+static void stat_cache_remove(lua_State *L, int arg, const char *path, bool prefix)
+{
+    size_t len = strlen(path);
+    for (int i = 1; i <= 2; i++)
+    {
+        lua_getiuservalue(L, arg, i);
+        remove_path(L, path, len, prefix);
+        lua_pop(L, 1);
+    }
+}
+
+// Removes `path`, and the paths under it if `prefix` is set, from all the live caches; called by the
+// functions of std.fs changing the file system.
+static void stat_caches_invalidate(lua_State *L, const char *path, bool prefix)
+{
+    if (lua_getfield(L, LUA_REGISTRYINDEX, StatCachesKey) != LUA_TTABLE)
+    {
+        lua_pop(L, 1);
+        return;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        stat_cache_remove(L, lua_gettop(L), path, prefix);
+    }
+    lua_pop(L, 1);
+}
+
+#define XX(name, expr)                                                                 \
+    static bool stat_cache_##name(lua_State *L, int arg, const char *path, bool *result) \
+    {                                                                                  \
+        void *ud = stat_cache_get(L, arg, path);                                       \
+        if (ud == NULL) return false;                                                  \
+        *result = (expr);                                                              \
+        return true;                                                                   \
+    }
+
+XX(is_directory, fsL_metadata_is_directory(ud))
+XX(is_file, fsL_metadata_is_file(ud))
+XX(is_symlink, fsL_metadata_is_symlink(ud))
+#if defined(_STD_WINDOWS)
+XX(is_hidden, fsL_metadata_is_hidden(ud))
+#else
+XX(is_block_device, fsL_metadata_is_block_device(ud))
+XX(is_char_device, fsL_metadata_is_char_device(ud))
+XX(is_socket, fsL_metadata_is_socket(ud))
+XX(is_fifo, fsL_metadata_is_fifo(ud))
+#endif
+
+#undef XX
+
+#define XX(name, expr)                                                                 \
+    static bool stat_cache_##name(lua_State *L, int arg, const char *path, bool *result) \
+    {                                                                                  \
+        void *ud = stat_cache_get(L, arg, path);                                       \
+        *result = ud != NULL && (expr);                                                \
+        return ud != NULL || is_not_found(syserrL_errno());                            \
+    }
+
+XX(exists, true)
+XX(directory_exists, fsL_metadata_is_directory(ud))
+XX(file_exists, fsL_metadata_is_file(ud))
+
+#undef XX
+
+/***
+ * @type StatCache
+ * A cache of the metadata of paths; see @{stat_cache}.
+ */
+
+/***
+ * Removes the metadata of a path, and of the paths under it, from the cache; without a path
+ * empties the cache and starts a new generation.
+ *
+ * @function invalidate
+ * @tparam[opt] string path the path to remove.
+ */
+static int fs_stat_cache_invalidate(lua_State *L)
+{
+    stat_cache_t *cache = check_stat_cache(L, 1);
+    if (lua_isnoneornil(L, 2))
+    {
+        cache->generation++;
+        stat_cache_reset(L, 1);
+        return 0;
+    }
+    const char *path = luaL_checkstring(L, 2);
+    stat_cache_remove(L, 1, path, true);
+    return 0;
+}
+
+/***
+ * Returns the statistics of the cache.
+ *
+ * @function stats
+ * @treturn table a table with the fields `hits`, `misses`, `entries` and `generation`.
+ */
+static int fs_stat_cache_stats(lua_State *L)
+{
+    stat_cache_t *cache = check_stat_cache(L, 1);
+    lua_Integer entries = 0;
+    lua_getiuservalue(L, 1, 1);
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        entries++;
+    }
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, cache->hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, cache->misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, entries);
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, cache->generation);
+    lua_setfield(L, -2, "generation");
+    return 1;
+}
+
+/*** @section end */
+
+static void create_stat_cache_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg stat_cache_funcs[] = {
+#define XX(name) {#name, fs_stat_cache_##name},
+        XX(invalidate)
+        XX(stats)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg stat_cache_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, StatCacheMetatableName); // mt
+    luaL_setfuncs(L, stat_cache_meta_methods, 0);  // mt
+    luaL_newlibtable(L, stat_cache_funcs);         // mt t
+    luaL_setfuncs(L, stat_cache_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");                // mt
+    lua_pop(L, 1);                                 //
+}
+
+/***
+ * Creates a cache of the metadata of paths.
+ *
+ * The cache can be passed to the predicates, like @{is_file} or @{exists}, and to @{metadata}, which
+ * then read the metadata of each path once instead of once per call. Failures are cached too.
+ * The cached metadata are those of the paths themselves, without following symbolic links.
+ *
+ * The functions of this module changing the file system, like @{rename} or @{remove_file},
+ * remove the paths they change from all the caches; other changes are not seen until the entries
+ * expire or the cache is invalidated.
+ *
+ * The following options are supported:
+ *
+ * - `ttl` (integer): the number of milliseconds the entries stay valid. Defaults to no expiration.
+ *
+ * @usage
+ * local cache = fs.stat_cache({ttl = 1000})
+ * if fs.exists(path, cache) and fs.is_file(path, cache) then
+ *   print(fs.metadata(path, {cache = cache}):length())
+ * end
+ * print(cache:stats().hits) -- 2
+ *
+ * @function stat_cache
+ * @within Path functions
+ * @tparam[opt] table opts the options of the cache.
+ * @treturn StatCache the new cache.
+ */
+static int fs_stat_cache(lua_State *L)
+{
+    lua_Integer ttl = 0;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        if (lua_getfield(L, 1, "ttl") != LUA_TNIL)
+        {
+            ttl = luaL_checkinteger(L, -1);
+            luaL_argcheck(L, ttl > 0 && ttl <= LUA_MAXINTEGER / NANOS_PER_MILLI, 1, "ttl out of range");
+        }
+        lua_pop(L, 1);
+    }
+
+    stat_cache_t *cache = (stat_cache_t *)lua_newuserdatauv(L, sizeof(stat_cache_t), 2);
+    cache->ttl = ttl * NANOS_PER_MILLI;
+    cache->generation = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    luaL_setmetatable(L, StatCacheMetatableName);
+    stat_cache_reset(L, lua_gettop(L));
+
+    if (lua_getfield(L, LUA_REGISTRYINDEX, StatCachesKey) != LUA_TTABLE)
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_createtable(L, 0, 1);
+        lua_pushliteral(L, "k");
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, StatCachesKey);
+    }
+    lua_pushvalue(L, -2);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+    return 1;
+}
@@ -25,20 +25,7 @@
 static int fs_remove_directory(lua_State *L)
 {
     _CHECKLSTRING(path, 1)
-
-    bool is_directory;
-    if (!fsL_is_directory(L, path, &is_directory))
-    {
-        _STD_RETURN_NIL_ERROR
-    }
-
-    if (!is_directory)
-    {
-        lua_pushnil(L);
-        lua_pushstring(L, "not a directory");
-        return 2;
-    }
-
+    stat_caches_invalidate(L, path, true);
     XX(fsL_remove_directory(L, path))
 }
 
@@ -56,6 +43,7 @@ static int fs_remove_directory(lua_State *L)
 static int fs_create_directory(lua_State *L)
 {
     _CHECKLSTRING(path, 1)
+    stat_caches_invalidate(L, path, false);
     XX(fsL_create_directory(L, path))
 }
 
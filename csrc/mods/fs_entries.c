@@ -7,8 +7,12 @@
 #include "libutil.h"
 #include "libsyserror.h"
 
+#include <errno.h>
 #include <lua.h>
 
+// the most slots preallocated for a batch of records, which grows past them as needed
+#define MAX_PREALLOCATED_BATCH 4096
+
 static int fs_entries_close(lua_State *L)
 {
     void *ud = luaL_checkudata(L, 1, EntriesMetatableName);
@@ -66,19 +70,6 @@ static int fs_entries(lua_State *L)
 {
     _CHECKLSTRING(path, 1)
 
-    bool is_directory;
-    if (!fsL_is_directory(L, path, &is_directory))
-    {
-        _STD_RETURN_NIL_ERROR
-    }
-
-    if (!is_directory)
-    {
-        lua_pushnil(L);
-        lua_pushstring(L, "not a directory");
-        return 2;
-    }
-
     lua_pushcfunction(L, fs_entries_next);
     if (fsL_read_dir(L, path))
     {
@@ -88,5 +79,226 @@ static int fs_entries(lua_State *L)
         return 4;
     }
     lua_pop(L, 1);
+    _STD_RETURN_NIL_ERROR
+}
+
+#if defined(_STD_UNIX)
+typedef struct
+{
+    fs_dir_t *dir;
+    int batch;
+    int count; // the number of records filled by the previous call
+    bool with_type;
+    bool with_stat;
+} dir_reader_t;
+
+static dir_reader_t *check_dir_reader(lua_State *L)
+{
+    return (dir_reader_t *)luaL_checkudata(L, 1, DirReaderMetatableName);
+}
+
+static int fs_dir_reader_close(lua_State *L)
+{
+    dir_reader_t *r = check_dir_reader(L);
+    bool ok = fsL_dir_close(r->dir);
+    r->dir = NULL;
+    if (ok) return 0;
     return syserrL_last_error(L);
 }
+
+// Fills the record at the top of the stack with the entry.
+static bool fill_record(lua_State *L, dir_reader_t *r, const dir_entry_t *entry)
+{
+    lua_pushlstring(L, entry->name, entry->name_len);
+    lua_setfield(L, -2, "name");
+    lua_pushinteger(L, (lua_Integer)entry->ino);
+    lua_setfield(L, -2, "ino");
+
+    int type = entry->type;
+    if (r->with_stat)
+    {
+        lua_getfield(L, -1, "stat");
+        if (!fsL_dir_metadata(L, r->dir, entry->name, lua_gettop(L)))
+        {
+            // the entry was removed after being listed
+            if (errno != ENOENT) return false;
+            lua_pop(L, 1);
+            lua_pushnil(L);
+            lua_setfield(L, -2, "stat");
+            goto type;
+        }
+        if (lua_getmetatable(L, -1) == 0)
+        {
+            luaL_setmetatable(L, AttributesMetatableName);
+        }
+        else
+        {
+            lua_pop(L, 1);
+        }
+        type = fsL_metadata_type(lua_touserdata(L, -1));
+        lua_setfield(L, -3, "stat");
+        lua_pop(L, 1);
+    }
+type:
+    if (r->with_type)
+    {
+        lua_pushstring(L, fsL_type_name(type));
+        lua_setfield(L, -2, "type");
+    }
+    return true;
+}
+
+static int fs_dir_reader_next(lua_State *L)
+{
+    dir_reader_t *r = check_dir_reader(L);
+    if (r->dir == NULL) return 0;
+
+    lua_settop(L, 1);
+    lua_getiuservalue(L, 1, 1); // records
+    int n = 0;
+    dir_entry_t entry;
+    while (n < r->batch)
+    {
+        int res = fsL_dir_next(r->dir, &entry, r->with_type && !r->with_stat);
+        if (res < 0) return syserrL_last_error(L);
+        if (res == 0) break;
+
+        n++;
+        if (lua_rawgeti(L, 2, n) != LUA_TTABLE)
+        {
+            lua_pop(L, 1);
+            lua_createtable(L, 0, 4);
+            lua_pushvalue(L, -1);
+            lua_rawseti(L, 2, n);
+        }
+        if (!fill_record(L, r, &entry)) return syserrL_last_error(L);
+        lua_pop(L, 1);
+    }
+
+    for (int i = n + 1; i <= r->count; i++)
+    {
+        lua_pushnil(L);
+        lua_rawseti(L, 2, i);
+    }
+    r->count = n;
+
+    if (n == 0)
+    {
+        fs_dir_reader_close(L);
+        return 0;
+    }
+    lua_pushinteger(L, n);
+    return 2;
+}
+
+static void create_dir_reader_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg dir_reader_funcs[] = {
+#define XX(name) {#name, fs_dir_reader_##name},
+        XX(close)
+        XX(next)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg dir_reader_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", fs_dir_reader_close},
+        {"__close", fs_dir_reader_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, DirReaderMetatableName); // mt
+    luaL_setfuncs(L, dir_reader_meta_methods, 0);  // mt
+    luaL_newlibtable(L, dir_reader_funcs);         // mt t
+    luaL_setfuncs(L, dir_reader_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");                // mt
+    lua_pop(L, 1);                                 //
+}
+
+/***
+ * Returns an iterator over the entries of a directory, read in batches.
+ *
+ * Each step of the iteration returns an array of up to `batch` records and the number of records
+ * in it; `.` and `..` are skipped. Each record has the fields:
+ *
+ * - `name` (string): the name of the entry.
+ * - `ino` (integer): the inode number of the entry.
+ * - `type` (string): the type of the entry, as returned by @{walk}; only when `with_type` is `true`.
+ * - `stat` (Metadata): the metadata of the entry, without following symbolic links; only when
+ *   `with_stat` is `true`.
+ *
+ * The types come from the directory listing itself; entries are stat-ed only when the file system
+ * does not report their type, or when `with_stat` is `true`.
+ *
+ * The array, the records and the metadata are reused by the next step of the iteration: copy
+ * what must outlive it.
+ *
+ * The following options are supported:
+ *
+ * - `batch` (integer): the maximum number of entries returned by each step. Defaults to 256.
+ * - `with_type` (boolean): `false` to leave out the type of the entries. Defaults to `true`.
+ * - `with_stat` (boolean): `true` to include the metadata of the entries. Defaults to `false`.
+ *
+ * @usage
+ * for records, n in fs.read_dir('.', {batch = 1024}) do
+ *   for i = 1, n do
+ *     print(records[i].type, records[i].name)
+ *   end
+ * end
+ *
+ * @function read_dir
+ * @within Directory functions
+ * @tparam string path the directory to read.
+ * @tparam[opt] table opts the options of the read.
+ * @return an iterator over the entries of the directory if the function succeeded; otherwise `nil`.
+ * @return the state of the iteration if the function succeeded; otherwise an error message describing
+ * why the function failed.
+ * @raise If `path` is `nil`, or if the directory cannot be read while iterating.
+ * @remark this function is not available on Windows.
+ */
+static int fs_read_dir(lua_State *L)
+{
+    _CHECKLSTRING(path, 1)
+    lua_Integer batch = 256;
+    bool with_type = true, with_stat = false;
+
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        if (lua_getfield(L, 2, "batch") != LUA_TNIL)
+        {
+            batch = luaL_checkinteger(L, -1);
+            luaL_argcheck(L, batch >= 1 && batch <= INT_MAX, 2, "batch out of range");
+        }
+        if (lua_getfield(L, 2, "with_type") != LUA_TNIL) with_type = lua_toboolean(L, -1);
+        lua_getfield(L, 2, "with_stat");
+        with_stat = lua_toboolean(L, -1);
+        lua_pop(L, 3);
+    }
+
+    dir_reader_t *r = (dir_reader_t *)lua_newuserdatauv(L, sizeof(dir_reader_t), 1);
+    r->dir = NULL;
+    r->batch = (int)batch;
+    r->count = 0;
+    r->with_type = with_type;
+    r->with_stat = with_stat;
+    luaL_setmetatable(L, DirReaderMetatableName);
+    lua_createtable(L, r->batch < MAX_PREALLOCATED_BATCH ? r->batch : MAX_PREALLOCATED_BATCH, 0);
+    lua_setiuservalue(L, -2, 1);
+
+    r->dir = fsL_dir_open(path);
+    if (r->dir == NULL)
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+
+    lua_pushcfunction(L, fs_dir_reader_next); // r next
+    lua_insert(L, -2);                        // next r
+    lua_pushnil(L);                           // next r nil
+    lua_pushvalue(L, -2);                     // next r nil r
+    return 4;
+}
+#endif
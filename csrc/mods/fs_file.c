@@ -11,25 +11,88 @@
 
 #include <lauxlib.h>
 
+static bool opt_boolean(lua_State *L, int arg, const char *name, bool def)
+{
+    bool result = lua_getfield(L, arg, name) == LUA_TNIL ? def : lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    return result;
+}
+
+// Reads the copy options at `arg`, leaving the progress function, if any, at the top of the stack.
+static void check_copy_opts(lua_State *L, int arg, copy_opts_t *opts)
+{
+    opts->overwrite = false;
+    opts->permissions = true;
+    opts->timestamps = false;
+    opts->sparse = false;
+    opts->progress = 0;
+    opts->progress_interval = 0;
+
+    if (!lua_istable(L, arg))
+    {
+        opts->overwrite = lua_toboolean(L, arg);
+        return;
+    }
+
+    opts->overwrite = opt_boolean(L, arg, "overwrite", false);
+    opts->permissions = opt_boolean(L, arg, "permissions", true);
+    opts->timestamps = opt_boolean(L, arg, "timestamps", false);
+    opts->sparse = opt_boolean(L, arg, "sparse", false);
+    if (lua_getfield(L, arg, "progress_interval") != LUA_TNIL)
+    {
+        lua_Integer interval = luaL_checkinteger(L, -1);
+        luaL_argcheck(L, interval >= 0, arg, "progress_interval must be non-negative");
+        opts->progress_interval = (uint64_t)interval;
+    }
+    lua_pop(L, 1);
+    if (lua_getfield(L, arg, "progress") != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TFUNCTION);
+        opts->progress = lua_gettop(L);
+        return;
+    }
+    lua_pop(L, 1);
+}
+
 /***
  * Copies the content of an existing file to a new file.
  *
- * @function copy
+ * On Linux the data is copied by the kernel when possible: the file is cloned if the file system
+ * supports reflinks, otherwise it is copied with `copy_file_range` or `sendfile`, falling back to a
+ * read/write loop.
+ *
+ * The options can be given as a table with the following fields:
+ *
+ * - `overwrite` (boolean): `true` if the destination file can be overwritten; defaults to `false`.
+ * - `permissions` (boolean): `true` to give the destination the permissions of the source; defaults
+ *   to `true`.
+ * - `timestamps` (boolean): `true` to give the destination the access and modification times of
+ *   the source; defaults to `false`.
+ * - `sparse` (boolean): `true` to preserve the holes of a sparse source; defaults to `false`.
+ * - `progress` (function): a function called with the number of bytes copied and the size of the
+ *   source as the copy proceeds; returning `false` cancels the copy.
+ * - `progress_interval` (integer): the number of bytes to copy between two calls to `progress`;
+ *   defaults to calling it once per chunk.
+ *
+ * @function copy_file
  * @within File functions
  * @tparam string from the path of the file to copy.
  * @tparam string to the path of the destination file.
- * @tparam[boolean] overwrite `true` if the destination file can be overwritten; otherwise `false`.
+ * @tparam[opt] boolean|table opts `true` if the destination file can be overwritten, or the options of the copy.
  * @treturn boolean `true` if the function succeeded; otherwise `false`.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
  * failed.
- * @raise If any of `from` or `to` is `nil` or doesn't exists.
+ * @raise If any of `from` or `to` is `nil`, or if the progress function raises an error.
+ * @remark on Windows and macOS the progress function is called once, when the copy is complete.
  */
 static int fs_copy_file(lua_State *L)
 {
     const char *from = luaL_checkstring(L, 1);
     const char *to = luaL_checkstring(L, 2);
-    int overwrite = lua_toboolean(L, 3);
-    _STD_RETURN_OK_ERROR(fsL_copy_file(L, from, to, overwrite))
+    copy_opts_t opts;
+    check_copy_opts(L, 3, &opts);
+    stat_caches_invalidate(L, to, false);
+    _STD_RETURN_OK_ERROR(fsL_copy_file(L, from, to, &opts))
 }
 
 /***
@@ -46,5 +109,6 @@ static int fs_copy_file(lua_State *L)
 static int fs_remove_file(lua_State *L)
 {
     const char *path = luaL_checkstring(L, 1);
+    stat_caches_invalidate(L, path, false);
     _STD_RETURN_OK_ERROR(fsL_remove_file(L, path))
 }
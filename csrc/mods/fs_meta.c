@@ -7,6 +7,8 @@
 #include "libsyserror.h"
 #include "libutil.h"
 
+#include "libtime.h"
+
 #include <lauxlib.h>
 #include <string.h>
 
@@ -15,53 +17,147 @@
  * A type representing the metadata of a path.
  */
 
-#define XX(name)                                                   \
+// Floors the division, so that times before the Unix Epoch are rounded like after it.
+static lua_Integer floor_div(lua_Integer a, lua_Integer b)
+{
+    lua_Integer q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+#define XX(name, field, unit)                                      \
     static int fs_metadata_##name(lua_State *L)                    \
     {                                                              \
         void *ud = luaL_checkudata(L, 1, AttributesMetatableName); \
-        lua_pushinteger(L, fsL_metadata_##name(ud));               \
+        lua_Integer value;                                         \
+        if (fsL_metadata_field(ud, field, &value))                 \
+        {                                                          \
+            lua_pushinteger(L, floor_div(value, unit));            \
+        }                                                          \
+        else                                                       \
+        {                                                          \
+            lua_pushnil(L);                                        \
+        }                                                          \
         return 1;                                                  \
     }
 
 /***
  * Gets the size of the file the metadata is for.
  *
- * @function accessed
- * @treturn integer the last access time for the file.
- * @remark The returned value corresponds to the number of milliseconds elapsed
- * since the Unix Epoch.
+ * @function length
+ * @treturn integer the size of the file in bytes, or `nil` if the size was not requested.
+ */
+XX(length, FS_FIELD_LENGTH, 1)
+
+/***
+ * Gets the number of 512-byte blocks allocated to the file the metadata is for.
+ *
+ * @function blocks
+ * @treturn integer the number of blocks, or `nil` if the number of blocks was not requested.
+ * @remark Unix-only
+ */
+XX(blocks, FS_FIELD_BLOCKS, 1)
+
+/***
+ * Gets the inode number of the file the metadata is for.
+ *
+ * @function inode
+ * @treturn integer the inode number, or `nil` if the inode number was not requested.
+ * @remark Unix-only
+ */
+XX(inode, FS_FIELD_INODE, 1)
+
+/***
+ * Gets the identifier of the device containing the file the metadata is for.
+ *
+ * @function device
+ * @treturn integer the identifier of the device.
+ * @remark Unix-only
  */
-XX(length)
+XX(device, FS_FIELD_DEVICE, 1)
+
+/***
+ * Gets the number of hard links to the file the metadata is for.
+ *
+ * @function links
+ * @treturn integer the number of hard links, or `nil` if the number of links was not requested.
+ * @remark Unix-only
+ */
+XX(links, FS_FIELD_LINKS, 1)
 
 /***
  * Gets the last access time for the file the metadata is for.
  *
  * @function accessed
- * @treturn integer the last access time for the file.
+ * @treturn integer the last access time for the file, or `nil` if the time was not requested.
  * @remark The returned value corresponds to the number of milliseconds elapsed
  * since the Unix Epoch.
  */
-XX(accessed)
+XX(accessed, FS_FIELD_ACCESSED, NANOS_PER_MILLI)
 
 /***
  * Gets the creation time for the file the metadata is for.
  *
  * @function created
- * @treturn integer the creation time for the file.
+ * @treturn integer the creation time for the file, or `nil` if the time was not requested or
+ * the file system does not record it.
  * @remark The returned value corresponds to the number of milliseconds elapsed
  * since the Unix Epoch.
  */
-XX(created)
+XX(created, FS_FIELD_CREATED, NANOS_PER_MILLI)
 
 /***
  * Gets the last modification time for the file the metadata is for.
  *
  * @function modified
- * @treturn integer the last modification time for the file.
+ * @treturn integer the last modification time for the file, or `nil` if the time was not requested.
+ * @remark The returned value corresponds to the number of milliseconds elapsed
+ * since the Unix Epoch.
+ */
+XX(modified, FS_FIELD_MODIFIED, NANOS_PER_MILLI)
+
+/***
+ * Gets the last status change time for the file the metadata is for.
+ *
+ * @function changed
+ * @treturn integer the last status change time for the file, or `nil` if the time was not requested.
  * @remark The returned value corresponds to the number of milliseconds elapsed
  * since the Unix Epoch.
+ * @remark Unix-only
+ */
+XX(changed, FS_FIELD_CHANGED, NANOS_PER_MILLI)
+
+/***
+ * Gets the last access time for the file the metadata is for, in nanoseconds.
+ *
+ * @function accessed_ns
+ * @treturn integer the number of nanoseconds elapsed since the Unix Epoch, or `nil`.
+ */
+XX(accessed_ns, FS_FIELD_ACCESSED, 1)
+
+/***
+ * Gets the creation time for the file the metadata is for, in nanoseconds.
+ *
+ * @function created_ns
+ * @treturn integer the number of nanoseconds elapsed since the Unix Epoch, or `nil`.
+ */
+XX(created_ns, FS_FIELD_CREATED, 1)
+
+/***
+ * Gets the last modification time for the file the metadata is for, in nanoseconds.
+ *
+ * @function modified_ns
+ * @treturn integer the number of nanoseconds elapsed since the Unix Epoch, or `nil`.
+ */
+XX(modified_ns, FS_FIELD_MODIFIED, 1)
+
+/***
+ * Gets the last status change time for the file the metadata is for, in nanoseconds.
+ *
+ * @function changed_ns
+ * @treturn integer the number of nanoseconds elapsed since the Unix Epoch, or `nil`.
+ * @remark Unix-only
  */
-XX(modified)
+XX(changed_ns, FS_FIELD_CHANGED, 1)
 
 #undef XX
 
@@ -157,26 +253,158 @@ XX(is_char_device)
 
 /*** @section end */
 
+// Returns the FS_FIELD_* value of the field name at the top of the stack.
+static unsigned int check_metadata_field(lua_State *L, int arg)
+{
+    static const char *const names[] = {"type", "mode", "links", "inode", "device", "length",
+                                        "blocks", "accessed", "modified", "changed", "created", NULL};
+    const char *name = lua_tostring(L, -1);
+    for (int i = 0; name != NULL && names[i] != NULL; i++)
+    {
+        if (strcmp(names[i], name) == 0) return 1u << i;
+    }
+    return (unsigned int)luaL_argerror(L, arg, lua_pushfstring(L, "invalid field '%s'", luaL_tolstring(L, -1, NULL)));
+}
+
+static void check_metadata_opts(lua_State *L, int arg, metadata_opts_t *opts)
+{
+    opts->fields = FS_FIELD_ALL;
+    opts->follow_symlinks = false;
+    if (lua_isnoneornil(L, arg)) return;
+
+    luaL_checktype(L, arg, LUA_TTABLE);
+    opts->follow_symlinks = opt_boolean(L, arg, "follow_symlinks", false);
+    int type = lua_getfield(L, arg, "fields");
+    if (type == LUA_TSTRING)
+    {
+        opts->fields = check_metadata_field(L, arg);
+    }
+    else if (type != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        opts->fields = 0;
+        int n = (int)lua_rawlen(L, -1);
+        for (int i = 1; i <= n; i++)
+        {
+            lua_rawgeti(L, -1, i);
+            opts->fields |= check_metadata_field(L, arg);
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+}
+
+// Moves the cache of the options at `arg`, if any and usable with the options, to `arg`; returns
+// `arg` if there is a cache, otherwise 0.
+static int opt_stat_cache(lua_State *L, int arg, const metadata_opts_t *opts)
+{
+    if (opts->follow_symlinks || !lua_istable(L, arg)) return 0;
+    if (lua_getfield(L, arg, "cache") == LUA_TNIL)
+    {
+        lua_pop(L, 1);
+        return 0;
+    }
+    check_stat_cache(L, -1);
+    lua_replace(L, arg);
+    return arg;
+}
+
+// Pushes the metadata of `path`, reading them from the cache at `cache` unless it is 0.
+static bool push_metadata(lua_State *L, const char *path, const metadata_opts_t *opts, int cache)
+{
+    if (cache == 0)
+    {
+        if (!fsL_metadata(L, path, opts)) return false;
+        luaL_setmetatable(L, AttributesMetatableName);
+        return true;
+    }
+    if (stat_cache_get(L, cache, path) == NULL) return false;
+    lua_getiuservalue(L, cache, 1);
+    lua_getfield(L, -1, path);
+    lua_remove(L, -2);
+    return true;
+}
+
 /***
  * Returns a new userdata representing the metadata of a given path.
  *
+ * On Linux the metadata are read with `statx`, asking the file system only for the requested
+ * fields; the methods of the metadata return `nil` for the fields that were not requested.
+ *
+ * The following options are supported:
+ *
+ * - `fields` (string|table): the fields to read, among `"type"`, `"mode"`, `"links"`, `"inode"`,
+ *   `"device"`, `"length"`, `"blocks"`, `"accessed"`, `"modified"`, `"changed"` and `"created"`.
+ *   The type, the mode and the device are always available. Defaults to all the fields.
+ * - `follow_symlinks` (boolean): `true` to return the metadata of the target of a symbolic link
+ *   instead of the metadata of the link. Defaults to `false`.
+ * - `cache` (StatCache): a cache to read the metadata from; the cache holds all the fields and is
+ *   not used when following symbolic links. See @{stat_cache}.
+ *
  * @function metadata
  * @within Path functions
  * @tparam string path the path to get the attribute of,
+ * @tparam[opt] table opts the options.
  * @treturn Metadata the metadata of the given path; or `nil` if the function fails.
  * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
  * failed.
- * @raise If `path` is `nil`.
+ * @raise If `path` is `nil`, or `opts` contains an unknown field.
  */
 static int fs_metadata(lua_State *L)
 {
     _CHECKLSTRING(path, 1)
-    if (fsL_metadata(L, path))
+    metadata_opts_t opts;
+    check_metadata_opts(L, 2, &opts);
+    int cache = opt_stat_cache(L, 2, &opts);
+    if (push_metadata(L, path, &opts, cache)) return 1;
+    _STD_RETURN_NIL_ERROR
+}
+
+/***
+ * Returns the metadata of several paths at once.
+ *
+ * @function metadata_many
+ * @within Path functions
+ * @tparam {string,...} paths the paths to get the metadata of.
+ * @tparam[opt] table opts the options, as for @{metadata}.
+ * @treturn {Metadata|false,...} the metadata of each path, or `false` for the paths whose metadata
+ * could not be read.
+ * @treturn {[integer]=string} the error messages, keyed by the index of the failed paths; or `nil` if
+ * all the metadata were read.
+ * @raise If `paths` is not a table, or `opts` contains an unknown field.
+ */
+static int fs_metadata_many(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    metadata_opts_t opts;
+    check_metadata_opts(L, 2, &opts);
+    int cache = opt_stat_cache(L, 2, &opts);
+    lua_settop(L, 2);
+
+    int n = (int)lua_rawlen(L, 1);
+    lua_createtable(L, n, 0); // paths cache results
+    int has_errors = 0;
+    for (int i = 1; i <= n; i++)
     {
-        luaL_setmetatable(L, AttributesMetatableName);
-        return 1;
+        lua_rawgeti(L, 1, i);
+        const char *path = lua_tostring(L, -1);
+        luaL_argcheck(L, path != NULL, 1, "paths must be strings");
+        if (!push_metadata(L, path, &opts, cache))
+        {
+            if (!has_errors)
+            {
+                lua_newtable(L);
+                lua_insert(L, 4); // paths cache results errors path
+                has_errors = 1;
+            }
+            syserrL_pushlasterror(L);
+            lua_rawseti(L, 4, i);
+            lua_pushboolean(L, 0);
+        }
+        lua_rawseti(L, 3, i);
+        lua_pop(L, 1);
     }
-    _STD_RETURN_NIL_ERROR
+    return has_errors ? 2 : 1;
 }
 
 static void create_metadata_metatable(lua_State *L)
@@ -184,9 +412,13 @@ static void create_metadata_metatable(lua_State *L)
     // clang-format off
     const struct luaL_Reg funcs[] = {
 #define XX(name) {#name, fs_metadata_##name},
+        XX(length)
         XX(accessed)
         XX(created)
         XX(modified)
+        XX(accessed_ns)
+        XX(created_ns)
+        XX(modified_ns)
         XX(is_directory)
         XX(is_file)
         XX(is_readonly)
@@ -194,6 +426,12 @@ static void create_metadata_metatable(lua_State *L)
 #if defined(_STD_WINDOWS)
         XX(is_hidden)
 #else
+        XX(blocks)
+        XX(inode)
+        XX(device)
+        XX(links)
+        XX(changed)
+        XX(changed_ns)
         XX(is_socket)
         XX(is_fifo)
         XX(is_block_device)
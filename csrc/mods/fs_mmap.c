@@ -0,0 +1,318 @@
+/***
+ * @module std.fs
+ */
+
+#include "fs.h"
+#include "libsyserror.h"
+#include "libutil.h"
+
+#include <lauxlib.h>
+#include <string.h>
+
+typedef struct
+{
+    fs_mapping_t mapping;
+    bool closed;
+} mapping_t;
+
+static mapping_t *check_mapping(lua_State *L, int arg)
+{
+    mapping_t *m = (mapping_t *)luaL_checkudata(L, arg, MappingMetatableName);
+    if (m->closed) luaL_error(L, "attempt to use a closed mapping");
+    return m;
+}
+
+// Translates a relative initial position, like string.sub: negative means back from the end.
+static size_t posrelat(lua_Integer pos, size_t len)
+{
+    if (pos > 0) return (size_t)pos;
+    if (pos == 0) return 1;
+    if (pos < -(lua_Integer)len) return 1;
+    return len + (size_t)pos + 1;
+}
+
+// Translates a relative end position, like string.sub.
+static size_t getendpos(lua_Integer pos, size_t len)
+{
+    if (pos > (lua_Integer)len) return len;
+    if (pos >= 0) return (size_t)pos;
+    if (pos < -(lua_Integer)len) return 0;
+    return len + (size_t)pos + 1;
+}
+
+static const char *find_bytes(const char *s, size_t len, const char *p, size_t p_len)
+{
+    if (p_len == 0) return s;
+    if (p_len > len) return NULL;
+    const char *last = s + (len - p_len);
+    while (s <= last)
+    {
+        s = (const char *)memchr(s, p[0], (size_t)(last - s) + 1);
+        if (s == NULL) return NULL;
+        if (memcmp(s + 1, p + 1, p_len - 1) == 0) return s;
+        s++;
+    }
+    return NULL;
+}
+
+static int fs_mapping_close(lua_State *L)
+{
+    mapping_t *m = (mapping_t *)luaL_checkudata(L, 1, MappingMetatableName);
+    if (m->closed) return 0;
+    m->closed = true;
+    if (fsL_munmap(&m->mapping)) return 0;
+    return syserrL_last_error(L);
+}
+
+// Unlike close, never raises: an error from a finalizer would only be a warning.
+static int fs_mapping_gc(lua_State *L)
+{
+    mapping_t *m = (mapping_t *)luaL_checkudata(L, 1, MappingMetatableName);
+    if (!m->closed)
+    {
+        m->closed = true;
+        fsL_munmap(&m->mapping);
+    }
+    return 0;
+}
+
+/***
+ * @type Mapping
+ * A read-only memory mapping of a file; see @{mmap}.
+ *
+ * The methods of a mapping follow the functions of the `string` library, but read the mapped
+ * file in place: only the returned strings are copied.
+ */
+
+/***
+ * Returns the size of the mapped file; a mapping supports also the length operator.
+ *
+ * @function len
+ * @treturn integer the size of the mapped file in bytes.
+ */
+static int fs_mapping_len(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, 1);
+    lua_pushinteger(L, (lua_Integer)m->mapping.size);
+    return 1;
+}
+
+/***
+ * Returns a substring of the mapped file, like `string.sub`.
+ *
+ * @function sub
+ * @tparam integer i the position of the first byte.
+ * @tparam[opt=-1] integer j the position of the last byte.
+ * @treturn string the bytes from `i` to `j`.
+ */
+static int fs_mapping_sub(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, 1);
+    size_t len = m->mapping.size;
+    size_t i = posrelat(luaL_checkinteger(L, 2), len);
+    size_t j = getendpos(luaL_optinteger(L, 3, -1), len);
+    if (i <= j)
+    {
+        lua_pushlstring(L, m->mapping.data + i - 1, j - i + 1);
+    }
+    else
+    {
+        lua_pushliteral(L, "");
+    }
+    return 1;
+}
+
+/***
+ * Returns the values of bytes of the mapped file, like `string.byte`.
+ *
+ * @function byte
+ * @tparam[opt=1] integer i the position of the first byte.
+ * @tparam[opt=i] integer j the position of the last byte.
+ * @return the values of the bytes from `i` to `j`.
+ */
+static int fs_mapping_byte(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, 1);
+    size_t len = m->mapping.size;
+    lua_Integer pi = luaL_optinteger(L, 2, 1);
+    size_t i = posrelat(pi, len);
+    size_t j = getendpos(luaL_optinteger(L, 3, pi), len);
+    if (i > j) return 0;
+    if (j - i >= (size_t)INT_MAX) return luaL_error(L, "range too large");
+
+    int n = (int)(j - i) + 1;
+    luaL_checkstack(L, n, "range too large");
+    const unsigned char *data = (const unsigned char *)m->mapping.data + i - 1;
+    for (int k = 0; k < n; k++)
+    {
+        lua_pushinteger(L, data[k]);
+    }
+    return n;
+}
+
+/***
+ * Finds the first occurrence of a plain string in the mapped file.
+ *
+ * @function find
+ * @tparam string s the string to find; it is not a pattern.
+ * @tparam[opt=1] integer init the position to start the search from.
+ * @treturn integer the position of the first byte of the occurrence, or `nil` if `s` is not found.
+ * @treturn integer the position of the last byte of the occurrence.
+ */
+static int fs_mapping_find(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, 1);
+    size_t p_len;
+    const char *p = luaL_checklstring(L, 2, &p_len);
+    size_t len = m->mapping.size;
+    size_t init = posrelat(luaL_optinteger(L, 3, 1), len);
+    if (init > len + 1)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    const char *data = m->mapping.data;
+    const char *found = data == NULL ? (p_len == 0 ? "" : NULL)
+                                     : find_bytes(data + init - 1, len - init + 1, p, p_len);
+    if (found == NULL)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+    size_t start = data == NULL ? init : (size_t)(found - data) + 1;
+    lua_pushinteger(L, (lua_Integer)start);
+    lua_pushinteger(L, (lua_Integer)(start + p_len - 1));
+    return 2;
+}
+
+static int mapping_lines_next(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, lua_upvalueindex(1));
+    size_t pos = (size_t)lua_tointeger(L, lua_upvalueindex(2));
+    size_t len = m->mapping.size;
+    if (pos > len) return 0;
+
+    const char *start = m->mapping.data + pos - 1;
+    const char *nl = (const char *)memchr(start, '\n', len - pos + 1);
+    size_t line_len = nl != NULL ? (size_t)(nl - start) : len - pos + 1;
+    lua_pushinteger(L, (lua_Integer)(pos + line_len + 1));
+    lua_replace(L, lua_upvalueindex(2));
+    lua_pushlstring(L, start, line_len);
+    return 1;
+}
+
+/***
+ * Returns an iterator over the lines of the mapped file.
+ *
+ * The lines are returned without the end-of-line character, like `io.lines`; each string is
+ * created only when the iterator reaches its line.
+ *
+ * @function lines
+ * @tparam[opt=1] integer init the position to start from.
+ * @treturn function an iterator returning the lines of the mapped file.
+ */
+static int fs_mapping_lines(lua_State *L)
+{
+    mapping_t *m = check_mapping(L, 1);
+    size_t init = posrelat(luaL_optinteger(L, 2, 1), m->mapping.size);
+    lua_settop(L, 1);
+    lua_pushinteger(L, (lua_Integer)init);
+    lua_pushcclosure(L, mapping_lines_next, 2);
+    return 1;
+}
+
+/***
+ * Gives the system a hint on how the mapped file will be accessed.
+ *
+ * @function advise
+ * @tparam string advice one of `"normal"`, `"sequential"`, `"random"`, `"willneed"` and `"dontneed"`.
+ * @treturn boolean `true` if the function succeeded; otherwise `false`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @remark On Windows only `"willneed"` has an effect.
+ */
+static int fs_mapping_advise(lua_State *L)
+{
+    static const char *const advices[] = {"normal", "sequential", "random", "willneed", "dontneed", NULL};
+    mapping_t *m = check_mapping(L, 1);
+    int advice = luaL_checkoption(L, 2, NULL, advices);
+    _STD_RETURN_OK_ERROR(fsL_madvise(&m->mapping, advice))
+}
+
+/*** @section end */
+
+static void create_mapping_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg mapping_funcs[] = {
+#define XX(name) {#name, fs_mapping_##name},
+        XX(advise)
+        XX(byte)
+        XX(close)
+        XX(find)
+        XX(len)
+        XX(lines)
+        XX(sub)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg mapping_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", fs_mapping_gc},
+        {"__close", fs_mapping_close},
+        {"__len", fs_mapping_len},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, MappingMetatableName); // mt
+    luaL_setfuncs(L, mapping_meta_methods, 0);  // mt
+    luaL_newlibtable(L, mapping_funcs);         // mt t
+    luaL_setfuncs(L, mapping_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");             // mt
+    lua_pop(L, 1);                              //
+}
+
+/***
+ * Maps a file in memory, read-only.
+ *
+ * The file is read by the system as its pages are accessed, so large files can be searched and
+ * iterated without reading them whole into a Lua string. The mapping is released when it is
+ * closed, garbage collected, or goes out of scope as a to-be-closed variable.
+ *
+ * @usage
+ * local m <close> = assert(fs.mmap('server.log'))
+ * m:advise('sequential')
+ * for line in m:lines() do
+ *   if line:find('ERROR', 1, true) then print(line) end
+ * end
+ *
+ * @function mmap
+ * @within File functions
+ * @tparam string path the file to map.
+ * @treturn Mapping the mapping if the function succeeded; otherwise `nil`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @raise If `path` is `nil`.
+ * @remark Changes to the file while it is mapped may be visible through the mapping. On POSIX systems,
+ * truncating a mapped file, from this process or another one, makes any access to the pages past its
+ * new end raise `SIGBUS`, which kills the process: a mapping is only safe on files which are not
+ * truncated while it is open. On Windows, a mapped file cannot be truncated.
+ */
+static int fs_mmap(lua_State *L)
+{
+    _CHECKLSTRING(path, 1)
+    mapping_t *m = (mapping_t *)lua_newuserdatauv(L, sizeof(mapping_t), 0);
+    m->closed = true;
+    m->mapping.data = NULL;
+    m->mapping.size = 0;
+    luaL_setmetatable(L, MappingMetatableName);
+    if (!fsL_mmap(L, path, &m->mapping))
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+    m->closed = false;
+    return 1;
+}
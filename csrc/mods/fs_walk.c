@@ -0,0 +1,258 @@
+/***
+ * @module std.fs
+ */
+
+#include "fs.h"
+#include "libsyserror.h"
+#include "libutil.h"
+
+#include <lauxlib.h>
+#include <string.h>
+
+// the most slots preallocated for a batch of paths, which grows past them as needed
+#define MAX_PREALLOCATED_BATCH 4096
+
+typedef struct
+{
+    fs_walk_t *walk;
+    lua_Integer batch;
+} walker_t;
+
+static walker_t *check_walker(lua_State *L)
+{
+    return (walker_t *)luaL_checkudata(L, 1, WalkerMetatableName);
+}
+
+static int fs_walker_close(lua_State *L)
+{
+    walker_t *w = check_walker(L);
+    fsL_walk_close(w->walk);
+    w->walk = NULL;
+    return 0;
+}
+
+static int walker_fail(lua_State *L, walker_t *w)
+{
+    const char *err = fsL_walk_error(w->walk);
+    lua_pushstring(L, err != NULL ? err : strerror(ENOMEM));
+    fs_walker_close(L);
+    return lua_error(L);
+}
+
+static int fs_walker_next(lua_State *L)
+{
+    walker_t *w = check_walker(L);
+    if (w->walk == NULL) return 0;
+
+    walk_entry_t entry;
+    if (w->batch == 0)
+    {
+        int r = fsL_walk_next(w->walk, &entry);
+        if (r < 0) return walker_fail(L, w);
+        if (r == 0) return 0;
+        lua_pushlstring(L, entry.path, entry.path_len);
+        lua_pushstring(L, fsL_type_name(entry.type));
+        lua_pushinteger(L, entry.depth);
+        return 3;
+    }
+
+    int prealloc = w->batch < MAX_PREALLOCATED_BATCH ? (int)w->batch : MAX_PREALLOCATED_BATCH;
+    lua_createtable(L, prealloc, 0); // paths
+    lua_createtable(L, prealloc, 0); // paths types
+    lua_Integer n = 0;
+    while (n < w->batch)
+    {
+        int r = fsL_walk_next(w->walk, &entry);
+        if (r < 0) return walker_fail(L, w);
+        if (r == 0) break;
+        n++;
+        lua_pushlstring(L, entry.path, entry.path_len);
+        lua_rawseti(L, -3, n);
+        lua_pushstring(L, fsL_type_name(entry.type));
+        lua_rawseti(L, -2, n);
+    }
+    return n > 0 ? 2 : 0;
+}
+
+/***
+ * @type Walker
+ * The state of a directory walk; see @{walk}.
+ */
+
+/***
+ * Returns the error message of the first directory that could not be read, if any.
+ * @function error
+ * @treturn string the error message, or `nil`.
+ */
+static int fs_walker_error(lua_State *L)
+{
+    walker_t *w = check_walker(L);
+    const char *err = w->walk != NULL ? fsL_walk_error(w->walk) : NULL;
+    lua_pushstring(L, err);
+    return 1;
+}
+
+/*** @section end */
+
+static void create_walker_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg walker_funcs[] = {
+#define XX(name) {#name, fs_walker_##name},
+        XX(close)
+        XX(error)
+        XX(next)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg walker_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", fs_walker_close},
+        {"__close", fs_walker_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, WalkerMetatableName); // mt
+    luaL_setfuncs(L, walker_meta_methods, 0);  // mt
+    luaL_newlibtable(L, walker_funcs);         // mt t
+    luaL_setfuncs(L, walker_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");            // mt
+    lua_pop(L, 1);                             //
+}
+
+// Pushes the patterns of the option `name`, a string or an array of strings, on the stack and
+// stores pointers to them into `patterns`, which is allocated as a userdata.
+static const char *const *check_patterns(lua_State *L, int arg, const char *name, size_t *count)
+{
+    *count = 0;
+    int type = lua_getfield(L, arg, name);
+    if (type == LUA_TNIL) return NULL;
+    if (type == LUA_TSTRING)
+    {
+        const char **patterns = (const char **)lua_newuserdatauv(L, sizeof(char *), 1);
+        lua_insert(L, -2);
+        patterns[0] = lua_tostring(L, -1);
+        lua_setiuservalue(L, -2, 1);
+        *count = 1;
+        return patterns;
+    }
+
+    luaL_argexpected(L, type == LUA_TTABLE, arg, "string or table");
+    size_t n = (size_t)lua_rawlen(L, -1);
+    const char **patterns = (const char **)lua_newuserdatauv(L, (n > 0 ? n : 1) * sizeof(char *), 1);
+    lua_insert(L, -2);
+    for (size_t i = 0; i < n; i++)
+    {
+        lua_rawgeti(L, -1, (lua_Integer)(i + 1));
+        patterns[i] = lua_tostring(L, -1);
+        luaL_argcheck(L, patterns[i] != NULL, arg, "patterns must be strings");
+        lua_pop(L, 1);
+    }
+    lua_setiuservalue(L, -2, 1);
+    *count = n;
+    return patterns;
+}
+
+/***
+ * Walks a directory tree.
+ *
+ * The tree is visited in C: directories are opened relative to their parent and the type of the
+ * entries is taken from the directory listing when the file system reports it, so that most of
+ * the entries are never stat-ed. The root directory itself is not returned.
+ *
+ * The following options are supported:
+ *
+ * - `max_depth` (integer): the maximum depth of the entries to return; the entries of the root
+ *   directory have depth 1. Defaults to no limit.
+ * - `follow_symlinks` (boolean): `true` to descend into symbolic links to directories, visiting
+ *   each directory once; the type of a followed link is the type of its target. Defaults to `false`.
+ * - `include` (string|table): glob patterns an entry must match to be returned; directories not
+ *   matching them are still visited.
+ * - `exclude` (string|table): glob patterns of entries to skip; excluded directories are not visited.
+ *   Patterns containing a `/` are matched against the path relative to the root, others against
+ *   the name of the entry.
+ * - `strict` (boolean): `true` to raise an error when a directory cannot be read; by default the
+ *   directory is skipped and the error is available through @{Walker:error}.
+ * - `threads` (integer): the number of threads reading directories concurrently; with more than
+ *   one thread the order of the entries is unspecified. Threads mostly pay off on cold caches and
+ *   network file systems. Defaults to 1.
+ * - `batch` (integer): when given, each step of the iteration returns two arrays, with the paths and
+ *   the types of up to `batch` entries, instead of a single entry.
+ *
+ * The types of the entries are: `"file"`, `"directory"`, `"symlink"`, `"block_device"`,
+ * `"char_device"`, `"fifo"`, `"socket"` and `"unknown"`.
+ *
+ * @usage
+ * for path, type, depth in fs.walk('src', {exclude = '.git'}) do
+ *   print(depth, type, path)
+ * end
+ *
+ * @function walk
+ * @within Directory functions
+ * @tparam string root the directory to walk.
+ * @tparam[opt] table opts the options of the walk.
+ * @return an iterator returning the path, the type and the depth of each entry if the function
+ * succeeded; otherwise `nil`.
+ * @treturn Walker|string the state of the walk if the function succeeded; otherwise an error message
+ * describing why the function failed.
+ * @raise If `root` is `nil`, or if `strict` is `true` and a directory cannot be read.
+ * @remark this function is not available on Windows.
+ */
+static int fs_walk(lua_State *L)
+{
+    const char *root = luaL_checkstring(L, 1);
+    walk_opts_t opts = {0};
+    opts.max_depth = -1;
+    opts.threads = 1;
+    lua_Integer batch = 0;
+
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_settop(L, 2);
+        if (lua_getfield(L, 2, "max_depth") != LUA_TNIL)
+        {
+            lua_Integer max_depth = luaL_checkinteger(L, -1);
+            luaL_argcheck(L, max_depth >= 0 && max_depth <= INT_MAX, 2, "max_depth out of range");
+            opts.max_depth = (int)max_depth;
+        }
+        lua_getfield(L, 2, "follow_symlinks");
+        opts.follow_symlinks = lua_toboolean(L, -1);
+        lua_getfield(L, 2, "strict");
+        opts.strict = lua_toboolean(L, -1);
+        if (lua_getfield(L, 2, "threads") != LUA_TNIL)
+        {
+            lua_Integer threads = luaL_checkinteger(L, -1);
+            luaL_argcheck(L, threads >= 1 && threads <= 256, 2, "threads out of range");
+            opts.threads = (int)threads;
+        }
+        if (lua_getfield(L, 2, "batch") != LUA_TNIL)
+        {
+            batch = luaL_checkinteger(L, -1);
+            luaL_argcheck(L, batch >= 1 && batch <= INT_MAX, 2, "batch out of range");
+        }
+        lua_settop(L, 2);
+        // the patterns are kept on the stack while the walk copies them
+        opts.include = check_patterns(L, 2, "include", &opts.include_count);
+        opts.exclude = check_patterns(L, 2, "exclude", &opts.exclude_count);
+    }
+
+    walker_t *w = (walker_t *)lua_newuserdatauv(L, sizeof(walker_t), 0);
+    w->walk = NULL;
+    w->batch = batch;
+    luaL_setmetatable(L, WalkerMetatableName);
+
+    w->walk = fsL_walk_open(root, &opts);
+    if (w->walk == NULL)
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+
+    lua_pushcfunction(L, fs_walker_next); // w next
+    lua_insert(L, -2);                    // next w
+    lua_pushnil(L);                       // next w nil
+    lua_pushvalue(L, -2);                 // next w nil w
+    return 4;
+}
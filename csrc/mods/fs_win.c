@@ -9,17 +9,18 @@
 #include <lauxlib.h>
 #include <string.h>
 
-#define XX(name)                                   \
-    static int fs_##name(lua_State *L)             \
-    {                                              \
-        const char *path = luaL_checkstring(L, 1); \
-        bool result;                               \
-        if (fsL_##name(L, path, &result))          \
-        {                                          \
-            lua_pushboolean(L, result);            \
-            return 1;                              \
-        }                                          \
-        _STD_RETURN_NIL_ERROR                      \
+#define XX(name)                                                                              \
+    static int fs_##name(lua_State *L)                                                        \
+    {                                                                                         \
+        const char *path = luaL_checkstring(L, 1);                                            \
+        bool result;                                                                          \
+        if (lua_isnoneornil(L, 2) ? fsL_##name(L, path, &result)                              \
+                                  : stat_cache_##name(L, 2, path, &result))                   \
+        {                                                                                     \
+            lua_pushboolean(L, result);                                                       \
+            return 1;                                                                         \
+        }                                                                                     \
+        _STD_RETURN_NIL_ERROR                                                                 \
     }
 
 /***
@@ -28,6 +29,7 @@
  * @function is_hidden
  * @within Path functions
  * @tparam string path the path to test.
+ * @tparam[opt] StatCache cache the cache of the metadata to use.
  * @treturn boolean `nil` if the function fails; `true` if the path is hidden, otherwise `false`.
  * @treturn string `nil` if the function succeeded; otherwise an error message describing why
  * the function failed.
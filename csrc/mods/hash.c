@@ -6,10 +6,28 @@
  * @module std.hash
  */
 
+#include "libhash.h"
+
 #include <lauxlib.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
+#define StateMetatableName "std.hash.state"
+
+#define TAG_NIL 0x9e3779b97f4a7c15ULL
+#define TAG_FALSE 0xbf58476d1ce4e5b9ULL
+#define TAG_TRUE 0x94d049bb133111ebULL
+#define TAG_NUMBER 0xd6e8feb86659fd93ULL
+#define TAG_POINTER 0xa0761d6478bd642fULL
+#define TAG_USERDATA 0xe7037ed1a0b428dbULL
+#define TAG_TABLE 0x8ebc6af09c88c6e3ULL
+#define TAG_KEY 0x589965cc75374cc3ULL
+#define TAG_VALUE 0x1d8e4e27c47d124fULL
+#define TAG_CYCLE 0x2545f4914f6cdd1dULL
+#define TAG_DEPTH 0x9fb21c651e98df25ULL
+
 /***
  * Returns a 32 bits hash code for a given value.
  * If the given value has a metatable defining the `__hash` metamethod,
@@ -50,15 +68,8 @@ static int hash_hash(lua_State *L)
     {
         size_t len;
         const char *s = luaL_checklstring(L, 1, &len);
-
-        // use up to 64 characters to compute the hash
-        const size_t step = (len >> 6) + 1;
-        uint32_t hash = (uint32_t)(len ^ (len >> 32));
-        for (size_t i = 0; i < len; i += step)
-        {
-            hash = (hash << 2) + (hash >> 2) + (uint32_t)s[i];
-        }
-        lua_pushinteger(L, (lua_Integer)hash);
+        uint64_t hash = hashL_bytes(s, len, hashL_seed());
+        lua_pushinteger(L, (lua_Integer)hashL_fold32(hash));
         return 1;
     }
 
@@ -69,7 +80,14 @@ static int hash_hash(lua_State *L)
         if (!is_num)
         {
             double n = (double)lua_tonumber(L, 1);
-            bits = isnan(n) ? 0x7ff8000000000000L : *(uint64_t *)&n;
+            if (isnan(n))
+            {
+                bits = 0x7ff8000000000000L;
+            }
+            else
+            {
+                memcpy(&bits, &n, sizeof(bits));
+            }
         }
         lua_pushinteger(L, (lua_Integer)(uint32_t)(bits ^ (bits >> 32)));
         return 1;
@@ -80,16 +98,388 @@ static int hash_hash(lua_State *L)
     return 1;
 }
 
+static uint64_t opt_seed(lua_State *L, int arg)
+{
+    return lua_isnoneornil(L, arg) ? hashL_seed() : (uint64_t)luaL_checkinteger(L, arg);
+}
+
+/***
+ * Returns the 64 bits hash code of a string.
+ * All the bytes of the string are used to compute the hash code.
+ * @function string
+ * @tparam string s the string to compute the hash code of.
+ * @tparam[opt] integer seed the seed to use; defaults to the per-process seed.
+ * @treturn integer a 64 bits hash code for the given string.
+ * @remark the per-process seed is random unless the `STD_HASH_SEED` environment variable is set.
+ */
+static int hash_string(lua_State *L)
+{
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    uint64_t seed = opt_seed(L, 2);
+    lua_pushinteger(L, (lua_Integer)hashL_bytes(s, len, seed));
+    return 1;
+}
+
+typedef struct
+{
+    uint64_t sum;
+    uint64_t count;
+    uint64_t key_hash;
+    bool has_key;
+} deep_frame_t;
+
+typedef struct
+{
+    uint64_t seed;
+    lua_Integer max_depth;
+    bool cycle_error;
+    int path;
+    int frames_slot;
+    deep_frame_t *frames;
+    size_t capacity;
+    size_t depth;
+} deep_t;
+
+static uint64_t deep_number(lua_State *L, int idx, uint64_t seed)
+{
+    int is_int;
+    uint64_t bits = (uint64_t)lua_tointegerx(L, idx, &is_int);
+    if (!is_int)
+    {
+        double n = (double)lua_tonumber(L, idx);
+        if (isnan(n))
+        {
+            bits = 0x7ff8000000000000L;
+        }
+        else
+        {
+            memcpy(&bits, &n, sizeof(bits));
+        }
+    }
+    return hashL_mix(bits ^ TAG_NUMBER, seed);
+}
+
+static uint64_t deep_pointer(lua_State *L, int idx, uint64_t seed)
+{
+    return hashL_mix((uint64_t)(uintptr_t)lua_topointer(L, idx) ^ TAG_POINTER, seed);
+}
+
+static void deep_push_frame(lua_State *L, deep_t *d, int idx)
+{
+    if (d->depth == d->capacity)
+    {
+        size_t capacity = d->capacity * 2;
+        deep_frame_t *frames = (deep_frame_t *)lua_newuserdatauv(L, capacity * sizeof(deep_frame_t), 0);
+        memcpy(frames, d->frames, d->depth * sizeof(deep_frame_t));
+        lua_replace(L, d->frames_slot);
+        d->frames = frames;
+        d->capacity = capacity;
+    }
+
+    luaL_checkstack(L, 5, "table too deep");
+    lua_pushvalue(L, idx);                            // t
+    lua_pushvalue(L, -1);                             // t t
+    lua_pushinteger(L, (lua_Integer)d->depth);        // t t depth
+    lua_rawset(L, d->path);                           // t
+    lua_pushnil(L);                                   // t nil
+
+    deep_frame_t *frame = &d->frames[d->depth++];
+    frame->sum = 0;
+    frame->count = 0;
+    frame->has_key = false;
+}
+
+// Computes the hash code of the value at `idx` if it does not require visiting a table;
+// otherwise pushes a frame for the table and returns false.
+static bool deep_enter(lua_State *L, deep_t *d, int idx, uint64_t *h)
+{
+    idx = lua_absindex(L, idx);
+    int type = lua_type(L, idx);
+    switch (type)
+    {
+        case LUA_TNONE:
+        case LUA_TNIL:
+            *h = hashL_mix(TAG_NIL, d->seed);
+            return true;
+        case LUA_TBOOLEAN:
+            *h = hashL_mix(lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE, d->seed);
+            return true;
+        case LUA_TNUMBER:
+            *h = deep_number(L, idx, d->seed);
+            return true;
+        case LUA_TSTRING:
+        {
+            size_t len;
+            const char *s = lua_tolstring(L, idx, &len);
+            *h = hashL_bytes(s, len, d->seed);
+            return true;
+        }
+        case LUA_TTABLE:
+        case LUA_TUSERDATA:
+            break;
+        default:
+            *h = deep_pointer(L, idx, d->seed);
+            return true;
+    }
+
+    if (luaL_getmetafield(L, idx, "__hash") != LUA_TNIL) // __hash
+    {
+        lua_pushvalue(L, idx);                           // __hash value
+        lua_call(L, 1, 1);                               // hash
+        *h = lua_type(L, -1) == LUA_TSTRING ? hashL_bytes(lua_tostring(L, -1), lua_rawlen(L, -1), d->seed)
+                                            : deep_number(L, -1, d->seed);
+        lua_pop(L, 1);
+        return true;
+    }
+
+    if (type == LUA_TUSERDATA)
+    {
+        // userdata comparing equal through __eq must hash alike
+        if (luaL_getmetafield(L, idx, "__eq") != LUA_TNIL)
+        {
+            lua_pop(L, 1);
+            *h = hashL_mix(TAG_USERDATA, d->seed);
+            return true;
+        }
+        *h = deep_pointer(L, idx, d->seed);
+        return true;
+    }
+
+    if (d->max_depth >= 0 && (lua_Integer)d->depth > d->max_depth)
+    {
+        *h = hashL_mix(TAG_DEPTH ^ (uint64_t)lua_rawlen(L, idx), d->seed);
+        return true;
+    }
+
+    lua_pushvalue(L, idx);
+    if (lua_rawget(L, d->path) != LUA_TNIL)
+    {
+        size_t depth = (size_t)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        if (d->cycle_error)
+        {
+            luaL_error(L, "cycle detected");
+        }
+        *h = hashL_mix(TAG_CYCLE ^ (uint64_t)(d->depth - depth), d->seed);
+        return true;
+    }
+    lua_pop(L, 1);
+
+    deep_push_frame(L, d, idx);
+    return false;
+}
+
+static void deep_check_opts(lua_State *L, int arg, deep_t *d)
+{
+    d->seed = hashL_seed();
+    d->max_depth = -1;
+    d->cycle_error = false;
+    if (lua_isnoneornil(L, arg)) return;
+
+    luaL_checktype(L, arg, LUA_TTABLE);
+    if (lua_getfield(L, arg, "seed") != LUA_TNIL)
+    {
+        d->seed = (uint64_t)luaL_checkinteger(L, -1);
+    }
+    if (lua_getfield(L, arg, "depth") != LUA_TNIL)
+    {
+        d->max_depth = luaL_checkinteger(L, -1);
+        luaL_argcheck(L, d->max_depth >= 0, arg, "depth must be non-negative");
+    }
+    if (lua_getfield(L, arg, "cycles") != LUA_TNIL)
+    {
+        static const char *const modes[] = {"mark", "error", NULL};
+        d->cycle_error = luaL_checkoption(L, -1, NULL, modes) == 1;
+    }
+    lua_pop(L, 3);
+}
+
+/***
+ * Returns the 64 bits structural hash code of a value.
+ *
+ * Tables are hashed by content: the key-value pairs are combined in an order-independent way, so
+ * two tables with the same content have the same hash code. Nested tables are visited iteratively.
+ * Tables and userdata with a `__hash` metamethod are hashed by the value it returns; userdata
+ * with an `__eq` metamethod, but not `__hash`, all share the same hash code.
+ *
+ * The following options are supported:
+ *
+ * - `seed` (integer): the seed to use; defaults to the per-process seed.
+ * - `depth` (integer): the maximum depth of the tables to visit; deeper tables are hashed by length only.
+ * - `cycles` (string): `"mark"` (default) to hash a reference to a table being visited by its
+ *   distance from it, or `"error"` to raise an error.
+ *
+ * @function deep
+ * @param value the value to compute the hash code of.
+ * @tparam[opt] table opts the hashing options.
+ * @treturn integer a 64 bits hash code for the given value.
+ * @raise If `cycles` is `"error"` and `value` contains a cycle.
+ */
+static int hash_deep(lua_State *L)
+{
+    deep_t d;
+    deep_check_opts(L, 2, &d);
+
+    lua_settop(L, 2);
+    lua_newtable(L);
+    d.path = 3;
+    d.capacity = 8;
+    d.frames = (deep_frame_t *)lua_newuserdatauv(L, d.capacity * sizeof(deep_frame_t), 0);
+    d.frames_slot = 4;
+    d.depth = 0;
+
+    uint64_t h;
+    if (deep_enter(L, &d, 1, &h))
+    {
+        lua_pushinteger(L, (lua_Integer)h);
+        return 1;
+    }
+
+    while (true)
+    {
+        // stack: ... t k
+        deep_frame_t *frame = &d.frames[d.depth - 1];
+        if (lua_next(L, -2)) // t k v
+        {
+            if (!deep_enter(L, &d, -2, &h)) continue;
+        }
+        else // t
+        {
+            h = hashL_mix(frame->sum ^ TAG_TABLE, frame->count ^ d.seed);
+            lua_pushnil(L);          // t nil
+            lua_rawset(L, d.path);   //
+            if (--d.depth == 0) break;
+        }
+
+        // deliver the hash code of a key or a value to the frame on top of the stack (... t k v)
+        frame = &d.frames[d.depth - 1];
+        if (!frame->has_key)
+        {
+            frame->key_hash = h;
+            frame->has_key = true;
+            if (!deep_enter(L, &d, -1, &h)) continue;
+            frame = &d.frames[d.depth - 1];
+        }
+        frame->sum += hashL_mix(frame->key_hash ^ TAG_KEY, h ^ TAG_VALUE);
+        frame->count++;
+        frame->has_key = false;
+        lua_pop(L, 1); // t k
+    }
+
+    lua_pushinteger(L, (lua_Integer)h);
+    return 1;
+}
+
+/***
+ * @type State
+ * An incremental hasher.
+ * Feeding a string in pieces produces the same hash code as @{string} on the whole string.
+ */
+
+static hash_state_t *check_state(lua_State *L)
+{
+    return (hash_state_t *)luaL_checkudata(L, 1, StateMetatableName);
+}
+
+/***
+ * Feeds one or more strings to the hasher.
+ * @function update
+ * @tparam string ... the strings to add.
+ * @treturn State the hasher.
+ */
+static int hash_state_update(lua_State *L)
+{
+    hash_state_t *state = check_state(L);
+    int n = lua_gettop(L);
+    for (int i = 2; i <= n; i++)
+    {
+        size_t len;
+        const char *s = luaL_checklstring(L, i, &len);
+        hashL_update(state, s, len);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/***
+ * Returns the hash code of the strings fed so far.
+ * The hasher is not modified and more strings can be added afterwards.
+ * @function digest
+ * @treturn integer a 64 bits hash code.
+ */
+static int hash_state_digest(lua_State *L)
+{
+    hash_state_t *state = check_state(L);
+    lua_pushinteger(L, (lua_Integer)hashL_digest(state));
+    return 1;
+}
+
+/***
+ * Resets the hasher.
+ * @function reset
+ * @tparam[opt] integer seed the seed to use; defaults to the per-process seed.
+ * @treturn State the hasher.
+ */
+static int hash_state_reset(lua_State *L)
+{
+    hash_state_t *state = check_state(L);
+    hashL_init(state, opt_seed(L, 2));
+    lua_settop(L, 1);
+    return 1;
+}
+
+/*** @section end */
+
+/***
+ * Returns a new incremental hasher.
+ * @function state
+ * @tparam[opt] integer seed the seed to use; defaults to the per-process seed.
+ * @treturn State a new hasher.
+ */
+static int hash_state(lua_State *L)
+{
+    uint64_t seed = opt_seed(L, 1);
+    hash_state_t *state = (hash_state_t *)lua_newuserdatauv(L, sizeof(hash_state_t), 0);
+    hashL_init(state, seed);
+    luaL_setmetatable(L, StateMetatableName);
+    return 1;
+}
+
+static void create_state_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg funcs[] = {
+#define XX(name) {#name, hash_state_##name},
+        XX(update)
+        XX(digest)
+        XX(reset)
+        {NULL, NULL}
+#undef XX
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, StateMetatableName); // mt
+    luaL_newlibtable(L, funcs);               // mt t
+    luaL_setfuncs(L, funcs, 0);               // mt t
+    lua_setfield(L, -2, "__index");           // mt
+    lua_pop(L, 1);                            //
+}
+
 // clang-format off
 static const struct luaL_Reg funcs[] =
 {
     { "hash", hash_hash },
+    { "string", hash_string },
+    { "deep", hash_deep },
+    { "state", hash_state },
     { NULL, NULL }
 };
 // clang-format on
 
 extern int luaopen_std_hash(lua_State *L)
 {
+    create_state_metatable(L);
     lua_newtable(L);
     luaL_setfuncs(L, funcs, 0);
     return 1;
@@ -0,0 +1,793 @@
+//  Copyright Simone Livieri. All Rights Reserved.
+//  Unauthorized copying of this file, via any medium is strictly prohibited.
+//  For terms of use, see LICENSE.txt
+
+/***
+ * Hash maps and sets whose keys are compared by value.
+ *
+ * Keys are hashed with the `__hash` metamethod, when defined, or with the same functions used by
+ * @{std.hash}, and compared with the `__eq` metamethod; a custom hash function and a custom
+ * equality comparer can be given instead. Entries are stored densely in insertion order and
+ * indexed by an open-addressing table using Robin Hood hashing.
+ *
+ * @module std.hashmap
+ */
+
+#include "libhash.h"
+
+#include <lauxlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MapMetatableName "std.hashmap.map"
+#define SetMetatableName "std.hashmap.set"
+
+// user values of a map userdata
+#define UV_KEYS 1
+#define UV_VALUES 2
+#define UV_SLOTS 3
+#define UV_HASHES 4
+#define UV_EQ 5
+#define UV_HASH 6
+#define UV_COUNT 6
+
+#define MIN_CAPACITY 8
+#define MAX_CAPACITY ((size_t)1 << 30)
+// the index is grown when more than 7/8 of its slots are in use
+#define MAX_LOAD(capacity) ((capacity) - ((capacity) >> 3))
+
+#define TAG_EQ 0x6a09e667f3bcc909ULL
+#define TAG_FALSE 0xbf58476d1ce4e5b9ULL
+#define TAG_TRUE 0x94d049bb133111ebULL
+
+typedef struct
+{
+    uint32_t tag; // the low 32 bits of the hash code
+    uint32_t idx; // 1-based index of the entry; 0 if the slot is empty
+} slot_t;
+
+typedef struct
+{
+    bool is_set;
+    bool has_eq;
+    bool has_hash;
+    uint64_t seed;
+    uint64_t version;
+    size_t count;
+    size_t capacity;
+    size_t entries_capacity;
+    size_t max_probe;
+    slot_t *slots;
+    uint64_t *hashes;
+} map_t;
+
+static map_t *check_map(lua_State *L, int arg)
+{
+    map_t *m = (map_t *)luaL_testudata(L, arg, MapMetatableName);
+    if (m == NULL) m = (map_t *)luaL_testudata(L, arg, SetMetatableName);
+    if (m == NULL) luaL_typeerror(L, arg, "hashmap");
+    return m;
+}
+
+static uint64_t hash_number(lua_State *L, int idx)
+{
+    int is_int;
+    uint64_t bits = (uint64_t)lua_tointegerx(L, idx, &is_int);
+    if (!is_int)
+    {
+        double n = (double)lua_tonumber(L, idx);
+        memcpy(&bits, &n, sizeof(bits));
+    }
+    return bits;
+}
+
+static uint64_t hash_result(lua_State *L, map_t *m)
+{
+    uint64_t h;
+    switch (lua_type(L, -1))
+    {
+        case LUA_TNUMBER:
+            h = hashL_mix(hash_number(L, -1), m->seed);
+            break;
+        case LUA_TSTRING:
+            h = hashL_bytes(lua_tostring(L, -1), lua_rawlen(L, -1), m->seed);
+            break;
+        default:
+            return (uint64_t)luaL_error(L, "hash function must return a number or a string");
+    }
+    lua_pop(L, 1);
+    return h;
+}
+
+static void check_version(lua_State *L, map_t *m, uint64_t version)
+{
+    if (m->version != version) luaL_error(L, "hashmap modified during a hash or an equality callback");
+}
+
+// Computes the hash code of the key at `idx`; `m` must be the userdata at index 1.
+static uint64_t map_hash(lua_State *L, map_t *m, int idx)
+{
+    int type = lua_type(L, idx);
+    if (type == LUA_TNIL) luaL_error(L, "key is nil");
+    if (type == LUA_TNUMBER && !lua_isinteger(L, idx) && isnan(lua_tonumber(L, idx))) luaL_error(L, "key is NaN");
+
+    uint64_t version = m->version;
+    if (m->has_eq && !m->has_hash)
+    {
+        // nothing is known about the keys the comparer considers equal
+        return hashL_mix(TAG_EQ, m->seed);
+    }
+    if (m->has_hash)
+    {
+        lua_getiuservalue(L, 1, UV_HASH); // hash
+        lua_pushvalue(L, idx);            // hash key
+        lua_call(L, 1, 1);                // h
+        check_version(L, m, version);
+        return hash_result(L, m);
+    }
+
+    switch (type)
+    {
+        case LUA_TBOOLEAN:
+            return hashL_mix(lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE, m->seed);
+        case LUA_TNUMBER:
+            return hashL_mix(hash_number(L, idx), m->seed);
+        case LUA_TSTRING:
+        {
+            size_t len;
+            const char *s = lua_tolstring(L, idx, &len);
+            return hashL_bytes(s, len, m->seed);
+        }
+        case LUA_TTABLE:
+        case LUA_TUSERDATA:
+            if (luaL_getmetafield(L, idx, "__hash") != LUA_TNIL) // __hash
+            {
+                lua_pushvalue(L, idx); // __hash key
+                lua_call(L, 1, 1);     // h
+                check_version(L, m, version);
+                return hash_result(L, m);
+            }
+            // keys comparing equal through __eq must hash alike
+            if (luaL_getmetafield(L, idx, "__eq") != LUA_TNIL)
+            {
+                lua_pop(L, 1);
+                return hashL_mix(TAG_EQ, m->seed);
+            }
+            break;
+        default:
+            break;
+    }
+    return hashL_mix((uint64_t)(uintptr_t)lua_topointer(L, idx), m->seed);
+}
+
+// Compares the key at the top of the stack with the key at `idx` and pops it.
+static bool map_equal(lua_State *L, map_t *m, int idx)
+{
+    bool eq;
+    if (lua_rawequal(L, -1, idx))
+    {
+        eq = true;
+    }
+    else if (m->has_eq)
+    {
+        uint64_t version = m->version;
+        lua_getiuservalue(L, 1, UV_EQ); // key eq
+        lua_insert(L, -2);              // eq key
+        lua_pushvalue(L, idx);          // eq key other
+        lua_call(L, 2, 1);              // r
+        check_version(L, m, version);
+        eq = lua_toboolean(L, -1);
+    }
+    else
+    {
+        eq = lua_compare(L, -1, idx, LUA_OPEQ);
+    }
+    lua_pop(L, 1);
+    return eq;
+}
+
+static inline size_t slot_distance(const map_t *m, size_t pos, uint32_t tag)
+{
+    size_t mask = m->capacity - 1;
+    return (pos - (tag & mask)) & mask;
+}
+
+// Returns the position of the slot indexing the key at `idx`, or `SIZE_MAX` if the key is not in
+// the map; `keys` is the stack index of the keys table.
+static size_t map_find(lua_State *L, map_t *m, int keys, int idx, uint64_t h)
+{
+    if (m->count == 0) return SIZE_MAX;
+
+    size_t mask = m->capacity - 1;
+    uint32_t tag = (uint32_t)h;
+    for (size_t pos = tag & mask, dist = 0;; pos = (pos + 1) & mask, dist++)
+    {
+        slot_t s = m->slots[pos];
+        if (s.idx == 0 || slot_distance(m, pos, s.tag) < dist) return SIZE_MAX;
+        if (s.tag == tag && m->hashes[s.idx - 1] == h)
+        {
+            lua_rawgeti(L, keys, s.idx);
+            if (map_equal(L, m, idx)) return pos;
+        }
+    }
+}
+
+static void slots_insert(map_t *m, slot_t s)
+{
+    size_t mask = m->capacity - 1;
+    size_t pos = s.tag & mask, dist = 0;
+    while (true)
+    {
+        slot_t *cur = &m->slots[pos];
+        if (cur->idx == 0)
+        {
+            *cur = s;
+            if (dist > m->max_probe) m->max_probe = dist;
+            return;
+        }
+
+        size_t cur_dist = slot_distance(m, pos, cur->tag);
+        if (cur_dist < dist)
+        {
+            slot_t t = *cur;
+            *cur = s;
+            s = t;
+            if (dist > m->max_probe) m->max_probe = dist;
+            dist = cur_dist;
+        }
+        pos = (pos + 1) & mask;
+        dist++;
+    }
+}
+
+static void slots_remove(map_t *m, size_t pos)
+{
+    size_t mask = m->capacity - 1;
+    size_t next = (pos + 1) & mask;
+    while (m->slots[next].idx != 0 && slot_distance(m, next, m->slots[next].tag) > 0)
+    {
+        m->slots[pos] = m->slots[next];
+        pos = next;
+        next = (next + 1) & mask;
+    }
+    m->slots[pos].idx = 0;
+}
+
+static void rehash(lua_State *L, map_t *m, size_t capacity)
+{
+    slot_t *slots = (slot_t *)lua_newuserdatauv(L, capacity * sizeof(slot_t), 0);
+    memset(slots, 0, capacity * sizeof(slot_t));
+    lua_setiuservalue(L, 1, UV_SLOTS);
+
+    m->slots = slots;
+    m->capacity = capacity;
+    m->max_probe = 0;
+    for (size_t i = 0; i < m->count; i++)
+    {
+        slot_t s = {(uint32_t)m->hashes[i], (uint32_t)(i + 1)};
+        slots_insert(m, s);
+    }
+}
+
+static void reserve_entries(lua_State *L, map_t *m, size_t n)
+{
+    if (n <= m->entries_capacity) return;
+
+    size_t capacity = m->entries_capacity < MIN_CAPACITY ? MIN_CAPACITY : m->entries_capacity;
+    while (capacity < n) capacity *= 2;
+
+    uint64_t *hashes = (uint64_t *)lua_newuserdatauv(L, capacity * sizeof(uint64_t), 0);
+    if (m->count > 0) memcpy(hashes, m->hashes, m->count * sizeof(uint64_t));
+    lua_setiuservalue(L, 1, UV_HASHES);
+
+    m->hashes = hashes;
+    m->entries_capacity = capacity;
+}
+
+// Makes room for `n` entries without growing the index.
+static void map_reserve(lua_State *L, map_t *m, size_t n)
+{
+    if (n > MAX_LOAD(MAX_CAPACITY)) luaL_error(L, "hashmap too big");
+
+    reserve_entries(L, m, n);
+    if (n <= MAX_LOAD(m->capacity)) return;
+
+    size_t capacity = m->capacity < MIN_CAPACITY ? MIN_CAPACITY : m->capacity;
+    while (n > MAX_LOAD(capacity)) capacity *= 2;
+    rehash(L, m, capacity);
+}
+
+// Adds the key at `idx`, not in the map yet, with its value at the top of the stack and pops the value.
+static void map_insert(lua_State *L, map_t *m, int keys, int values, int idx, uint64_t h)
+{
+    map_reserve(L, m, m->count + 1);
+
+    size_t i = ++m->count;
+    m->hashes[i - 1] = h;
+    lua_pushvalue(L, idx);
+    lua_rawseti(L, keys, (lua_Integer)i);
+    lua_rawseti(L, values, (lua_Integer)i);
+
+    slot_t s = {(uint32_t)h, (uint32_t)i};
+    slots_insert(m, s);
+    m->version++;
+}
+
+// Removes the entry indexed by the slot at `pos`, moving the last entry in its place.
+static void map_remove(lua_State *L, map_t *m, int keys, int values, size_t pos)
+{
+    size_t i = m->slots[pos].idx, last = m->count;
+    slots_remove(m, pos);
+
+    if (i != last)
+    {
+        uint64_t h = m->hashes[last - 1];
+        size_t mask = m->capacity - 1;
+        for (pos = (uint32_t)h & mask; m->slots[pos].idx != last; pos = (pos + 1) & mask)
+        {
+        }
+        m->slots[pos].idx = (uint32_t)i;
+        m->hashes[i - 1] = h;
+
+        lua_rawgeti(L, keys, (lua_Integer)last);
+        lua_rawseti(L, keys, (lua_Integer)i);
+        lua_rawgeti(L, values, (lua_Integer)last);
+        lua_rawseti(L, values, (lua_Integer)i);
+    }
+
+    lua_pushnil(L);
+    lua_rawseti(L, keys, (lua_Integer)last);
+    lua_pushnil(L);
+    lua_rawseti(L, values, (lua_Integer)last);
+    m->count--;
+    m->version++;
+}
+
+// Pushes the keys and values tables of the map at index 1: the key at index 2 is at index 3 after the call.
+static map_t *check_entries(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_settop(L, 3);
+    lua_getiuservalue(L, 1, UV_KEYS);   // map key value keys
+    lua_getiuservalue(L, 1, UV_VALUES); // map key value keys values
+    return m;
+}
+
+/***
+ * @type Map
+ * A hash map.
+ * Maps support the length operator `#`, and `pairs`, which iterates the entries in insertion order
+ * as long as no entry is removed.
+ */
+
+/***
+ * Returns the value associated with a key.
+ * @function get
+ * @param key the key to get the value of.
+ * @param[opt] default the value to return if the key is not found.
+ * @return the value associated with the key, or `default` if the key is not found.
+ * @raise If `key` is `nil` or NaN.
+ */
+static int hashmap_get(lua_State *L)
+{
+    map_t *m = check_entries(L);
+    luaL_checkany(L, 2);
+    size_t pos = map_find(L, m, 4, 2, map_hash(L, m, 2));
+    if (pos == SIZE_MAX)
+    {
+        lua_settop(L, 3);
+        return 1;
+    }
+    lua_rawgeti(L, 5, m->slots[pos].idx);
+    return 1;
+}
+
+/***
+ * Associates a value with a key.
+ * @function put
+ * @param key the key.
+ * @param value the value to associate with the key; if `nil`, the key is removed.
+ * @return the value previously associated with the key, or `nil`.
+ * @raise If `key` is `nil` or NaN.
+ */
+static int hashmap_put(lua_State *L)
+{
+    map_t *m = check_entries(L);
+    luaL_checkany(L, 2);
+    uint64_t h = map_hash(L, m, 2);
+    size_t pos = map_find(L, m, 4, 2, h);
+    if (pos == SIZE_MAX)
+    {
+        if (!lua_isnil(L, 3))
+        {
+            lua_pushvalue(L, 3);
+            map_insert(L, m, 4, 5, 2, h);
+        }
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_Integer i = m->slots[pos].idx;
+    lua_rawgeti(L, 5, i); // ... old
+    if (lua_isnil(L, 3))
+    {
+        map_remove(L, m, 4, 5, pos);
+    }
+    else
+    {
+        lua_pushvalue(L, 3);
+        lua_rawseti(L, 5, i);
+    }
+    return 1;
+}
+
+/*** @section end */
+
+/***
+ * @type Set
+ * A hash set.
+ * Sets support the length operator `#`, and `pairs`, which iterates the keys in insertion order,
+ * as long as no key is removed, and returns `true` as value.
+ */
+
+/***
+ * Adds a key.
+ * This method is supported by maps too: the key is associated with `true` if it is not in the map.
+ * @function add
+ * @param key the key to add.
+ * @treturn boolean `true` if the key was added; `false` if it was already present.
+ * @raise If `key` is `nil` or NaN.
+ */
+static int hashmap_add(lua_State *L)
+{
+    map_t *m = check_entries(L);
+    luaL_checkany(L, 2);
+    uint64_t h = map_hash(L, m, 2);
+    size_t pos = map_find(L, m, 4, 2, h);
+    if (pos == SIZE_MAX)
+    {
+        lua_pushboolean(L, true);
+        map_insert(L, m, 4, 5, 2, h);
+        lua_pushboolean(L, true);
+        return 1;
+    }
+    lua_pushboolean(L, false);
+    return 1;
+}
+
+/***
+ * Determines whether a key is present.
+ * This method is supported by maps too.
+ * @function has
+ * @param key the key to look for.
+ * @treturn boolean `true` if the key is present; `false` otherwise.
+ * @raise If `key` is `nil` or NaN.
+ */
+static int hashmap_has(lua_State *L)
+{
+    map_t *m = check_entries(L);
+    luaL_checkany(L, 2);
+    lua_pushboolean(L, map_find(L, m, 4, 2, map_hash(L, m, 2)) != SIZE_MAX);
+    return 1;
+}
+
+/***
+ * Removes a key.
+ * This method is supported by maps too.
+ * @function remove
+ * @param key the key to remove.
+ * @return the value associated with the removed key (`true` for sets), or `nil` if the key was
+ * not present.
+ * @raise If `key` is `nil` or NaN.
+ */
+static int hashmap_remove(lua_State *L)
+{
+    map_t *m = check_entries(L);
+    luaL_checkany(L, 2);
+    size_t pos = map_find(L, m, 4, 2, map_hash(L, m, 2));
+    if (pos == SIZE_MAX)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_rawgeti(L, 5, m->slots[pos].idx);
+    map_remove(L, m, 4, 5, pos);
+    return 1;
+}
+
+/***
+ * Returns the number of entries.
+ * This method is supported by maps too.
+ * @function len
+ * @treturn integer the number of entries.
+ */
+static int hashmap_len(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_pushinteger(L, (lua_Integer)m->count);
+    return 1;
+}
+
+/***
+ * Removes all the entries.
+ * The memory used by the map is kept for reuse.
+ * This method is supported by maps too.
+ * @function clear
+ * @return the map.
+ */
+static int hashmap_clear(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_settop(L, 1);
+    lua_createtable(L, (int)m->entries_capacity, 0);
+    lua_setiuservalue(L, 1, UV_KEYS);
+    lua_createtable(L, (int)m->entries_capacity, 0);
+    lua_setiuservalue(L, 1, UV_VALUES);
+    if (m->capacity > 0) memset(m->slots, 0, m->capacity * sizeof(slot_t));
+    m->count = 0;
+    m->max_probe = 0;
+    m->version++;
+    return 1;
+}
+
+/***
+ * Makes room for a given number of entries, so that adding them will not need to grow the map.
+ * This method is supported by maps too.
+ * @function reserve
+ * @tparam integer n the number of entries.
+ * @return the map.
+ */
+static int hashmap_reserve(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_Integer n = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "size must be non-negative");
+    lua_settop(L, 1);
+    map_reserve(L, m, (size_t)n);
+    m->version++;
+    return 1;
+}
+
+/***
+ * Returns statistics about the index of the map.
+ * The returned table has the following fields:
+ *
+ * - `count`: the number of entries.
+ * - `capacity`: the number of slots of the index.
+ * - `load_factor`: the ratio between `count` and `capacity`.
+ * - `max_probe`: the longest distance, in slots, between the position of a key and its home slot.
+ * - `mean_probe`: the average distance between the position of a key and its home slot.
+ *
+ * This method is supported by maps too.
+ * @function stats
+ * @treturn table the statistics.
+ */
+static int hashmap_stats(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+
+    size_t total = 0;
+    for (size_t pos = 0; pos < m->capacity; pos++)
+    {
+        if (m->slots[pos].idx != 0) total += slot_distance(m, pos, m->slots[pos].tag);
+    }
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, (lua_Integer)m->count);
+    lua_setfield(L, -2, "count");
+    lua_pushinteger(L, (lua_Integer)m->capacity);
+    lua_setfield(L, -2, "capacity");
+    lua_pushnumber(L, m->capacity > 0 ? (lua_Number)m->count / (lua_Number)m->capacity : 0);
+    lua_setfield(L, -2, "load_factor");
+    lua_pushinteger(L, (lua_Integer)m->max_probe);
+    lua_setfield(L, -2, "max_probe");
+    lua_pushnumber(L, m->count > 0 ? (lua_Number)total / (lua_Number)m->count : 0);
+    lua_setfield(L, -2, "mean_probe");
+    return 1;
+}
+
+/***
+ * Returns an array with the keys, in the order used by `pairs`.
+ * This method is supported by maps too.
+ * @function keys
+ * @treturn table an array with the keys.
+ */
+static int hashmap_keys(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_getiuservalue(L, 1, UV_KEYS);
+    lua_createtable(L, (int)m->count, 0);
+    for (lua_Integer i = 1; i <= (lua_Integer)m->count; i++)
+    {
+        lua_rawgeti(L, -2, i);
+        lua_rawseti(L, -2, i);
+    }
+    return 1;
+}
+
+static int hashmap_iter(lua_State *L)
+{
+    map_t *m = check_map(L, 1);
+    lua_Integer i = lua_tointeger(L, lua_upvalueindex(1)) + 1;
+    if (i > (lua_Integer)m->count) return 0;
+
+    lua_pushinteger(L, i);
+    lua_replace(L, lua_upvalueindex(1));
+    lua_getiuservalue(L, 1, UV_KEYS);
+    lua_rawgeti(L, -1, i);
+    if (m->is_set)
+    {
+        lua_pushboolean(L, true);
+    }
+    else
+    {
+        lua_getiuservalue(L, 1, UV_VALUES);
+        lua_rawgeti(L, -1, i);
+        lua_remove(L, -2);
+    }
+    return 2;
+}
+
+/***
+ * Returns an iterator over the entries, as `pairs` does.
+ * This method is supported by maps too.
+ * @function pairs
+ * @return an iterator over the entries.
+ */
+static int hashmap_pairs(lua_State *L)
+{
+    check_map(L, 1);
+    lua_pushinteger(L, 0);
+    lua_pushcclosure(L, hashmap_iter, 1);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+/*** @section end */
+
+static void create_metatable(lua_State *L, const char *name)
+{
+    // clang-format off
+    const struct luaL_Reg funcs[] = {
+#define XX(name) {#name, hashmap_##name},
+        XX(add)
+        XX(clear)
+        XX(get)
+        XX(has)
+        XX(keys)
+        XX(len)
+        XX(pairs)
+        XX(put)
+        XX(remove)
+        XX(reserve)
+        XX(stats)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__len", hashmap_len},
+        {"__pairs", hashmap_pairs},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, name);          // mt
+    luaL_setfuncs(L, meta_methods, 0);   // mt
+    luaL_newlibtable(L, funcs);          // mt t
+    luaL_setfuncs(L, funcs, 0);          // mt t
+    if (strcmp(name, SetMetatableName) == 0)
+    {
+        lua_pushnil(L);                  // mt t nil
+        lua_setfield(L, -2, "get");      // mt t
+        lua_pushnil(L);                  // mt t nil
+        lua_setfield(L, -2, "put");      // mt t
+    }
+    lua_setfield(L, -2, "__index");      // mt
+    lua_pop(L, 1);                       //
+}
+
+static int new_map(lua_State *L, bool is_set)
+{
+    lua_Integer capacity = 0;
+    bool has_eq = false, has_hash = false;
+    lua_settop(L, 1);
+    if (!lua_isnil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        has_eq = lua_getfield(L, 1, "eq") != LUA_TNIL;
+        luaL_argcheck(L, !has_eq || lua_type(L, 2) == LUA_TFUNCTION, 1, "eq must be a function");
+        has_hash = lua_getfield(L, 1, "hash") != LUA_TNIL;
+        luaL_argcheck(L, !has_hash || lua_type(L, 3) == LUA_TFUNCTION, 1, "hash must be a function");
+        if (lua_getfield(L, 1, "capacity") != LUA_TNIL)
+        {
+            int is_integer;
+            capacity = lua_tointegerx(L, 4, &is_integer);
+            luaL_argcheck(L, is_integer, 1, "capacity must be an integer");
+            luaL_argcheck(L, capacity >= 0, 1, "capacity must be non-negative");
+            luaL_argcheck(L, (lua_Unsigned)capacity <= MAX_LOAD(MAX_CAPACITY), 1, "capacity too big");
+        }
+    }
+    else
+    {
+        lua_settop(L, 4);
+    }
+
+    // opts eq hash capacity
+    map_t *m = (map_t *)lua_newuserdatauv(L, sizeof(map_t), UV_COUNT); // opts eq hash capacity map
+    memset(m, 0, sizeof(map_t));
+    m->is_set = is_set;
+    m->has_eq = has_eq;
+    m->has_hash = has_hash;
+    m->seed = hashL_seed();
+    luaL_setmetatable(L, is_set ? SetMetatableName : MapMetatableName);
+    lua_replace(L, 1); // map eq hash capacity
+
+    lua_pushvalue(L, 2);
+    lua_setiuservalue(L, 1, UV_EQ);
+    lua_pushvalue(L, 3);
+    lua_setiuservalue(L, 1, UV_HASH);
+    lua_createtable(L, (int)capacity, 0);
+    lua_setiuservalue(L, 1, UV_KEYS);
+    lua_createtable(L, (int)capacity, 0);
+    lua_setiuservalue(L, 1, UV_VALUES);
+    lua_settop(L, 1);
+
+    if (capacity > 0) map_reserve(L, m, (size_t)capacity);
+    return 1;
+}
+
+/***
+ * Returns a new hash map.
+ *
+ * The following options are supported:
+ *
+ * - `eq` (function): the function used to compare keys for equality (see @{std.array.eq_comparer});
+ *   defaults to `==`.
+ * - `hash` (function): the function used to compute the hash code of a key, returning an integer
+ *   or a string (e.g. @{std.hash.deep}); it must be consistent with `eq`. If `eq` is given
+ *   without `hash`, all the keys share the same hash code and lookups take linear time.
+ * - `capacity` (integer): the number of entries to reserve room for.
+ *
+ * @function map
+ * @tparam[opt] table opts the options of the map.
+ * @treturn Map a new map.
+ */
+static int hashmap_map(lua_State *L)
+{
+    return new_map(L, false);
+}
+
+/***
+ * Returns a new hash set.
+ * The supported options are the same as @{map}.
+ * @function set
+ * @tparam[opt] table opts the options of the set.
+ * @treturn Set a new set.
+ */
+static int hashmap_set(lua_State *L)
+{
+    return new_map(L, true);
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "map", hashmap_map },
+    { "set", hashmap_set },
+    { NULL, NULL }
+};
+// clang-format on
+
+extern int luaopen_std_hashmap(lua_State *L)
+{
+    create_metatable(L, MapMetatableName);
+    create_metatable(L, SetMetatableName);
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
@@ -0,0 +1,646 @@
+/***
+ * High dynamic range histograms of integer values.
+ *
+ * A @{Histogram} counts values, such as latencies in nanoseconds, in the buckets of the
+ * HdrHistogram layout: the values are grouped by powers of 2, each power being divided in linear
+ * sub-buckets, so that every value is known to a fixed number of significant decimal digits
+ * whatever its magnitude. Its memory is allocated once, by @{new}, recording a value costs a few
+ * instructions, and the histograms of the same values can be merged.
+ *
+ * @usage
+ * local h = histogram.new({highest = 60 * 1e9}) -- up to 1 minute in nanoseconds
+ * for _ = 1, 1000 do
+ *   local t0 = time.monotonic_ns()
+ *   work()
+ *   h:record_since(t0)
+ * end
+ * print(h:percentile(50, 99, 99.9))
+ *
+ * @module std.histogram
+ */
+#include "std.h"
+#include "libtime.h"
+#include "libsyserror.h"
+
+#include <lauxlib.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define HistogramMetatableName "std.histogram.histogram"
+
+#define DEFAULT_LOWEST 1
+#define DEFAULT_HIGHEST (3600 * NANOS_PER_SECOND)
+#define DEFAULT_DIGITS 3
+#define MAX_DIGITS 5
+
+#define ENCODING_MAGIC "HDR\x01"
+#define ENCODING_MAGIC_LEN 4
+
+typedef struct
+{
+    lua_Integer lowest;  // the lowest value discernible from 0
+    lua_Integer highest; // the highest value trackable
+    int digits;          // the number of significant decimal digits
+    int unit_magnitude;
+    int half_count_magnitude;
+    lua_Integer half_count; // the number of sub-buckets in the upper half of each bucket
+    lua_Integer sub_bucket_mask;
+    int counts_len;
+} layout_t;
+
+typedef struct
+{
+    layout_t layout;
+    lua_Integer total;
+    lua_Integer min; // LUA_MAXINTEGER while empty
+    lua_Integer max;
+    lua_Integer counts[];
+} histogram_t;
+
+static int log2_floor(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Computes the layout of the buckets, returning false if the parameters are out of range.
+static bool layout_init(layout_t *l, lua_Integer lowest, lua_Integer highest, lua_Integer digits)
+{
+    if (lowest < 1 || digits < 1 || digits > MAX_DIGITS || highest < 2 * lowest) return false;
+
+    lua_Integer largest_single_unit = 2;
+    for (int i = 0; i < digits; i++)
+    {
+        largest_single_unit *= 10;
+    }
+    int sub_bucket_count_magnitude = log2_floor((uint64_t)largest_single_unit - 1) + 1;
+    l->lowest = lowest;
+    l->highest = highest;
+    l->digits = (int)digits;
+    l->unit_magnitude = log2_floor((uint64_t)lowest);
+    l->half_count_magnitude = sub_bucket_count_magnitude - 1;
+    l->half_count = (lua_Integer)1 << l->half_count_magnitude;
+    if (l->unit_magnitude + sub_bucket_count_magnitude > 62) return false;
+    l->sub_bucket_mask = ((l->half_count << 1) - 1) << l->unit_magnitude;
+
+    // the number of buckets needed to cover the highest value
+    int bucket_count = 1;
+    uint64_t smallest_untrackable = (uint64_t)(l->half_count << 1) << l->unit_magnitude;
+    while (smallest_untrackable <= (uint64_t)highest)
+    {
+        if (smallest_untrackable > (uint64_t)LUA_MAXINTEGER / 2)
+        {
+            bucket_count++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        bucket_count++;
+    }
+    l->counts_len = (int)((bucket_count + 1) * l->half_count);
+    return true;
+}
+
+static bool layout_equal(const layout_t *a, const layout_t *b)
+{
+    return a->lowest == b->lowest && a->highest == b->highest && a->digits == b->digits;
+}
+
+// Returns the index of the counts of `value`, or -1 if it is out of range.
+static int counts_index(const layout_t *l, lua_Integer value)
+{
+    if (value < 0) return -1;
+    int pow2_ceiling = log2_floor((uint64_t)value | (uint64_t)l->sub_bucket_mask) + 1;
+    int bucket = pow2_ceiling - l->unit_magnitude - (l->half_count_magnitude + 1);
+    lua_Integer sub_bucket = value >> (bucket + l->unit_magnitude);
+    lua_Integer index = ((lua_Integer)(bucket + 1) << l->half_count_magnitude) + (sub_bucket - l->half_count);
+    return index < l->counts_len ? (int)index : -1;
+}
+
+// Returns the lowest value counted at `index`, and in `size` the number of values counted there.
+static lua_Integer value_at_index(const layout_t *l, int index, lua_Integer *size)
+{
+    int bucket = (index >> l->half_count_magnitude) - 1;
+    lua_Integer sub_bucket = (index & (l->half_count - 1)) + l->half_count;
+    if (bucket < 0)
+    {
+        sub_bucket -= l->half_count;
+        bucket = 0;
+    }
+    *size = (lua_Integer)1 << (bucket + l->unit_magnitude);
+    return sub_bucket << (bucket + l->unit_magnitude);
+}
+
+static histogram_t *new_histogram(lua_State *L, const layout_t *layout)
+{
+    size_t size = sizeof(histogram_t) + (size_t)layout->counts_len * sizeof(lua_Integer);
+    histogram_t *h = (histogram_t *)lua_newuserdatauv(L, size, 0);
+    memset(h, 0, size);
+    h->layout = *layout;
+    h->min = LUA_MAXINTEGER;
+    luaL_setmetatable(L, HistogramMetatableName);
+    return h;
+}
+
+static histogram_t *check_histogram(lua_State *L, int arg)
+{
+    return (histogram_t *)luaL_checkudata(L, arg, HistogramMetatableName);
+}
+
+// Raises an error if adding `count` values would overflow the number of values recorded, which
+// bounds the count of every sub-bucket.
+static void check_total(lua_State *L, const histogram_t *h, lua_Integer count)
+{
+    if (count > LUA_MAXINTEGER - h->total) luaL_error(L, "too many values recorded");
+}
+
+static bool record(histogram_t *h, lua_Integer value, lua_Integer count)
+{
+    int index = counts_index(&h->layout, value);
+    if (index < 0) return false;
+    if (count == 0) return true;
+    h->counts[index] += count;
+    h->total += count;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    return true;
+}
+
+// Returns the value at a percentile, clamped to the values recorded.
+static lua_Integer value_at_percentile(const histogram_t *h, lua_Number percentile)
+{
+    if (h->total == 0) return 0;
+    if (percentile == 0) return h->min;
+    lua_Integer rank = (lua_Integer)(percentile / 100.0 * (lua_Number)h->total + 0.5);
+    if (rank < 1) rank = 1;
+    lua_Integer seen = 0;
+    for (int i = 0; i < h->layout.counts_len; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            lua_Integer size;
+            lua_Integer value = value_at_index(&h->layout, i, &size) + size - 1;
+            if (value < h->min) return h->min;
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+/***
+ * @type Histogram
+ */
+
+/***
+ * Records a value.
+ * @function record
+ * @tparam integer value the value, from 0 to the highest value of the histogram.
+ * @tparam[opt=1] integer count the number of times the value is recorded.
+ * @treturn boolean `true` if the value was recorded; `false` if it is out of range.
+ * @raise If the number of values recorded would overflow an integer.
+ */
+static int histogram_histogram_record(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_Integer value = luaL_checkinteger(L, 2);
+    lua_Integer count = luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, count >= 0, 3, "count out of range");
+    check_total(L, h, count);
+    lua_pushboolean(L, record(h, value, count));
+    return 1;
+}
+
+/***
+ * Records the time elapsed since an instant of the monotonic clock.
+ * @function record_since
+ * @tparam integer start the instant, as a value of @{std.time.monotonic_ns}.
+ * @treturn boolean `true` if the time was recorded; `false` if it is out of range; `nil` if the clock
+ * failed.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @raise If the number of values recorded would overflow an integer.
+ */
+static int histogram_histogram_record_since(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_Integer start = luaL_checkinteger(L, 2);
+    lua_Integer now;
+    if (timeL_monotonic_time(&now))
+    {
+        check_total(L, h, 1);
+        lua_pushboolean(L, record(h, now - start, 1));
+        return 1;
+    }
+    _STD_RETURN_NIL_ERROR
+}
+
+/***
+ * Returns the number of values recorded.
+ * @function count
+ * @treturn integer the number of values.
+ */
+static int histogram_histogram_count(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_pushinteger(L, h->total);
+    return 1;
+}
+
+/***
+ * Returns the lowest value recorded.
+ * @function min
+ * @treturn integer the lowest value, or 0 if no value was recorded.
+ */
+static int histogram_histogram_min(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_pushinteger(L, h->total > 0 ? h->min : 0);
+    return 1;
+}
+
+/***
+ * Returns the highest value recorded.
+ * @function max
+ * @treturn integer the highest value, or 0 if no value was recorded.
+ */
+static int histogram_histogram_max(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_pushinteger(L, h->max);
+    return 1;
+}
+
+// Returns the mean of the values, counted at the middles of their sub-buckets.
+static lua_Number mean_of(const histogram_t *h)
+{
+    if (h->total == 0) return 0;
+    lua_Number sum = 0;
+    for (int i = 0; i < h->layout.counts_len; i++)
+    {
+        if (h->counts[i] == 0) continue;
+        lua_Integer size;
+        lua_Integer value = value_at_index(&h->layout, i, &size);
+        sum += (lua_Number)(value + size / 2) * (lua_Number)h->counts[i];
+    }
+    return sum / (lua_Number)h->total;
+}
+
+/***
+ * Returns the mean of the values recorded, computed from the middles of their sub-buckets.
+ * @function mean
+ * @treturn number the mean, or 0 if no value was recorded.
+ */
+static int histogram_histogram_mean(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_pushnumber(L, mean_of(h));
+    return 1;
+}
+
+/***
+ * Returns the standard deviation of the values recorded, computed from the middles of their
+ * sub-buckets.
+ * @function stddev
+ * @treturn number the standard deviation, or 0 if no value was recorded.
+ */
+static int histogram_histogram_stddev(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    lua_Number mean = mean_of(h);
+    lua_Number squares = 0;
+    for (int i = 0; i < h->layout.counts_len; i++)
+    {
+        if (h->counts[i] == 0) continue;
+        lua_Integer size;
+        lua_Number deviation = (lua_Number)(value_at_index(&h->layout, i, &size) + size / 2) - mean;
+        squares += deviation * deviation * (lua_Number)h->counts[i];
+    }
+    lua_pushnumber(L, h->total > 0 ? sqrt(squares / (lua_Number)h->total) : 0);
+    return 1;
+}
+
+/***
+ * Returns the values at some percentiles: the highest values equivalent to the values under
+ * which the percentiles of the values recorded fall.
+ * @function percentile
+ * @tparam number ... the percentiles, from 0 to 100.
+ * @treturn integer... the value at each percentile, or 0 if no value was recorded.
+ * @usage
+ * local p50, p99, p999 = h:percentile(50, 99, 99.9)
+ */
+static int histogram_histogram_percentile(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    int n = lua_gettop(L) - 1;
+    luaL_argcheck(L, n > 0, 2, "percentile expected");
+    luaL_checkstack(L, n, "too many percentiles");
+    for (int arg = 2; arg <= n + 1; arg++)
+    {
+        lua_Number percentile = luaL_checknumber(L, arg);
+        luaL_argcheck(L, percentile >= 0 && percentile <= 100, arg, "percentile out of range");
+        lua_pushinteger(L, value_at_percentile(h, percentile));
+    }
+    return n;
+}
+
+/***
+ * Adds the values of another histogram.
+ *
+ * The counts of a histogram of the same range and precision are added as they are; the values of
+ * another histogram are recorded at the lowest values of their sub-buckets.
+ *
+ * @function merge
+ * @tparam Histogram other the histogram to add.
+ * @treturn integer the number of values dropped because they are out of range.
+ * @raise If the number of values recorded would overflow an integer.
+ */
+static int histogram_histogram_merge(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    histogram_t *other = check_histogram(L, 2);
+    check_total(L, h, other->total);
+    lua_Integer dropped = 0;
+    if (other->total == 0)
+    {
+        // nothing to add
+    }
+    else if (layout_equal(&h->layout, &other->layout))
+    {
+        for (int i = 0; i < h->layout.counts_len; i++)
+        {
+            h->counts[i] += other->counts[i];
+        }
+        h->total += other->total;
+        if (other->min < h->min) h->min = other->min;
+        if (other->max > h->max) h->max = other->max;
+    }
+    else
+    {
+        for (int i = 0; i < other->layout.counts_len; i++)
+        {
+            lua_Integer count = other->counts[i];
+            if (count == 0) continue;
+            lua_Integer size;
+            if (!record(h, value_at_index(&other->layout, i, &size), count)) dropped += count;
+        }
+    }
+    lua_pushinteger(L, dropped);
+    return 1;
+}
+
+/***
+ * Discards the values recorded.
+ * @function reset
+ */
+static int histogram_histogram_reset(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    memset(h->counts, 0, (size_t)h->layout.counts_len * sizeof(lua_Integer));
+    h->total = h->max = 0;
+    h->min = LUA_MAXINTEGER;
+    return 0;
+}
+
+static void add_varint(luaL_Buffer *b, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        luaL_addchar(b, (char)(value | 0x80));
+        value >>= 7;
+    }
+    luaL_addchar(b, (char)value);
+}
+
+// Reads a varint at `*p`, returning false if it is truncated or too long.
+static bool read_varint(const unsigned char **p, const unsigned char *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7)
+    {
+        unsigned char c = *(*p)++;
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+/***
+ * Serializes the histogram.
+ *
+ * The counts are encoded as in the payload of the V2 format of HdrHistogram, as zig-zag LEB128
+ * integers where the runs of empty sub-buckets are written as negative counts, after a header
+ * holding the range and the precision.
+ *
+ * @function encode
+ * @treturn string the binary encoding, to be read by @{decode}.
+ */
+static int histogram_histogram_encode(lua_State *L)
+{
+    histogram_t *h = check_histogram(L, 1);
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    luaL_addlstring(&b, ENCODING_MAGIC, ENCODING_MAGIC_LEN);
+    add_varint(&b, (uint64_t)h->layout.digits);
+    add_varint(&b, (uint64_t)h->layout.lowest);
+    add_varint(&b, (uint64_t)h->layout.highest);
+    add_varint(&b, (uint64_t)h->min);
+    add_varint(&b, (uint64_t)h->max);
+    lua_Integer zeros = 0;
+    for (int i = 0; i < h->layout.counts_len; i++)
+    {
+        lua_Integer count = h->counts[i];
+        if (count == 0)
+        {
+            zeros++;
+            continue;
+        }
+        if (zeros > 0)
+        {
+            add_varint(&b, ((uint64_t)zeros << 1) - 1); // zig-zag of -zeros
+            zeros = 0;
+        }
+        add_varint(&b, (uint64_t)count << 1);
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+/*** @section end */
+
+/***
+ * Creates a histogram.
+ *
+ * The following options are supported:
+ *
+ * - `lowest` (integer): the lowest value discernible from 0, the unit of the sub-buckets.
+ *   Defaults to 1.
+ * - `highest` (integer): the highest value to record, at least twice the lowest one. Defaults
+ *   to 1 hour in nanoseconds.
+ * - `digits` (integer): the number of significant decimal digits kept for each value, from 1 to 5.
+ *   Defaults to 3.
+ *
+ * The memory of the histogram grows with the logarithm of the ratio of the highest value to the
+ * lowest one, and with 10 to the power of its digits: about 270 kB with the defaults.
+ *
+ * @function new
+ * @tparam[opt] table opts the options of the histogram.
+ * @treturn Histogram the new histogram.
+ * @raise If an option is not valid.
+ */
+static int histogram_new(lua_State *L)
+{
+    lua_Integer lowest = DEFAULT_LOWEST;
+    lua_Integer highest = DEFAULT_HIGHEST;
+    lua_Integer digits = DEFAULT_DIGITS;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "lowest");
+        lowest = luaL_optinteger(L, -1, lowest);
+        lua_getfield(L, 1, "highest");
+        highest = luaL_optinteger(L, -1, highest);
+        lua_getfield(L, 1, "digits");
+        digits = luaL_optinteger(L, -1, digits);
+        lua_pop(L, 3);
+        luaL_argcheck(L, lowest >= 1, 1, "lowest out of range");
+        luaL_argcheck(L, highest >= 2 * lowest, 1, "highest out of range");
+        luaL_argcheck(L, digits >= 1 && digits <= MAX_DIGITS, 1, "digits out of range");
+    }
+    layout_t layout;
+    luaL_argcheck(L, layout_init(&layout, lowest, highest, digits), 1, "lowest out of range");
+    new_histogram(L, &layout);
+    return 1;
+}
+
+// Reads the counts encoded at `p`, returning false if they are not valid for `layout` or do not
+// match the lowest and highest values. The counts are only validated if `counts` is NULL.
+static bool decode_counts(const layout_t *layout, const unsigned char *p, const unsigned char *end, uint64_t min,
+                          uint64_t max, lua_Integer *counts, lua_Integer *total)
+{
+    lua_Integer index = 0;
+    int first = -1, last = -1;
+    *total = 0;
+    while (p < end)
+    {
+        uint64_t zigzag;
+        if (!read_varint(&p, end, &zigzag)) return false;
+        if (zigzag & 1)
+        {
+            // a run of empty sub-buckets
+            if ((zigzag >> 1) >= (uint64_t)(layout->counts_len - index)) return false;
+            index += (lua_Integer)(zigzag >> 1) + 1;
+            continue;
+        }
+        lua_Integer count = (lua_Integer)(zigzag >> 1);
+        if (index >= layout->counts_len || count > LUA_MAXINTEGER - *total) return false;
+        if (count > 0)
+        {
+            if (first < 0) first = (int)index;
+            last = (int)index;
+        }
+        if (counts != NULL) counts[index] = count;
+        index++;
+        *total += count;
+    }
+    if (*total == 0) return true;
+    return min <= max && max <= (uint64_t)LUA_MAXINTEGER && counts_index(layout, (lua_Integer)min) == first &&
+           counts_index(layout, (lua_Integer)max) == last;
+}
+
+/***
+ * Deserializes a histogram.
+ *
+ * The encoding is validated before the histogram is allocated, so that a string which is not an
+ * encoding never allocates its counts.
+ *
+ * @function decode
+ * @tparam string s the encoding of a histogram, as returned by @{Histogram:encode}.
+ * @treturn Histogram the histogram.
+ * @raise If `s` is not a valid encoding.
+ */
+static int histogram_decode(lua_State *L)
+{
+    size_t len;
+    const unsigned char *p = (const unsigned char *)luaL_checklstring(L, 1, &len);
+    const unsigned char *end = p + len;
+    uint64_t digits, lowest, highest, min = 0, max = 0;
+    layout_t layout;
+    lua_Integer total;
+    bool valid = len >= ENCODING_MAGIC_LEN && memcmp(p, ENCODING_MAGIC, ENCODING_MAGIC_LEN) == 0;
+    p += ENCODING_MAGIC_LEN;
+    valid = valid && read_varint(&p, end, &digits) && read_varint(&p, end, &lowest) &&
+            read_varint(&p, end, &highest) && read_varint(&p, end, &min) && read_varint(&p, end, &max) &&
+            digits <= MAX_DIGITS && highest <= (uint64_t)LUA_MAXINTEGER &&
+            layout_init(&layout, (lua_Integer)lowest, (lua_Integer)highest, (lua_Integer)digits) &&
+            decode_counts(&layout, p, end, min, max, NULL, &total);
+    luaL_argcheck(L, valid, 1, "invalid histogram");
+
+    histogram_t *h = new_histogram(L, &layout);
+    decode_counts(&layout, p, end, min, max, h->counts, &h->total);
+    if (h->total > 0)
+    {
+        h->min = (lua_Integer)min;
+        h->max = (lua_Integer)max;
+    }
+    return 1;
+}
+
+static void create_histogram_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg histogram_funcs[] = {
+#define XX(name) {#name, histogram_histogram_##name},
+        XX(count)
+        XX(encode)
+        XX(max)
+        XX(mean)
+        XX(merge)
+        XX(min)
+        XX(percentile)
+        XX(record)
+        XX(record_since)
+        XX(reset)
+        XX(stddev)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg histogram_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, HistogramMetatableName); // mt
+    luaL_setfuncs(L, histogram_meta_methods, 0);  // mt
+    luaL_newlibtable(L, histogram_funcs);         // mt t
+    luaL_setfuncs(L, histogram_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");               // mt
+    lua_pop(L, 1);                                //
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "decode", histogram_decode },
+    { "new", histogram_new },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_histogram(lua_State *L)
+{
+    create_histogram_metatable(L);
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
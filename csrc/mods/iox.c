@@ -0,0 +1,492 @@
+/***
+ * @module std.iox
+ */
+#include "std.h"
+#include "libfs.h"
+#include "libsyserror.h"
+#include "libutil.h"
+
+#include <lauxlib.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LinesMetatableName "std.iox.lines"
+#define WriterMetatableName "std.iox.writer"
+
+#define DEFAULT_CHUNK_SIZE (1 << 20)
+#define MAX_CHUNK_SIZE (1 << 30)
+
+#define DEFAULT_HIGH_WATER_MARK (1 << 20)
+#define MAX_HIGH_WATER_MARK (1 << 30)
+// the most buffers gathered by a single write
+#define MAX_BUFFERS 1024
+// the strings up to this length are copied together instead of being gathered one by one
+#define MAX_COPIED_LENGTH 256
+#define COPY_BUFFER_SIZE (64 * 1024)
+// the most slots preallocated for a batch of lines, which grows past them as needed
+#define MAX_PREALLOCATED_BATCH 4096
+
+typedef struct
+{
+    FILE *fp;
+    char *buf;   // the buffer, kept alive by the first uservalue
+    size_t cap;  // the size of the buffer
+    size_t head; // the start of the first line not returned yet
+    size_t scan; // where to resume the search of the next newline
+    size_t tail; // the end of the bytes read
+    lua_Integer batch;
+    bool crlf;
+    bool eof;
+} lines_t;
+
+static lines_t *check_lines(lua_State *L, int arg)
+{
+    lines_t *lines = (lines_t *)luaL_checkudata(L, arg, LinesMetatableName);
+    if (lines->fp == NULL) luaL_error(L, "attempt to use a closed file");
+    return lines;
+}
+
+static int lines_close(lua_State *L)
+{
+    lines_t *lines = (lines_t *)luaL_checkudata(L, 1, LinesMetatableName);
+    if (lines->fp != NULL)
+    {
+        fclose(lines->fp);
+        lines->fp = NULL;
+    }
+    return 0;
+}
+
+// Moves the partial line at the end of the buffer to its start, growing the buffer if the line
+// fills it, and reads the next chunk after it; raises if the read fails.
+static void lines_fill(lua_State *L, lines_t *lines, int arg)
+{
+    size_t partial = lines->tail - lines->head;
+    if (partial == lines->cap)
+    {
+        if (lines->cap > MAX_CHUNK_SIZE) luaL_error(L, "line too long");
+        char *buf = (char *)lua_newuserdatauv(L, lines->cap * 2, 0);
+        memcpy(buf, lines->buf + lines->head, partial);
+        lua_setiuservalue(L, arg, 1);
+        lines->buf = buf;
+        lines->cap *= 2;
+    }
+    else if (lines->head > 0)
+    {
+        memmove(lines->buf, lines->buf + lines->head, partial);
+    }
+    lines->scan -= lines->head;
+    lines->head = 0;
+    lines->tail = partial;
+
+    size_t n = fread(lines->buf + lines->tail, 1, lines->cap - lines->tail, lines->fp);
+    if (n == 0)
+    {
+        if (ferror(lines->fp)) syserrL_last_error(L);
+        lines->eof = true;
+    }
+    lines->tail += n;
+}
+
+// Pushes the next line, without the end-of-line characters; returns false at the end of the file.
+static bool lines_push_next(lua_State *L, lines_t *lines, int arg)
+{
+    for (;;)
+    {
+        const char *nl = (const char *)memchr(lines->buf + lines->scan, '\n', lines->tail - lines->scan);
+        if (nl != NULL)
+        {
+            const char *start = lines->buf + lines->head;
+            size_t len = (size_t)(nl - start);
+            if (lines->crlf && len > 0 && start[len - 1] == '\r') len--;
+            lua_pushlstring(L, start, len);
+            lines->head = lines->scan = (size_t)(nl - lines->buf) + 1;
+            return true;
+        }
+        lines->scan = lines->tail;
+        if (lines->eof)
+        {
+            if (lines->head == lines->tail) return false;
+            lua_pushlstring(L, lines->buf + lines->head, lines->tail - lines->head);
+            lines->head = lines->scan = lines->tail;
+            return true;
+        }
+        lines_fill(L, lines, arg);
+    }
+}
+
+static int lines_next(lua_State *L)
+{
+    lines_t *lines = check_lines(L, 1);
+    if (lines->batch == 0)
+    {
+        return lines_push_next(L, lines, 1) ? 1 : 0;
+    }
+
+    lua_createtable(L, lines->batch < MAX_PREALLOCATED_BATCH ? (int)lines->batch : MAX_PREALLOCATED_BATCH, 0);
+    lua_Integer n = 0;
+    while (n < lines->batch && lines_push_next(L, lines, 1))
+    {
+        lua_rawseti(L, -2, ++n);
+    }
+    if (n == 0) return 0;
+    lua_pushinteger(L, n);
+    return 2;
+}
+
+static void create_lines_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg lines_meta_methods[] = {
+        {"__gc", lines_close},
+        {"__close", lines_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, LinesMetatableName); // mt
+    luaL_setfuncs(L, lines_meta_methods, 0);  // mt
+    lua_pop(L, 1);                            //
+}
+
+static lua_Integer opt_integer_field(lua_State *L, int arg, const char *name, lua_Integer def, lua_Integer max)
+{
+    lua_Integer value = def;
+    if (lua_getfield(L, arg, name) != LUA_TNIL)
+    {
+        value = luaL_checkinteger(L, -1);
+        luaL_argcheck(L, value > 0 && value <= max, arg, lua_pushfstring(L, "%s out of range", name));
+    }
+    lua_pop(L, 1);
+    return value;
+}
+
+static bool opt_boolean_field(lua_State *L, int arg, const char *name, bool def)
+{
+    bool value = def;
+    if (lua_getfield(L, arg, name) != LUA_TNIL)
+    {
+        luaL_checktype(L, -1, LUA_TBOOLEAN);
+        value = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+    return value;
+}
+
+/***
+ * Opens a file and returns an iterator over its lines, reading the file in large chunks.
+ *
+ * The lines are returned without the end-of-line characters, like `io.lines`; a last line not
+ * terminated by a newline is returned as well. The file is read a chunk at a time and the
+ * newlines are found with `memchr`, so each line costs only the creation of its string; a line
+ * longer than a chunk grows the buffer as needed. The file is closed when the iteration ends, or
+ * when the loop is exited, since the iterator is also its closing value.
+ *
+ * The following options are supported:
+ *
+ * - `chunk` (integer): the number of bytes read at a time. Defaults to 1 MiB.
+ * - `batch` (integer): if set, each step of the iteration returns an array of up to `batch`
+ *   lines and the number of lines in it, instead of a single line.
+ * - `crlf` (boolean): whether to remove also a carriage return before a newline. Defaults to `true`.
+ *
+ * @usage
+ * for line in iox.lines_chunked('server.log') do
+ *   if line:find('ERROR', 1, true) then print(line) end
+ * end
+ *
+ * for lines, n in iox.lines_chunked('data.csv', {batch = 1024}) do
+ *   for i = 1, n do consume(lines[i]) end
+ * end
+ *
+ * @function lines_chunked
+ * @tparam string filename the name of the file to read.
+ * @tparam[opt] table opts the options of the iteration.
+ * @treturn function an iterator returning the lines of the file if the function succeeded; otherwise `nil`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @raise If `filename` is `nil`, if an option is not valid, or if reading the file fails.
+ */
+static int iox_lines_chunked(lua_State *L)
+{
+    _CHECKLSTRING(filename, 1)
+    lua_Integer chunk = DEFAULT_CHUNK_SIZE;
+    lua_Integer batch = 0;
+    bool crlf = true;
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        chunk = opt_integer_field(L, 2, "chunk", chunk, MAX_CHUNK_SIZE);
+        batch = opt_integer_field(L, 2, "batch", batch, INT_MAX);
+        crlf = opt_boolean_field(L, 2, "crlf", crlf);
+    }
+
+    lines_t *lines = (lines_t *)lua_newuserdatauv(L, sizeof(lines_t), 1);
+    lines->fp = NULL;
+    luaL_setmetatable(L, LinesMetatableName);
+    lines->buf = (char *)lua_newuserdatauv(L, (size_t)chunk, 0);
+    lua_setiuservalue(L, -2, 1);
+    lines->cap = (size_t)chunk;
+    lines->head = lines->scan = lines->tail = 0;
+    lines->batch = batch;
+    lines->crlf = crlf;
+    lines->eof = false;
+
+    lines->fp = fopen(filename, "rb");
+    if (lines->fp == NULL)
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+    // the chunks are read straight into the buffer
+    setvbuf(lines->fp, NULL, _IONBF, 0);
+
+    lua_pushcfunction(L, lines_next);
+    lua_insert(L, -2);
+    lua_pushnil(L);
+    lua_pushvalue(L, -2);
+    return 4;
+}
+
+typedef struct
+{
+    fs_writer_t *w;
+    char copies[COPY_BUFFER_SIZE]; // the short strings gathered
+} writer_t;
+
+typedef struct
+{
+    writer_t *writer;
+    int anchors;    // the stack index of the table keeping alive the strings converted from numbers
+    size_t hwm;     // the number of bytes gathered before writing them
+    size_t count;   // the number of buffers gathered
+    size_t pending; // the number of bytes gathered
+    size_t copied;  // the number of bytes in the copy buffer of the writer
+    fs_buffer_t bufs[MAX_BUFFERS];
+} gather_t;
+
+static int writer_gc(lua_State *L)
+{
+    writer_t *writer = (writer_t *)luaL_checkudata(L, 1, WriterMetatableName);
+    if (writer->w != NULL)
+    {
+        fsL_writer_close(L, writer->w, false);
+        writer->w = NULL;
+    }
+    return 0;
+}
+
+static void create_writer_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg writer_meta_methods[] = {
+        {"__gc", writer_gc},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, WriterMetatableName); // mt
+    luaL_setfuncs(L, writer_meta_methods, 0);  // mt
+    lua_pop(L, 1);                             //
+}
+
+// Pushes a writer for `filename` configured by the options at `arg`; returns NULL, with the
+// error as the last error, if the file cannot be created.
+static writer_t *push_writer(lua_State *L, const char *filename, int arg, size_t *hwm)
+{
+    static const char *const syncs[] = {"none", "data", "direct", NULL};
+    lua_Integer mark = DEFAULT_HIGH_WATER_MARK;
+    int sync = FS_SYNC_NONE;
+    bool atomic = false;
+    if (!lua_isnoneornil(L, arg))
+    {
+        luaL_checktype(L, arg, LUA_TTABLE);
+        mark = opt_integer_field(L, arg, "hwm", mark, MAX_HIGH_WATER_MARK);
+        lua_getfield(L, arg, "sync");
+        sync = luaL_checkoption(L, -1, "none", syncs);
+        lua_pop(L, 1);
+        atomic = opt_boolean_field(L, arg, "atomic", atomic);
+    }
+    *hwm = (size_t)mark;
+
+    writer_t *writer = (writer_t *)lua_newuserdatauv(L, sizeof(writer_t), 0);
+    writer->w = NULL;
+    luaL_setmetatable(L, WriterMetatableName);
+    writer->w = fsL_writer_open(L, filename, sync, atomic);
+    return writer->w != NULL ? writer : NULL;
+}
+
+static bool gather_flush(lua_State *L, gather_t *g)
+{
+    bool ok = g->count == 0 || fsL_writer_write(g->writer->w, g->bufs, g->count);
+    g->count = 0;
+    g->pending = 0;
+    g->copied = 0;
+    if (g->anchors != 0)
+    {
+        lua_newtable(L);
+        lua_replace(L, g->anchors);
+    }
+    return ok;
+}
+
+static bool gather_add(lua_State *L, gather_t *g, const char *data, size_t len)
+{
+    if (len == 0) return true;
+    if (len <= MAX_COPIED_LENGTH)
+    {
+        // a syscall gathering many tiny buffers is slower than copying them
+        if (g->copied + len > COPY_BUFFER_SIZE && !gather_flush(L, g)) return false;
+        char *copy = g->writer->copies + g->copied;
+        memcpy(copy, data, len);
+        g->copied += len;
+        g->pending += len;
+        fs_buffer_t *last = g->count > 0 ? &g->bufs[g->count - 1] : NULL;
+        if (last != NULL && last->data + last->len == copy)
+        {
+            last->len += len;
+            return g->pending < g->hwm || gather_flush(L, g);
+        }
+        data = copy;
+    }
+    else
+    {
+        g->pending += len;
+    }
+    g->bufs[g->count].data = data;
+    g->bufs[g->count].len = len;
+    g->count++;
+    return (g->count < MAX_BUFFERS && g->pending < g->hwm) || gather_flush(L, g);
+}
+
+// Closes the writer of `g`, committing the file if `ok`; returns `ok` and the result of the close.
+static bool gather_close(lua_State *L, gather_t *g, bool ok)
+{
+    ok = ok && gather_flush(L, g);
+    fs_writer_t *w = g->writer->w;
+    g->writer->w = NULL;
+    return fsL_writer_close(L, w, ok) && ok;
+}
+
+/***
+ * Creates a new file, writes one or more strings to the file, each followed by a newline, and then
+ * closes the file.
+ *
+ * The strings are gathered, with their newlines, in vectored writes of up to `hwm` bytes: the
+ * long strings are written in place, while the short ones are first copied together, since
+ * the system is slower at gathering many tiny buffers than at copying them.
+ *
+ * The following options are supported:
+ *
+ * - `hwm` (integer): the number of bytes gathered before writing them. Defaults to 1 MiB.
+ * - `sync` (string): `"none"` to leave the data in the system cache, `"data"` to flush the data
+ *   to the device before closing the file, or `"direct"` to bypass the system cache too, where
+ *   the file system supports it. Defaults to `"none"`.
+ * - `atomic` (boolean): whether to write a temporary file next to `filename`, which replaces
+ *   `filename` only once it is complete, with its owner and permissions. A symbolic link is
+ *   replaced by a regular file. Defaults to `false`.
+ *
+ * @usage
+ * assert(iox.write_lines('report.csv', rows, {atomic = true, sync = 'data'}))
+ *
+ * @function write_lines
+ * @tparam string filename the name of the file to write to.
+ * @tparam table lines the lines to write to the file; the numbers are converted to strings.
+ * @tparam[opt] table opts the options of the write.
+ * @treturn boolean `true` if the function succeeded, otherwise `false`.
+ * @treturn string err `nil` if the function succeeded, otherwise an error message describing why the function failed.
+ * @raise If `filename` or `lines` are `nil`, if an option is not valid, or if a line is neither a string nor a
+ * number.
+ * @remark Without `atomic`, a failed write leaves the file partially written.
+ */
+static int iox_write_lines(lua_State *L)
+{
+    _CHECKLSTRING(filename, 1)
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 3);
+    lua_Integer n = luaL_len(L, 2);
+
+    gather_t g = {.anchors = 4, .count = 0, .pending = 0, .copied = 0};
+    lua_newtable(L); // anchors
+    g.writer = push_writer(L, filename, 3, &g.hwm);
+    if (g.writer == NULL)
+    {
+        lua_pushboolean(L, 0);
+        syserrL_pushlasterror(L);
+        return 2;
+    }
+
+    bool ok = true;
+    for (lua_Integer i = 1; ok && i <= n; i++)
+    {
+        size_t len;
+        const char *line;
+        switch (lua_rawgeti(L, 2, i))
+        {
+            case LUA_TSTRING:
+                // kept alive by the table
+                line = lua_tolstring(L, -1, &len);
+                lua_pop(L, 1);
+                break;
+            case LUA_TNUMBER:
+                line = lua_tolstring(L, -1, &len);
+                lua_rawseti(L, g.anchors, (lua_Integer)lua_rawlen(L, g.anchors) + 1);
+                break;
+            default:
+                gather_close(L, &g, false);
+                return luaL_error(L, "bad line #%I (string expected, got %s)", i, luaL_typename(L, -1));
+        }
+        ok = gather_add(L, &g, line, len) && gather_add(L, &g, "\n", 1);
+    }
+    _STD_RETURN_OK_ERROR(gather_close(L, &g, ok))
+}
+
+/***
+ * Creates a new file, write the contents to the file, and then closes the file.
+ *
+ * The options are those of @{write_lines}.
+ *
+ * @function write_all
+ * @tparam string filename the name of the file to write to.
+ * @tparam string content the content to write to the file.
+ * @tparam[opt] table opts the options of the write.
+ * @treturn boolean `true` if the function succeeded, otherwise `false`.
+ * @treturn string err `nil` if the function succeeded, otherwise an error message describing why the function failed.
+ * @raise If `filename` or `content` are `nil`, or if an option is not valid.
+ */
+static int iox_write_all(lua_State *L)
+{
+    _CHECKLSTRING(filename, 1)
+    _CHECKLSTRING(content, 2)
+    lua_settop(L, 3);
+
+    gather_t g = {.anchors = 0, .count = 0, .pending = 0, .copied = 0};
+    g.writer = push_writer(L, filename, 3, &g.hwm);
+    if (g.writer == NULL)
+    {
+        lua_pushboolean(L, 0);
+        syserrL_pushlasterror(L);
+        return 2;
+    }
+    bool ok = gather_add(L, &g, content, content_len);
+    _STD_RETURN_OK_ERROR(gather_close(L, &g, ok))
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "lines_chunked", iox_lines_chunked },
+    { "write_all", iox_write_all },
+    { "write_lines", iox_write_lines },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_iox_native(lua_State *L)
+{
+    create_lines_metatable(L);
+    create_writer_metatable(L);
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
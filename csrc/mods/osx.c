@@ -0,0 +1,37 @@
+/***
+ * Native support of @{std.osx}.
+ * @module std.osx.native
+ */
+#include "std.h"
+
+#include <lauxlib.h>
+
+#if defined(_STD_UNIX)
+#include "osx_unix.c"
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "spawn", osx_spawn },
+    { NULL, NULL }
+};
+// clang-format on
+#else
+// the commands are run by the shell
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { NULL, NULL }
+};
+// clang-format on
+#endif
+
+_STD_EXTERN int luaopen_std_osx_native(lua_State *L)
+{
+#if defined(_STD_UNIX)
+    create_spawner_metatable(L);
+#endif
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
@@ -0,0 +1,668 @@
+#include "libsyserror.h"
+#include "libtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(_STD_LINUX)
+#include <sys/syscall.h>
+#endif
+
+extern char **environ;
+
+#define SpawnerMetatableName "std.osx.spawner"
+
+#define CHUNK_SIZE 65536
+#define MAX_CONCURRENCY 1024
+#define MAX_TIMEOUT (LUA_MAXINTEGER / NANOS_PER_MILLI / 2)
+#define MIN_WAIT_MILLIS 1
+#define MAX_WAIT_MILLIS 16
+#define DEFAULT_PATH "/bin:/usr/bin" // the PATH of execvp when it is not set
+
+#if defined(_STD_LINUX) && defined(SYS_pidfd_open)
+#define HAVE_PIDFD
+#endif
+
+#if defined(_STD_APPLE) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define HAVE_ADDCHDIR
+#endif
+
+// clang-format off
+static const char *const stream_names[] = {"stdout", "stderr"};
+// clang-format on
+
+enum
+{
+    STREAM_STDOUT,
+    STREAM_STDERR,
+    STREAM_COUNT,
+    POLLS_PER_CHILD = STREAM_COUNT + 1 // the pipes and the pidfd
+};
+
+enum
+{
+    OUTPUT_CAPTURE,
+    OUTPUT_INHERIT,
+    OUTPUT_CALLBACK
+};
+
+typedef struct
+{
+    pid_t pid;   // 0 if the slot is free
+    int command; // the index of the command in the list
+    int fds[STREAM_COUNT];
+    int pidfd; // polled for the exit along with the pipes, or -1
+    int modes[STREAM_COUNT];
+    lua_Integer deadline; // in nanoseconds of the monotonic clock, or 0
+    bool timed_out;
+    bool exited;     // the pidfd is readable
+    int wait_millis; // the interval between the checks of the exit, without pidfd
+} child_t;
+
+// The children running, killed and reaped when the spawner is closed by an error.
+typedef struct
+{
+    int size;
+    struct pollfd *polls;
+    int *owners; // the child and the stream of each poll, as child * POLLS_PER_CHILD + stream
+    child_t children[];
+} spawner_t;
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static bool make_pipe(int fds[2])
+{
+#if defined(_STD_LINUX)
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+static int spawner_close(lua_State *L)
+{
+    spawner_t *s = (spawner_t *)luaL_checkudata(L, 1, SpawnerMetatableName);
+    for (int i = 0; i < s->size; i++)
+    {
+        child_t *c = &s->children[i];
+        for (int k = 0; k < STREAM_COUNT; k++)
+        {
+            close_fd(&c->fds[k]);
+        }
+        close_fd(&c->pidfd);
+        if (c->pid > 0)
+        {
+            kill(c->pid, SIGKILL);
+            while (waitpid(c->pid, NULL, 0) < 0 && errno == EINTR)
+            {
+            }
+            c->pid = 0;
+        }
+    }
+    return 0;
+}
+
+static _STD_NORETURN void invalid_field(lua_State *L, int i, const char *field)
+{
+    luaL_argerror(L, 1, lua_pushfstring(L, "invalid %s in command %d", field, i));
+    abort(); // unreachable
+}
+
+static int output_mode(lua_State *L, int cmd, int stream)
+{
+    switch (lua_getfield(L, cmd, stream_names[stream]))
+    {
+        case LUA_TNIL:
+            return OUTPUT_CAPTURE;
+        case LUA_TBOOLEAN:
+            return lua_toboolean(L, -1) ? OUTPUT_CAPTURE : OUTPUT_INHERIT;
+        case LUA_TFUNCTION:
+            return OUTPUT_CALLBACK;
+        default:
+            return -1;
+    }
+}
+
+// Checks the commands before any of them is spawned.
+static void check_command(lua_State *L, int i)
+{
+    int top = lua_gettop(L);
+    if (lua_geti(L, 1, i) != LUA_TTABLE) invalid_field(L, i, "table");
+    int cmd = lua_gettop(L);
+
+    if (lua_getfield(L, cmd, "argv") != LUA_TTABLE || luaL_len(L, -1) == 0) invalid_field(L, i, "argv");
+    lua_Integer argc = luaL_len(L, -1);
+    for (lua_Integer k = 1; k <= argc; k++)
+    {
+        if (lua_rawgeti(L, -1, k) != LUA_TSTRING) invalid_field(L, i, "argv");
+        lua_pop(L, 1);
+    }
+
+    int type = lua_getfield(L, cmd, "env");
+    if (type == LUA_TTABLE)
+    {
+        lua_pushnil(L);
+        while (lua_next(L, -2))
+        {
+            type = lua_type(L, -1);
+            if (lua_type(L, -2) != LUA_TSTRING || (type != LUA_TSTRING && !(type == LUA_TBOOLEAN && !lua_toboolean(L, -1))))
+                invalid_field(L, i, "env");
+            lua_pop(L, 1);
+        }
+    }
+    else if (type != LUA_TNIL)
+        invalid_field(L, i, "env");
+
+    type = lua_getfield(L, cmd, "cwd");
+    if (type != LUA_TNIL && type != LUA_TSTRING) invalid_field(L, i, "cwd");
+
+    type = lua_getfield(L, cmd, "timeout");
+    if (type != LUA_TNIL)
+    {
+        int isnum;
+        lua_Integer timeout = lua_tointegerx(L, -1, &isnum);
+        if (!isnum || timeout <= 0 || timeout > MAX_TIMEOUT) invalid_field(L, i, "timeout");
+    }
+
+    for (int k = 0; k < STREAM_COUNT; k++)
+    {
+        if (output_mode(L, cmd, k) < 0) invalid_field(L, i, stream_names[k]);
+    }
+    lua_settop(L, top);
+}
+
+// Pushes the environment of a command: the variables of the process overridden by the table at `env`,
+// as a userdata holding the array and a table anchoring the strings.
+static char **push_environment(lua_State *L, int env)
+{
+    size_t count = 0;
+    for (char **e = environ; *e != NULL; e++)
+    {
+        count++;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, env))
+    {
+        count++;
+        lua_pop(L, 1);
+    }
+
+    char **envp = (char **)lua_newuserdatauv(L, (count + 1) * sizeof(char *), 1); // envp
+    lua_newtable(L);                                                               // envp strings
+    size_t n = 0;
+    for (char **e = environ; *e != NULL; e++)
+    {
+        const char *equal = strchr(*e, '=');
+        if (equal == NULL) continue;
+        lua_pushlstring(L, *e, (size_t)(equal - *e));
+        bool overridden = lua_rawget(L, env) != LUA_TNIL;
+        lua_pop(L, 1);
+        if (!overridden) envp[n++] = *e;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, env))
+    {
+        if (lua_type(L, -1) == LUA_TSTRING)
+        {
+            envp[n++] = (char *)lua_pushfstring(L, "%s=%s", lua_tostring(L, -2), lua_tostring(L, -1));
+            lua_rawseti(L, -4, (lua_Integer)n);
+        }
+        lua_pop(L, 1);
+    }
+    envp[n] = NULL;
+    lua_setiuservalue(L, -2, 1); // envp
+    return envp;
+}
+
+// Pushes the path of the program `name` looked up in the PATH set by the table at `env`, as execvp
+// does in the child, returning the error number if it is not found.
+static int push_program(lua_State *L, int env, const char *name)
+{
+    const char *dirs = (lua_getfield(L, env, "PATH") == LUA_TSTRING) ? lua_tostring(L, -1) : DEFAULT_PATH;
+    int err = ENOENT;
+    for (;;)
+    {
+        const char *end = strchr(dirs, ':');
+        size_t len = end != NULL ? (size_t)(end - dirs) : strlen(dirs);
+        // an empty directory is the working one
+        const char *program = len == 0 ? lua_pushstring(L, name) : lua_pushfstring(L, "%s/%s", lua_pushlstring(L, dirs, len), name);
+        struct stat st;
+        if (stat(program, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            if (access(program, X_OK) == 0) return 0;
+            err = EACCES;
+        }
+        lua_pop(L, len == 0 ? 1 : 2);
+        if (end == NULL) return err;
+        dirs = end + 1;
+    }
+}
+
+// Spawns the command `i` in the child `c`, returning 0 or the error number.
+static int spawn_command(lua_State *L, int i, child_t *c, lua_Integer now)
+{
+    int top = lua_gettop(L);
+    lua_geti(L, 1, i);
+    int cmd = lua_gettop(L);
+
+    lua_getfield(L, cmd, "argv");
+    int argc = (int)luaL_len(L, -1);
+    const char **argv = (const char **)lua_newuserdatauv(L, ((size_t)argc + 1) * sizeof(char *), 0);
+    for (int k = 1; k <= argc; k++)
+    {
+        lua_rawgeti(L, -2, k);
+        argv[k - 1] = lua_tostring(L, -1); // anchored by the command
+        lua_pop(L, 1);
+    }
+    argv[argc] = NULL;
+
+    int err = 0;
+    char **envp = environ;
+    const char *program = NULL; // looked up in the PATH of the process by posix_spawnp if NULL
+    if (lua_getfield(L, cmd, "env") == LUA_TTABLE)
+    {
+        int env = lua_gettop(L);
+        envp = push_environment(L, env);
+        lua_pushliteral(L, "PATH");
+        bool sets_path = lua_rawget(L, env) != LUA_TNIL;
+        lua_pop(L, 1);
+        if (sets_path && strchr(argv[0], '/') == NULL)
+        {
+            err = push_program(L, env, argv[0]);
+            if (err == 0) program = lua_tostring(L, -1);
+        }
+    }
+    const char *cwd = (lua_getfield(L, cmd, "cwd") == LUA_TSTRING) ? lua_tostring(L, -1) : NULL;
+    lua_Integer timeout = (lua_getfield(L, cmd, "timeout") == LUA_TNIL) ? 0 : lua_tointeger(L, -1);
+    for (int k = 0; k < STREAM_COUNT; k++)
+    {
+        c->modes[k] = output_mode(L, cmd, k);
+    }
+
+    if (err != 0) goto done;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    err = posix_spawn_file_actions_init(&actions);
+    if (err != 0) goto done;
+    err = posix_spawnattr_init(&attr);
+    if (err != 0)
+    {
+        posix_spawn_file_actions_destroy(&actions);
+        goto done;
+    }
+
+    // the child starts with the default handler of SIGPIPE and no signal blocked
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    int write_fds[STREAM_COUNT] = {-1, -1};
+    for (int k = 0; k < STREAM_COUNT && err == 0; k++)
+    {
+        int target = k == STREAM_STDOUT ? STDOUT_FILENO : STDERR_FILENO;
+        switch (c->modes[k])
+        {
+            case OUTPUT_CAPTURE:
+            case OUTPUT_CALLBACK:
+            {
+                int fds[2];
+                if (!make_pipe(fds))
+                {
+                    err = errno;
+                    break;
+                }
+                c->fds[k] = fds[0];
+                write_fds[k] = fds[1];
+                fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+                err = posix_spawn_file_actions_adddup2(&actions, fds[1], target);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    if (err == 0 && cwd != NULL)
+    {
+#if defined(HAVE_ADDCHDIR)
+        err = posix_spawn_file_actions_addchdir_np(&actions, cwd);
+#else
+        err = ENOTSUP;
+#endif
+    }
+    if (err == 0)
+    {
+        if (program != NULL)
+            err = posix_spawn(&c->pid, program, &actions, &attr, (char *const *)argv, envp);
+        else
+            err = posix_spawnp(&c->pid, argv[0], &actions, &attr, (char *const *)argv, envp);
+    }
+#if defined(HAVE_PIDFD)
+    // without pidfd (before Linux 5.3), the exit is checked at intervals
+    if (err == 0) c->pidfd = (int)syscall(SYS_pidfd_open, c->pid, 0);
+#endif
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    for (int k = 0; k < STREAM_COUNT; k++)
+    {
+        close_fd(&write_fds[k]);
+        if (err != 0) close_fd(&c->fds[k]);
+    }
+
+done:
+    if (err != 0) c->pid = 0;
+    c->command = i;
+    c->deadline = timeout > 0 ? now + timeout * NANOS_PER_MILLI : 0;
+    c->timed_out = false;
+    c->exited = false;
+    c->wait_millis = MIN_WAIT_MILLIS;
+    lua_settop(L, top);
+    return err;
+}
+
+// Sets the outputs captured in the result of a command, at the top of the stack.
+static void set_outputs(lua_State *L, int chunks, int i)
+{
+    for (int k = 0; k < STREAM_COUNT; k++)
+    {
+        if (lua_rawgeti(L, chunks, (lua_Integer)(i - 1) * STREAM_COUNT + k + 1) == LUA_TTABLE)
+        {
+            luaL_Buffer b;
+            int t = lua_gettop(L);
+            lua_Integer n = luaL_len(L, t);
+            luaL_buffinit(L, &b);
+            for (lua_Integer j = 1; j <= n; j++)
+            {
+                lua_rawgeti(L, t, j);
+                luaL_addvalue(&b);
+            }
+            luaL_pushresult(&b);
+            lua_setfield(L, -3, stream_names[k]);
+            lua_pop(L, 1);
+        }
+        else
+        {
+            lua_pop(L, 1);
+            lua_pushliteral(L, "");
+            lua_setfield(L, -2, stream_names[k]);
+        }
+    }
+}
+
+// Records the result of a child reaped, or of a command that could not be spawned.
+static void set_result(lua_State *L, int results, int chunks, const child_t *c, int status, int err)
+{
+    lua_createtable(L, 0, 6);
+    if (err != 0)
+    {
+        lua_pushboolean(L, false);
+        lua_setfield(L, -2, "ok");
+        syserrL_push_error(L, NULL, err);
+        lua_setfield(L, -2, "error");
+    }
+    else
+    {
+        const char *what = "exit";
+        lua_Integer code = 0;
+        if (c->timed_out)
+            what = "timeout";
+        if (WIFEXITED(status))
+            code = WEXITSTATUS(status);
+        else if (WIFSIGNALED(status))
+        {
+            code = WTERMSIG(status);
+            if (!c->timed_out) what = "signal";
+        }
+        lua_pushboolean(L, !c->timed_out && WIFEXITED(status) && code == 0);
+        lua_setfield(L, -2, "ok");
+        lua_pushstring(L, what);
+        lua_setfield(L, -2, "status");
+        lua_pushinteger(L, code);
+        lua_setfield(L, -2, "code");
+        set_outputs(L, chunks, c->command);
+    }
+    lua_rawseti(L, results, c->command);
+}
+
+// Handles the output read from a stream of a child.
+static void on_output(lua_State *L, int chunks, child_t *c, int stream, const char *data, size_t len)
+{
+    if (c->modes[stream] == OUTPUT_CALLBACK)
+    {
+        lua_geti(L, 1, c->command);
+        lua_getfield(L, -1, stream_names[stream]);
+        lua_pushlstring(L, data, len);
+        lua_call(L, 1, 0);
+        lua_pop(L, 1);
+        return;
+    }
+    lua_Integer slot = (lua_Integer)(c->command - 1) * STREAM_COUNT + stream + 1;
+    if (lua_rawgeti(L, chunks, slot) != LUA_TTABLE)
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, chunks, slot);
+    }
+    lua_pushlstring(L, data, len);
+    lua_rawseti(L, -2, luaL_len(L, -2) + 1);
+    lua_pop(L, 1);
+}
+
+// Reads a chunk of a stream of a child, closing it at its end, and returns whether the stream may
+// have more to read at once.
+static bool read_stream(lua_State *L, int chunks, child_t *c, int stream)
+{
+    char buffer[CHUNK_SIZE];
+    ssize_t n = read(c->fds[stream], buffer, sizeof(buffer));
+    if (n > 0)
+    {
+        on_output(L, chunks, c, stream, buffer, (size_t)n);
+        return true;
+    }
+    if (n < 0 && errno == EINTR) return true;
+    if (n == 0 || errno != EAGAIN) close_fd(&c->fds[stream]);
+    return false;
+}
+
+/***
+ * Runs some commands, with a limit on the number running at once, and returns their results.
+ *
+ * Each command is a table with the following fields:
+ *
+ * - `argv` (table): the program, looked up in `PATH` (the one set by `env` if any), and its
+ *   arguments.
+ * - `env` (table): the environment variables to set, or to unset if `false`.
+ * - `cwd` (string): the working directory of the command.
+ * - `timeout` (integer): the number of milliseconds after which the command is killed.
+ * - `stdout`, `stderr`: `true` to capture the output (the default), `false` to leave it to the
+ *   output of the process, or a function called with each chunk of the output.
+ *
+ * The outputs are read until the command exits: what the processes it started write after, or
+ * while they keep the pipes open, is not read.
+ *
+ * The result of each command is a table with the following fields: `ok`, `true` if the command
+ * exited with the status 0 in time; `status`, `"exit"`, `"signal"` or `"timeout"`; `code`, the
+ * exit status or the number of the signal; `stdout` and `stderr`, the outputs captured; or
+ * `error` if the command could not be run.
+ *
+ * @function spawn
+ * @tparam table cmds the commands.
+ * @tparam[opt=1] integer concurrency the maximum number of commands running at once.
+ * @treturn table the results of the commands, in the order of the commands.
+ * @raise If a command is not valid.
+ */
+static int osx_spawn(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_Integer concurrency = luaL_optinteger(L, 2, 1);
+    luaL_argcheck(L, concurrency > 0 && concurrency <= MAX_CONCURRENCY, 2, "concurrency out of range");
+    int count = (int)luaL_len(L, 1);
+    for (int i = 1; i <= count; i++)
+    {
+        check_command(L, i);
+    }
+
+    lua_settop(L, 2);
+    const int results = 3;
+    const int chunks = 4;
+    lua_createtable(L, count, 0);                 // cmds concurrency results
+    lua_createtable(L, count * STREAM_COUNT, 0);  // cmds concurrency results chunks
+    int size = count < concurrency ? count : (int)concurrency;
+    if (size == 0) size = 1;
+    size_t bytes = sizeof(spawner_t) + (size_t)size * (sizeof(child_t) + POLLS_PER_CHILD * (sizeof(struct pollfd) + sizeof(int)));
+    spawner_t *s = (spawner_t *)lua_newuserdatauv(L, bytes, 0); // cmds concurrency results chunks spawner
+    s->size = size;
+    s->polls = (struct pollfd *)(void *)&s->children[size];
+    s->owners = (int *)(void *)&s->polls[size * POLLS_PER_CHILD];
+    for (int i = 0; i < size; i++)
+    {
+        child_t *c = &s->children[i];
+        c->pid = 0;
+        c->fds[STREAM_STDOUT] = c->fds[STREAM_STDERR] = c->pidfd = -1;
+    }
+    luaL_setmetatable(L, SpawnerMetatableName);
+    lua_toclose(L, -1);
+
+    int next = 1;
+    int running = 0;
+    while (next <= count || running > 0)
+    {
+        lua_Integer now;
+        if (!timeL_monotonic_time(&now)) return syserrL_last_error(L);
+
+        // start the next commands in the free slots
+        for (int i = 0; i < size && next <= count; i++)
+        {
+            child_t *c = &s->children[i];
+            if (c->pid != 0) continue;
+            int err = spawn_command(L, next++, c, now);
+            if (err == 0)
+                running++;
+            else
+                set_result(L, results, chunks, c, 0, err);
+        }
+        if (running == 0) continue;
+
+        int timeout = -1;
+        nfds_t n = 0;
+        for (int i = 0; i < size; i++)
+        {
+            child_t *c = &s->children[i];
+            if (c->pid == 0) continue;
+            if (c->deadline > 0 && !c->timed_out)
+            {
+                if (now >= c->deadline)
+                {
+                    // the output written after is dropped: grandchildren may keep the pipes open
+                    kill(c->pid, SIGKILL);
+                    c->timed_out = true;
+                    close_fd(&c->fds[STREAM_STDOUT]);
+                    close_fd(&c->fds[STREAM_STDERR]);
+                }
+                else
+                {
+                    lua_Integer millis = (c->deadline - now + NANOS_PER_MILLI - 1) / NANOS_PER_MILLI;
+                    if (millis > INT_MAX) millis = INT_MAX;
+                    if (timeout < 0 || millis < timeout) timeout = (int)millis;
+                }
+            }
+            for (int k = 0; k < STREAM_COUNT; k++)
+            {
+                if (c->fds[k] < 0) continue;
+                s->polls[n].fd = c->fds[k];
+                s->polls[n].events = POLLIN;
+                s->polls[n].revents = 0;
+                s->owners[n++] = i * POLLS_PER_CHILD + k;
+            }
+            // the exit is waited for along with the output: grandchildren may keep the pipes open
+            if (c->pidfd >= 0)
+            {
+                s->polls[n].fd = c->pidfd;
+                s->polls[n].events = POLLIN;
+                s->polls[n].revents = 0;
+                s->owners[n++] = i * POLLS_PER_CHILD + STREAM_COUNT;
+            }
+            else if (timeout < 0 || c->wait_millis < timeout)
+                timeout = c->wait_millis;
+        }
+
+        int ready = poll(s->polls, n, timeout);
+        if (ready < 0 && errno != EINTR) return syserrL_last_error(L);
+        for (nfds_t j = 0; ready > 0 && j < n; j++)
+        {
+            child_t *c = &s->children[s->owners[j] / POLLS_PER_CHILD];
+            int stream = s->owners[j] % POLLS_PER_CHILD;
+            if (s->polls[j].revents == 0) continue;
+            if (stream == STREAM_COUNT)
+                c->exited = true;
+            else
+                read_stream(L, chunks, c, stream);
+        }
+
+        // reap the children exited, with what their pipes hold
+        for (int i = 0; i < size; i++)
+        {
+            child_t *c = &s->children[i];
+            if (c->pid == 0 || (c->pidfd >= 0 && !c->exited)) continue;
+            int status = 0;
+            pid_t pid = waitpid(c->pid, &status, WNOHANG);
+            if (pid == 0)
+            {
+                if (c->wait_millis < MAX_WAIT_MILLIS) c->wait_millis *= 2;
+                continue;
+            }
+            if (pid < 0 && errno == EINTR) continue;
+            for (int k = 0; k < STREAM_COUNT; k++)
+            {
+                while (c->fds[k] >= 0 && read_stream(L, chunks, c, k))
+                {
+                }
+                close_fd(&c->fds[k]);
+            }
+            close_fd(&c->pidfd);
+            c->pid = 0;
+            running--;
+            set_result(L, results, chunks, c, status, pid < 0 ? errno : 0);
+        }
+    }
+    lua_pushvalue(L, results);
+    return 1;
+}
+
+static void create_spawner_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg spawner_meta_methods[] = {
+        {"__close", spawner_close},
+        {"__gc", spawner_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, SpawnerMetatableName); // mt
+    luaL_setfuncs(L, spawner_meta_methods, 0);  // mt
+    lua_pop(L, 1);                              //
+}
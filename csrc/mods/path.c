@@ -5,9 +5,12 @@
  */
 #include "libpath.h"
 #include "liballocator.h"
+#include "libsyserror.h"
 #include "libutil.h"
 
+#include <ctype.h>
 #include <lauxlib.h>
+#include <limits.h>
 #include <lua.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -318,8 +321,8 @@ static int path_file_stem(lua_State *L)
         lua_settop(L, 1);
         return 1;
     }
-    size_t stem_len = path_len - components.ext_offset + (components.ext_offset ? 1 : 0);
-    lua_pushlstring(L, path + components.file_offset, stem_len);
+    size_t stem_end = components.ext_offset ? components.ext_offset - 1 : path_len;
+    lua_pushlstring(L, path + components.file_offset, stem_end - components.file_offset);
     return 1;
 }
 
@@ -360,43 +363,23 @@ static int path_set_file_stem(lua_State *L)
     return 1;
 }
 
-/***
- * Combines strings into a path.
- * @function combine
- * @tparam string ... the parts of the path.
- * @treturn string the combined parts.
- * @remark if any of the given args is an absolute path, the function will
- * combine the parts starting from that absolute path.
- */
-static int path_combine(lua_State *L)
+typedef struct
 {
-    int n = lua_gettop(L);
-    if (n == 0) return 0;
-
-    for (int i = 1; i <= n; i++)
-    {
-        luaL_checktype(L, i, LUA_TSTRING);
-    }
-
-    typedef struct
-    {
-        const char *path;
-        size_t path_len;
-        bool ends_with_sep;
-    } arg_t;
-
-    arg_t *args = allocatorL_allocT(L, arg_t, n);
+    const char *path;
+    size_t path_len;
+    bool ends_with_sep;
+} combine_arg_t;
 
+// Pushes the combination of the parts in `args`.
+static void push_combined(lua_State *L, combine_arg_t *args, int n)
+{
     bool has_verbatim_root = false;
     size_t len = 0;
     int first = 0, last = 0;
     for (int i = 0; i < n; i++)
     {
-        size_t path_len;
-        const char *path = lua_tolstring(L, i + 1, &path_len);
-
-        args[i].path = path;
-        args[i].path_len = path_len;
+        const char *path = args[i].path;
+        size_t path_len = args[i].path_len;
         args[i].ends_with_sep = false;
 
         if (path_len == 0) continue;
@@ -421,15 +404,14 @@ static int path_combine(lua_State *L)
     if (len == 0)
     {
         lua_pushlstring(L, "", 0);
-        allocatorL_free(L, args);
-        return 1;
+        return;
     }
 
     luaL_Buffer b;
     luaL_buffinitsize(L, &b, len);
     for (int i = first; i <= last; i++)
     {
-        arg_t arg = args[i];
+        combine_arg_t arg = args[i];
         if (arg.path_len == 0) continue;
 
         luaL_addlstring(&b, arg.path, arg.path_len);
@@ -439,6 +421,32 @@ static int path_combine(lua_State *L)
         }
     }
     luaL_pushresult(&b);
+}
+
+/***
+ * Combines strings into a path.
+ * @function combine
+ * @tparam string ... the parts of the path.
+ * @treturn string the combined parts.
+ * @remark if any of the given args is an absolute path, the function will
+ * combine the parts starting from that absolute path.
+ */
+static int path_combine(lua_State *L)
+{
+    int n = lua_gettop(L);
+    if (n == 0) return 0;
+
+    for (int i = 1; i <= n; i++)
+    {
+        luaL_checktype(L, i, LUA_TSTRING);
+    }
+
+    combine_arg_t *args = allocatorL_allocT(L, combine_arg_t, n);
+    for (int i = 0; i < n; i++)
+    {
+        args[i].path = lua_tolstring(L, i + 1, &args[i].path_len);
+    }
+    push_combined(L, args, n);
     allocatorL_free(L, args);
     return 1;
 }
@@ -627,6 +635,124 @@ static int path_normalize(lua_State *L)
     return pathL_normalize(L, path, path_len);
 }
 
+static int invalid_path(lua_State *L, int arg, lua_Integer i)
+{
+    return luaL_argerror(L, arg, lua_pushfstring(L, "invalid path at index %I", i));
+}
+
+/***
+ * Applies an operation to each path of an array.
+ * @function map
+ * @tparam string op the operation: `"combine"`, `"full_path"` or `"normalize"`.
+ * @tparam table paths the paths.
+ * @param ... the other arguments of the operation.
+ * @treturn table the result of the operation for each path, in the order of the paths.
+ * @raise If `op` is not valid, or if an argument or a path is not valid for the operation.
+ * @remark `map(op, paths, ...)` returns `{path[op](paths[1], ...), path[op](paths[2], ...), ...}`,
+ * but without a call for each path: the working directory is read once, and the buffers are
+ * allocated once for all the paths.
+ * @usage local full_paths = path.map('full_path', manifest, root)
+ */
+static int path_map(lua_State *L)
+{
+    // clang-format off
+    static const char *const ops[] = {"combine", "full_path", "normalize", NULL};
+    // clang-format on
+    enum
+    {
+        OP_COMBINE,
+        OP_FULL_PATH,
+        OP_NORMALIZE
+    };
+
+    int op = luaL_checkoption(L, 1, NULL, ops);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_Integer n = (lua_Integer)lua_rawlen(L, 2);
+
+    int parts = 0;
+    const char *base_path = NULL;
+    size_t base_path_len = 0;
+    if (op == OP_COMBINE)
+    {
+        parts = lua_gettop(L) - 2;
+        for (int i = 3; i <= parts + 2; i++)
+        {
+            luaL_checktype(L, i, LUA_TSTRING);
+        }
+    }
+    else if (op == OP_FULL_PATH)
+    {
+        base_path = pathL_optlpath(L, 3, NULL, &base_path_len);
+        if (base_path != NULL && !pathL_is_fully_qualified(base_path, base_path_len))
+        {
+            return luaL_argerror(L, 3, "path is not fully qualified");
+        }
+    }
+
+    // the paths are checked before any is processed
+    size_t max_path_len = 0;
+    bool needs_cwd = false;
+    for (lua_Integer i = 1; i <= n; i++)
+    {
+        if (lua_rawgeti(L, 2, i) != LUA_TSTRING) return invalid_path(L, 2, i);
+        size_t path_len;
+        const char *path = lua_tolstring(L, -1, &path_len);
+        if (op == OP_FULL_PATH)
+        {
+            if (path_len > INT_MAX || !pathL_is_valid_path(path, path_len)) return invalid_path(L, 2, i);
+            if (base_path == NULL && !pathL_is_rooted(path, path_len, NULL)) needs_cwd = true;
+        }
+        if (path_len > max_path_len) max_path_len = path_len;
+        lua_pop(L, 1);
+    }
+
+    lua_createtable(L, n < INT_MAX ? (int)n : INT_MAX, 0); // op paths ... results
+    int results = lua_gettop(L);
+
+    path_batch_t batch;
+    combine_arg_t *args = NULL;
+    if (op == OP_COMBINE)
+    {
+        args = (combine_arg_t *)lua_newuserdatauv(L, (size_t)(parts + 1) * sizeof(combine_arg_t), 0);
+        for (int i = 1; i <= parts; i++)
+        {
+            args[i].path = lua_tolstring(L, i + 2, &args[i].path_len);
+        }
+    }
+    else if (!pathL_batch_init(L, &batch, max_path_len, base_path_len, needs_cwd))
+    {
+        _STD_RETURN_NIL_ERROR
+    }
+
+    for (lua_Integer i = 1; i <= n; i++)
+    {
+        lua_rawgeti(L, 2, i);
+        size_t path_len;
+        const char *path = lua_tolstring(L, -1, &path_len);
+        switch (op)
+        {
+            case OP_COMBINE:
+                args[0].path = path;
+                args[0].path_len = path_len;
+                push_combined(L, args, parts + 1);
+                break;
+            case OP_FULL_PATH:
+                if (pathL_batch_full_path(L, &batch, base_path, base_path_len, path, path_len) != 1) return 2;
+                break;
+            default:
+                if (pathL_is_normalized(path, path_len))
+                    lua_pushvalue(L, -1);
+                else
+                    lua_pushlstring(L, batch.scratch, pathL_normalize_into(batch.scratch, path, path_len));
+                break;
+        }
+        lua_rawseti(L, results, i);
+        lua_pop(L, 1);
+    }
+    lua_pushvalue(L, results);
+    return 1;
+}
+
 /***
  * Normalizes the canonical form of a path.
  * @function canonicalize
@@ -646,6 +772,90 @@ static int path_canonicalize(lua_State *L)
     return pathL_canonicalize(L, path, path_len);
 }
 
+#define ResolveCacheMetatableName "std.path.resolve_cache"
+
+static path_resolve_cache_t *check_resolve_cache(lua_State *L, int arg)
+{
+    return (path_resolve_cache_t *)luaL_checkudata(L, arg, ResolveCacheMetatableName);
+}
+
+/***
+ * Returns the absolute path of a path, with its `.` and `..` segments resolved.
+ *
+ * By default the path is resolved physically, as by @{canonicalize}: each segment is read from the
+ * file system, and the symbolic links are replaced by their target; the path must exist. With
+ * `lexical`, the `..` segments remove the segment before them, and the file system is not read.
+ *
+ * The following options are supported:
+ *
+ * - `lexical` (boolean): whether the path is resolved without reading the file system. Defaults to
+ * `false`.
+ * - `cache` (@{ResolveCache}): the cache of the directories and of the links read while resolving,
+ * so that the paths under the same directories read each of them once.
+ *
+ * @function resolve
+ * @tparam string path the path to resolve, relative to the working directory if not rooted.
+ * @tparam[opt] table opts the options.
+ * @treturn string the absolute path of `path`, without trailing separator.
+ * @raise If `path` is `nil` or invalid, or if an option is invalid.
+ * @return `nil` and an error message if the path cannot be resolved physically.
+ * @usage
+ * local cache = path.resolve_cache()
+ * for _, p in ipairs(manifest) do
+ *   print(path.resolve(p, {cache = cache}))
+ * end
+ */
+static int path_resolve(lua_State *L)
+{
+    _PATH_CHECKLPATH(path, 1)
+    bool lexical = false;
+    path_resolve_cache_t *cache = NULL;
+    lua_settop(L, 2);
+    if (!lua_isnil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_getfield(L, 2, "lexical");
+        lexical = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        if (lua_getfield(L, 2, "cache") != LUA_TNIL) cache = check_resolve_cache(L, -1);
+    }
+    lua_settop(L, 3); // path opts cache
+
+    if (lexical)
+    {
+        return pathL_resolve_lexical(L, path, path_len);
+    }
+    if (cache == NULL)
+    {
+        return pathL_resolve_physical(L, path, path_len, NULL, 0);
+    }
+    lua_getiuservalue(L, 3, 1); // path opts cache entries
+    return pathL_resolve_physical(L, path, path_len, cache, 4);
+}
+
+/***
+ * Creates a cache for @{resolve}.
+ *
+ * The cache keeps the directories and the symbolic links met while resolving paths, by their
+ * physical path, with the target of the links: resolving many paths under the same directories
+ * then reads each directory, and each link, once. The changes made to the file system after they
+ * are cached are not seen until they are removed with @{ResolveCache:invalidate}.
+ *
+ * @function resolve_cache
+ * @treturn ResolveCache the new cache.
+ */
+static int path_resolve_cache(lua_State *L)
+{
+    path_resolve_cache_t *cache = (path_resolve_cache_t *)lua_newuserdatauv(L, sizeof(path_resolve_cache_t), 1);
+    cache->generation = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    luaL_setmetatable(L, ResolveCacheMetatableName);
+    lua_newtable(L);
+    lua_setiuservalue(L, -2, 1);
+    return 1;
+}
+
 /***
  * Returns a value that indicates whether the character at the specified
  * position in a path is a directory separator.
@@ -734,19 +944,21 @@ static int path_starts_with(lua_State *L)
 
     path += path_root_len;
     path_len -= path_root_len;
-    path_tokenizer_t *path_tokenizer = path_tokenizer_new(L, path, path_len, path_verbatim);
+    path_tokenizer_t path_tokenizer;
+    path_tokenizer_init(&path_tokenizer, path, path_len, path_verbatim);
 
     prefix += prefix_root_len;
     prefix_len -= prefix_root_len;
-    path_tokenizer_t *prefix_tokenizer = path_tokenizer_new(L, prefix, prefix_len, prefix_verbatim);
+    path_tokenizer_t prefix_tokenizer;
+    path_tokenizer_init(&prefix_tokenizer, prefix, prefix_len, prefix_verbatim);
 
     int result = 0;
     while (true)
     {
         size_t path_tok_len;
-        const char *path_tok = path_tokenizer_next(path_tokenizer, &path_tok_len);
+        const char *path_tok = path_tokenizer_next(&path_tokenizer, &path_tok_len);
         size_t prefix_tok_len;
-        const char *prefix_tok = path_tokenizer_next(prefix_tokenizer, &prefix_tok_len);
+        const char *prefix_tok = path_tokenizer_next(&prefix_tokenizer, &prefix_tok_len);
 
         if (path_tok_len == 0 || prefix_tok_len == 0)
         {
@@ -759,8 +971,6 @@ static int path_starts_with(lua_State *L)
             break;
         }
     }
-    path_tokenizer_free(L, path_tokenizer);
-    path_tokenizer_free(L, prefix_tokenizer);
     lua_pushboolean(L, result);
     return 1;
 }
@@ -799,23 +1009,26 @@ static int path_ends_with(lua_State *L)
 
     path += path_root_len;
     path_len -= path_root_len;
-    path_tokenizer_t *path_tokenizer = path_tokenizer_new(L, path, path_len, path_verbatim);
+    path_tokenizer_t path_tokenizer;
+    path_tokenizer_init(&path_tokenizer, path, path_len, path_verbatim);
 
     suffix += suffix_root_len;
     suffix_len -= suffix_root_len;
-    path_tokenizer_t *suffix_tokenizer = path_tokenizer_new(L, suffix, suffix_len, suffix_verbatim);
+    path_tokenizer_t suffix_tokenizer;
+    path_tokenizer_init(&suffix_tokenizer, suffix, suffix_len, suffix_verbatim);
 
     int result = 0;
     while (true)
     {
         size_t path_tok_len;
-        const char *path_tok = path_tokenizer_next_back(path_tokenizer, &path_tok_len);
+        const char *path_tok = path_tokenizer_next_back(&path_tokenizer, &path_tok_len);
         size_t suffix_tok_len;
-        const char *suffix_tok = path_tokenizer_next_back(suffix_tokenizer, &suffix_tok_len);
+        const char *suffix_tok = path_tokenizer_next_back(&suffix_tokenizer, &suffix_tok_len);
 
         if (path_tok_len == 0 && suffix_tok_len == 0)
         {
-            continue;
+            result = 1;
+            break;
         }
 
         if (path_tok_len == 0 || suffix_tok_len == 0)
@@ -830,8 +1043,6 @@ static int path_ends_with(lua_State *L)
             break;
         }
     }
-    path_tokenizer_free(L, path_tokenizer);
-    path_tokenizer_free(L, suffix_tokenizer);
     lua_pushboolean(L, result);
     return 1;
 }
@@ -885,6 +1096,811 @@ static int path_ends_with_separator(lua_State *L)
     return 1;
 }
 
+// A segment of a path, as returned by a path_tokenizer_t.
+typedef struct
+{
+    const char *token;
+    size_t token_len;
+} token_t;
+
+// Returns the next segment of a tokenizer, but the `.` that it returns at the end of a path.
+static const char *next_segment(path_tokenizer_t *tokenizer, size_t *token_len)
+{
+    const char *token = path_tokenizer_next(tokenizer, token_len);
+    if (*token_len == 1 && *token == '.' && !tokenizer->verbatim) return path_tokenizer_next(tokenizer, token_len);
+    return token;
+}
+
+// Returns the segments of `path` after its root, in `buf` if they fit, otherwise in a userdata pushed
+// on the stack.
+static token_t *tokenize(lua_State *L, const char *path, size_t path_len, size_t root_len, bool verbatim, token_t *buf,
+                         size_t buf_count, size_t *count)
+{
+    path_tokenizer_t tokenizer;
+    size_t token_len;
+    size_t n = 0;
+    path_tokenizer_init(&tokenizer, path + root_len, path_len - root_len, verbatim);
+    while (next_segment(&tokenizer, &token_len), token_len > 0)
+    {
+        n++;
+    }
+
+    token_t *tokens = n <= buf_count ? buf : (token_t *)lua_newuserdatauv(L, n * sizeof(token_t), 0);
+    path_tokenizer_init(&tokenizer, path + root_len, path_len - root_len, verbatim);
+    for (size_t i = 0; i < n; i++)
+    {
+        tokens[i].token = next_segment(&tokenizer, &tokens[i].token_len);
+    }
+    *count = n;
+    return tokens;
+}
+
+// Writes into `dst` the path from the segments `base` to the segments left in `tokenizer`, which
+// has the same root, and returns its length; `dst` holds at least `3 * base_count` bytes, and the
+// length of the path plus one.
+static size_t relative_into(char *dst, const token_t *base, size_t base_count, path_tokenizer_t *tokenizer)
+{
+    size_t token_len;
+    const char *token = next_segment(tokenizer, &token_len);
+    size_t common = 0;
+    while (token_len > 0 && common < base_count
+           && pathL_compare(token, token_len, base[common].token, base[common].token_len) == 0)
+    {
+        common++;
+        token = next_segment(tokenizer, &token_len);
+    }
+
+    size_t len = 0;
+    for (size_t i = common; i < base_count; i++)
+    {
+        if (len > 0) dst[len++] = _STD_PATH_DIRSEP;
+        dst[len++] = '.';
+        dst[len++] = '.';
+    }
+    for (; token_len > 0; token = next_segment(tokenizer, &token_len))
+    {
+        if (len > 0) dst[len++] = _STD_PATH_DIRSEP;
+        memcpy(dst + len, token, token_len);
+        len += token_len;
+    }
+    if (len == 0) dst[len++] = '.';
+    return len;
+}
+
+/***
+ * Returns the relative path from a path to another.
+ * @function relative
+ * @tparam string from the path from which the relative path starts.
+ * @tparam string to the path to which the relative path leads.
+ * @treturn string the path `p` such that `combine(from, p)` denotes `to`: the `..` segments leaving
+ * the segments of `from` not in `to`, then the segments of `to` after them; `"."` if the paths are
+ * the same. Or `nil` if the paths have different roots.
+ * @raise If `from` or `to` is `nil`, or invalid.
+ * @remark the paths are compared segment-wise, as by @{starts_with}, without reading the file system:
+ * they should be normalized, as by @{resolve}, first.
+ * @usage print(path.relative('/usr/local/lib', '/usr/share/lua')) -- ../../share/lua
+ */
+static int path_relative(lua_State *L)
+{
+    _PATH_CHECKLPATH(from, 1)
+    _PATH_CHECKLPATH(to, 2)
+
+    bool from_verbatim;
+    size_t from_root_len = pathL_root_length(from, from_len, &from_verbatim);
+    bool to_verbatim;
+    size_t to_root_len = pathL_root_length(to, to_len, &to_verbatim);
+    if (pathL_compare(from, from_root_len, to, to_root_len) != 0)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    token_t buf[32];
+    size_t count;
+    token_t *base = tokenize(L, from, from_len, from_root_len, from_verbatim, buf, 32, &count);
+
+    path_tokenizer_t tokenizer;
+    path_tokenizer_init(&tokenizer, to + to_root_len, to_len - to_root_len, to_verbatim);
+    luaL_Buffer b;
+    char *dst = luaL_buffinitsize(L, &b, 3 * count + to_len + 1);
+    luaL_pushresultsize(&b, relative_into(dst, base, count, &tokenizer));
+    return 1;
+}
+
+/***
+ * Returns the relative paths from a path to each path of an array.
+ * @function relative_all
+ * @tparam string base the path from which the relative paths start.
+ * @tparam table paths the paths.
+ * @treturn table the relative path from `base` to each path, in the order of the paths, or `false`
+ * for the paths whose root is not the root of `base`.
+ * @raise If `base` is `nil` or invalid, or if a path is not valid.
+ * @remark `relative_all(base, paths)` returns `{relative(base, paths[1]), ...}`, but `base` is
+ * parsed once, and the buffer of the results is allocated once for all the paths.
+ * @usage local names = path.relative_all(root, manifest)
+ */
+static int path_relative_all(lua_State *L)
+{
+    _PATH_CHECKLPATH(base, 1)
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_Integer n = (lua_Integer)lua_rawlen(L, 2);
+
+    // the paths are checked before any is processed
+    size_t max_path_len = 0;
+    for (lua_Integer i = 1; i <= n; i++)
+    {
+        if (lua_rawgeti(L, 2, i) != LUA_TSTRING) return invalid_path(L, 2, i);
+        size_t path_len;
+        const char *path = lua_tolstring(L, -1, &path_len);
+        if (path_len > INT_MAX || !pathL_is_valid_path(path, path_len)) return invalid_path(L, 2, i);
+        if (path_len > max_path_len) max_path_len = path_len;
+        lua_pop(L, 1);
+    }
+
+    lua_settop(L, 2);
+    lua_createtable(L, n < INT_MAX ? (int)n : INT_MAX, 0); // base paths results
+
+    bool base_verbatim;
+    size_t base_root_len = pathL_root_length(base, base_len, &base_verbatim);
+    token_t buf[32];
+    size_t count;
+    token_t *tokens = tokenize(L, base, base_len, base_root_len, base_verbatim, buf, 32, &count);
+    char *scratch = (char *)lua_newuserdatauv(L, 3 * count + max_path_len + 1, 0);
+
+    for (lua_Integer i = 1; i <= n; i++)
+    {
+        lua_rawgeti(L, 2, i);
+        size_t path_len;
+        const char *path = lua_tolstring(L, -1, &path_len);
+        bool verbatim;
+        size_t root_len = pathL_root_length(path, path_len, &verbatim);
+        if (pathL_compare(base, base_root_len, path, root_len) != 0)
+        {
+            lua_pushboolean(L, 0);
+        }
+        else
+        {
+            path_tokenizer_t tokenizer;
+            path_tokenizer_init(&tokenizer, path + root_len, path_len - root_len, verbatim);
+            lua_pushlstring(L, scratch, relative_into(scratch, tokens, count, &tokenizer));
+        }
+        lua_rawseti(L, 3, i);
+        lua_pop(L, 1);
+    }
+    lua_settop(L, 3);
+    return 1;
+}
+
+/***
+ * Returns the longest path that all the paths of an array start with.
+ * @function common_prefix
+ * @tparam table paths the paths.
+ * @treturn string the root and the segments shared by all the paths, as in the first path, without
+ * trailing separator unless it is the root; an empty string if they have none; or `nil` if there
+ * are no paths.
+ * @raise If `paths` is not a table, or if a path is not valid.
+ * @remark the paths are compared segment-wise, as by @{starts_with}, in a single pass: each path
+ * is checked, then read up to the first segment it does not share with the prefix found so far.
+ * @usage print(path.common_prefix({'/usr/lib/a.so', '/usr/lib/lua/b.so'})) -- /usr/lib
+ */
+static int path_common_prefix(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_Integer n = (lua_Integer)lua_rawlen(L, 1);
+    if (n == 0) return 0;
+
+    // the prefix is kept as a length of the first path, anchored by the table
+    if (lua_rawgeti(L, 1, 1) != LUA_TSTRING) return invalid_path(L, 1, 1);
+    size_t first_len;
+    const char *first = lua_tolstring(L, -1, &first_len);
+    if (!pathL_is_valid_path(first, first_len)) return invalid_path(L, 1, 1);
+    lua_pop(L, 1);
+
+    bool first_verbatim;
+    size_t root_len = pathL_root_length(first, first_len, &first_verbatim);
+    size_t prefix_len = root_len;
+    path_tokenizer_t tokenizer;
+    path_tokenizer_init(&tokenizer, first + root_len, first_len - root_len, first_verbatim);
+    size_t token_len;
+    for (const char *token; (token = next_segment(&tokenizer, &token_len)) != NULL;)
+    {
+        prefix_len = (size_t)(token - first) + token_len;
+    }
+
+    for (lua_Integer i = 2; i <= n; i++)
+    {
+        if (lua_rawgeti(L, 1, i) != LUA_TSTRING) return invalid_path(L, 1, i);
+        size_t path_len;
+        const char *path = lua_tolstring(L, -1, &path_len);
+        if (!pathL_is_valid_path(path, path_len)) return invalid_path(L, 1, i);
+        lua_pop(L, 1);
+        if (prefix_len == 0) continue;
+
+        bool verbatim;
+        size_t path_root_len = pathL_root_length(path, path_len, &verbatim);
+        if (pathL_compare(first, root_len, path, path_root_len) != 0)
+        {
+            prefix_len = 0;
+            continue;
+        }
+
+        path_tokenizer_t prefix_tokenizer;
+        path_tokenizer_init(&prefix_tokenizer, first + root_len, prefix_len - root_len, first_verbatim);
+        path_tokenizer_t path_tokenizer;
+        path_tokenizer_init(&path_tokenizer, path + path_root_len, path_len - path_root_len, verbatim);
+        size_t common_len = root_len;
+        while (true)
+        {
+            size_t prefix_tok_len;
+            const char *prefix_tok = next_segment(&prefix_tokenizer, &prefix_tok_len);
+            size_t path_tok_len;
+            const char *path_tok = next_segment(&path_tokenizer, &path_tok_len);
+            if (prefix_tok_len == 0 || path_tok_len == 0
+                || pathL_compare(prefix_tok, prefix_tok_len, path_tok, path_tok_len) != 0)
+            {
+                break;
+            }
+            common_len = (size_t)(prefix_tok - first) + prefix_tok_len;
+        }
+        prefix_len = common_len;
+    }
+
+    lua_pushlstring(L, first, prefix_len);
+    return 1;
+}
+
+#define PathMetatableName "std.path.path"
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+} segment_t;
+
+enum
+{
+    UV_STRING = 1, // the string of the path
+    UV_PARENT,     // the parent, once computed
+    UV_COUNT
+};
+
+typedef struct
+{
+    const char *path; // anchored by UV_STRING
+    size_t path_len;
+    path_components_t components;
+    int count;
+    segment_t segments[];
+} path_t;
+
+static path_t *check_path(lua_State *L, int arg)
+{
+    return (path_t *)luaL_checkudata(L, arg, PathMetatableName);
+}
+
+// Returns the string of a Path or of a string argument.
+static const char *check_lpath_or_string(lua_State *L, int arg, size_t *len)
+{
+    path_t *p = (path_t *)luaL_testudata(L, arg, PathMetatableName);
+    if (p == NULL) return luaL_checklstring(L, arg, len);
+    *len = p->path_len;
+    return p->path;
+}
+
+// Finds the segments of `path` from `from`, storing them in `segments` if not NULL, and returns
+// their number.
+static int scan_segments(const char *path, size_t path_len, size_t from, bool verbatim, segment_t *segments)
+{
+    int count = 0;
+    size_t i = from;
+    while (i < path_len)
+    {
+        for (; i < path_len && pathL_is_dirsep(path[i], verbatim); i++)
+            ;
+        if (i == path_len) break;
+
+        size_t start = i;
+        for (; i < path_len && !pathL_is_dirsep(path[i], verbatim); i++)
+            ;
+        if (segments != NULL)
+        {
+            segments[count].offset = (uint32_t)start;
+            segments[count].length = (uint32_t)(i - start);
+        }
+        count++;
+    }
+    return count;
+}
+
+// Pushes the key of the string at `idx` in the table of the paths interned: the paths equal for
+// pathL_compare share a key.
+static void push_intern_key(lua_State *L, int idx)
+{
+#if defined(_STD_WINDOWS)
+    size_t len;
+    const char *path = lua_tolstring(L, idx, &len);
+    luaL_Buffer b;
+    char *key = luaL_buffinitsize(L, &b, len);
+    for (size_t i = 0; i < len; i++)
+    {
+        key[i] = (char)tolower((unsigned char)path[i]);
+    }
+    luaL_pushresultsize(&b, len);
+#else
+    lua_pushvalue(L, idx);
+#endif
+}
+
+// Replaces the string at the top of the stack with its Path, from the table of the paths interned
+// (the upvalue 1). A Path created is given the first `prefix_count` segments of `prefix`, which must
+// end before `from`, and the segments found after `from`.
+static path_t *intern_path(lua_State *L, const segment_t *prefix, int prefix_count, size_t from)
+{
+    int s = lua_gettop(L);
+    push_intern_key(L, s);
+    if (lua_rawget(L, lua_upvalueindex(1)) == LUA_TUSERDATA)
+    {
+        lua_replace(L, s);
+        return (path_t *)lua_touserdata(L, s);
+    }
+    lua_pop(L, 1);
+
+    size_t path_len;
+    const char *path = lua_tolstring(L, s, &path_len);
+    if (path_len > INT_MAX)
+    {
+        luaL_error(L, "path too long");
+    }
+
+    path_components_t components = pathL_split_path(path, path_len);
+    if (from < components.root_len) from = components.root_len;
+    int count = prefix_count + scan_segments(path, path_len, from, components.verbatim, NULL);
+
+    path_t *p = (path_t *)lua_newuserdatauv(L, sizeof(path_t) + (size_t)count * sizeof(segment_t), UV_COUNT - 1);
+    p->path = path;
+    p->path_len = path_len;
+    p->components = components;
+    p->count = count;
+    if (prefix_count > 0) memcpy(p->segments, prefix, (size_t)prefix_count * sizeof(segment_t));
+    scan_segments(path, path_len, from, components.verbatim, p->segments + prefix_count);
+    luaL_setmetatable(L, PathMetatableName);
+
+    lua_pushvalue(L, s);
+    lua_setiuservalue(L, -2, UV_STRING);
+    push_intern_key(L, s);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, lua_upvalueindex(1));
+    lua_replace(L, s);
+    return p;
+}
+
+// Replaces the combination at the top of the stack with its Path, given the Path `base` of its
+// first part.
+static path_t *intern_combined(lua_State *L, const path_t *base)
+{
+    size_t len;
+    const char *combined = lua_tolstring(L, -1, &len);
+    bool extends = base != NULL && base->path_len > 0 && base->path_len <= len
+                   && memcmp(combined, base->path, base->path_len) == 0
+                   && (base->path_len == len || pathL_is_dirsep(combined[base->path_len], base->components.verbatim)
+                       || pathL_is_dirsep(base->path[base->path_len - 1], base->components.verbatim));
+    if (!extends) return intern_path(L, NULL, 0, 0);
+    return intern_path(L, base->segments, base->count, base->path_len);
+}
+
+// Pushes the Path combining the arguments from `first`, which are Paths or strings.
+static path_t *push_joined(lua_State *L, int first, const path_t *base)
+{
+    int n = lua_gettop(L) - first + 1;
+    combine_arg_t *args = (combine_arg_t *)lua_newuserdatauv(L, (size_t)n * sizeof(combine_arg_t), 0);
+    for (int i = 0; i < n; i++)
+    {
+        args[i].path = check_lpath_or_string(L, first + i, &args[i].path_len);
+    }
+    push_combined(L, args, n);
+    lua_remove(L, -2);
+    return intern_combined(L, base);
+}
+
+/***
+ * Returns the Path of a string.
+ * @function new
+ * @tparam string|Path path the path.
+ * @treturn Path the path, parsed.
+ * @raise If `path` is `nil`, or invalid.
+ * @remark the paths are interned: the same Path is returned for equal strings, until it is
+ * collected, so Paths can be compared with `rawequal` and used as keys of a table. On Windows the
+ * strings are compared without case, and the Path returned keeps the case of the first string.
+ * @usage
+ * local p = path.new('/usr/local/lib/liblua.so')
+ * print(p:parent(), p:file_stem(), #p, p:part(-2))
+ */
+static int path_new(lua_State *L)
+{
+    if (luaL_testudata(L, 1, PathMetatableName) != NULL)
+    {
+        lua_settop(L, 1);
+        return 1;
+    }
+    pathL_checklpath(L, 1, NULL);
+    lua_settop(L, 1);
+    intern_path(L, NULL, 0, 0);
+    return 1;
+}
+
+/***
+ * A path, parsed once into its root, directory, file name, extension and segments.
+ *
+ * The Paths derived from a Path, by @{Path:parent}, @{Path:join} or concatenation, reuse its
+ * segments. `#p` is the number of segments of `p`, and `tostring(p)` its string. Paths are equal
+ * if their strings are equal, without case on Windows, and then hash alike for @{std.hash} and
+ * @{std.hashmap}; the shorter Path comes first, then the first string.
+ * @type Path
+ */
+
+/***
+ * Returns the parent of a path.
+ * @function parent
+ * @treturn Path the directory part of the path; or `nil` if the path is empty, or denotes a root
+ * directory.
+ */
+static int path_path_parent(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    if (lua_getiuservalue(L, 1, UV_PARENT) != LUA_TNIL) return 1;
+    if (p->components.root_len == p->path_len || p->components.dir_len == 0) return 0;
+
+    size_t dir_len = p->components.dir_len;
+    int count = 0;
+    while (count < p->count && p->segments[count].offset + p->segments[count].length <= dir_len)
+    {
+        count++;
+    }
+    lua_pushlstring(L, p->path, dir_len);
+    intern_path(L, p->segments, count, dir_len);
+    lua_pushvalue(L, -1);
+    lua_setiuservalue(L, 1, UV_PARENT);
+    return 1;
+}
+
+/***
+ * Returns the file name part of a path.
+ * @function file_name
+ * @treturn string the file name part of the path; or `nil` if it has none.
+ */
+static int path_path_file_name(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    size_t file_offset = p->components.file_offset;
+    if (file_offset == p->path_len) return 0;
+    if (file_offset == 0)
+    {
+        lua_getiuservalue(L, 1, UV_STRING);
+        return 1;
+    }
+    lua_pushlstring(L, p->path + file_offset, p->path_len - file_offset);
+    return 1;
+}
+
+/***
+ * Returns the file stem part (file name without extension) of a path.
+ * @function file_stem
+ * @treturn string the file stem part of the path; or `nil` if it has no file name.
+ */
+static int path_path_file_stem(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    size_t file_offset = p->components.file_offset;
+    if (file_offset == p->path_len) return 0;
+    size_t stem_end = p->components.ext_offset ? p->components.ext_offset - 1 : p->path_len;
+    lua_pushlstring(L, p->path + file_offset, stem_end - file_offset);
+    return 1;
+}
+
+/***
+ * Returns the extension of a path.
+ * @function extension
+ * @treturn string the extension of the path; or `nil` if it has none.
+ */
+static int path_path_extension(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    size_t ext_offset = p->components.ext_offset;
+    if (ext_offset == 0 || ext_offset == p->path_len) return 0;
+    lua_pushlstring(L, p->path + ext_offset, p->path_len - ext_offset);
+    return 1;
+}
+
+/***
+ * Returns the root directory information of a path.
+ * @function root
+ * @treturn string the root of the path; or `nil` if it has none.
+ */
+static int path_path_root(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    size_t root_len = p->components.root_len;
+    if (root_len == 0) return 0;
+    if (root_len == p->path_len)
+    {
+        lua_getiuservalue(L, 1, UV_STRING);
+        return 1;
+    }
+    lua_pushlstring(L, p->path, root_len);
+    return 1;
+}
+
+/***
+ * Returns a value that indicates whether a path contains a root.
+ * @function is_rooted
+ * @treturn boolean `true` if the path contains a root; otherwise `false`.
+ */
+static int path_path_is_rooted(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    lua_pushboolean(L, p->components.root_len > 0);
+    return 1;
+}
+
+/***
+ * Returns a segment of a path: a part between its root and its directory separators.
+ * @function part
+ * @tparam integer index the index of the segment, negative to count from the last one.
+ * @treturn string the segment; or `nil` if `index` is out of range.
+ */
+static int path_path_part(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    lua_Integer index = luaL_checkinteger(L, 2);
+    if (index < 0) index += p->count + 1;
+    if (index < 1 || index > p->count) return 0;
+    const segment_t *segment = &p->segments[index - 1];
+    lua_pushlstring(L, p->path + segment->offset, segment->length);
+    return 1;
+}
+
+/***
+ * Combines a path with other parts.
+ * @function join
+ * @tparam string|Path ... the parts to add.
+ * @treturn Path the combined parts, as by @{std.path.combine}.
+ */
+static int path_path_join(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    push_joined(L, 1, p);
+    return 1;
+}
+
+static int path_path_tostring(lua_State *L)
+{
+    check_path(L, 1);
+    lua_getiuservalue(L, 1, UV_STRING);
+    return 1;
+}
+
+static int path_path_len(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    lua_pushinteger(L, p->count);
+    return 1;
+}
+
+static int path_path_eq(lua_State *L)
+{
+    path_t *p = (path_t *)luaL_testudata(L, 1, PathMetatableName);
+    path_t *other = (path_t *)luaL_testudata(L, 2, PathMetatableName);
+    lua_pushboolean(L, p != NULL && other != NULL
+                           && pathL_compare(p->path, p->path_len, other->path, other->path_len) == 0);
+    return 1;
+}
+
+// The FNV-1a hash of the string, without case where pathL_compare ignores it.
+static int path_path_hash(lua_State *L)
+{
+    path_t *p = check_path(L, 1);
+    uint64_t h = 14695981039346656037u;
+    for (size_t i = 0; i < p->path_len; i++)
+    {
+#if defined(_STD_WINDOWS)
+        h ^= (uint64_t)tolower((unsigned char)p->path[i]);
+#else
+        h ^= (uint64_t)(unsigned char)p->path[i];
+#endif
+        h *= 1099511628211u;
+    }
+    lua_pushinteger(L, (lua_Integer)h);
+    return 1;
+}
+
+static int path_path_lt(lua_State *L)
+{
+    size_t path_len, other_len;
+    const char *path = check_lpath_or_string(L, 1, &path_len);
+    const char *other = check_lpath_or_string(L, 2, &other_len);
+    lua_pushboolean(L, pathL_compare(path, path_len, other, other_len) < 0);
+    return 1;
+}
+
+static int path_path_le(lua_State *L)
+{
+    size_t path_len, other_len;
+    const char *path = check_lpath_or_string(L, 1, &path_len);
+    const char *other = check_lpath_or_string(L, 2, &other_len);
+    lua_pushboolean(L, pathL_compare(path, path_len, other, other_len) <= 0);
+    return 1;
+}
+
+static int path_path_concat(lua_State *L)
+{
+    push_joined(L, 1, (path_t *)luaL_testudata(L, 1, PathMetatableName));
+    return 1;
+}
+
+/*** @section end */
+
+// Creates the metatable of the Paths, whose functions share the table of the paths interned at the
+// top of the stack.
+static void create_path_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg path_funcs[] = {
+#define XX(name) {#name, path_path_##name},
+        XX(extension)
+        XX(file_name)
+        XX(file_stem)
+        XX(is_rooted)
+        XX(join)
+        XX(parent)
+        XX(part)
+        XX(root)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg path_meta_methods[] = {
+        {"__concat", path_path_concat},
+        {"__eq", path_path_eq},
+        {"__hash", path_path_hash},
+        {"__index", NULL}, // placeholder
+        {"__le", path_path_le},
+        {"__len", path_path_len},
+        {"__lt", path_path_lt},
+        {"__tostring", path_path_tostring},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, PathMetatableName);      // interned mt
+    lua_pushvalue(L, -2);                         // interned mt interned
+    luaL_setfuncs(L, path_meta_methods, 1);       // interned mt
+    luaL_newlibtable(L, path_funcs);              // interned mt t
+    lua_pushvalue(L, -3);                         // interned mt t interned
+    luaL_setfuncs(L, path_funcs, 1);              // interned mt t
+    lua_setfield(L, -2, "__index");               // interned mt
+    lua_pop(L, 1);                                // interned
+}
+
+/***
+ * @type ResolveCache
+ * A cache of the physical paths resolved; see @{resolve_cache}.
+ */
+
+/***
+ * Removes a path, and the paths under it, from the cache; without a path empties the cache and
+ * starts a new generation.
+ *
+ * @function invalidate
+ * @tparam[opt] string path the physical path to remove.
+ * @treturn integer the number of entries removed.
+ */
+static int path_resolve_cache_invalidate(lua_State *L)
+{
+    path_resolve_cache_t *cache = check_resolve_cache(L, 1);
+    lua_Integer removed = 0;
+    lua_settop(L, 2);
+    lua_getiuservalue(L, 1, 1); // cache path entries
+    if (lua_isnoneornil(L, 2))
+    {
+        lua_pushnil(L);
+        while (lua_next(L, -2))
+        {
+            lua_pop(L, 1);
+            removed++;
+        }
+        cache->generation++;
+        lua_newtable(L);
+        lua_setiuservalue(L, 1, 1);
+        lua_pushinteger(L, removed);
+        return 1;
+    }
+
+    _PATH_CHECKLPATH(path, 2)
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, -2) != LUA_TNIL) removed++;
+    lua_pop(L, 1);
+    lua_pushvalue(L, 2);
+    lua_pushnil(L);
+    lua_rawset(L, -3);
+
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        size_t key_len;
+        const char *key = lua_tolstring(L, -1, &key_len);
+        if (path_len > 0 && key_len > path_len && memcmp(key, path, path_len) == 0
+            && (pathL_is_dirsep(key[path_len], false) || pathL_is_dirsep(path[path_len - 1], false)))
+        {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, -4);
+            removed++;
+        }
+    }
+    lua_pushinteger(L, removed);
+    return 1;
+}
+
+/***
+ * Returns the statistics of the cache.
+ *
+ * @function stats
+ * @treturn table a table with the fields `hits`, `misses`, `entries` and `generation`: a miss is a
+ * read of the file system.
+ */
+static int path_resolve_cache_stats(lua_State *L)
+{
+    path_resolve_cache_t *cache = check_resolve_cache(L, 1);
+    lua_Integer entries = 0;
+    lua_getiuservalue(L, 1, 1);
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        entries++;
+    }
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, cache->hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, cache->misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, entries);
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, cache->generation);
+    lua_setfield(L, -2, "generation");
+    return 1;
+}
+
+/*** @section end */
+
+static void create_resolve_cache_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg resolve_cache_funcs[] = {
+#define XX(name) {#name, path_resolve_cache_##name},
+        XX(invalidate)
+        XX(stats)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg resolve_cache_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, ResolveCacheMetatableName); // mt
+    luaL_setfuncs(L, resolve_cache_meta_methods, 0);  // mt
+    luaL_newlibtable(L, resolve_cache_funcs);         // mt t
+    luaL_setfuncs(L, resolve_cache_funcs, 0);         // mt t
+    lua_setfield(L, -2, "__index");                   // mt
+    lua_pop(L, 1);                                    //
+}
+
 /***
  * The system's directory separator.
  * @tfield string DIRSEP the system's directory separator.
@@ -908,6 +1924,7 @@ _STD_EXTERN int luaopen_std_path(lua_State *L)
 #define XX(name) { #name, path_ ## name },
         XX(canonicalize)
         XX(combine)
+        XX(common_prefix)
         XX(ends_with_separator)
         XX(ends_with)
         XX(extension)
@@ -921,9 +1938,14 @@ _STD_EXTERN int luaopen_std_path(lua_State *L)
         XX(is_separator)
         XX(is_valid_file_name)
         XX(is_valid_path)
+        XX(map)
         XX(normalize)
         XX(parent)
         XX(random_file_name)
+        XX(relative)
+        XX(relative_all)
+        XX(resolve)
+        XX(resolve_cache)
         XX(root)
         XX(set_extension)
         XX(set_file_name)
@@ -938,9 +1960,21 @@ _STD_EXTERN int luaopen_std_path(lua_State *L)
     };
     // clang-format on
 
+    create_resolve_cache_metatable(L);
+
     lua_newtable(L);
     luaL_setfuncs(L, funcs, 0);
 
+    // the paths interned, collected with their last reference
+    lua_newtable(L);                          // M interned
+    lua_createtable(L, 0, 1);                 // M interned mt
+    lua_pushliteral(L, "v");                  // M interned mt "v"
+    lua_setfield(L, -2, "__mode");            // M interned mt
+    lua_setmetatable(L, -2);                  // M interned
+    create_path_metatable(L);                 // M interned
+    lua_pushcclosure(L, path_new, 1);         // M new
+    lua_setfield(L, -2, "new");               // M
+
     char c = _STD_PATH_DIRSEP;
     lua_pushlstring(L, &c, sizeof(c));
     lua_setfield(L, -2, "DIRSEP");
@@ -0,0 +1,703 @@
+/***
+ * Sampling profiler of Lua code.
+ *
+ * The profiler samples the Lua call stack at regular intervals, and aggregates the samples by
+ * function, by line, and by stack of functions in the folded stacks format of the flame graphs.
+ *
+ * In the `"timer"` mode, a timer of the CPU time of the process (`SIGPROF`) fires at every
+ * interval and arms a debug hook, which takes the sample at the next instruction and disarms
+ * itself: the code runs without any hook between the samples. The time spent in C functions is
+ * sampled on the return to the Lua function calling them, and the time spent in coroutines on
+ * their return to the main thread.
+ *
+ * In the `"count"` mode, a count hook samples the stack every given number of instructions, in
+ * the main thread and in the coroutines created while the profiler runs. The hook makes the Lua
+ * interpreter check every instruction, which slows it down.
+ *
+ * There is a single profiler per process.
+ *
+ * @usage
+ * profile.start({interval = 500}) -- 2 kHz
+ * cli.run(commands, arg)
+ * profile.stop()
+ * for _, row in ipairs(profile.report()) do
+ *   print(row.self, row.total, row.name, row.source, row.line)
+ * end
+ * io.open('cli.folded', 'w'):write(profile.folded()) -- flamegraph.pl cli.folded > cli.svg
+ *
+ * @module std.profile
+ */
+#include "std.h"
+#include "libsyserror.h"
+#include "libtime.h"
+
+#include <lauxlib.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ProfilerMetatableName "std.profile.profiler"
+
+#define DEFAULT_TIMER_INTERVAL 1000    // microseconds
+#define MAX_TIMER_INTERVAL 10000000    // microseconds
+#define DEFAULT_COUNT_INTERVAL 100000  // instructions
+#define DEFAULT_DEPTH 64
+#define MAX_DEPTH 256
+#define NONE UINT32_MAX
+#define ROOT 0
+
+// clang-format off
+static const char *const modes[] = {"timer", "count", NULL};
+// clang-format on
+
+enum
+{
+    MODE_TIMER,
+    MODE_COUNT
+};
+
+typedef struct
+{
+    const void *function; // anchored by the profiler: the address identifies the function
+    char *name;           // the name of the function where it was first sampled, or NULL
+    lua_Integer self;     // the samples in the function
+    lua_Integer total;    // the samples in the function or in the functions it called
+    lua_Integer stamp;    // the last sample counted in total
+} func_t;
+
+// A node of the call tree: the calls of a function from the functions of the parent node.
+typedef struct
+{
+    uint32_t func;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    lua_Integer self;
+} node_t;
+
+typedef struct
+{
+    uint32_t func; // NONE for an empty slot
+    int line;
+    lua_Integer self;
+} line_t;
+
+typedef struct
+{
+    lua_State *main; // the thread sampled by the timer
+    int mode;
+    lua_Integer interval;
+    int depth;
+    bool running;
+    int anchors; // the reference of the table anchoring the functions sampled
+    lua_Integer samples;
+    lua_Integer dropped;
+    func_t *funcs;
+    uint32_t func_count;
+    uint32_t func_capacity;
+    uint32_t *func_slots; // open addressing, the indexes of the functions plus 1
+    uint32_t func_slot_count;
+    node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    line_t *lines; // open addressing
+    uint32_t line_count;
+    uint32_t line_slot_count;
+    uint32_t frames[MAX_DEPTH];
+} profiler_t;
+
+// the profiler running in the process, read by the timer
+static profiler_t *volatile running_profiler;
+
+static void hook(lua_State *L, lua_Debug *ar);
+
+// Called by the timer: takes a sample at the next instruction of the main thread.
+static void arm_hook(void)
+{
+    profiler_t *p = running_profiler;
+    if (p != NULL) lua_sethook(p->main, hook, LUA_MASKCOUNT, 1);
+}
+
+#if defined(_STD_WINDOWS)
+#include "profile_win.c"
+#else
+#include "profile_unix.c"
+#endif
+
+// Grows an array of `*capacity` elements of `size` bytes to hold `count` elements.
+static bool reserve(void **array, uint32_t *capacity, uint32_t count, size_t size)
+{
+    if (count <= *capacity) return true;
+    uint32_t n = *capacity == 0 ? 64 : *capacity * 2;
+    void *grown = realloc(*array, n * size);
+    if (grown == NULL) return false;
+    *array = grown;
+    *capacity = n;
+    return true;
+}
+
+static uint32_t hash_pointer(const void *p)
+{
+    uint64_t h = (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+static uint32_t hash_line(uint32_t func, int line)
+{
+    uint64_t h = ((uint64_t)func << 32 | (uint32_t)line) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+// Returns the slot of a function in the index: the slot holding it, or the empty slot to insert it.
+static uint32_t func_slot(const profiler_t *p, const void *function)
+{
+    uint32_t mask = p->func_slot_count - 1;
+    uint32_t i = hash_pointer(function) & mask;
+    while (p->func_slots[i] != 0 && p->funcs[p->func_slots[i] - 1].function != function)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Keeps the index of the functions at most half full.
+static bool grow_func_slots(profiler_t *p)
+{
+    if ((p->func_count + 1) * 2 <= p->func_slot_count) return true;
+    uint32_t n = p->func_slot_count == 0 ? 128 : p->func_slot_count * 2;
+    uint32_t *slots = (uint32_t *)calloc(n, sizeof(uint32_t));
+    if (slots == NULL) return false;
+    free(p->func_slots);
+    p->func_slots = slots;
+    p->func_slot_count = n;
+    for (uint32_t f = 0; f < p->func_count; f++)
+    {
+        p->func_slots[func_slot(p, p->funcs[f].function)] = f + 1;
+    }
+    return true;
+}
+
+// Returns the slot of a line: the slot holding it, or the empty slot to insert it.
+static uint32_t line_slot(const line_t *lines, uint32_t slot_count, uint32_t func, int line)
+{
+    uint32_t mask = slot_count - 1;
+    uint32_t i = hash_line(func, line) & mask;
+    while (lines[i].func != NONE && (lines[i].func != func || lines[i].line != line))
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Keeps the table of the lines at most half full.
+static bool grow_lines(profiler_t *p)
+{
+    if ((p->line_count + 1) * 2 <= p->line_slot_count) return true;
+    uint32_t n = p->line_slot_count == 0 ? 256 : p->line_slot_count * 2;
+    line_t *lines = (line_t *)malloc(n * sizeof(line_t));
+    if (lines == NULL) return false;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        lines[i].func = NONE;
+    }
+    for (uint32_t i = 0; i < p->line_slot_count; i++)
+    {
+        line_t *line = &p->lines[i];
+        if (line->func != NONE) lines[line_slot(lines, n, line->func, line->line)] = *line;
+    }
+    free(p->lines);
+    p->lines = lines;
+    p->line_slot_count = n;
+    return true;
+}
+
+static char *copy_string(const char *s)
+{
+    size_t len = strlen(s);
+    char *copy = (char *)malloc(len + 1);
+    if (copy != NULL) memcpy(copy, s, len + 1);
+    return copy;
+}
+
+// Returns the identifier of the function pushed by lua_getinfo, popping it, or NONE if out of memory.
+static uint32_t function_id(lua_State *L, profiler_t *p, lua_Debug *ar)
+{
+    const void *function = lua_topointer(L, -1);
+    if (p->func_slot_count > 0)
+    {
+        uint32_t slot = func_slot(p, function);
+        if (p->func_slots[slot] != 0)
+        {
+            lua_pop(L, 1);
+            return p->func_slots[slot] - 1;
+        }
+    }
+    if (!grow_func_slots(p) || !reserve((void **)&p->funcs, &p->func_capacity, p->func_count + 1, sizeof(func_t)))
+    {
+        lua_pop(L, 1);
+        return NONE;
+    }
+
+    // the first sample of the function: anchor it, so that its address is not reused
+    lua_rawgeti(L, LUA_REGISTRYINDEX, p->anchors); // f anchors
+    lua_insert(L, -2);                             // anchors f
+    lua_rawsetp(L, -2, function);                  // anchors
+    lua_pop(L, 1);                                 //
+    uint32_t id = p->func_count++;
+    func_t *func = &p->funcs[id];
+    memset(func, 0, sizeof(*func));
+    func->function = function;
+    lua_getinfo(L, "n", ar);
+    func->name = ar->name != NULL ? copy_string(ar->name) : NULL;
+    p->func_slots[func_slot(p, function)] = id + 1;
+    return id;
+}
+
+// Returns the child node of `parent` for the function `func`, adding it on its first use.
+static uint32_t child_node(profiler_t *p, uint32_t parent, uint32_t func)
+{
+    for (uint32_t i = p->nodes[parent].first_child; i != ROOT; i = p->nodes[i].next_sibling)
+    {
+        if (p->nodes[i].func == func) return i;
+    }
+    if (!reserve((void **)&p->nodes, &p->node_capacity, p->node_count + 1, sizeof(node_t))) return NONE;
+    uint32_t i = p->node_count++;
+    node_t *node = &p->nodes[i];
+    node->func = func;
+    node->parent = parent;
+    node->first_child = ROOT;
+    node->next_sibling = p->nodes[parent].first_child;
+    node->self = 0;
+    p->nodes[parent].first_child = i;
+    return i;
+}
+
+static bool record_sample(profiler_t *p, int depth, int line)
+{
+    if (p->node_count == 0)
+    {
+        if (!reserve((void **)&p->nodes, &p->node_capacity, 1, sizeof(node_t))) return false;
+        memset(&p->nodes[ROOT], 0, sizeof(node_t));
+        p->node_count = 1;
+    }
+    uint32_t node = ROOT;
+    for (int i = depth - 1; i >= 0; i--)
+    {
+        node = child_node(p, node, p->frames[i]);
+        if (node == NONE) return false;
+    }
+    if (!grow_lines(p)) return false;
+
+    p->samples++;
+    for (int i = 0; i < depth; i++)
+    {
+        // a recursive function is counted once per sample
+        func_t *func = &p->funcs[p->frames[i]];
+        if (func->stamp != p->samples)
+        {
+            func->stamp = p->samples;
+            func->total++;
+        }
+    }
+    p->funcs[p->frames[0]].self++;
+    p->nodes[node].self++;
+    line_t *entry = &p->lines[line_slot(p->lines, p->line_slot_count, p->frames[0], line)];
+    if (entry->func == NONE)
+    {
+        entry->func = p->frames[0];
+        entry->line = line;
+        entry->self = 0;
+        p->line_count++;
+    }
+    entry->self++;
+    return true;
+}
+
+// Samples the stack of `L`, keeping its innermost frames.
+static void take_sample(lua_State *L, profiler_t *p)
+{
+    lua_Debug ar;
+    int depth = 0;
+    int line = -1;
+    for (int level = 0; depth < p->depth && lua_getstack(L, level, &ar); level++)
+    {
+        lua_getinfo(L, level == 0 ? "fl" : "f", &ar);
+        if (level == 0) line = ar.currentline;
+        uint32_t func = function_id(L, p, &ar);
+        if (func == NONE)
+        {
+            p->dropped++;
+            return;
+        }
+        p->frames[depth++] = func;
+    }
+    if (depth > 0 && !record_sample(p, depth, line)) p->dropped++;
+}
+
+static void hook(lua_State *L, lua_Debug *ar)
+{
+    (void)ar;
+    profiler_t *p = running_profiler;
+    if (p == NULL || !p->running)
+    {
+        // a coroutine hooked by a profiler stopped since
+        lua_sethook(L, NULL, 0, 0);
+        return;
+    }
+    if (p->mode == MODE_TIMER) lua_sethook(L, NULL, 0, 0); // until the next tick
+    take_sample(L, p);
+}
+
+static void stop_profiler(profiler_t *p)
+{
+    if (!p->running) return;
+    if (p->mode == MODE_TIMER) stop_timer();
+    running_profiler = NULL;
+    p->running = false;
+    lua_sethook(p->main, NULL, 0, 0);
+}
+
+static void clear_profiler(lua_State *L, profiler_t *p)
+{
+    for (uint32_t f = 0; f < p->func_count; f++)
+    {
+        free(p->funcs[f].name);
+    }
+    free(p->funcs);
+    free(p->func_slots);
+    free(p->nodes);
+    free(p->lines);
+    p->funcs = NULL;
+    p->func_slots = NULL;
+    p->nodes = NULL;
+    p->lines = NULL;
+    p->func_count = p->func_capacity = p->func_slot_count = 0;
+    p->node_count = p->node_capacity = 0;
+    p->line_count = p->line_slot_count = 0;
+    p->samples = p->dropped = 0;
+    if (L != NULL)
+    {
+        lua_newtable(L);
+        lua_rawseti(L, LUA_REGISTRYINDEX, p->anchors);
+    }
+}
+
+static profiler_t *to_profiler(lua_State *L)
+{
+    return (profiler_t *)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+// Pushes a table of the labels of the functions, by identifier plus 1.
+static void push_labels(lua_State *L, profiler_t *p)
+{
+    lua_createtable(L, (int)p->func_count, 0);     // labels
+    lua_rawgeti(L, LUA_REGISTRYINDEX, p->anchors); // labels anchors
+    for (uint32_t f = 0; f < p->func_count; f++)
+    {
+        lua_Debug ar;
+        lua_rawgetp(L, -1, p->funcs[f].function); // labels anchors function
+        lua_getinfo(L, ">S", &ar);                // labels anchors
+        const char *name = p->funcs[f].name;
+        if (name == NULL) name = strcmp(ar.what, "main") == 0 ? "main chunk" : "?";
+        if (ar.linedefined > 0)
+            lua_pushfstring(L, "%s (%s:%d)", name, ar.short_src, ar.linedefined);
+        else
+            lua_pushfstring(L, "%s (%s)", name, ar.short_src);
+        lua_rawseti(L, -3, (lua_Integer)f + 1);
+    }
+    lua_pop(L, 1); // labels
+}
+
+// Pushes a row of report for a function, with its name, its source and a line, by default the
+// line where it is defined.
+static void push_row(lua_State *L, int anchors, const func_t *func, const int *line)
+{
+    lua_Debug ar;
+    lua_createtable(L, 0, 5);
+    lua_rawgetp(L, anchors, func->function);
+    lua_getinfo(L, ">S", &ar);
+    const char *name = func->name;
+    if (name == NULL) name = strcmp(ar.what, "main") == 0 ? "main chunk" : "?";
+    lua_pushstring(L, name);
+    lua_setfield(L, -2, "name");
+    lua_pushstring(L, ar.short_src);
+    lua_setfield(L, -2, "source");
+    lua_pushinteger(L, line != NULL ? *line : ar.linedefined);
+    lua_setfield(L, -2, "line");
+}
+
+static int compare_funcs(const void *a, const void *b)
+{
+    const func_t *x = *(const func_t *const *)a;
+    const func_t *y = *(const func_t *const *)b;
+    if (x->self != y->self) return x->self > y->self ? -1 : 1;
+    if (x->total != y->total) return x->total > y->total ? -1 : 1;
+    return 0;
+}
+
+static int compare_lines(const void *a, const void *b)
+{
+    const line_t *x = *(const line_t *const *)a;
+    const line_t *y = *(const line_t *const *)b;
+    if (x->self != y->self) return x->self > y->self ? -1 : 1;
+    return 0;
+}
+
+/***
+ * Starts the profiler.
+ *
+ * The following options are supported:
+ *
+ * - `mode` (string): `"timer"` or `"count"`. Defaults to `"timer"`.
+ * - `interval` (integer): the interval between the samples, in microseconds of CPU time in the
+ *   `"timer"` mode, defaulting to 1000; in instructions in the `"count"` mode, defaulting to 100000.
+ * - `depth` (integer): the maximum number of frames sampled, from 1 to 256. The outermost frames of
+ *   the deeper stacks are left out. Defaults to 64.
+ *
+ * The samples are added to those of the previous runs, until @{reset}.
+ *
+ * @function start
+ * @tparam[opt] table opts the options of the profiler.
+ * @treturn boolean `true` if the function succeeded; otherwise `false`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @raise If an option is not valid, or if a profiler is already running.
+ * @remark The timer of the CPU time fires at most once per tick of the kernel, every 1 to 10 milliseconds
+ * depending on its configuration. It counts the CPU time of all the threads of the process, so the threads running
+ * beside Lua, like the workers of `std.aio` or `fs.walk`, make the samples more frequent. On Windows, the `"timer"` mode samples at intervals of wall-clock time rounded to
+ * milliseconds.
+ */
+static int profile_start(lua_State *L)
+{
+    profiler_t *p = to_profiler(L);
+    int mode = MODE_TIMER;
+    lua_Integer interval = -1;
+    lua_Integer depth = DEFAULT_DEPTH;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "mode");
+        const char *name = luaL_optstring(L, -1, modes[MODE_TIMER]);
+        for (mode = 0; modes[mode] != NULL && strcmp(modes[mode], name) != 0; mode++)
+        {
+        }
+        luaL_argcheck(L, modes[mode] != NULL, 1, "invalid mode");
+        lua_getfield(L, 1, "interval");
+        interval = luaL_optinteger(L, -1, interval);
+        lua_getfield(L, 1, "depth");
+        depth = luaL_optinteger(L, -1, depth);
+        lua_pop(L, 3);
+    }
+    if (interval == -1) interval = mode == MODE_TIMER ? DEFAULT_TIMER_INTERVAL : DEFAULT_COUNT_INTERVAL;
+    luaL_argcheck(L, interval > 0 && interval <= (mode == MODE_TIMER ? MAX_TIMER_INTERVAL : INT_MAX), 1,
+                  "interval out of range");
+    luaL_argcheck(L, depth > 0 && depth <= MAX_DEPTH, 1, "depth out of range");
+    if (running_profiler != NULL) luaL_error(L, "a profiler is already running");
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    p->main = lua_tothread(L, -1);
+    lua_pop(L, 1);
+    p->mode = mode;
+    p->interval = interval;
+    p->depth = (int)depth;
+    p->running = true;
+    running_profiler = p;
+    if (mode == MODE_COUNT)
+    {
+        lua_sethook(p->main, hook, LUA_MASKCOUNT, (int)interval);
+        if (L != p->main) lua_sethook(L, hook, LUA_MASKCOUNT, (int)interval);
+    }
+    else if (!start_timer(interval))
+    {
+        running_profiler = NULL;
+        p->running = false;
+        _STD_RETURN_OK_ERROR(false)
+    }
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+/***
+ * Stops the profiler.
+ * @function stop
+ * @treturn integer the number of samples taken since the last @{reset}.
+ */
+static int profile_stop(lua_State *L)
+{
+    profiler_t *p = to_profiler(L);
+    stop_profiler(p);
+    if (L != p->main && p->main != NULL) lua_sethook(L, NULL, 0, 0);
+    lua_pushinteger(L, p->samples);
+    return 1;
+}
+
+/***
+ * Returns whether the profiler is running.
+ * @function running
+ * @treturn boolean `true` if the profiler is running; otherwise `false`.
+ */
+static int profile_running(lua_State *L)
+{
+    profiler_t *p = to_profiler(L);
+    lua_pushboolean(L, p->running);
+    return 1;
+}
+
+/***
+ * Discards the samples.
+ * @function reset
+ */
+static int profile_reset(lua_State *L)
+{
+    profiler_t *p = to_profiler(L);
+    clear_profiler(L, p);
+    return 0;
+}
+
+/***
+ * Returns the samples aggregated by function or by line, the most sampled first.
+ *
+ * Each row is a table with the following fields:
+ *
+ * - `name` (string): the name of the function, as called when first sampled.
+ * - `source` (string): the source of the function, as `short_src` of `debug.getinfo`.
+ * - `line` (integer): the line where the function is defined, or the line sampled.
+ * - `self` (integer): the number of samples in the function, or at the line.
+ * - `total` (integer): the number of samples in the function or in the functions it called, by
+ *   function only.
+ *
+ * @function report
+ * @tparam[opt="function"] string by `"function"` or `"line"`.
+ * @treturn table the rows of the report.
+ * @treturn integer the number of samples.
+ * @treturn integer the number of samples dropped for lack of memory.
+ */
+static int profile_report(lua_State *L)
+{
+    static const char *const keys[] = {"function", "line", NULL};
+    profiler_t *p = to_profiler(L);
+    bool by_line = luaL_checkoption(L, 1, "function", keys) == 1;
+    lua_settop(L, 0);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, p->anchors); // anchors
+    uint32_t count = by_line ? p->line_count : p->func_count;
+    void **rows = (void **)lua_newuserdatauv(L, (count > 0 ? count : 1) * sizeof(void *), 0); // anchors rows
+    uint32_t n = 0;
+    if (by_line)
+    {
+        for (uint32_t i = 0; i < p->line_slot_count; i++)
+        {
+            if (p->lines[i].func != NONE) rows[n++] = &p->lines[i];
+        }
+        qsort(rows, n, sizeof(void *), compare_lines);
+    }
+    else
+    {
+        for (uint32_t f = 0; f < p->func_count; f++)
+        {
+            if (p->funcs[f].total > 0) rows[n++] = &p->funcs[f];
+        }
+        qsort(rows, n, sizeof(void *), compare_funcs);
+    }
+
+    lua_createtable(L, (int)n, 0); // anchors rows report
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (by_line)
+        {
+            const line_t *line = (const line_t *)rows[i];
+            push_row(L, 1, &p->funcs[line->func], &line->line);
+            lua_pushinteger(L, line->self);
+            lua_setfield(L, -2, "self");
+        }
+        else
+        {
+            const func_t *func = (const func_t *)rows[i];
+            push_row(L, 1, func, NULL);
+            lua_pushinteger(L, func->self);
+            lua_setfield(L, -2, "self");
+            lua_pushinteger(L, func->total);
+            lua_setfield(L, -2, "total");
+        }
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    lua_pushinteger(L, p->samples);
+    lua_pushinteger(L, p->dropped);
+    return 3;
+}
+
+static void add_stack(lua_State *L, luaL_Buffer *b, profiler_t *p, uint32_t node)
+{
+    if (p->nodes[node].parent != ROOT)
+    {
+        add_stack(L, b, p, p->nodes[node].parent);
+        luaL_addchar(b, ';');
+    }
+    lua_rawgeti(L, 1, (lua_Integer)p->nodes[node].func + 1);
+    luaL_addvalue(b);
+}
+
+/***
+ * Returns the samples aggregated by stack, in the folded stacks format.
+ *
+ * Each line holds the functions of a stack, outermost first and separated by `;`, and the number
+ * of samples of the stack: the input of `flamegraph.pl` and of speedscope. The functions are
+ * labelled by their name, their source and the line where they are defined.
+ *
+ * @function folded
+ * @treturn string the folded stacks.
+ */
+static int profile_folded(lua_State *L)
+{
+    profiler_t *p = to_profiler(L);
+    lua_settop(L, 0);
+    push_labels(L, p); // labels
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    for (uint32_t i = 1; i < p->node_count; i++)
+    {
+        if (p->nodes[i].self == 0) continue;
+        add_stack(L, &b, p, i);
+        lua_pushfstring(L, " %I\n", p->nodes[i].self);
+        luaL_addvalue(&b);
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+static int profile_gc(lua_State *L)
+{
+    profiler_t *p = (profiler_t *)luaL_checkudata(L, 1, ProfilerMetatableName);
+    stop_profiler(p);
+    clear_profiler(NULL, p);
+    return 0;
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "folded", profile_folded },
+    { "report", profile_report },
+    { "reset", profile_reset },
+    { "running", profile_running },
+    { "start", profile_start },
+    { "stop", profile_stop },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_profile(lua_State *L)
+{
+    // the profiler of the Lua state, an upvalue of the functions
+    profiler_t *p = (profiler_t *)lua_newuserdatauv(L, sizeof(profiler_t), 0); // p
+    memset(p, 0, sizeof(*p));
+    lua_newtable(L);                                                          // p anchors
+    p->anchors = luaL_ref(L, LUA_REGISTRYINDEX);                              // p
+    luaL_newmetatable(L, ProfilerMetatableName);                              // p mt
+    lua_pushcfunction(L, profile_gc);                                         // p mt gc
+    lua_setfield(L, -2, "__gc");                                              // p mt
+    lua_setmetatable(L, -2);                                                  // p
+    lua_newtable(L);                                                          // p t
+    lua_insert(L, -2);                                                        // t p
+    luaL_setfuncs(L, funcs, 1);                                               // t
+    return 1;
+}
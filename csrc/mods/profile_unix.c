@@ -0,0 +1,57 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+static struct sigaction previous_action;
+// the thread running the Lua code sampled, which started the timer
+static pthread_t owner_thread;
+
+// The signal of the timer goes to any thread of the process, such as the workers of std.aio or
+// fs.walk: it is forwarded to the thread running the Lua code, so that the hook is only armed there.
+static void on_sigprof(int sig)
+{
+    if (pthread_equal(pthread_self(), owner_thread))
+    {
+        arm_hook();
+    }
+    else
+    {
+        int error = errno;
+        pthread_kill(owner_thread, sig);
+        errno = error;
+    }
+}
+
+// Starts a timer of the CPU time of the process, firing every `interval` microseconds.
+static bool start_timer(lua_Integer interval)
+{
+    owner_thread = pthread_self();
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigprof;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous_action) != 0) return false;
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = (time_t)(interval / (MILLIS_PER_SECOND * MICROS_PER_MILLI));
+    timer.it_interval.tv_usec = (suseconds_t)(interval % (MILLIS_PER_SECOND * MICROS_PER_MILLI));
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+    {
+        int error = errno;
+        sigaction(SIGPROF, &previous_action, NULL);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+static void stop_timer(void)
+{
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &previous_action, NULL);
+}
@@ -0,0 +1,25 @@
+#include <windows.h>
+
+static HANDLE timer_handle;
+
+static VOID CALLBACK on_timer(PVOID param, BOOLEAN fired)
+{
+    (void)param;
+    (void)fired;
+    arm_hook();
+}
+
+// Starts a timer firing every `interval` microseconds, rounded to milliseconds.
+static bool start_timer(lua_Integer interval)
+{
+    DWORD period = (DWORD)((interval + MICROS_PER_MILLI / 2) / MICROS_PER_MILLI);
+    if (period == 0) period = 1;
+    return CreateTimerQueueTimer(&timer_handle, NULL, on_timer, NULL, period, period, WT_EXECUTEDEFAULT);
+}
+
+static void stop_timer(void)
+{
+    // waits for the callbacks running
+    DeleteTimerQueueTimer(NULL, timer_handle, INVALID_HANDLE_VALUE);
+    timer_handle = NULL;
+}
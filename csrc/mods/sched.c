@@ -0,0 +1,417 @@
+/***
+ * Cooperative scheduling of coroutines.
+ *
+ * A @{Scheduler} runs tasks, coroutines which give way to each other when they wait: a task
+ * calling @{sleep} is suspended until its deadline while the other tasks run, and the process
+ * only sleeps when every task is waiting.
+ *
+ * The deadlines are kept in a hierarchical timer wheel keyed by the monotonic clock of
+ * @{std.time}, which holds any number of timers with a constant cost for adding and cancelling
+ * each of them.
+ *
+ * @usage
+ * local s = sched.new()
+ * for i = 1, 3 do
+ *   s:spawn(function()
+ *     sched.sleep(i * 100)
+ *     print(i)
+ *   end)
+ * end
+ * s:after(250, function() print('after 250 ms') end)
+ * s:run() -- prints 1, 2, after 250 ms, 3 in about 300 ms
+ *
+ * @module std.sched
+ */
+#include "std.h"
+#include "libsleep.h"
+#include "libsyserror.h"
+#include "libtime.h"
+#include "libwheel.h"
+
+#include <lauxlib.h>
+#include <stdlib.h>
+
+#define SchedulerMetatableName "std.sched.scheduler"
+
+#define DEFAULT_RESOLUTION 1
+#define MAX_RESOLUTION 1000
+#define MAX_DELAY (LUA_MAXINTEGER / NANOS_PER_MILLI / 2)
+
+// the uservalues of a scheduler
+enum
+{
+    UV_READY = 1,  // the queue of the tasks ready to run, from head to tail
+    UV_TIMERS = 2, // the sleeping tasks and the functions of the timers, keyed by the timer identifiers
+    UV_COUNT = 2
+};
+
+typedef struct
+{
+    wheel_t wheel;
+    lua_Integer resolution; // the nanoseconds per tick of the wheel
+    lua_Integer head;
+    lua_Integer tail;
+    bool running;
+} scheduler_t;
+
+// the first value yielded by sched.sleep, telling its tasks from the other coroutines
+static char sleep_marker;
+// the registry key of the task being resumed by a scheduler
+static char current_task;
+
+static scheduler_t *check_scheduler(lua_State *L, int arg)
+{
+    return (scheduler_t *)luaL_checkudata(L, arg, SchedulerMetatableName);
+}
+
+static lua_Integer check_delay(lua_State *L, int arg)
+{
+    lua_Integer millis = luaL_checkinteger(L, arg);
+    luaL_argcheck(L, millis <= MAX_DELAY, arg, "delay out of range");
+    return millis;
+}
+
+// Returns the tick at which a timer of `millis` milliseconds expires: the first one not earlier than its deadline.
+static uint64_t deadline_tick(lua_State *L, scheduler_t *s, lua_Integer millis)
+{
+    lua_Integer now;
+    if (!timeL_monotonic_time(&now)) syserrL_last_error(L);
+    lua_Integer deadline = now + (millis > 0 ? millis : 0) * NANOS_PER_MILLI;
+    return (uint64_t)((deadline + s->resolution - 1) / s->resolution);
+}
+
+// Adds a timer for the value at the top of the stack, which it pops, to the timers at `timers`.
+static lua_Integer add_timer(lua_State *L, scheduler_t *s, int timers, lua_Integer millis)
+{
+    int64_t id = wheelL_add(&s->wheel, deadline_tick(L, s, millis));
+    if (id < 0)
+    {
+        s->running = false;
+        luaL_error(L, "not enough memory");
+    }
+    lua_rawseti(L, timers, (lua_Integer)id);
+    return (lua_Integer)id;
+}
+
+// Queues the task at the top of the stack, which it pops, in the queue at `ready`.
+static void enqueue(lua_State *L, scheduler_t *s, int ready)
+{
+    lua_rawseti(L, ready, s->tail++);
+}
+
+/***
+ * Suspends the current task for a given number of milliseconds, letting the other tasks run.
+ *
+ * The task is resumed at the first tick of its scheduler after the delay. A delay less than or
+ * equal to zero just puts the task back at the end of the queue of the tasks ready to run, which
+ * is also what happens when a task calls `coroutine.yield`.
+ *
+ * @function sleep
+ * @tparam integer millis the number of milliseconds for which the task is to be suspended.
+ * @raise If it is not called from a task of a @{Scheduler}.
+ */
+static int sched_sleep(lua_State *L)
+{
+    lua_Integer millis = check_delay(L, 1);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &current_task);
+    // a coroutine created by the task would yield to the task instead of the scheduler
+    if (lua_tothread(L, -1) != L) luaL_error(L, "not called from a task of a scheduler");
+    lua_settop(L, 0);
+    lua_pushlightuserdata(L, &sleep_marker);
+    lua_pushinteger(L, millis);
+    return lua_yield(L, 2);
+}
+
+/***
+ * @type Scheduler
+ */
+
+/***
+ * Creates a task running a function with the given arguments, and queues it.
+ *
+ * The task runs the next time the scheduler runs its queue, either in @{run} or when the running
+ * task gives way.
+ *
+ * @function spawn
+ * @tparam function f the function of the task.
+ * @param ... the arguments of `f`.
+ * @treturn thread the coroutine of the task.
+ */
+static int sched_scheduler_spawn(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    int top = lua_gettop(L);
+    lua_State *co = lua_newthread(L);
+    lua_rotate(L, 2, 1); // s co f ...
+    lua_xmove(L, co, top - 1);
+    lua_getiuservalue(L, 1, UV_READY);
+    lua_pushvalue(L, 2);
+    enqueue(L, s, 3);
+    lua_settop(L, 2);
+    return 1;
+}
+
+/***
+ * Calls a function in a new task after a given number of milliseconds.
+ *
+ * @function after
+ * @tparam integer millis the delay in milliseconds.
+ * @tparam function f the function to call, without arguments.
+ * @treturn integer the identifier of the timer, for @{cancel}.
+ * @raise If the memory is exhausted.
+ */
+static int sched_scheduler_after(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    lua_Integer millis = check_delay(L, 2);
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    lua_settop(L, 3);
+    lua_getiuservalue(L, 1, UV_TIMERS);
+    lua_rotate(L, 3, 1);
+    lua_pushinteger(L, add_timer(L, s, 3, millis));
+    return 1;
+}
+
+/***
+ * Cancels a timer created by @{after}.
+ *
+ * @function cancel
+ * @tparam integer id the identifier of the timer.
+ * @treturn boolean `true` if the timer was cancelled; `false` if it has already expired or been cancelled.
+ */
+static int sched_scheduler_cancel(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    lua_Integer id = luaL_checkinteger(L, 2);
+    lua_getiuservalue(L, 1, UV_TIMERS);
+    // the timers of the sleeping tasks cannot be cancelled
+    bool cancelled = lua_rawgeti(L, 3, id) == LUA_TFUNCTION && wheelL_cancel(&s->wheel, (int64_t)id);
+    if (cancelled)
+    {
+        lua_pushnil(L);
+        lua_rawseti(L, 3, id);
+    }
+    lua_pushboolean(L, cancelled);
+    return 1;
+}
+
+/***
+ * Returns the number of pending timers: the sleeping tasks and the functions waiting for @{after}.
+ *
+ * @function pending
+ * @treturn integer the number of pending timers.
+ */
+static int sched_scheduler_pending(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    lua_pushinteger(L, (lua_Integer)s->wheel.count);
+    return 1;
+}
+
+typedef struct
+{
+    lua_State *L;
+    scheduler_t *s;
+} expire_ctx_t;
+
+// Queues the task of an expired timer, from the run loop.
+static void expire_timer(void *ctx, int64_t id)
+{
+    lua_State *L = ((expire_ctx_t *)ctx)->L;
+    scheduler_t *s = ((expire_ctx_t *)ctx)->s;
+    lua_rawgeti(L, 3, (lua_Integer)id);
+    lua_pushnil(L);
+    lua_rawseti(L, 3, (lua_Integer)id);
+    if (lua_isfunction(L, -1))
+    {
+        lua_State *co = lua_newthread(L);
+        lua_rotate(L, -2, 1);
+        lua_xmove(L, co, 1);
+    }
+    enqueue(L, s, 2);
+}
+
+// Resumes the task at the head of the queue, from the run loop.
+static void resume_task(lua_State *L, scheduler_t *s)
+{
+    lua_rawgeti(L, 2, s->head);
+    lua_pushnil(L);
+    lua_rawseti(L, 2, s->head++);
+    lua_State *co = lua_tothread(L, -1);
+
+    // a new task holds its function and arguments
+    int nargs = lua_status(co) == LUA_OK ? lua_gettop(co) - 1 : 0;
+    int nres;
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &current_task); // co previous
+    lua_pushvalue(L, -2);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &current_task);
+    int status = lua_resume(co, L, nargs, &nres);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &current_task); // co
+    if (status == LUA_YIELD)
+    {
+        bool sleeping = nres == 2 && lua_touserdata(co, -2) == &sleep_marker;
+        lua_Integer millis = sleeping ? lua_tointeger(co, -1) : 0;
+        lua_pop(co, nres);
+        if (millis > 0)
+            add_timer(L, s, 3, millis);
+        else
+            enqueue(L, s, 2);
+    }
+    else if (status == LUA_OK)
+    {
+        lua_pop(L, 1);
+    }
+    else
+    {
+        s->running = false;
+        if (lua_type(co, -1) == LUA_TSTRING)
+        {
+            luaL_traceback(L, co, lua_tostring(co, -1), 0);
+        }
+        else
+        {
+            lua_xmove(co, L, 1);
+        }
+        lua_error(L);
+    }
+}
+
+/***
+ * Runs the tasks until they have all completed and there are no pending timers.
+ *
+ * The tasks ready to run are resumed in turn, then the expired timers queue their tasks. When no
+ * task is ready, the thread sleeps until the next deadline.
+ *
+ * @function run
+ * @raise If a task raises an error, with its traceback. The other tasks are left to be run by a
+ * later call.
+ */
+static int sched_scheduler_run(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    if (s->running) luaL_error(L, "scheduler is already running");
+    lua_settop(L, 1);
+    lua_getiuservalue(L, 1, UV_READY);  // s ready
+    lua_getiuservalue(L, 1, UV_TIMERS); // s ready timers
+    expire_ctx_t ctx = {L, s};
+    s->running = true;
+    for (;;)
+    {
+        // the tasks queued meanwhile wait for the next round, after the expired timers
+        for (lua_Integer n = s->tail - s->head; n > 0; n--) resume_task(L, s);
+        if (s->head == s->tail && s->wheel.count == 0) break;
+
+        lua_Integer now;
+        if (!timeL_monotonic_time(&now))
+        {
+            s->running = false;
+            syserrL_last_error(L);
+        }
+        wheelL_advance(&s->wheel, (uint64_t)(now / s->resolution), expire_timer, &ctx);
+
+        uint64_t next;
+        if (s->head == s->tail && wheelL_next(&s->wheel, &next))
+        {
+            sleepL_sleep_until((lua_Integer)next * s->resolution);
+        }
+    }
+    s->running = false;
+    return 0;
+}
+
+static int sched_scheduler_gc(lua_State *L)
+{
+    scheduler_t *s = check_scheduler(L, 1);
+    wheelL_free(&s->wheel);
+    return 0;
+}
+
+/*** @section end */
+
+static void create_scheduler_metatable(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg scheduler_funcs[] = {
+#define XX(name) {#name, sched_scheduler_##name},
+        XX(after)
+        XX(cancel)
+        XX(pending)
+        XX(run)
+        XX(spawn)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg scheduler_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", sched_scheduler_gc},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    luaL_newmetatable(L, SchedulerMetatableName);  // mt
+    luaL_setfuncs(L, scheduler_meta_methods, 0);   // mt
+    luaL_newlibtable(L, scheduler_funcs);          // mt t
+    luaL_setfuncs(L, scheduler_funcs, 0);          // mt t
+    lua_setfield(L, -2, "__index");                // mt
+    lua_pop(L, 1);                                 //
+}
+
+/***
+ * Creates a scheduler.
+ *
+ * The following options are supported:
+ *
+ * - `resolution` (integer): the milliseconds per tick of the timer wheel, between 1 and 1000.
+ *   The deadlines are rounded up to a tick. Defaults to 1.
+ *
+ * @function new
+ * @tparam[opt] table opts the options of the scheduler.
+ * @treturn Scheduler the new scheduler.
+ * @raise If an option is not valid.
+ */
+static int sched_new(lua_State *L)
+{
+    lua_Integer resolution = DEFAULT_RESOLUTION;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "resolution");
+        resolution = luaL_optinteger(L, -1, resolution);
+        lua_pop(L, 1);
+        luaL_argcheck(L, resolution > 0 && resolution <= MAX_RESOLUTION, 1, "resolution out of range");
+    }
+
+    lua_Integer now;
+    if (!timeL_monotonic_time(&now)) syserrL_last_error(L);
+    scheduler_t *s = (scheduler_t *)lua_newuserdatauv(L, sizeof(scheduler_t), UV_COUNT);
+    s->resolution = resolution * NANOS_PER_MILLI;
+    s->head = s->tail = 1;
+    s->running = false;
+    wheelL_init(&s->wheel, (uint64_t)(now / s->resolution));
+    luaL_setmetatable(L, SchedulerMetatableName);
+    for (int uv = 1; uv <= UV_COUNT; uv++)
+    {
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, uv);
+    }
+    return 1;
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "new", sched_new },
+    { "sleep", sched_sleep },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_sched(lua_State *L)
+{
+    create_scheduler_metatable(L);
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
@@ -11,11 +11,39 @@
 #include <math.h>
 
 #define MILLIS_MAX INT_MAX
+#define NANOS_MAX (MILLIS_MAX * NANOS_PER_MILLI)
 
-static lua_Integer do_sleep(lua_State *L, lua_Integer millis)
+// clang-format off
+static const char *const modes[] = {"sleep", "hybrid", "spin", NULL};
+// clang-format on
+
+enum
+{
+    MODE_SLEEP,
+    MODE_HYBRID,
+    MODE_SPIN
+};
+
+static void wait_until(lua_Integer deadline, int mode)
 {
-    luaL_argcheck(L, (millis <= (lua_Number)MILLIS_MAX), 1, "value is too large");
-    if (millis <= 0) return 0;
+    switch (mode)
+    {
+        case MODE_SLEEP:
+            sleepL_sleep_until(deadline);
+            break;
+        case MODE_HYBRID:
+            sleepL_spin_until(deadline, SLEEP_SPIN_NANOS);
+            break;
+        default:
+            sleepL_spin_until(deadline, LUA_MAXINTEGER);
+            break;
+    }
+}
+
+static lua_Integer do_sleep(lua_State *L, lua_Integer nanos, int mode)
+{
+    luaL_argcheck(L, nanos <= NANOS_MAX, 1, "value is too large");
+    if (nanos <= 0) return 0;
 
     lua_Integer start_time;
     if (!timeL_monotonic_time(&start_time))
@@ -23,7 +51,10 @@ static lua_Integer do_sleep(lua_State *L, lua_Integer millis)
         return -1;
     }
 
-    sleepL_sleep(millis);
+    if (mode == MODE_SLEEP)
+        sleepL_sleep_ns(nanos);
+    else
+        wait_until(start_time + nanos, mode);
 
     lua_Integer now;
     if (!timeL_monotonic_time(&now))
@@ -31,7 +62,7 @@ static lua_Integer do_sleep(lua_State *L, lua_Integer millis)
         return -1;
     }
 
-    lua_Integer unslept = millis - (now - start_time) / NANOS_PER_MILLI;
+    lua_Integer unslept = nanos - (now - start_time);
     return unslept < 0 ? 0 : unslept;
 }
 
@@ -45,11 +76,12 @@ static lua_Integer do_sleep(lua_State *L, lua_Integer millis)
 static int sleep_sleep(lua_State *L)
 {
     lua_Number seconds = luaL_checknumber(L, 1);
+    luaL_argcheck(L, seconds <= (lua_Number)MILLIS_MAX / MILLIS_PER_SECOND, 1, "value is too large");
     lua_Integer millis = (lua_Integer)ceil(seconds * MILLIS_PER_SECOND);
-    lua_Integer unslept = do_sleep(L, millis);
+    lua_Integer unslept = do_sleep(L, millis > 0 ? millis * NANOS_PER_MILLI : 0, MODE_SLEEP);
     if (unslept >= 0)
     {
-        lua_pushnumber(L, unslept / (lua_Number)MILLIS_PER_SECOND);
+        lua_pushnumber(L, unslept / (lua_Number)NANOS_PER_SECOND);
         return 1;
     }
     _STD_RETURN_NIL_ERROR
@@ -65,7 +97,37 @@ static int sleep_sleep(lua_State *L)
 static int sleep_sleep_ms(lua_State *L)
 {
     lua_Integer millis = luaL_checkinteger(L, 1);
-    lua_Integer unslept = do_sleep(L, millis);
+    luaL_argcheck(L, millis <= MILLIS_MAX, 1, "value is too large");
+    lua_Integer unslept = do_sleep(L, millis > 0 ? millis * NANOS_PER_MILLI : 0, MODE_SLEEP);
+    if (unslept >= 0)
+    {
+        lua_pushinteger(L, unslept / NANOS_PER_MILLI);
+        return 1;
+    }
+    _STD_RETURN_NIL_ERROR
+}
+
+/***
+ * Suspends the execution of the Lua program for a given number of nanoseconds.
+ *
+ * The following modes are supported:
+ *
+ * - `"sleep"`: the thread sleeps. The kernel wakes it up late by its timer slack and its wakeup latency,
+ *   usually tens of microseconds.
+ * - `"hybrid"`: the thread sleeps until 100 microseconds before the deadline, then spins.
+ * - `"spin"`: the thread spins, keeping a processor busy for the whole wait.
+ *
+ * @function sleep_ns
+ * @tparam integer nanos the number of nanoseconds for which the execution is to be suspended.
+ * @tparam[opt="sleep"] string mode how to wait.
+ * @treturn integer the number of nanoseconds unslept.
+ * @remark the function return immediately if `nanos` is less than or equal to zero.
+ */
+static int sleep_sleep_ns(lua_State *L)
+{
+    lua_Integer nanos = luaL_checkinteger(L, 1);
+    int mode = luaL_checkoption(L, 2, "sleep", modes);
+    lua_Integer unslept = do_sleep(L, nanos, mode);
     if (unslept >= 0)
     {
         lua_pushinteger(L, unslept);
@@ -74,11 +136,88 @@ static int sleep_sleep_ms(lua_State *L)
     _STD_RETURN_NIL_ERROR
 }
 
+/***
+ * Suspends the execution of the Lua program until the monotonic clock reaches a deadline.
+ *
+ * Unlike a loop of relative sleeps, a periodic loop advancing its deadline by the period does not
+ * drift: the time spent between the sleeps and their overshoot are not accumulated.
+ *
+ * @function until_ns
+ * @tparam integer deadline the deadline, as a value of @{std.time.monotonic_ns}.
+ * @tparam[opt="sleep"] string mode how to wait, as @{sleep_ns}.
+ * @treturn integer the number of nanoseconds by which the deadline was overshot.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @usage
+ * local deadline = time.monotonic_ns()
+ * while running do
+ *   deadline = deadline + 1000000 -- 1 kHz
+ *   sleep.until_ns(deadline, 'hybrid')
+ *   step()
+ * end
+ */
+static int sleep_until_ns(lua_State *L)
+{
+    lua_Integer deadline = luaL_checkinteger(L, 1);
+    int mode = luaL_checkoption(L, 2, "sleep", modes);
+    wait_until(deadline, mode);
+    lua_Integer now;
+    if (timeL_monotonic_time(&now))
+    {
+        lua_pushinteger(L, now - deadline);
+        return 1;
+    }
+    _STD_RETURN_NIL_ERROR
+}
+
+/***
+ * Returns the timer slack of the calling thread: how late the kernel may wake it up, to group the wakeups.
+ * @function timer_slack
+ * @treturn integer the timer slack in nanoseconds.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @remark The timer slack is only supported on Linux, where it defaults to 50 microseconds.
+ */
+static int sleep_timer_slack(lua_State *L)
+{
+    lua_Integer nanos;
+    if (sleepL_timer_slack(&nanos))
+    {
+        lua_pushinteger(L, nanos);
+        return 1;
+    }
+    _STD_RETURN_NIL_ERROR
+}
+
+/***
+ * Sets the timer slack of the calling thread.
+ *
+ * A slack of 1 nanosecond makes the sleeps as precise as the kernel allows, at the cost of more
+ * wakeups; 0 restores the default slack of the thread.
+ *
+ * @function set_timer_slack
+ * @tparam integer nanos the timer slack in nanoseconds.
+ * @treturn boolean `true` if the function succeeded; otherwise `false`.
+ * @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function
+ * failed.
+ * @remark The timer slack is only supported on Linux.
+ */
+static int sleep_set_timer_slack(lua_State *L)
+{
+    lua_Integer nanos = luaL_checkinteger(L, 1);
+    luaL_argcheck(L, nanos >= 0 && nanos <= UINT_MAX, 1, "value out of range");
+    _STD_RETURN_OK_ERROR(sleepL_set_timer_slack(nanos))
+}
+
 // clang-format off
 static const struct luaL_Reg funcs[] =
 {
+    {"set_timer_slack", sleep_set_timer_slack},
     {"sleep", sleep_sleep},
     {"sleep_ms", sleep_sleep_ms},
+    {"sleep_ns", sleep_sleep_ns},
+    {"timer_slack", sleep_timer_slack},
+    {"until_ns", sleep_until_ns},
     { NULL, NULL }
 };
 // clang-format on
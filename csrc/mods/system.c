@@ -1,4 +1,5 @@
 #include "std.h"
+#include "liballocator.h"
 
 #include <lauxlib.h>
 
@@ -30,10 +31,31 @@ static int system_cpu_endianness(lua_State *L)
     return 1;
 }
 
+static int system_allocator_stats(lua_State *L)
+{
+    allocator_stats_t stats = allocatorL_stats(L);
+    lua_createtable(L, 0, 9);
+#define XX(name)                                  \
+    lua_pushinteger(L, (lua_Integer)stats.name); \
+    lua_setfield(L, -2, #name);
+    XX(allocations)
+    XX(bytes_allocated)
+    XX(bytes_in_use)
+    XX(peak_bytes)
+    XX(fallbacks)
+    XX(pool_hits)
+    XX(pooled_bytes)
+    XX(scratch_capacity)
+    XX(scratch_peak)
+#undef XX
+    return 1;
+}
+
 // clang-format off
 static const struct luaL_Reg funcs[] =
 {
 #define XX(name) { #name, system_ ## name },
+    XX(allocator_stats)
     XX(cpu_arch)
     XX(cpu_count)
     XX(cpu_endianness)
@@ -0,0 +1,664 @@
+/***
+ * Tracing and profiling of named spans.
+ *
+ * A @{Tracer} measures spans of code, opened with @{Tracer:begin} and closed with
+ * @{Tracer:finish}, or scoped by a to-be-closed variable with @{Tracer:span}. The spans nest: each
+ * one is the child of the span open when it began.
+ *
+ * The spans are timed with the cycle counter of @{std.time.cycles} and aggregated as they
+ * close, so that a tracer can be left on in production:
+ *
+ * - per name, by @{Tracer:stats}: the count, the total, minimum and maximum durations, and a
+ *   histogram of the durations;
+ * - per stack of names, by @{Tracer:folded}, in the folded stacks format of the flame graphs.
+ *
+ * The last spans closed are also kept in a ring buffer, exported as Chrome trace events by
+ * @{Tracer:chrome}.
+ *
+ * @usage
+ * local tracer = trace.new()
+ *
+ * local function parse(s)
+ *   local _ <close> = tracer:span('parse')
+ *   ...
+ * end
+ *
+ * tracer:begin('load')
+ * parse(s)
+ * tracer:finish()
+ *
+ * print(tracer:stats().parse.count)
+ * io.open('trace.json', 'w'):write(tracer:chrome())
+ *
+ * @module std.trace
+ */
+#include "std.h"
+#include "libtime.h"
+
+#include <lauxlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define TracerMetatableName "std.trace.tracer"
+#define SpanMetatableName "std.trace.span"
+
+#define DEFAULT_CAPACITY 65536
+#define MAX_CAPACITY (1 << 24)
+#define MAX_DEPTH 256
+#define HISTOGRAM_BUCKETS 64
+#define ROOT 0
+#define NAME_CACHE_SIZE 64
+
+// the uservalues of a tracer
+enum
+{
+    UV_IDS = 1,   // the identifiers of the names
+    UV_NAMES = 2, // the names, by identifier
+    UV_SPANS = 3, // the to-be-closed values returned by span, by depth
+    UV_COUNT = 3
+};
+
+typedef struct
+{
+    lua_Integer count;
+    lua_Integer total;
+    lua_Integer min;
+    lua_Integer max;
+    lua_Integer histogram[HISTOGRAM_BUCKETS]; // bucket k counts the durations of [2^k, 2^(k+1)) nanoseconds
+} name_stats_t;
+
+// A node of the call tree: the spans of a name begun in the spans of the parent node.
+typedef struct
+{
+    uint32_t name;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    lua_Integer count;
+    lua_Integer total;
+    lua_Integer children; // the time spent in the child spans
+} node_t;
+
+typedef struct
+{
+    lua_Integer start; // in cycles since the creation of the tracer
+    lua_Integer duration;
+    uint32_t name;
+    uint32_t depth;
+} event_t;
+
+typedef struct
+{
+    uint32_t node;
+    lua_Integer start;
+} frame_t;
+
+// The names are interned strings anchored by the tracer, so their addresses identify them: the cache
+// spares the lookup of the identifiers of the names seen last.
+typedef struct
+{
+    const char *name;
+    uint32_t id;
+} name_cache_t;
+
+typedef struct
+{
+    double ns_per_cycle;
+    lua_Integer origin;
+    name_stats_t *stats;
+    uint32_t name_count;
+    uint32_t name_capacity;
+    node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    event_t *events;
+    size_t capacity; // a power of 2, or 0 if the events are not kept
+    size_t head;     // the next event to write
+    size_t size;
+    lua_Integer dropped;
+    int depth;
+    frame_t stack[MAX_DEPTH];
+    name_cache_t cache[NAME_CACHE_SIZE];
+} tracer_t;
+
+// a to-be-closed value of a tracer, referencing it in its uservalue: the one of the spans begun at
+// `depth`, reused by them
+typedef struct
+{
+    tracer_t *tracer;
+    int depth;
+} span_t;
+
+static tracer_t *check_tracer(lua_State *L, int arg)
+{
+    return (tracer_t *)luaL_checkudata(L, arg, TracerMetatableName);
+}
+
+// Returns the userdata at 1 if its metatable is the first upvalue of the function: a cheaper
+// check than luaL_checkudata, which looks the metatable up in the registry by name.
+static void *to_self(lua_State *L, const char *tname)
+{
+    void *p = lua_touserdata(L, 1);
+    if (p != NULL && lua_getmetatable(L, 1))
+    {
+        bool ok = lua_rawequal(L, -1, lua_upvalueindex(1));
+        lua_pop(L, 1);
+        if (ok) return p;
+    }
+    return luaL_checkudata(L, 1, tname);
+}
+
+static name_cache_t *cache_slot(tracer_t *t, const char *name)
+{
+    return &t->cache[((uintptr_t)name >> 4) & (NAME_CACHE_SIZE - 1)];
+}
+
+// Grows an array of `*capacity` elements of `size` bytes to hold `count` elements.
+static void *reserve(lua_State *L, void *array, uint32_t *capacity, uint32_t count, size_t size)
+{
+    if (count <= *capacity) return array;
+    uint32_t n = *capacity == 0 ? 16 : *capacity * 2;
+    void *grown = realloc(array, n * size);
+    if (grown == NULL) luaL_error(L, "not enough memory");
+    *capacity = n;
+    return grown;
+}
+
+// Returns the identifier of the name at `arg`, registering it on its first use.
+static uint32_t intern(lua_State *L, tracer_t *t, int arg)
+{
+    if (lua_type(L, arg) != LUA_TSTRING) luaL_typeerror(L, arg, "string");
+    const char *name = lua_tostring(L, arg);
+    name_cache_t *slot = cache_slot(t, name);
+    if (slot->name == name) return slot->id;
+
+    uint32_t id;
+    lua_getiuservalue(L, 1, UV_IDS);   // ids
+    lua_getiuservalue(L, 1, UV_NAMES); // ids names
+    lua_pushvalue(L, arg);
+    if (lua_rawget(L, -3) == LUA_TNUMBER)
+    {
+        id = (uint32_t)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+    }
+    else
+    {
+        lua_pop(L, 1);
+        t->stats = (name_stats_t *)reserve(L, t->stats, &t->name_capacity, t->name_count + 1, sizeof(name_stats_t));
+        id = t->name_count++;
+        name_stats_t *stats = &t->stats[id];
+        memset(stats, 0, sizeof(*stats));
+        stats->min = LUA_MAXINTEGER;
+        lua_pushvalue(L, arg);
+        lua_pushinteger(L, id);
+        lua_rawset(L, -4);
+        lua_pushvalue(L, arg);
+        lua_rawseti(L, -2, (lua_Integer)id + 1);
+    }
+    // cache the anchored string: a long string equal to a name may be another object, reused once collected
+    lua_rawgeti(L, -1, (lua_Integer)id + 1);
+    name = lua_tostring(L, -1);
+    slot = cache_slot(t, name);
+    slot->name = name;
+    slot->id = id;
+    lua_pop(L, 3);
+    return id;
+}
+
+// Returns the child node of `parent` for the name `name`, adding it on its first use.
+static uint32_t child_node(lua_State *L, tracer_t *t, uint32_t parent, uint32_t name)
+{
+    for (uint32_t i = t->nodes[parent].first_child; i != ROOT; i = t->nodes[i].next_sibling)
+    {
+        if (t->nodes[i].name == name) return i;
+    }
+    t->nodes = (node_t *)reserve(L, t->nodes, &t->node_capacity, t->node_count + 1, sizeof(node_t));
+    uint32_t i = t->node_count++;
+    node_t *node = &t->nodes[i];
+    node->name = name;
+    node->parent = parent;
+    node->first_child = ROOT;
+    node->next_sibling = t->nodes[parent].first_child;
+    node->count = node->total = node->children = 0;
+    t->nodes[parent].first_child = i;
+    return i;
+}
+
+static void begin_span(lua_State *L, tracer_t *t, int arg)
+{
+    if (t->depth >= MAX_DEPTH) luaL_error(L, "spans nested too deeply");
+    uint32_t name = intern(L, t, arg);
+    uint32_t parent = t->depth > 0 ? t->stack[t->depth - 1].node : ROOT;
+    frame_t *frame = &t->stack[t->depth++];
+    frame->node = child_node(L, t, parent, name);
+    frame->start = timeL_cycles();
+}
+
+static int bucket_of(lua_Integer duration)
+{
+    if (duration < 2) return 0;
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, (unsigned long long)duration);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll((unsigned long long)duration);
+#endif
+}
+
+static void finish_span(lua_State *L, tracer_t *t)
+{
+    lua_Integer now = timeL_cycles();
+    if (t->depth == 0) luaL_error(L, "no span to finish");
+    frame_t *frame = &t->stack[--t->depth];
+    lua_Integer duration = (lua_Integer)((double)(now - frame->start) * t->ns_per_cycle);
+    if (duration < 0) duration = 0;
+
+    node_t *node = &t->nodes[frame->node];
+    node->count++;
+    node->total += duration;
+    t->nodes[node->parent].children += duration;
+
+    name_stats_t *stats = &t->stats[node->name];
+    stats->count++;
+    stats->total += duration;
+    if (duration < stats->min) stats->min = duration;
+    if (duration > stats->max) stats->max = duration;
+    stats->histogram[bucket_of(duration)]++;
+
+    if (t->capacity > 0)
+    {
+        event_t *event = &t->events[t->head];
+        event->start = frame->start - t->origin;
+        event->duration = duration;
+        event->name = node->name;
+        event->depth = (uint32_t)t->depth;
+        t->head = (t->head + 1) & (t->capacity - 1);
+        if (t->size < t->capacity)
+            t->size++;
+        else
+            t->dropped++;
+    }
+}
+
+/***
+ * @type Tracer
+ */
+
+/***
+ * Begins a span, nested in the span open if any.
+ * @function begin
+ * @tparam string name the name of the span.
+ * @raise If the spans are nested more than 256 deep.
+ */
+static int trace_tracer_begin(lua_State *L)
+{
+    tracer_t *t = (tracer_t *)to_self(L, TracerMetatableName);
+    begin_span(L, t, 2);
+    return 0;
+}
+
+/***
+ * Finishes the innermost open span.
+ * @function finish
+ * @raise If no span is open.
+ */
+static int trace_tracer_finish(lua_State *L)
+{
+    tracer_t *t = (tracer_t *)to_self(L, TracerMetatableName);
+    finish_span(L, t);
+    return 0;
+}
+
+/***
+ * Begins a span finished when the value returned goes out of scope, along with the spans begun in it
+ * and left open.
+ * @function span
+ * @tparam string name the name of the span.
+ * @return a value to assign to a to-be-closed variable.
+ * @raise If the spans are nested more than 256 deep.
+ * @usage
+ * local _ <close> = tracer:span('parse')
+ */
+static int trace_tracer_span(lua_State *L)
+{
+    tracer_t *t = (tracer_t *)to_self(L, TracerMetatableName);
+    begin_span(L, t, 2);
+    lua_getiuservalue(L, 1, UV_SPANS); // spans
+    if (lua_rawgeti(L, -1, t->depth) == LUA_TNIL)
+    {
+        lua_pop(L, 1);
+        span_t *span = (span_t *)lua_newuserdatauv(L, sizeof(span_t), 1); // spans span
+        span->tracer = t;
+        span->depth = t->depth;
+        luaL_setmetatable(L, SpanMetatableName);
+        lua_pushvalue(L, 1);
+        lua_setiuservalue(L, -2, 1);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, t->depth);
+    }
+    return 1;
+}
+
+// Finishes the span of the value closed and the spans nested in it, if they are still open.
+static int trace_span_close(lua_State *L)
+{
+    span_t *span = (span_t *)to_self(L, SpanMetatableName);
+    tracer_t *t = span->tracer;
+    while (t->depth >= span->depth)
+    {
+        finish_span(L, t);
+    }
+    return 0;
+}
+
+/***
+ * Returns the statistics of the spans finished, by name.
+ *
+ * The statistics of a name are a table with the following fields, the durations in nanoseconds:
+ *
+ * - `count` (integer): the number of spans.
+ * - `total` (integer): the total duration of the spans, including their child spans.
+ * - `min` (integer) and `max` (integer): the shortest and the longest durations.
+ * - `histogram` (table): the counts of the durations in powers of 2: `histogram[k]` counts the
+ *   durations from 2^(k-1) to 2^k - 1, and `histogram[1]` the durations under 2.
+ *
+ * @function stats
+ * @treturn table the statistics of each name.
+ */
+static int trace_tracer_stats(lua_State *L)
+{
+    tracer_t *t = check_tracer(L, 1);
+    lua_getiuservalue(L, 1, UV_NAMES); // t names
+    lua_newtable(L);                   // t names result
+    for (uint32_t id = 0; id < t->name_count; id++)
+    {
+        name_stats_t *stats = &t->stats[id];
+        if (stats->count == 0) continue;
+        lua_createtable(L, 0, 5);
+        lua_pushinteger(L, stats->count);
+        lua_setfield(L, -2, "count");
+        lua_pushinteger(L, stats->total);
+        lua_setfield(L, -2, "total");
+        lua_pushinteger(L, stats->min);
+        lua_setfield(L, -2, "min");
+        lua_pushinteger(L, stats->max);
+        lua_setfield(L, -2, "max");
+        int buckets = bucket_of(stats->max) + 1;
+        lua_createtable(L, buckets, 0);
+        for (int k = 0; k < buckets; k++)
+        {
+            lua_pushinteger(L, stats->histogram[k]);
+            lua_rawseti(L, -2, k + 1);
+        }
+        lua_setfield(L, -2, "histogram");
+        lua_rawgeti(L, 2, (lua_Integer)id + 1);
+        lua_insert(L, -2);
+        lua_rawset(L, 3);
+    }
+    return 1;
+}
+
+static void add_json_string(luaL_Buffer *b, const char *s, size_t len)
+{
+    luaL_addchar(b, '"');
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+        {
+            luaL_addchar(b, '\\');
+            luaL_addchar(b, (char)c);
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            luaL_addstring(b, escape);
+        }
+        else
+        {
+            luaL_addchar(b, (char)c);
+        }
+    }
+    luaL_addchar(b, '"');
+}
+
+/***
+ * Exports the last spans finished as Chrome trace events.
+ *
+ * The JSON document can be loaded in `chrome://tracing` or Perfetto. The tracer keeps the number
+ * of spans given by its `capacity` option: the older ones are dropped.
+ *
+ * @function chrome
+ * @treturn string the JSON document.
+ * @treturn integer the number of spans dropped.
+ */
+static int trace_tracer_chrome(lua_State *L)
+{
+    tracer_t *t = check_tracer(L, 1);
+    lua_settop(L, 1);
+    lua_getiuservalue(L, 1, UV_NAMES); // t names
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    luaL_addstring(&b, "{\"traceEvents\":[");
+    size_t first = t->size < t->capacity ? 0 : t->head;
+    for (size_t n = 0; n < t->size; n++)
+    {
+        event_t *event = &t->events[(first + n) & (t->capacity - 1)];
+        if (n > 0) luaL_addchar(&b, ',');
+        luaL_addstring(&b, "{\"name\":");
+        // the name stays anchored by the names once popped: the stack is not to be used across the buffer calls
+        lua_rawgeti(L, 2, (lua_Integer)event->name + 1);
+        size_t len;
+        const char *name = lua_tolstring(L, -1, &len);
+        lua_pop(L, 1);
+        add_json_string(&b, name, len);
+        char fields[128];
+        double start = (double)timeL_cycles_to_ns(event->start) / 1000.0;
+        snprintf(fields, sizeof(fields), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}", start,
+                 (double)event->duration / 1000.0);
+        luaL_addstring(&b, fields);
+    }
+    luaL_addstring(&b, "]}");
+    luaL_pushresult(&b);
+    lua_pushinteger(L, t->dropped);
+    return 2;
+}
+
+static void add_stack(lua_State *L, luaL_Buffer *b, tracer_t *t, uint32_t node)
+{
+    if (t->nodes[node].parent != ROOT)
+    {
+        add_stack(L, b, t, t->nodes[node].parent);
+        luaL_addchar(b, ';');
+    }
+    lua_rawgeti(L, 2, (lua_Integer)t->nodes[node].name + 1);
+    luaL_addvalue(b);
+}
+
+/***
+ * Exports the time spent in each stack of spans, in the folded stacks format.
+ *
+ * Each line holds the names of a stack of spans, outermost first and separated by `;`, and the
+ * time spent in the innermost span but not in its children, in nanoseconds: the input of
+ * `flamegraph.pl` and of speedscope.
+ *
+ * @function folded
+ * @treturn string the folded stacks.
+ */
+static int trace_tracer_folded(lua_State *L)
+{
+    tracer_t *t = check_tracer(L, 1);
+    lua_settop(L, 1);
+    lua_getiuservalue(L, 1, UV_NAMES); // t names
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    for (uint32_t i = 1; i < t->node_count; i++)
+    {
+        node_t *node = &t->nodes[i];
+        lua_Integer self = node->total - node->children;
+        if (node->count == 0 || self <= 0) continue;
+        add_stack(L, &b, t, i);
+        lua_pushfstring(L, " %I\n", self);
+        luaL_addvalue(&b);
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+/***
+ * Discards the statistics and the spans finished.
+ * @function reset
+ * @raise If a span is open.
+ */
+static int trace_tracer_reset(lua_State *L)
+{
+    tracer_t *t = check_tracer(L, 1);
+    if (t->depth > 0) luaL_error(L, "cannot reset a tracer with open spans");
+    for (uint32_t id = 0; id < t->name_count; id++)
+    {
+        memset(&t->stats[id], 0, sizeof(name_stats_t));
+        t->stats[id].min = LUA_MAXINTEGER;
+    }
+    memset(&t->nodes[ROOT], 0, sizeof(node_t));
+    t->node_count = 1;
+    t->head = t->size = 0;
+    t->dropped = 0;
+    return 0;
+}
+
+static int trace_tracer_gc(lua_State *L)
+{
+    tracer_t *t = check_tracer(L, 1);
+    free(t->stats);
+    free(t->nodes);
+    free(t->events);
+    t->stats = NULL;
+    t->nodes = NULL;
+    t->events = NULL;
+    t->name_count = t->name_capacity = t->node_count = t->node_capacity = 0;
+    t->capacity = t->size = 0;
+    return 0;
+}
+
+/*** @section end */
+
+static void create_metatables(lua_State *L)
+{
+    // clang-format off
+    const struct luaL_Reg tracer_funcs[] = {
+#define XX(name) {#name, trace_tracer_##name},
+        XX(begin)
+        XX(chrome)
+        XX(finish)
+        XX(folded)
+        XX(reset)
+        XX(span)
+        XX(stats)
+        {NULL, NULL}
+#undef XX
+    };
+
+    const struct luaL_Reg tracer_meta_methods[] = {
+        {"__index", NULL}, // placeholder
+        {"__gc", trace_tracer_gc},
+        {NULL, NULL}
+    };
+
+    const struct luaL_Reg span_meta_methods[] = {
+        {"__close", trace_span_close},
+        {NULL, NULL}
+    };
+    // clang-format on
+
+    // the methods check their userdata against the metatable in their upvalue
+    luaL_newmetatable(L, TracerMetatableName); // mt
+    luaL_setfuncs(L, tracer_meta_methods, 0);  // mt
+    luaL_newlibtable(L, tracer_funcs);         // mt t
+    lua_pushvalue(L, -2);                      // mt t mt
+    luaL_setfuncs(L, tracer_funcs, 1);         // mt t
+    lua_setfield(L, -2, "__index");            // mt
+    lua_pop(L, 1);                             //
+
+    luaL_newmetatable(L, SpanMetatableName);   // mt
+    lua_pushvalue(L, -1);                      // mt mt
+    luaL_setfuncs(L, span_meta_methods, 1);    // mt
+    lua_pop(L, 1);                             //
+}
+
+/***
+ * Creates a tracer.
+ *
+ * The following options are supported:
+ *
+ * - `capacity` (integer): the number of spans kept for @{Tracer:chrome}, rounded up to a power
+ *   of 2; 0 keeps none. Defaults to 65536.
+ *
+ * @function new
+ * @tparam[opt] table opts the options of the tracer.
+ * @treturn Tracer the new tracer.
+ * @raise If an option is not valid.
+ * @remark The first tracer calibrates the cycle counter, which takes about 2 milliseconds.
+ */
+static int trace_new(lua_State *L)
+{
+    lua_Integer capacity = DEFAULT_CAPACITY;
+    if (!lua_isnoneornil(L, 1))
+    {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "capacity");
+        capacity = luaL_optinteger(L, -1, capacity);
+        lua_pop(L, 1);
+        luaL_argcheck(L, capacity >= 0 && capacity <= MAX_CAPACITY, 1, "capacity out of range");
+    }
+    size_t rounded = 0;
+    if (capacity > 0)
+    {
+        rounded = 1;
+        while (rounded < (size_t)capacity) rounded <<= 1;
+    }
+
+    tracer_t *t = (tracer_t *)lua_newuserdatauv(L, sizeof(tracer_t), UV_COUNT);
+    memset(t, 0, sizeof(*t));
+    luaL_setmetatable(L, TracerMetatableName);
+    for (int uv = UV_IDS; uv <= UV_SPANS; uv++)
+    {
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, uv);
+    }
+
+    t->ns_per_cycle = (double)NANOS_PER_SECOND / (double)timeL_cycles_frequency(NULL);
+    t->origin = timeL_cycles();
+    t->nodes = (node_t *)reserve(L, NULL, &t->node_capacity, 1, sizeof(node_t));
+    memset(&t->nodes[ROOT], 0, sizeof(node_t));
+    t->node_count = 1;
+    if (rounded > 0)
+    {
+        t->events = (event_t *)malloc(rounded * sizeof(event_t));
+        if (t->events == NULL) luaL_error(L, "not enough memory");
+        t->capacity = rounded;
+    }
+    return 1;
+}
+
+// clang-format off
+static const struct luaL_Reg funcs[] =
+{
+    { "new", trace_new },
+    { NULL, NULL }
+};
+// clang-format on
+
+_STD_EXTERN int luaopen_std_trace(lua_State *L)
+{
+    create_metatables(L);
+    lua_newtable(L);
+    luaL_setfuncs(L, funcs, 0);
+    return 1;
+}
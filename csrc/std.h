@@ -1,13 +1,14 @@
 #pragma once
 
-#include <stdint.h>
-
+// must precede the first system header to take effect
 #if defined(_MSC_VER)
 #define WIN32_LEAN_AND_MEAN
-#elif defined(__GNUC__) || defined(__clang__)
+#elif (defined(__GNUC__) || defined(__clang__)) && !defined(_GNU_SOURCE)
 #define _GNU_SOURCE
 #endif
 
+#include <stdint.h>
+
 #if defined(_MSC_VER)
 #define _STD_EXTERN __declspec(dllexport)
 #define _STD_ALIGN(x) __declspec(align(x))
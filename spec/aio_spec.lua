@@ -0,0 +1,177 @@
+if package.config:sub(1, 1) ~= '/' then
+  return
+end
+
+describe("#aio", function()
+  local aio = require 'std.aio'
+
+  local helpers = require 'spec.helpers'
+  local read_file, temp_file, write_file = helpers.read_file, helpers.temp_file, helpers.write_file
+
+  -- Submits `op` and waits for its completion record.
+  local function run(ring, op)
+    local id = assert(ring:submit(op))
+    local records = ring:wait(1)
+    assert.are_equal(1, #records)
+    assert.are_equal(id, records[1].id)
+    return records[1]
+  end
+
+  for _, backend in ipairs({'threads', 'io_uring'}) do
+    describe(backend, function()
+      local ring, filename
+      before_each(function()
+        ring = aio.new({backend = backend})
+        filename = temp_file()
+      end)
+      after_each(function()
+        if ring then
+          ring:close()
+        end
+        os.remove(filename)
+      end)
+
+      it("should report its backend", function()
+        if not ring then
+          return -- io_uring is not available
+        end
+        assert.are_equal(backend, ring:backend())
+      end)
+      it("should open, write, read and close a file", function()
+        if not ring then
+          return
+        end
+        local fd = run(ring, {op = 'open', path = filename, mode = 'w+'}).result
+        assert.is_number(fd)
+        assert.are_equal(5, run(ring, {op = 'write', fd = fd, data = 'hello'}).result)
+        assert.are_equal(6, run(ring, {op = 'write', fd = fd, data = ' world', offset = 5}).result)
+        assert.is_true(run(ring, {op = 'fsync', fd = fd}).result)
+        assert.are_equal('world', run(ring, {op = 'read', fd = fd, length = 5, offset = 6}).result)
+        assert.are_equal('', run(ring, {op = 'read', fd = fd, length = 5, offset = 100}).result)
+        assert.is_true(run(ring, {op = 'close', fd = fd}).result)
+        assert.are_equal('hello world', read_file(filename))
+      end)
+      it("should read the metadata of a file", function()
+        if not ring then
+          return
+        end
+        write_file(filename, '12345')
+        local record = run(ring, {op = 'stat', path = filename, tag = 'x'})
+        assert.are_equal('stat', record.op)
+        assert.are_equal('x', record.tag)
+        assert.are_equal(5, record.result:length())
+        assert.is_true(record.result:is_file())
+      end)
+      it("should rename a file", function()
+        if not ring then
+          return
+        end
+        write_file(filename, 'a')
+        local to = temp_file()
+        assert.is_true(run(ring, {op = 'rename', path = filename, to = to}).result)
+        assert.are_equal('a', read_file(to))
+        os.remove(to)
+      end)
+      it("should report errors", function()
+        if not ring then
+          return
+        end
+        local record = run(ring, {op = 'open', path = filename})
+        assert.is_nil(record.result)
+        assert.is_string(record.err)
+        record = run(ring, {op = 'stat', path = filename})
+        assert.is_string(record.err)
+      end)
+      it("should keep many operations in flight", function()
+        if not ring then
+          return
+        end
+        write_file(filename, string.rep('x', 4096))
+        local fd = run(ring, {op = 'open', path = filename}).result
+        local ids = {}
+        for i = 1, 200 do
+          ids[assert(ring:submit({op = 'read', fd = fd, length = 16, offset = i, tag = i}))] = i
+        end
+        assert.are_equal(200, ring:pending())
+        local seen = 0
+        while ring:pending() > 0 do
+          for _, record in ipairs(ring:wait(10)) do
+            assert.are_equal(ids[record.id], record.tag)
+            assert.are_equal(string.rep('x', 16), record.result)
+            seen = seen + 1
+          end
+        end
+        assert.are_equal(200, seen)
+        run(ring, {op = 'close', fd = fd})
+      end)
+      it("should poll without waiting", function()
+        if not ring then
+          return
+        end
+        assert.are_same({}, ring:poll())
+        write_file(filename, 'a')
+        ring:submit({op = 'stat', path = filename})
+        local records = {}
+        while #records == 0 do
+          records = ring:poll()
+        end
+        assert.are_equal(1, #records)
+      end)
+      it("should time out", function()
+        if not ring then
+          return
+        end
+        assert.are_same({}, ring:wait(1, 10))
+      end)
+      it("should limit the operations in flight", function()
+        if not ring then
+          return
+        end
+        local small = aio.new({backend = backend, entries = 2})
+        write_file(filename, 'a')
+        assert.is_number(small:submit({op = 'stat', path = filename}))
+        assert.is_number(small:submit({op = 'stat', path = filename}))
+        local id, err = small:submit({op = 'stat', path = filename})
+        assert.is_nil(id)
+        assert.is_string(err)
+        small:close()
+      end)
+      it("should close the files opened by the operations not reaped", function()
+        local fs = require 'std.fs'
+        if not ring or not fs.metadata('/proc/self/fd') then
+          return
+        end
+        local function count_fds()
+          local n = 0
+          for _ in fs.entries('/proc/self/fd') do
+            n = n + 1
+          end
+          return n
+        end
+        write_file(filename, 'a')
+        local before = count_fds()
+        local other = aio.new({backend = backend})
+        for _ = 1, 8 do
+          assert.is_number(other:submit({op = 'open', path = filename}))
+        end
+        other:close()
+        assert.are_equal(before, count_fds())
+      end)
+      it("should reject invalid operations", function()
+        if not ring then
+          return
+        end
+        assert.has_error(function()
+          ring:submit({op = 'truncate'})
+        end)
+        assert.has_error(function()
+          ring:submit({op = 'read', fd = 0})
+        end)
+        assert.has_error(function()
+          ring:submit({op = 'open', path = filename, mode = 'x'})
+        end)
+        assert.are_equal(0, ring:pending())
+      end)
+    end)
+  end
+end)
@@ -208,6 +208,16 @@ describe("#array", function()
         return x == y
       end))
     end)
+    it("should returns the distinct elements using a hasher", function()
+      local hash = require 'std.hash'
+      local tablex = require 'std.tablex'
+      local a, b, c = {1, 2}, {2, 1}, {1, 2}
+      local r = array.distinct({a, b, c, a}, tablex.eq, hash.deep)
+      assert.are_equal(2, #r)
+      assert.are_equal(a, r[1])
+      assert.are_equal(b, r[2])
+      assert.same({1, 2}, array.distinct({1, 2, 1, 2, 1}, nil, hash.hash))
+    end)
   end)
   describe("except", function()
     it("should returns the set difference of the arrays", function()
@@ -215,6 +225,13 @@ describe("#array", function()
       assert.same({}, array.except({1}, {1}))
       assert.same({1, 2}, array.except({1, 2, 3}, {3}))
     end)
+    it("should returns the set difference of the arrays using a set", function()
+      local hash = require 'std.hash'
+      local hashmap = require 'std.hashmap'
+      local tablex = require 'std.tablex'
+      local set = hashmap.set({eq = tablex.eq, hash = hash.deep})
+      assert.same({{1}, {2}}, array.except({{1}, {2}, {3}}, {{3}}, set))
+    end)
   end)
   describe("intersect", function()
     it("should returns the set intersection of the arrays", function()
@@ -223,6 +240,13 @@ describe("#array", function()
       assert.same({}, array.intersect({}, {1}))
       assert.same({3, 3, 4}, array.intersect({1, 2, 3, 3, 4, 5}, {3, 3, 4}))
     end)
+    it("should returns the set intersection of the arrays using a map", function()
+      local hash = require 'std.hash'
+      local hashmap = require 'std.hashmap'
+      local tablex = require 'std.tablex'
+      local map = hashmap.map({eq = tablex.eq, hash = hash.deep})
+      assert.same({{3}, {3}, {4}}, array.intersect({{1}, {3}, {3}, {4}, {4}}, {{3}, {4}, {3}}, map))
+    end)
   end)
   describe("filter", function()
     it("should return the elements satisfying the condition", function()
@@ -1,15 +1,499 @@
--- describe("#fs", function()
---   local path = require 'std.path'
---   local fs = require 'std.fs'
---   describe("create_directory/remove_directory", function()
---     local filename = path.random_file_name()
---     it("should create a directory " .. filename, function()
---       local ok, err = fs.create_directory(filename)
---       assert.is_true(ok, err)
---     end)
---     it("should delete a directory " .. filename, function()
---       local ok, err = fs.remove_directory(filename)
---       assert.is_true(ok, err)
---     end)
---   end)
--- end)
+describe("#fs", function()
+  local path = require 'std.path'
+  local fs = require 'std.fs'
+
+  local helpers = require 'spec.helpers'
+  local read_file, temp_file, write_file = helpers.read_file, helpers.temp_file, helpers.write_file
+
+  describe("create_directory/remove_directory", function()
+    local filename = path.random_file_name()
+    it("should create a directory " .. filename, function()
+      local ok, err = fs.create_directory(filename)
+      assert.is_true(ok, err)
+    end)
+    it("should delete a directory " .. filename, function()
+      local ok, err = fs.remove_directory(filename)
+      assert.is_true(ok, err)
+    end)
+  end)
+
+  describe("copy_file", function()
+    local src, dst
+    local content = string.rep('0123456789abcdef', 100000)
+    before_each(function()
+      src, dst = temp_file(), temp_file()
+      write_file(src, content)
+    end)
+    after_each(function()
+      os.remove(src)
+      os.remove(dst)
+    end)
+    it("should copy a file", function()
+      assert.is_true(fs.copy_file(src, dst))
+      assert.are_equal(content, read_file(dst))
+    end)
+    it("should not overwrite a file", function()
+      write_file(dst, 'x')
+      local ok, err = fs.copy_file(src, dst)
+      assert.is_false(ok)
+      assert.not_nil(err)
+      assert.are_equal('x', read_file(dst))
+    end)
+    it("should overwrite a larger file", function()
+      write_file(dst, content .. content)
+      assert.is_true(fs.copy_file(src, dst, true))
+      assert.are_equal(content, read_file(dst))
+      write_file(dst, content .. content)
+      assert.is_true(fs.copy_file(src, dst, {overwrite = true}))
+      assert.are_equal(content, read_file(dst))
+    end)
+    it("should not copy a file onto itself", function()
+      assert.is_false(fs.copy_file(src, src, true))
+      assert.are_equal(content, read_file(src))
+    end)
+    it("should copy an empty file", function()
+      write_file(src, '')
+      assert.is_true(fs.copy_file(src, dst))
+      assert.are_equal('', read_file(dst))
+    end)
+    it("should report the progress", function()
+      local calls, last = 0, nil
+      assert.is_true(fs.copy_file(src, dst, {
+        progress = function(copied, total)
+          calls = calls + 1
+          last = copied
+          assert.are_equal(#content, total)
+        end,
+        progress_interval = 65536
+      }))
+      assert.is_true(calls >= 1)
+      assert.are_equal(#content, last)
+      assert.are_equal(content, read_file(dst))
+    end)
+    it("should cancel the copy", function()
+      local ok = fs.copy_file(src, dst, {
+        progress = function()
+          return false
+        end,
+        progress_interval = 65536
+      })
+      if package.config:sub(1, 1) == '/' then
+        assert.is_false(ok)
+        assert.is_nil(io.open(dst))
+      end
+    end)
+    it("should copy a sparse file", function()
+      assert.is_true(fs.copy_file(src, dst, {sparse = true}))
+      assert.are_equal(content, read_file(dst))
+      -- a hole of 8 MiB between two bytes
+      local f = assert(io.open(src, 'wb'))
+      f:write('a')
+      f:seek('set', 8 * 1024 * 1024)
+      f:write('b')
+      f:close()
+      assert.is_true(fs.copy_file(src, dst, {sparse = true, overwrite = true}))
+      local size = 8 * 1024 * 1024 + 1
+      assert.are_equal(size, fs.metadata(dst):length())
+      assert.are_equal('b', read_file(dst):sub(-1))
+      local blocks = fs.metadata(src):blocks()
+      if blocks and blocks * 512 < size then
+        -- the file system keeps holes: the copy has them too
+        assert.is_true(fs.metadata(dst):blocks() * 512 < size)
+      end
+    end)
+    if package.config:sub(1, 1) == '/' then
+      it("should not copy the permissions if not asked to", function()
+        os.execute("chmod 750 '" .. src .. "'")
+        os.remove(dst)
+        assert.is_true(fs.copy_file(src, dst, {permissions = false}))
+        assert.is_nil(os.execute("test -x '" .. dst .. "'"))
+        os.remove(dst)
+        assert.is_true(fs.copy_file(src, dst))
+        assert.is_true(os.execute("test -x '" .. dst .. "'"))
+      end)
+    end
+    it("should preserve the timestamps", function()
+      assert.is_true(fs.copy_file(src, dst, {timestamps = true}))
+      assert.are_equal(fs.metadata(src):modified(), fs.metadata(dst):modified())
+    end)
+  end)
+  describe("metadata", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+      write_file(filename, '0123456789')
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+    it("should return the metadata of a file", function()
+      local m = assert(fs.metadata(filename))
+      assert.is_true(m:is_file())
+      assert.is_false(m:is_directory())
+      assert.are_equal(10, m:length())
+      assert.are_equal(m:modified_ns() // 1000000, m:modified())
+      assert.is_true(math.abs(m:modified() - os.time() * 1000) < 60000)
+    end)
+    it("should return only the requested fields", function()
+      local m = assert(fs.metadata(filename, {fields = {'length'}}))
+      assert.are_equal(10, m:length())
+      assert.is_true(m:is_file())
+      if package.config:sub(1, 1) == '/' then
+        m = assert(fs.metadata(filename, {fields = 'modified'}))
+        assert.is_nil(m:length())
+        assert.is_number(m:modified())
+      end
+    end)
+    it("should reject unknown fields", function()
+      assert.has_error(function()
+        fs.metadata(filename, {fields = {'length', 'colour'}})
+      end)
+    end)
+    it("should fail on a missing file", function()
+      local m, err = fs.metadata(filename .. '.missing')
+      assert.is_nil(m)
+      assert.is_string(err)
+    end)
+    it("should return the metadata of several files", function()
+      local ms, errs = fs.metadata_many({filename, filename .. '.missing', filename})
+      assert.are_equal(3, #ms)
+      assert.are_equal(10, ms[1]:length())
+      assert.is_false(ms[2])
+      assert.are_equal(10, ms[3]:length())
+      assert.is_string(errs[2])
+      assert.is_nil(errs[1])
+      ms, errs = fs.metadata_many({filename})
+      assert.are_equal(1, #ms)
+      assert.is_nil(errs)
+    end)
+    if package.config:sub(1, 1) == '/' then
+      it("should return the Unix fields", function()
+        local m = assert(fs.metadata(filename))
+        assert.is_true(m:inode() > 0)
+        assert.are_equal(1, m:links())
+        assert.is_number(m:device())
+        assert.is_number(m:blocks())
+        assert.is_number(m:changed_ns())
+      end)
+      it("should follow symbolic links", function()
+        local link = filename .. '.link'
+        os.execute("ln -s '" .. filename .. "' '" .. link .. "'")
+        assert.is_true(fs.metadata(link):is_symlink())
+        assert.is_true(fs.metadata(link, {follow_symlinks = true}):is_file())
+        os.remove(link)
+      end)
+    end
+  end)
+
+  describe("mmap", function()
+    local filename
+    local content = 'first line\nsecond line\r\n\nlast line'
+    before_each(function()
+      filename = temp_file()
+      write_file(filename, content)
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+    it("should read a mapped file", function()
+      local m <close> = assert(fs.mmap(filename))
+      assert.are_equal(#content, #m)
+      assert.are_equal(#content, m:len())
+      assert.are_equal(content, m:sub(1))
+      for _, r in ipairs({{1, 5}, {-4, -1}, {3, 2}, {0, 100}, {-100, 3}, {12, -3}}) do
+        assert.are_equal(content:sub(r[1], r[2]), m:sub(r[1], r[2]))
+      end
+      assert.are_same({content:byte(1, 4)}, {m:byte(1, 4)})
+      assert.are_equal(content:byte(-1), m:byte(-1))
+    end)
+    it("should find a string", function()
+      local m <close> = assert(fs.mmap(filename))
+      assert.are_same({content:find('line', 1, true)}, {m:find('line')})
+      assert.are_same({content:find('line', 5, true)}, {m:find('line', 5)})
+      assert.are_same({content:find('line', -4, true)}, {m:find('line', -4)})
+      assert.is_nil(m:find('missing'))
+    end)
+    it("should iterate the lines", function()
+      local m <close> = assert(fs.mmap(filename))
+      local lines = {}
+      for line in m:lines() do
+        lines[#lines + 1] = line
+      end
+      local expected = {}
+      for line in io.lines(filename) do
+        expected[#expected + 1] = line
+      end
+      assert.are_same(expected, lines)
+      assert.is_true(m:advise('sequential'))
+    end)
+    it("should map an empty file", function()
+      write_file(filename, '')
+      local m <close> = assert(fs.mmap(filename))
+      assert.are_equal(0, #m)
+      assert.are_equal('', m:sub(1))
+      assert.is_nil(m:lines()())
+    end)
+    it("should not use a closed mapping", function()
+      local m = assert(fs.mmap(filename))
+      m:close()
+      assert.has_error(function()
+        m:sub(1)
+      end)
+    end)
+    it("should fail on a missing file", function()
+      local m, err = fs.mmap(filename .. '.missing')
+      assert.is_nil(m)
+      assert.is_string(err)
+    end)
+  end)
+
+  describe("predicates", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+      write_file(filename, 'x')
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+    it("should test a missing path", function()
+      assert.is_false(fs.exists(filename .. '.missing'))
+      assert.is_false(fs.file_exists(filename .. '.missing'))
+      assert.is_false(fs.directory_exists(filename .. '.missing'))
+      local ok, err = fs.is_file(filename .. '.missing')
+      assert.is_nil(ok)
+      assert.is_string(err)
+    end)
+    it("should test a file", function()
+      assert.is_true(fs.exists(filename))
+      assert.is_true(fs.file_exists(filename))
+      assert.is_true(fs.is_file(filename))
+      assert.is_false(fs.is_directory(filename))
+      assert.is_false(fs.is_symlink(filename))
+    end)
+    it("should not remove a file as a directory", function()
+      local ok, err = fs.remove_directory(filename)
+      assert.is_false(ok)
+      assert.is_string(err)
+      assert.is_true(fs.exists(filename))
+    end)
+  end)
+
+  describe("stat_cache", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+      write_file(filename, 'x')
+    end)
+    after_each(function()
+      os.remove(filename)
+      os.remove(filename .. '.moved')
+    end)
+    it("should cache the metadata of a path", function()
+      local cache = fs.stat_cache()
+      assert.is_true(fs.exists(filename, cache))
+      assert.is_true(fs.file_exists(filename, cache))
+      assert.is_true(fs.is_file(filename, cache))
+      assert.is_false(fs.is_directory(filename, cache))
+      assert.are_equal(1, fs.metadata(filename, {cache = cache}):length())
+      assert.are_same({hits = 4, misses = 1, entries = 1, generation = 0}, cache:stats())
+    end)
+    it("should cache missing paths", function()
+      local cache = fs.stat_cache()
+      assert.is_false(fs.exists(filename .. '.missing', cache))
+      assert.is_false(fs.file_exists(filename .. '.missing', cache))
+      local ok, err = fs.is_file(filename .. '.missing', cache)
+      assert.is_nil(ok)
+      assert.is_string(err)
+      local m, err2 = fs.metadata(filename .. '.missing', {cache = cache})
+      assert.is_nil(m)
+      assert.is_string(err2)
+      assert.are_equal(1, cache:stats().misses)
+    end)
+    it("should see the changes made through std.fs", function()
+      local cache = fs.stat_cache()
+      assert.is_true(fs.exists(filename, cache))
+      assert.is_true(fs.rename(filename, filename .. '.moved'))
+      assert.is_false(fs.exists(filename, cache))
+      assert.is_true(fs.exists(filename .. '.moved', cache))
+      assert.is_true(fs.remove_file(filename .. '.moved'))
+      assert.is_false(fs.exists(filename .. '.moved', cache))
+    end)
+    it("should invalidate entries", function()
+      local cache = fs.stat_cache()
+      assert.is_true(fs.exists(filename, cache))
+      os.remove(filename)
+      assert.is_true(fs.exists(filename, cache))
+      cache:invalidate(filename)
+      assert.is_false(fs.exists(filename, cache))
+      cache:invalidate()
+      assert.are_same({hits = 1, misses = 2, entries = 0, generation = 1}, cache:stats())
+    end)
+    it("should expire entries", function()
+      local cache = fs.stat_cache({ttl = 1})
+      assert.is_true(fs.exists(filename, cache))
+      local t0 = os.clock()
+      repeat until os.clock() - t0 > 0.01
+      assert.is_true(fs.exists(filename, cache))
+      assert.are_equal(2, cache:stats().misses)
+    end)
+  end)
+
+  if package.config:sub(1, 1) == '/' then
+    describe("walk", function()
+      local root
+      local tree = {'a/', 'a/b/', 'a/b/c/', 'd/', 'x.lua', 'a/y.txt', 'a/b/z.lua', 'a/b/c/w.lua'}
+
+      local function walk(opts)
+        local found = {}
+        for p, type, depth in fs.walk(root, opts) do
+          found[p:sub(#root + 2)] = {type, depth}
+        end
+        return found
+      end
+
+      local function count(t)
+        local n = 0
+        for _ in pairs(t) do n = n + 1 end
+        return n
+      end
+
+      before_each(function()
+        root = temp_file()
+        assert(fs.create_directory(root))
+        for _, entry in ipairs(tree) do
+          if entry:sub(-1) == '/' then
+            assert(fs.create_directory(path.combine(root, entry:sub(1, -2))))
+          else
+            write_file(path.combine(root, entry), entry)
+          end
+        end
+      end)
+      after_each(function()
+        os.execute("rm -rf '" .. root .. "'")
+      end)
+      it("should walk a directory tree", function()
+        local found = walk()
+        assert.are_equal(#tree, count(found))
+        assert.are_same({'directory', 1}, found['a'])
+        assert.are_same({'directory', 3}, found['a/b/c'])
+        assert.are_same({'file', 1}, found['x.lua'])
+        assert.are_same({'file', 4}, found['a/b/c/w.lua'])
+      end)
+      it("should respect max_depth", function()
+        local found = walk({max_depth = 2})
+        assert.are_equal(5, count(found))
+        assert.is_nil(found['a/b/z.lua'])
+      end)
+      it("should filter entries", function()
+        local found = walk({include = '*.lua', exclude = {'c'}})
+        assert.are_same({['x.lua'] = {'file', 1}, ['a/b/z.lua'] = {'file', 3}}, found)
+        found = walk({exclude = 'a/b'})
+        assert.are_equal(4, count(found))
+      end)
+      it("should walk with threads", function()
+        local found = {}
+        for paths, types in fs.walk(root, {threads = 4, batch = 3}) do
+          assert.is_true(#paths <= 3)
+          assert.are_equal(#paths, #types)
+          for i = 1, #paths do
+            found[paths[i]:sub(#root + 2)] = types[i]
+          end
+        end
+        assert.are_equal(#tree, count(found))
+        assert.are_equal('directory', found['a/b/c'])
+        assert.are_equal('file', found['a/b/c/w.lua'])
+      end)
+      it("should accept batches larger than the tree", function()
+        local batches = 0
+        for paths in fs.walk(root, {batch = 2147483647}) do
+          assert.are_equal(#tree, #paths)
+          batches = batches + 1
+        end
+        assert.are_equal(1, batches)
+      end)
+      it("should follow symbolic links", function()
+        os.execute("ln -s '" .. path.combine(root, 'a') .. "' '" .. path.combine(root, 'd/link') .. "'")
+        assert.are_same({'symlink', 2}, walk()['d/link'])
+        assert.are_same({'directory', 2}, walk({follow_symlinks = true})['d/link'])
+      end)
+      it("should visit each directory once with threads", function()
+        os.execute("ln -s '" .. root .. "' '" .. path.combine(root, 'a/b/loop') .. "'")
+        local found = {}
+        for p, type in fs.walk(root, {threads = 4, follow_symlinks = true}) do
+          found[p:sub(#root + 2)] = type
+        end
+        local sequential = walk({follow_symlinks = true})
+        assert.are_equal(count(sequential), count(found))
+        assert.are_equal(#tree + 1, count(found))
+        assert.are_equal('directory', found['a/b/loop'])
+        assert.is_nil(found['a/b/loop/a'])
+      end)
+      it("should fail on a missing directory", function()
+        local iter, err = fs.walk(path.combine(root, 'missing'))
+        assert.is_nil(iter)
+        assert.is_string(err)
+      end)
+    end)
+
+    describe("read_dir", function()
+      local root
+      local names = {'a', 'b.txt', 'c.lua', 'd', 'e'}
+
+      before_each(function()
+        root = temp_file()
+        assert(fs.create_directory(root))
+        for _, name in ipairs(names) do
+          if name:find('.', 1, true) then
+            write_file(path.combine(root, name), name)
+          else
+            assert(fs.create_directory(path.combine(root, name)))
+          end
+        end
+      end)
+      after_each(function()
+        os.execute("rm -rf '" .. root .. "'")
+      end)
+      it("should read a directory in batches", function()
+        local found, batches, last = {}, 0, nil
+        for records, n in fs.read_dir(root, {batch = 2}) do
+          assert.is_true(n <= 2)
+          assert.are_equal(n, #records)
+          assert.is_true(last == nil or last == records)
+          last = records
+          batches = batches + 1
+          for i = 1, n do
+            assert.is_number(records[i].ino)
+            found[records[i].name] = records[i].type
+          end
+        end
+        assert.are_equal(3, batches)
+        assert.are_same({a = 'directory', ['b.txt'] = 'file', ['c.lua'] = 'file', d = 'directory', e = 'directory'}, found)
+      end)
+      it("should accept batches larger than the directory", function()
+        local batches = 0
+        for records, n in fs.read_dir(root, {batch = 2147483647}) do
+          assert.are_equal(5, n)
+          assert.are_equal(5, #records)
+          batches = batches + 1
+        end
+        assert.are_equal(1, batches)
+      end)
+      it("should return the metadata of the entries", function()
+        local found = {}
+        for records, n in fs.read_dir(root, {with_type = false, with_stat = true}) do
+          for i = 1, n do
+            assert.is_nil(records[i].type)
+            found[records[i].name] = records[i].stat:is_directory()
+          end
+        end
+        assert.are_same({a = true, ['b.txt'] = false, ['c.lua'] = false, d = true, e = true}, found)
+      end)
+      it("should fail on a missing directory", function()
+        local iter, err = fs.read_dir(path.combine(root, 'missing'))
+        assert.is_nil(iter)
+        assert.is_string(err)
+      end)
+    end)
+  end
+end)
@@ -82,6 +82,32 @@ describe("#func", function()
         return nil, x * x
       end, 1)
     end)
+    it("should cache the function execution by key", function()
+      local hash = require 'std.hash'
+      local call_count = 0
+      local mf = func.memoize1(function(t)
+        call_count = call_count + 1
+        return #t
+      end, hash.deep)
+      assert.are_equal(2, mf({1, 2}))
+      assert.are_equal(2, mf({1, 2}))
+      assert.are_equal(1, call_count)
+      assert.are_equal(3, mf({1, 2, 3}))
+      assert.are_equal(2, call_count)
+    end)
+    it("should tell apart the arguments with the same hash", function()
+      local mf = func.memoize1(function(t)
+        return #t
+      end, function() return 0 end)
+      assert.are_equal(2, mf({1, 2}))
+      assert.are_equal(3, mf({1, 2, 3}))
+      assert.are_equal(2, mf({1, 2}))
+      local mf2 = func.memoize2(function(x, y)
+        return x .. y
+      end, function() return 0 end)
+      assert.are_equal("ab", mf2("a", "b"))
+      assert.are_equal("ba", mf2("b", "a"))
+    end)
   end)
   describe("memoize2", function()
     it("should cache the function execution", function()
@@ -47,4 +47,88 @@ describe("#hash", function()
     assert.are_equal(hash.hash(t1), hash.hash(t2))
     assert.are_equal(hash.hash(t1), hash.hash(t1))
   end)
+  it("should use all the characters of a string", function()
+    local prefix = ('x'):rep(4096)
+    assert.are_not_equal(hash.hash(prefix .. 'a'), hash.hash(prefix .. 'b'))
+    assert.are_not_equal(hash.string(prefix .. 'a'), hash.string(prefix .. 'b'))
+  end)
+  it("should return the 64 bits hash code of a string", function()
+    assert.are_equal(hash.string("abc"), hash.string("abc"))
+    assert.are_equal(hash.string("abc", 42), hash.string("abc", 42))
+    assert.are_not_equal(hash.string("abc", 1), hash.string("abc", 2))
+    assert.are_not_equal(hash.string(""), hash.string("\0"))
+  end)
+  it("should hash incrementally", function()
+    local s = {}
+    for i = 1, 300 do
+      s[i] = string.char(i % 251)
+    end
+    s = table.concat(s)
+    for len = 0, #s, 7 do
+      local x = s:sub(1, len)
+      for _, step in ipairs {1, 5, 16, 48, 49, 100} do
+        local state = hash.state(7)
+        for i = 1, len, step do
+          state:update(x:sub(i, i + step - 1))
+        end
+        assert.are_equal(hash.string(x, 7), state:digest())
+      end
+    end
+  end)
+  it("should reset the incremental hasher", function()
+    local state = hash.state():update("abc", "def")
+    assert.are_equal(hash.string("abcdef"), state:digest())
+    assert.are_equal(hash.string("x", 3), state:reset(3):update("x"):digest())
+  end)
+  describe("deep", function()
+    it("should hash scalars", function()
+      assert.are_equal(hash.deep(nil), hash.deep())
+      assert.are_equal(hash.deep(1), hash.deep(1.0))
+      assert.are_equal(hash.deep("abc"), hash.deep("abc"))
+      assert.are_not_equal(hash.deep(true), hash.deep(false))
+      assert.are_not_equal(hash.deep(1), hash.deep("1"))
+    end)
+    it("should hash tables by content", function()
+      assert.are_equal(hash.deep({}), hash.deep({}))
+      assert.are_equal(hash.deep({1, 2, {a = 'x'}}), hash.deep({1, 2, {a = 'x'}}))
+      assert.are_equal(hash.deep({a = 1, b = 2, c = 3}), hash.deep({c = 3, b = 2, a = 1}))
+      assert.are_not_equal(hash.deep({1, 2}), hash.deep({2, 1}))
+      assert.are_not_equal(hash.deep({{}}), hash.deep({{{}}}))
+      assert.are_not_equal(hash.deep({a = {b = 1}}), hash.deep({a = {b = 2}}))
+    end)
+    it("should hash table keys by content", function()
+      assert.are_equal(hash.deep({[{1}] = true}), hash.deep({[{1}] = true}))
+      assert.are_not_equal(hash.deep({[{1}] = true}), hash.deep({[{2}] = true}))
+    end)
+    it("should honor __hash", function()
+      local mt = {__hash = function() return 42 end}
+      assert.are_equal(hash.deep(setmetatable({1}, mt)), hash.deep(setmetatable({2}, mt)))
+      assert.are_equal(hash.deep({setmetatable({1}, mt)}), hash.deep({setmetatable({2}, mt)}))
+    end)
+    it("should detect cycles", function()
+      local t1, t2 = {1}, {1}
+      t1.self, t2.self = t1, t2
+      assert.are_equal(hash.deep(t1), hash.deep(t2))
+      assert.error(function()
+        hash.deep(t1, {cycles = 'error'})
+      end, "cycle detected")
+    end)
+    it("should limit the depth", function()
+      assert.are_equal(hash.deep({{1}}, {depth = 0}), hash.deep({{2}}, {depth = 0}))
+      assert.are_not_equal(hash.deep({{1}}, {depth = 1}), hash.deep({{2}}, {depth = 1}))
+    end)
+    it("should not recurse", function()
+      local t = {}
+      local x = t
+      for _ = 1, 100000 do
+        x[1] = {}
+        x = x[1]
+      end
+      assert.not_nil(hash.deep(t))
+    end)
+    it("should use the seed", function()
+      assert.are_equal(hash.deep({1}, {seed = 1}), hash.deep({1}, {seed = 1}))
+      assert.are_not_equal(hash.deep({1}, {seed = 1}), hash.deep({1}, {seed = 2}))
+    end)
+  end)
 end)
@@ -0,0 +1,164 @@
+describe("#hashmap", function()
+  local hash = require 'std.hash'
+  local hashmap = require 'std.hashmap'
+  local tablex = require 'std.tablex'
+
+  describe("map", function()
+    it("should associate values with keys", function()
+      local m = hashmap.map()
+      assert.is_nil(m:put('a', 1))
+      assert.is_nil(m:put(2, 'b'))
+      assert.are_equal(1, m:get('a'))
+      assert.are_equal('b', m:get(2))
+      assert.are_equal('b', m:get(2.0))
+      assert.is_nil(m:get('c'))
+      assert.are_equal(0, m:get('c', 0))
+      assert.are_equal(2, #m)
+      assert.are_equal(1, m:put('a', 3))
+      assert.are_equal(3, m:get('a'))
+      assert.are_equal(2, m:len())
+    end)
+    it("should remove keys", function()
+      local m = hashmap.map()
+      m:put('a', 1)
+      m:put('b', 2)
+      m:put('c', 3)
+      assert.are_equal(1, m:remove('a'))
+      assert.is_nil(m:remove('a'))
+      assert.are_equal(2, m:put('b', nil))
+      assert.are_equal(1, #m)
+      assert.is_false(m:has('a'))
+      assert.is_true(m:has('c'))
+      assert.are_equal(3, m:get('c'))
+    end)
+    it("should reject nil and NaN keys", function()
+      local m = hashmap.map()
+      assert.error(function()
+        m:put(nil, 1)
+      end)
+      assert.error(function()
+        m:put(0 / 0, 1)
+      end)
+    end)
+    it("should iterate the entries in insertion order", function()
+      local m = hashmap.map()
+      for i = 1, 100 do
+        m:put('k' .. i, i)
+      end
+      local i = 0
+      for k, v in pairs(m) do
+        i = i + 1
+        assert.are_equal('k' .. i, k)
+        assert.are_equal(i, v)
+      end
+      assert.are_equal(100, i)
+      assert.are_equal(100, #m:keys())
+      assert.are_equal('k1', m:keys()[1])
+    end)
+    it("should keep many keys", function()
+      local m = hashmap.map()
+      for i = 1, 10000 do
+        m:put(i, -i)
+      end
+      for i = 1, 10000, 2 do
+        m:remove(i)
+      end
+      assert.are_equal(5000, #m)
+      for i = 1, 10000 do
+        assert.are_equal(i % 2 == 0 and -i or nil, m:get(i))
+      end
+    end)
+    it("should compare keys with __eq and __hash", function()
+      local mt = {}
+      mt.__eq = function(x, y)
+        return x.id == y.id
+      end
+      mt.__hash = function(x)
+        return x.id
+      end
+      local m = hashmap.map()
+      m:put(setmetatable({id = 1}, mt), 'a')
+      assert.are_equal('a', m:get(setmetatable({id = 1}, mt)))
+      assert.is_nil(m:get(setmetatable({id = 2}, mt)))
+    end)
+    it("should compare keys with a custom comparer", function()
+      local m = hashmap.map({eq = tablex.eq, hash = hash.deep})
+      m:put({1, {2}}, 'a')
+      assert.are_equal('a', m:get({1, {2}}))
+      assert.is_nil(m:get({1, {3}}))
+      local n = hashmap.map({eq = tablex.eq})
+      n:put({1}, 'a')
+      assert.are_equal('a', n:get({1}))
+    end)
+    it("should reserve room for the entries", function()
+      local m = hashmap.map({capacity = 100})
+      local capacity = m:stats().capacity
+      assert.is_true(capacity >= 100)
+      for i = 1, 100 do
+        m:put(i, i)
+      end
+      assert.are_equal(capacity, m:stats().capacity)
+      m:reserve(1000)
+      assert.is_true(m:stats().capacity >= 1000)
+      assert.are_equal(50, m:get(50))
+    end)
+    it("should reject the invalid options", function()
+      for opts, message in pairs({
+        [{eq = 1}] = "eq must be a function",
+        [{hash = 'x'}] = "hash must be a function",
+        [{capacity = 1.5}] = "capacity must be an integer",
+        [{capacity = -1}] = "capacity must be non-negative",
+        [{capacity = math.maxinteger}] = "capacity too big",
+      }) do
+        local ok, err = pcall(hashmap.map, opts)
+        assert.is_false(ok)
+        assert.is_not_nil(err:find("bad argument #1", 1, true))
+        assert.is_not_nil(err:find(message, 1, true))
+      end
+    end)
+    it("should clear the entries", function()
+      local m = hashmap.map()
+      m:put(1, 1)
+      assert.are_equal(m, m:clear())
+      assert.are_equal(0, #m)
+      assert.is_nil(m:get(1))
+    end)
+    it("should return the statistics", function()
+      local m = hashmap.map()
+      for i = 1, 1000 do
+        m:put(i, i)
+      end
+      local stats = m:stats()
+      assert.are_equal(1000, stats.count)
+      assert.are_equal(stats.count / stats.capacity, stats.load_factor)
+      assert.is_true(stats.load_factor <= 0.875)
+      assert.is_true(stats.mean_probe <= stats.max_probe)
+    end)
+  end)
+
+  describe("set", function()
+    it("should add keys", function()
+      local s = hashmap.set()
+      assert.is_true(s:add('a'))
+      assert.is_false(s:add('a'))
+      assert.is_true(s:add(1))
+      assert.is_true(s:has('a'))
+      assert.is_false(s:has('b'))
+      assert.are_equal(2, #s)
+      assert.is_true(s:remove('a'))
+      assert.are_equal(1, #s)
+      assert.is_nil(s.get)
+    end)
+    it("should iterate the keys", function()
+      local s = hashmap.set()
+      s:add('a')
+      s:add('b')
+      local r = {}
+      for k, v in pairs(s) do
+        assert.is_true(v)
+        r[#r + 1] = k
+      end
+      assert.same({'a', 'b'}, r)
+    end)
+  end)
+end)
@@ -0,0 +1,24 @@
+-- Functions shared by the specs working with files.
+local M = {}
+
+function M.write_file(filename, content)
+  local f = assert(io.open(filename, 'wb'))
+  f:write(content)
+  f:close()
+end
+
+function M.read_file(filename)
+  local f = assert(io.open(filename, 'rb'))
+  local content = f:read('a')
+  f:close()
+  return content
+end
+
+-- Returns the name of a file which does not exist.
+function M.temp_file()
+  local filename = os.tmpname()
+  os.remove(filename)
+  return filename
+end
+
+return M
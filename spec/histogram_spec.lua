@@ -0,0 +1,165 @@
+describe("#histogram", function()
+  local histogram = require 'std.histogram'
+  local stopwatch = require 'std.stopwatch'
+  local time = require 'std.time'
+
+  -- the precision of 3 digits: the values are known to 1 part in 1000
+  local function assert_near(expected, actual)
+    assert.is_true(math.abs(actual - expected) <= expected / 1000 + 1,
+      ('expected %d, got %d'):format(expected, actual))
+  end
+
+  it("should record the values", function()
+    local h = histogram.new()
+    assert.are_equal(0, h:count())
+    assert.are_equal(0, h:min())
+    assert.are_equal(0, h:max())
+    assert.are_equal(0, h:percentile(50))
+    for i = 1, 10000 do
+      assert.is_true(h:record(i))
+    end
+    assert.is_true(h:record(0, 3))
+    assert.are_equal(10003, h:count())
+    assert.are_equal(0, h:min())
+    assert.are_equal(10000, h:max())
+    assert.are_equal(0, h:percentile(0))
+    assert.are_equal(10000, h:percentile(100))
+    local p50, p90, p999 = h:percentile(50, 90, 99.9)
+    assert_near(5000, p50)
+    assert_near(9000, p90)
+    assert_near(9990, p999)
+    assert.is_true(math.abs(h:mean() - 5000) < 10)
+    assert.is_true(math.abs(h:stddev() - 2887) < 10)
+  end)
+  it("should keep the precision at every magnitude", function()
+    local h = histogram.new({highest = 1e15, digits = 3})
+    for _, value in ipairs({1, 999, 123456, 987654321, 1e13}) do
+      h:reset()
+      h:record(math.tointeger(value))
+      h:record(1)
+      assert_near(math.tointeger(value), h:percentile(100))
+      assert_near(math.tointeger(value), h:percentile(75))
+    end
+  end)
+  it("should not record the values out of range", function()
+    local h = histogram.new({lowest = 1000, highest = 1000000})
+    assert.is_false(h:record(-1))
+    assert.is_false(h:record(1 << 40))
+    assert.is_true(h:record(999))
+    assert.are_equal(1, h:count())
+  end)
+  it("should merge the histograms", function()
+    local a, b = histogram.new(), histogram.new()
+    for i = 1, 100 do
+      a:record(i)
+      b:record(i + 100)
+    end
+    assert.are_equal(0, a:merge(b))
+    assert.are_equal(200, a:count())
+    assert.are_equal(1, a:min())
+    assert.are_equal(200, a:max())
+    assert.are_equal(100, a:percentile(50))
+    -- the values of other ranges are recorded one by one
+    local c = histogram.new({highest = 1000000})
+    b:record(1000000000, 5)
+    assert.are_equal(5, c:merge(b))
+    assert.are_equal(100, c:count())
+    assert.are_equal(101, c:min())
+  end)
+  it("should raise when the count overflows", function()
+    local a, b = histogram.new(), histogram.new()
+    a:record(10, math.maxinteger)
+    assert.has_error(function() a:record(10) end)
+    assert.has_error(function() a:record(20) end)
+    assert.are_equal(math.maxinteger, a:count())
+    b:record(10)
+    assert.has_error(function() a:merge(b) end)
+    assert.are_equal(math.maxinteger, a:count())
+  end)
+  it("should encode and decode the histograms", function()
+    local h = histogram.new({lowest = 10, highest = 1e9, digits = 2})
+    for i = 1, 1000 do
+      h:record(i * i, i % 3)
+    end
+    local s = h:encode()
+    assert.is_true(#s < 4000)
+    local d = histogram.decode(s)
+    assert.are_equal(h:count(), d:count())
+    assert.are_equal(h:min(), d:min())
+    assert.are_equal(h:max(), d:max())
+    assert.are_same({h:percentile(10, 50, 99)}, {d:percentile(10, 50, 99)})
+    assert.are_equal(s, d:encode())
+    assert.are_equal(0, histogram.decode(histogram.new():encode()):count())
+    assert.has_error(function()
+      histogram.decode('HDR')
+    end)
+    assert.has_error(function()
+      histogram.decode(s:sub(1, -2) .. '\255')
+    end)
+    assert.has_error(function()
+      histogram.decode(s .. '\255\255\255\255\255\255\255\255\255\127')
+    end)
+    -- an invalid encoding of the widest layout is rejected before its counts are allocated
+    collectgarbage()
+    collectgarbage('stop')
+    local before = collectgarbage('count')
+    assert.has_error(function()
+      histogram.decode('HDR\1\5\1\255\255\255\255\255\255\255\255\63\1\1\2\3')
+    end)
+    assert.is_true(collectgarbage('count') - before < 1024)
+    collectgarbage('restart')
+    -- the lowest and highest values must match the counts
+    local e = histogram.new()
+    e:record(100)
+    assert.has_error(function()
+      histogram.decode((e:encode():gsub('d', 'e', 1)))
+    end)
+  end)
+  it("should not change the range for a count of 0", function()
+    local h = histogram.new()
+    h:record(10)
+    assert.is_true(h:record(1000, 0))
+    assert.are_equal(1, h:count())
+    assert.are_equal(10, h:max())
+  end)
+  it("should return many percentiles", function()
+    local h = histogram.new()
+    h:record(10)
+    local p = {}
+    for i = 1, 1000 do
+      p[i] = 50
+    end
+    assert.are_equal(1000, select('#', h:percentile(table.unpack(p))))
+  end)
+  it("should record the elapsed times", function()
+    local h = histogram.new()
+    local t0 = time.monotonic_ns()
+    assert.is_true(h:record_since(t0))
+    local sw = stopwatch.start()
+    sw:stop()
+    assert.is_true(sw:record(h))
+    assert.are_equal(2, h:count())
+    assert.is_true(h:max() >= sw:get_elapsed_time_ns())
+  end)
+  it("should raise errors on invalid arguments", function()
+    assert.has_error(function()
+      histogram.new({lowest = 0})
+    end)
+    assert.has_error(function()
+      histogram.new({lowest = 10, highest = 15})
+    end)
+    assert.has_error(function()
+      histogram.new({digits = 6})
+    end)
+    local h = histogram.new()
+    assert.has_error(function()
+      h:percentile(101)
+    end)
+    assert.has_error(function()
+      h:percentile()
+    end)
+    assert.has_error(function()
+      h:record(1, -1)
+    end)
+  end)
+end)
@@ -0,0 +1,245 @@
+describe("#iox", function()
+  local iox = require 'std.iox'
+
+  local helpers = require 'spec.helpers'
+  local read_file, temp_file, write_file = helpers.read_file, helpers.temp_file, helpers.write_file
+
+  local function collect(filename, opts)
+    local t = {}
+    for line in iox.lines_chunked(filename, opts) do
+      t[#t + 1] = line
+    end
+    return t
+  end
+
+  describe("lines_chunked", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+
+    it("should read the lines of a file", function()
+      write_file(filename, 'a\nbb\n\nccc\n')
+      assert.are_same({'a', 'bb', '', 'ccc'}, collect(filename))
+    end)
+    it("should read an empty file", function()
+      write_file(filename, '')
+      assert.are_same({}, collect(filename))
+    end)
+    it("should return a last line without a newline", function()
+      write_file(filename, 'a\nb')
+      assert.are_same({'a', 'b'}, collect(filename))
+    end)
+    it("should remove carriage returns before newlines", function()
+      write_file(filename, 'a\r\nb\rc\r\n\r\n')
+      assert.are_same({'a', 'b\rc', ''}, collect(filename))
+      assert.are_same({'a\r', 'b\rc\r', '\r'}, collect(filename, {crlf = false}))
+    end)
+    it("should read lines across chunks", function()
+      local lines = {}
+      for i = 1, 1000 do
+        lines[i] = string.rep(string.char(97 + i % 26), i % 37)
+      end
+      write_file(filename, table.concat(lines, '\r\n') .. '\r\n')
+      for _, chunk in ipairs({1, 2, 3, 7, 64, 4096}) do
+        assert.are_same(lines, collect(filename, {chunk = chunk}))
+      end
+    end)
+    it("should read lines longer than a chunk", function()
+      local long = string.rep('x', 10000)
+      write_file(filename, 'a\n' .. long .. '\nb')
+      assert.are_same({'a', long, 'b'}, collect(filename, {chunk = 16}))
+    end)
+    it("should return the same lines as io.lines", function()
+      local content = ('line %d\n'):rep(100):format(table.unpack((function()
+        local t = {}
+        for i = 1, 100 do
+          t[i] = i
+        end
+        return t
+      end)()))
+      write_file(filename, content)
+      local expected = {}
+      for line in io.lines(filename) do
+        expected[#expected + 1] = line
+      end
+      assert.are_same(expected, collect(filename, {chunk = 100}))
+    end)
+    it("should return batches of lines", function()
+      write_file(filename, 'a\nb\nc\nd\ne\n')
+      local batches, counts = {}, {}
+      for lines, n in iox.lines_chunked(filename, {batch = 2}) do
+        batches[#batches + 1] = lines
+        counts[#counts + 1] = n
+      end
+      assert.are_same({{'a', 'b'}, {'c', 'd'}, {'e'}}, batches)
+      assert.are_same({2, 2, 1}, counts)
+    end)
+    it("should accept batches larger than the file", function()
+      write_file(filename, 'a\nb\n')
+      local batches = {}
+      for lines in iox.lines_chunked(filename, {batch = 2147483647}) do
+        batches[#batches + 1] = lines
+      end
+      assert.are_same({{'a', 'b'}}, batches)
+    end)
+    it("should close the file when the loop is exited", function()
+      write_file(filename, 'a\nb\n')
+      local iter, state, init, closing = iox.lines_chunked(filename)
+      for _ in iter, state, init, closing do
+        break
+      end
+      assert.has_error(function()
+        iter(state)
+      end)
+    end)
+    it("should fail for a missing file", function()
+      local iter, err = iox.lines_chunked(filename)
+      assert.is_nil(iter)
+      assert.is_string(err)
+    end)
+    it("should reject invalid options", function()
+      write_file(filename, 'a\n')
+      assert.has_error(function()
+        iox.lines_chunked(filename, {chunk = 0})
+      end)
+      assert.has_error(function()
+        iox.lines_chunked(filename, {batch = -1})
+      end)
+      assert.has_error(function()
+        iox.lines_chunked(filename, {crlf = 1})
+      end)
+    end)
+  end)
+
+  describe("read_lines", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+
+    it("should read all the lines of a file", function()
+      local lines = {}
+      for i = 1, 3000 do
+        lines[i] = tostring(i)
+      end
+      write_file(filename, table.concat(lines, '\n') .. '\r\n')
+      -- like io.lines, a carriage return is only removed in the text mode of Windows
+      if package.config:sub(1, 1) ~= '\\' then
+        lines[#lines] = lines[#lines] .. '\r'
+      end
+      assert.are_same(lines, iox.read_lines(filename))
+    end)
+    it("should fail for a missing file", function()
+      local t, err = iox.read_lines(filename)
+      assert.is_nil(t)
+      assert.is_string(err)
+    end)
+  end)
+
+  describe("write_lines/write_all", function()
+    local filename
+    before_each(function()
+      filename = temp_file()
+    end)
+    after_each(function()
+      os.remove(filename)
+    end)
+
+    it("should write lines", function()
+      assert.is_true(iox.write_lines(filename, {'a', '', 'bb', 42}))
+      assert.are_equal('a\n\nbb\n42\n', read_file(filename))
+    end)
+    it("should write no lines", function()
+      write_file(filename, 'old')
+      assert.is_true(iox.write_lines(filename, {}))
+      assert.are_equal('', read_file(filename))
+    end)
+    it("should write many lines across flushes", function()
+      local lines, expected = {}, {}
+      for i = 1, 5000 do
+        lines[i] = string.rep('x', i % 7 == 0 and 300 + i % 500 or i % 50)
+        expected[i] = lines[i] .. '\n'
+      end
+      for _, hwm in ipairs({1, 100, 1 << 20}) do
+        assert.is_true(iox.write_lines(filename, lines, {hwm = hwm}))
+        assert.are_equal(table.concat(expected), read_file(filename))
+      end
+    end)
+    it("should write the content of a file", function()
+      local content = string.rep('0123456789', 100000)
+      assert.is_true(iox.write_all(filename, content))
+      assert.are_equal(content, read_file(filename))
+      assert.is_true(iox.write_all(filename, ''))
+      assert.are_equal('', read_file(filename))
+    end)
+    it("should write with every sync mode", function()
+      local content = string.rep('z', 10000)
+      for _, sync in ipairs({'none', 'data', 'direct'}) do
+        assert.is_true(iox.write_all(filename, content, {sync = sync}))
+        assert.are_equal(content, read_file(filename))
+        assert.is_true(iox.write_lines(filename, {'a', 'b'}, {sync = sync, atomic = true}))
+        assert.are_equal('a\nb\n', read_file(filename))
+      end
+    end)
+    it("should replace a file atomically", function()
+      write_file(filename, 'old')
+      assert.is_true(iox.write_lines(filename, {'new'}, {atomic = true}))
+      assert.are_equal('new\n', read_file(filename))
+    end)
+    if package.config:sub(1, 1) == '/' then
+      it("should keep the permissions of the file replaced", function()
+        write_file(filename, 'old')
+        os.execute("chmod 750 '" .. filename .. "'")
+        assert.is_true(iox.write_all(filename, 'new', {atomic = true}))
+        assert.are_equal('new', read_file(filename))
+        assert.is_true(os.execute("test -x '" .. filename .. "'"))
+      end)
+      it("should replace a symbolic link with a regular file", function()
+        local target = temp_file()
+        write_file(target, 'old')
+        os.execute("chmod 750 '" .. target .. "' && ln -s '" .. target .. "' '" .. filename .. "'")
+        assert.is_true(iox.write_all(filename, 'new', {atomic = true}))
+        assert.are_equal('new', read_file(filename))
+        assert.are_equal('old', read_file(target))
+        assert.is_nil(os.execute("test -h '" .. filename .. "' || test -x '" .. filename .. "'"))
+        os.remove(target)
+      end)
+    end
+    it("should not leave a temporary file when a line is not valid", function()
+      write_file(filename, 'old')
+      assert.has_error(function()
+        iox.write_lines(filename, {'a', {}}, {atomic = true})
+      end)
+      collectgarbage()
+      assert.are_equal('old', read_file(filename))
+      local fs, path = require 'std.fs', require 'std.path'
+      local name = path.file_name(filename)
+      for entry in fs.entries(path.parent(filename)) do
+        assert.is_nil(entry:find(name .. '.', 1, true))
+      end
+    end)
+    it("should fail if the file cannot be created", function()
+      local ok, err = iox.write_lines(filename .. '/missing/file', {'a'})
+      assert.is_false(ok)
+      assert.is_string(err)
+      ok, err = iox.write_all(filename .. '/missing/file', 'a', {atomic = true})
+      assert.is_false(ok)
+      assert.is_string(err)
+    end)
+    it("should reject invalid options", function()
+      assert.has_error(function()
+        iox.write_all(filename, 'a', {sync = 'always'})
+      end)
+      assert.has_error(function()
+        iox.write_all(filename, 'a', {hwm = 0})
+      end)
+    end)
+  end)
+end)
@@ -0,0 +1,144 @@
+if package.config:sub(1, 1) ~= '/' then
+  return
+end
+
+describe("#osx", function()
+  local osx = require 'std.osx'
+  local stopwatch = require 'std.stopwatch'
+
+  describe("exec()", function()
+    it("should pass the argument list as it is", function()
+      local ok, out, err, status, code = osx.exec({name = 'echo', arg_list = {'a  b', '$HOME', '"c"'}})
+      assert.is_true(ok)
+      assert.are_equal('a  b $HOME "c"', out)
+      assert.is_nil(err)
+      assert.are_equal('exit', status)
+      assert.are_equal(0, code)
+    end)
+    it("should run the arguments string through the shell", function()
+      local ok, out, err = osx.exec({name = 'echo', args = 'out; echo err >&2'})
+      assert.is_true(ok)
+      assert.are_equal('out', out)
+      assert.are_equal('err', err)
+    end)
+    it("should return the exit status", function()
+      local ok, out, err, status, code = osx.exec({name = 'sh', arg_list = {'-c', 'echo failed; exit 3'}})
+      assert.is_false(ok)
+      assert.are_equal('failed', out)
+      assert.is_nil(err)
+      assert.are_equal('exit', status)
+      assert.are_equal(3, code)
+    end)
+    it("should fail if the command does not exist", function()
+      local ok, out, err = osx.exec({name = 'std-osx-spec-no-such-command', arg_list = {}})
+      assert.is_false(ok)
+      assert.is_nil(out)
+      assert.is_string(err)
+    end)
+    it("should set the environment and the working directory", function()
+      local ok, out = osx.exec({
+        name = 'sh',
+        arg_list = {'-c', 'echo "$STD_OSX_SPEC:${HOME-unset}"; pwd'},
+        env = {STD_OSX_SPEC = 'x=y', HOME = false},
+        cwd = '/'
+      })
+      assert.is_true(ok)
+      assert.are_equal('x=y:unset\n/', out)
+    end)
+    it("should leave or stream the outputs", function()
+      local chunks = {}
+      local ok, out, err = osx.exec({
+        name = 'sh',
+        arg_list = {'-c', 'seq 1 1000'},
+        stdout = function(chunk)
+          chunks[#chunks + 1] = chunk
+        end,
+        stderr = false
+      })
+      assert.is_true(ok)
+      assert.is_nil(out)
+      assert.is_nil(err)
+      local lines = {}
+      for i = 1, 1000 do
+        lines[i] = i
+      end
+      assert.are_equal(table.concat(lines, '\n') .. '\n', table.concat(chunks))
+    end)
+    it("should prefer the arguments string to the argument list", function()
+      local ok, out = osx.exec({name = 'echo', args = 'a | tr a b', arg_list = {'c'}})
+      assert.is_true(ok)
+      assert.are_equal('b', out)
+    end)
+    it("should look the program up in the PATH of the environment", function()
+      local ok, out = osx.exec({name = 'env', arg_list = {}, env = {PATH = '/nonexistent:/usr/bin:/bin'}})
+      assert.is_true(ok)
+      assert.is_not_nil(out:find('PATH=/nonexistent:/usr/bin:/bin', 1, true))
+      assert.is_false((osx.exec({name = 'env', arg_list = {}, env = {PATH = '/nonexistent'}})))
+    end)
+    it("should not wait for the processes keeping the pipes open", function()
+      local sw = stopwatch.start()
+      local ok, out = osx.exec({name = 'sh', arg_list = {'-c', 'echo started; sleep 5 &'}})
+      assert.is_true(ok)
+      assert.are_equal('started', out)
+      assert.is_true(sw:get_elapsed_time() < 4)
+    end)
+    it("should read large outputs", function()
+      local ok, out = osx.exec({name = 'head', arg_list = {'-c', '1000000', '/dev/zero'}})
+      assert.is_true(ok)
+      assert.are_equal(1000000, #out)
+    end)
+    it("should kill the command after the timeout", function()
+      local sw = stopwatch.start()
+      local ok, _, _, status = osx.exec({name = 'sleep', arg_list = {'10'}, timeout = 50})
+      assert.is_false(ok)
+      assert.are_equal('timeout', status)
+      assert.is_true(sw:get_elapsed_time() < 5)
+    end)
+  end)
+
+  describe("exec_many()", function()
+    it("should return the results in the order of the commands", function()
+      local cmds = {}
+      for i = 1, 20 do
+        cmds[i] = {name = 'sh', arg_list = {'-c', 'echo ' .. i .. '; exit ' .. i % 2}}
+      end
+      local results = osx.exec_many(cmds, {concurrency = 4})
+      assert.are_equal(20, #results)
+      for i, r in ipairs(results) do
+        assert.are_equal(i % 2 == 0, r.ok)
+        assert.are_equal(i % 2, r.code)
+        assert.are_equal(i .. '\n', r.stdout)
+        assert.are_equal('', r.stderr)
+      end
+    end)
+    it("should run the commands concurrently", function()
+      local cmds = {}
+      for i = 1, 4 do
+        cmds[i] = {name = 'sleep', arg_list = {'0.2'}}
+      end
+      local sw = stopwatch.start()
+      local results = osx.exec_many(cmds, {concurrency = 4})
+      assert.is_true(sw:get_elapsed_time() < 0.6)
+      for _, r in ipairs(results) do
+        assert.is_true(r.ok)
+      end
+    end)
+    it("should report the commands which could not be run", function()
+      local results = osx.exec_many({
+        {name = 'std-osx-spec-no-such-command', arg_list = {}},
+        {name = 'true', arg_list = {}}
+      })
+      assert.is_false(results[1].ok)
+      assert.is_string(results[1].error)
+      assert.is_true(results[2].ok)
+    end)
+    it("should raise an error if a command is not valid", function()
+      assert.has_error(function()
+        osx.exec_many({{name = 'true', arg_list = {}}, {name = 'true', arg_list = {}, timeout = 'x'}})
+      end)
+      assert.has_error(function()
+        osx.exec_many({}, {concurrency = 0})
+      end)
+    end)
+  end)
+end)
@@ -66,6 +66,31 @@ describe("#path", function()
     end)
   end)
 
+  describe("common_prefix", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.common_prefix(nil) end, "bad argument #1 to 'common_prefix' (table expected, got nil)")
+      assert.error(function() path.common_prefix({"hoge", 1}) end, "bad argument #1 to 'common_prefix' (invalid path at index 2)")
+      assert.error(function() path.common_prefix({"hoge", P"/fuga", 42}) end, "bad argument #1 to 'common_prefix' (invalid path at index 3)")
+    end)
+
+    it("should return the common prefix of the paths", function()
+      local cases = {
+        {P"/hoge/fuga", {P"/hoge/fuga/piyo", P"/hoge/fuga/hogera/piyo", P"/hoge/fuga"}},
+        {P"/hoge", {P"/hoge/fuga", P"/hoge/fugafuga"}},
+        {P"/", {P"/hoge", P"/fuga"}},
+        {P"hoge//fuga", {P"hoge//fuga/", P"hoge/fuga/piyo"}},
+        {P"hoge/fuga", {P"hoge/fuga/"}},
+        {"", {"hoge", "fuga"}},
+        {"", {P"/hoge", "hoge"}},
+      }
+      for _, case in ipairs(cases) do
+        local e, paths = case[1], case[2]
+        assert.are_equal(e, path.common_prefix(paths), table.concat(paths, ","))
+      end
+      assert.is_nil(path.common_prefix({}))
+    end)
+  end)
+
   describe("ends_with_separator", function()
     it("should report bad arguments", function()
       assert.error(function() path.ends_with_separator(nil) end, "bad argument #1 to 'ends_with_separator' (string expected, got nil)")
@@ -114,6 +139,8 @@ describe("#path", function()
         {"hoge/doge", "doge", true},
         {"hoge/doge", "doge/", true},
         {"hoge/doge", "hige", false},
+        {"hoge/doge", "hoge/doge", true},
+        {"hoge/doge/fuga/piyo/hogera", "fuga/piyo/hogera", true},
       }
       for _, case in ipairs(cases) do
         local p, s, e = case[1], case[2], case[3]
@@ -245,6 +272,8 @@ describe("#path", function()
       assert.are_equal("file", path.file_stem("file"))
       assert.are_equal("file", path.file_stem("file.exe"))
       assert.are_equal("file", path.file_stem(P"hoge/doge/file.exe"))
+      assert.are_equal("longname", path.file_stem(P"hoge/longname.c"))
+      assert.are_equal("doge", path.file_stem(P"hoge/doge"))
     end)
   end)
 
@@ -306,6 +335,8 @@ describe("#path", function()
         {root, path.combine(root, "..")},
         {root, path.combine(root, "..", "..", "..", "..")},
         {root, root .. P"///"},
+        {path.combine(cwd, "hogehoge", "fugafuga"), path.combine(cwd, "hogehoge", ".", "piyopiyo", "..", "fugafuga")},
+        {path.combine(cwd, ".hogehoge", "..fugafuga"), path.combine(cwd, ".hogehoge", "..fugafuga")},
      }
       for _, x in ipairs(cases) do
         assert.are_equal(x[1], path.full_path(x[2]))
@@ -330,6 +361,122 @@ describe("#path", function()
     end)
   end)
 
+  describe("map", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.map("hoge", {}) end)
+      assert.error(function() path.map("normalize", nil) end)
+      assert.error(function() path.map("normalize", {"a", 1}) end)
+      assert.error(function() path.map("full_path", {"a", "ho\0ge"}) end)
+      assert.error(function() path.map("full_path", {"a"}, "hoge") end)
+      assert.error(function() path.map("combine", {"a"}, 1) end)
+    end)
+    it("should return the results of the operation", function()
+      local cwd = path.full_path(".")
+      local base = path.parent(cwd)
+      local paths = {"", ".", "..", "a", P"a//b/./c/../d", P"/a/b", cwd, P"x///y", path.combine(cwd, "..", "z")}
+      for _, args in ipairs({
+        {"normalize"},
+        {"full_path"},
+        {"full_path", base},
+        {"combine"},
+        {"combine", "x", "y"},
+        {"combine", P"/x", "y"},
+      }) do
+        local op = args[1]
+        local results = path.map(op, paths, table.unpack(args, 2))
+        assert.are_equal(#paths, #results)
+        for i, p in ipairs(paths) do
+          assert.are_equal(path[op](p, table.unpack(args, 2)), results[i], op .. " " .. p)
+        end
+      end
+      assert.are_same({}, path.map("full_path", {}))
+    end)
+  end)
+
+  describe("new", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.new() end)
+      assert.error(function() path.new("ho\0ge") end)
+    end)
+    it("should return the same Path for the same string", function()
+      local p = path.new(P"/usr/local/lib/liblua.so")
+      assert.are_equal(P"/usr/local/lib/liblua.so", tostring(p))
+      assert.is_true(rawequal(p, path.new(P"/usr/local/lib/liblua.so")))
+      assert.is_true(rawequal(p, path.new(p)))
+      assert.is_true(rawequal(p:parent(), path.new(P"/usr/local/lib")))
+      assert.is_true(rawequal(p:parent(), path.new(P"/usr/local/lib/liblua.so"):parent()))
+    end)
+    it("should return the parts of the path", function()
+      for _, s in ipairs({"", ".", "..", "file", "file.exe", ".bashrc", P"hoge/doge/file.exe", P"hoge/doge/c.exe/",
+          P"/", P"/hoge", P"hoge//doge/", P"./hoge/longname.c"}) do
+        local p = path.new(s)
+        assert.are_equal(path.file_name(s), p:file_name(), s)
+        assert.are_equal(path.file_stem(s), p:file_stem(), s)
+        assert.are_equal(path.extension(s), p:extension(), s)
+        assert.are_equal(path.parent(s), p:parent() and tostring(p:parent()), s)
+        assert.are_equal(path.is_rooted(s), p:is_rooted(), s)
+        if s ~= "" then
+          assert.are_equal(path.root(s), p:root(), s)
+        end
+      end
+    end)
+    it("should return the segments of the path", function()
+      local p = path.new(P"/usr//local/./lib/")
+      assert.are_equal(4, #p)
+      assert.are_equal("usr", p:part(1))
+      assert.are_equal(".", p:part(3))
+      assert.are_equal("lib", p:part(-1))
+      assert.are_equal("usr", p:part(-4))
+      assert.is_nil(p:part(0))
+      assert.is_nil(p:part(5))
+      assert.is_nil(p:part(-5))
+      assert.are_equal(0, #path.new(P"/"))
+      assert.are_equal(4, #p:parent())
+      assert.are_equal(3, #p:parent():parent())
+      assert.are_equal("local", p:parent():parent():part(-2))
+    end)
+    it("should join the paths", function()
+      local p = path.new(P"/usr/local")
+      local lib = p:join("lib", path.new("lua"), "5.4")
+      assert.are_equal(path.combine(P"/usr/local", "lib", "lua", "5.4"), tostring(lib))
+      assert.are_equal(5, #lib)
+      assert.are_equal("5.4", lib:part(5))
+      assert.is_true(rawequal(lib, path.new(path.combine(P"/usr/local", "lib", "lua", "5.4"))))
+      assert.are_equal(P"/usr/local/bin", tostring(p .. "bin"))
+      assert.are_equal(P"/opt", tostring(p .. P"/opt"))
+      assert.are_equal(P"usr/local", tostring("usr" .. path.new("local")))
+      assert.are_equal(1, #(p .. P"/opt"))
+    end)
+    it("should compare the paths", function()
+      local windows = path.DIRSEP == "\\"
+      assert.are_equal(windows, path.new("hoge") == path.new("HOGE"))
+      assert.are_equal(windows, rawequal(path.new("hoge"), path.new("HOGE")))
+      assert.is_false(path.new("hoge") == path.new("doge"))
+      assert.is_false(path.new("hoge") == io.stdout)
+      assert.is_false(io.stdout == path.new("hoge"))
+      assert.is_true(path.new("hoge") < path.new("hoge2"))
+      assert.is_true(path.new("doge") < path.new("hoge"))
+      assert.is_true(path.new("hoge") <= path.new("hoge"))
+      assert.is_true(path.new("doge") < "hoge")
+      local paths = {path.new("b"), path.new("aa"), path.new("a")}
+      table.sort(paths)
+      assert.are_equal("a", tostring(paths[1]))
+      assert.are_equal("b", tostring(paths[2]))
+      assert.are_equal("aa", tostring(paths[3]))
+    end)
+    it("should hash the paths", function()
+      local hash = require 'std.hash'
+      local p = path.new(P"/usr/lib")
+      assert.are_equal(hash.deep(p), hash.deep(path.new(P"/usr/lib")))
+      assert.are_not_equal(hash.deep(p), hash.deep(path.new(P"/x/y")))
+      local m = require('std.hashmap').map()
+      m:put(p, 1)
+      m:put(path.new(P"/x/y"), 2)
+      assert.are_equal(1, m:get(path.new(P"/usr/lib")))
+      assert.are_equal(2, m:get(path.new(P"/x/y")))
+    end)
+  end)
+
   describe("random_file_name", function()
     it("should return different filenames", function()
       local names = {}
@@ -342,6 +489,162 @@ describe("#path", function()
     end)
   end)
 
+  describe("relative", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.relative(nil, "hoge") end, "bad argument #1 to 'relative' (string expected, got nil)")
+      assert.error(function() path.relative("hoge", nil) end, "bad argument #2 to 'relative' (string expected, got nil)")
+    end)
+
+    it("should return the relative path", function()
+      local cases = {
+        {P"/hoge/fuga", P"/hoge/fuga/piyo/hogera", P"piyo/hogera"},
+        {P"/hoge/fuga/piyo", P"/hoge/hogera", P"../../hogera"},
+        {P"/hoge/fuga", P"/hoge", ".."},
+        {P"/hoge/fuga/", P"/hoge//fuga", "."},
+        {P"/hoge/./fuga", P"/hoge/fuga/.", "."},
+        {P"/", P"/hoge/fuga", P"hoge/fuga"},
+        {P"/hoge/fuga", P"/", P"../.."},
+        {P"hoge/fuga", P"hoge/piyo", P"../piyo"},
+        {"", "hoge", "hoge"},
+      }
+      for _, case in ipairs(cases) do
+        local from, to, e = case[1], case[2], case[3]
+        assert.are_equal(e, path.relative(from, to), from .. " " .. to)
+      end
+    end)
+
+    it("should compare the segments as the file system", function()
+      local windows = path.DIRSEP == "\\"
+      assert.are_equal(windows and "c" or P"../../a/b/c", path.relative(P"/A/b", P"/a/b/c"))
+      assert.are_same({windows and "." or P"../B"}, path.relative_all(P"/a/b", {P"/a/B"}))
+    end)
+
+    it("should return nil for different roots", function()
+      assert.is_nil(path.relative(P"/hoge", "hoge"))
+      assert.is_nil(path.relative("hoge", P"/hoge"))
+    end)
+
+    it("should handle deep paths", function()
+      local segments = {}
+      for i = 1, 100 do
+        segments[i] = "hoge" .. i
+      end
+      local from = P"/" .. table.concat(segments, path.DIRSEP)
+      assert.are_equal(("..".. path.DIRSEP):rep(99) .. "fuga", path.relative(from, P"/hoge1/fuga"))
+    end)
+  end)
+
+  describe("relative_all", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.relative_all(nil, {}) end, "bad argument #1 to 'relative_all' (string expected, got nil)")
+      assert.error(function() path.relative_all("hoge", {"fuga", 1}) end, "bad argument #2 to 'relative_all' (invalid path at index 2)")
+    end)
+
+    it("should return the relative path of each path", function()
+      local paths = {P"/hoge/fuga/piyo", P"/hoge/hogera", P"/hoge/fuga", "fuga"}
+      local results = path.relative_all(P"/hoge/fuga", paths)
+      assert.are_same({"piyo", P"../hogera", ".", false}, results)
+      for i = 1, 3 do
+        assert.are_equal(path.relative(P"/hoge/fuga", paths[i]), results[i])
+      end
+      assert.are_same({}, path.relative_all("hoge", {}))
+    end)
+  end)
+
+  describe("resolve", function()
+    it("should report bad arguments", function()
+      assert.error(function() path.resolve(nil) end, "bad argument #1 to 'resolve' (string expected, got nil)")
+      assert.error(function() path.resolve("hoge", true) end, "bad argument #2 to 'resolve' (table expected, got boolean)")
+      assert.error(function() path.resolve("hoge", {cache = {}}) end)
+    end)
+
+    it("should resolve the path lexically", function()
+      local cwd = path.full_path(".")
+      local root = path.root(cwd)
+      local cases = {
+        {cwd, "."},
+        {cwd, P"./"},
+        {path.parent(cwd), ".."},
+        {path.combine(cwd, "hoge", "fuga"), P"hoge/piyo/../fuga/."},
+        {path.combine(cwd, "fuga"), P"hoge//..//fuga//"},
+        {root, path.combine(root, "..", "..")},
+        {path.combine(root, "hoge"), path.combine(root, "hoge", "fuga", "..") .. P"/"},
+      }
+      for _, case in ipairs(cases) do
+        local e, p = case[1], case[2]
+        assert.are_equal(e, path.resolve(p, {lexical = true}), p)
+      end
+    end)
+
+    if package.config:sub(1, 1) == '/' then
+      describe("physically", function()
+        local root
+
+        before_each(function()
+          root = path.canonicalize(path.parent(os.tmpname())) .. '/' .. path.random_file_name()
+          os.execute("mkdir -p '" .. root .. "/a/b/c' && touch '" .. root .. "/a/b/c/f'")
+          os.execute("ln -s a/b '" .. root .. "/l' && ln -s ../.. '" .. root .. "/a/b/up'")
+          os.execute("ln -s loop '" .. root .. "/loop'")
+        end)
+        after_each(function()
+          os.execute("rm -rf '" .. root .. "'")
+        end)
+
+        it("should resolve the links", function()
+          local f = root .. "/a/b/c/f"
+          assert.are_equal(f, path.resolve(root .. "/l/c/f"))
+          assert.are_equal(f, path.resolve(root .. "/l/up/l/./c//../c/f"))
+          assert.are_equal(root .. "/a", path.resolve(root .. "/l/.."))
+          assert.are_equal(path.canonicalize("."), path.resolve("."))
+        end)
+
+        it("should return the errors", function()
+          local ok, err = path.resolve(root .. "/missing/f")
+          assert.is_nil(ok)
+          assert.is_string(err)
+          ok, err = path.resolve(root .. "/a/b/c/f/")
+          assert.is_nil(ok)
+          assert.is_string(err)
+          ok, err = path.resolve(root .. "/loop")
+          assert.is_nil(ok)
+          assert.is_string(err)
+        end)
+
+        it("should cache the directories and the links", function()
+          local cache = path.resolve_cache()
+          local f = root .. "/a/b/c/f"
+          assert.are_equal(f, path.resolve(root .. "/l/c/f", {cache = cache}))
+          local misses = cache:stats().misses
+          assert.are_equal(f, path.resolve(root .. "/l/c/f", {cache = cache}))
+          -- only the file is read again
+          assert.are_equal(misses + 1, cache:stats().misses)
+          assert.are_equal(f, path.resolve(root .. "/l/up/a/b/c/f", {cache = cache}))
+          assert.are_equal(misses + 3, cache:stats().misses)
+        end)
+
+        it("should invalidate the entries", function()
+          local cache = path.resolve_cache()
+          assert.are_equal(root .. "/a/b/c/f", path.resolve(root .. "/l/c/f", {cache = cache}))
+          local entries = cache:stats().entries
+          -- a/b, a/b/c
+          assert.are_equal(2, cache:invalidate(root .. "/a/b"))
+          assert.are_equal(entries - 2, cache:stats().entries)
+
+          os.execute("rm '" .. root .. "/l' && ln -s a '" .. root .. "/l'")
+          assert.are_equal(root .. "/a/b/c/f", path.resolve(root .. "/l/c/f", {cache = cache}))
+          cache:invalidate(root .. "/l")
+          assert.is_nil(path.resolve(root .. "/l/c/f", {cache = cache}))
+          assert.are_equal(root .. "/a/b/c/f", path.resolve(root .. "/l/b/c/f", {cache = cache}))
+
+          assert.is_true(cache:invalidate() > 0)
+          local stats = cache:stats()
+          assert.are_equal(0, stats.entries)
+          assert.are_equal(1, stats.generation)
+        end)
+      end)
+    end
+  end)
+
   describe("#trim_ending_separator", function()
     it("should reaise with bad arguments", function()
       assert.error(function() path.trim_ending_separator(nil) end)
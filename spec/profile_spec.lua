@@ -0,0 +1,129 @@
+describe("#profile", function()
+  local profile = require 'std.profile'
+
+  local function spin(n)
+    local x = 0
+    for i = 1, n do
+      x = x + i % 7
+    end
+    return x
+  end
+
+  local function outer()
+    local x = spin(200000)
+    x = x + spin(20000) -- not a tail call, outer stays on the stack
+    return x
+  end
+
+  local function find(rows, name)
+    for _, row in ipairs(rows) do
+      if row.name == name then
+        return row
+      end
+    end
+  end
+
+  after_each(function()
+    profile.stop()
+    profile.reset()
+  end)
+
+  it("should sample the functions every given number of instructions", function()
+    assert.is_true(profile.start({mode = 'count', interval = 1000}))
+    assert.is_true(profile.running())
+    outer()
+    local samples = profile.stop()
+    assert.is_false(profile.running())
+    assert.is_true(samples > 100)
+    local rows, n, dropped = profile.report()
+    assert.are_equal(samples, n)
+    assert.are_equal(0, dropped)
+    assert.are_equal('spin', rows[1].name)
+    assert.is_true(rows[1].source:find('profile_spec', 1, true) ~= nil)
+    assert.are_equal(4, rows[1].line)
+    assert.is_true(rows[1].self > samples / 2)
+    local row = find(rows, 'outer')
+    assert.is_true(row.total >= rows[1].self)
+    assert.is_true(row.self < row.total)
+  end)
+  it("should aggregate the samples by line", function()
+    profile.start({mode = 'count', interval = 1000})
+    outer()
+    profile.stop()
+    local rows = profile.report('line')
+    assert.are_equal('spin', rows[1].name)
+    assert.is_true(rows[1].line >= 5 and rows[1].line <= 9)
+    assert.is_nil(rows[1].total)
+  end)
+  it("should export the stacks as folded stacks", function()
+    profile.start({mode = 'count', interval = 1000})
+    outer()
+    profile.stop()
+    local folded = profile.folded()
+    local count = 0
+    for line in folded:gmatch('[^\n]+') do
+      local stack, samples = line:match('^(.+) (%d+)$')
+      assert.is_not_nil(stack)
+      count = count + tonumber(samples)
+    end
+    local _, samples = profile.report()
+    assert.are_equal(samples, count)
+    assert.is_not_nil(folded:find('outer (spec/profile_spec.lua:12);spin (spec/profile_spec.lua:4) ', 1, true))
+  end)
+  it("should keep the innermost frames of the deep stacks", function()
+    profile.start({mode = 'count', interval = 1000, depth = 2})
+    outer()
+    profile.stop()
+    for line in profile.folded():gmatch('[^\n]+') do
+      local _, separators = line:gsub(';', '')
+      assert.is_true(separators <= 1)
+    end
+  end)
+  it("should sample the coroutines created while it runs", function()
+    profile.start({mode = 'count', interval = 1000})
+    local co = coroutine.wrap(outer)
+    co()
+    profile.stop()
+    assert.are_equal('spin', profile.report()[1].name)
+  end)
+  it("should sample the CPU time", function()
+    assert.is_true(profile.start({interval = 1000}))
+    local t0 = os.clock()
+    while os.clock() - t0 < 0.2 do
+      outer()
+    end
+    assert.is_true(profile.stop() > 0)
+    assert.is_not_nil(find(profile.report(), 'spin'))
+  end)
+  it("should add the samples of the runs until reset", function()
+    profile.start({mode = 'count', interval = 1000})
+    outer()
+    local first = profile.stop()
+    profile.start({mode = 'count', interval = 1000})
+    outer()
+    assert.is_true(profile.stop() > first)
+    profile.reset()
+    local rows, samples = profile.report()
+    assert.are_same({}, rows)
+    assert.are_equal(0, samples)
+    assert.are_equal('', profile.folded())
+  end)
+  it("should raise errors on invalid options", function()
+    assert.has_error(function()
+      profile.start({mode = 'wall'})
+    end)
+    assert.has_error(function()
+      profile.start({interval = 0})
+    end)
+    assert.has_error(function()
+      profile.start({depth = 257})
+    end)
+    assert.has_error(function()
+      profile.report('file')
+    end)
+    profile.start({mode = 'count'})
+    assert.has_error(function()
+      profile.start()
+    end)
+  end)
+end)
@@ -0,0 +1,151 @@
+describe("#sched", function()
+  local sched = require 'std.sched'
+  local time = require 'std.time'
+
+  local function now_ms()
+    return time.monotonic_ms()
+  end
+
+  it("should run the tasks in turn", function()
+    local s = sched.new()
+    local trace = {}
+    for i = 1, 3 do
+      s:spawn(function(name)
+        trace[#trace + 1] = name .. '1'
+        coroutine.yield()
+        trace[#trace + 1] = name .. '2'
+      end, tostring(i))
+    end
+    s:run()
+    assert.are_same({'11', '21', '31', '12', '22', '32'}, trace)
+  end)
+  it("should resume the sleeping tasks in the order of their deadlines", function()
+    local s = sched.new()
+    local trace = {}
+    local t0 = now_ms()
+    for _, delay in ipairs({60, 20, 40, 0}) do
+      s:spawn(function()
+        sched.sleep(delay)
+        trace[#trace + 1] = delay
+        assert.is_true(now_ms() - t0 >= delay)
+      end)
+    end
+    s:run()
+    assert.are_same({0, 20, 40, 60}, trace)
+    assert.is_true(now_ms() - t0 < 1000)
+  end)
+  it("should let the tasks sleep in parallel", function()
+    local s = sched.new()
+    local t0 = now_ms()
+    for _ = 1, 50 do
+      s:spawn(function()
+        sched.sleep(50)
+        sched.sleep(50)
+      end)
+    end
+    s:run()
+    local dt = now_ms() - t0
+    assert.is_true(dt >= 100)
+    assert.is_true(dt < 1000)
+  end)
+  it("should call the functions of the timers", function()
+    local s = sched.new({resolution = 5})
+    local trace = {}
+    s:after(30, function()
+      trace[#trace + 1] = 'b'
+    end)
+    s:after(10, function()
+      trace[#trace + 1] = 'a'
+      sched.sleep(40)
+      trace[#trace + 1] = 'c'
+    end)
+    assert.are_equal(2, s:pending())
+    s:run()
+    assert.are_same({'a', 'b', 'c'}, trace)
+    assert.are_equal(0, s:pending())
+  end)
+  it("should cancel the timers", function()
+    local s = sched.new()
+    local called = false
+    local id = s:after(10, function()
+      called = true
+    end)
+    assert.is_true(s:cancel(id))
+    assert.is_false(s:cancel(id))
+    s:run()
+    assert.is_false(called)
+  end)
+  it("should hold many pending timers", function()
+    local s = sched.new()
+    local ids = {}
+    for i = 1, 100000 do
+      ids[i] = s:after(i % 5000 + 10000, error)
+    end
+    assert.are_equal(100000, s:pending())
+    for i = 1, 100000, 2 do
+      assert.is_true(s:cancel(ids[i]))
+    end
+    assert.are_equal(50000, s:pending())
+    for i = 2, 100000, 2 do
+      assert.is_true(s:cancel(ids[i]))
+    end
+    assert.are_equal(0, s:pending())
+    s:run()
+  end)
+  it("should expire the timers spread over the levels of the wheel", function()
+    local s = sched.new()
+    local fired = 0
+    -- the 256 slots of the first level are one tick each
+    for _, delay in ipairs({1, 255, 256, 257, 300, 511, 512, 700}) do
+      s:after(delay, function()
+        fired = fired + 1
+      end)
+    end
+    s:run()
+    assert.are_equal(8, fired)
+  end)
+  it("should raise the errors of the tasks", function()
+    local s = sched.new()
+    s:spawn(function()
+      sched.sleep(1)
+      error('boom')
+    end)
+    assert.has_error(function()
+      s:run()
+    end)
+    s:spawn(function() end)
+    s:run()
+  end)
+  it("should not be run twice", function()
+    local s = sched.new()
+    local ok, err
+    s:spawn(function()
+      ok, err = pcall(s.run, s)
+    end)
+    s:run()
+    assert.is_false(ok)
+    assert.is_string(err)
+  end)
+  it("should reject invalid arguments", function()
+    assert.has_error(function()
+      sched.new({resolution = 0})
+    end)
+    assert.has_error(function()
+      sched.sleep(10) -- not in a task
+    end)
+    local ok, err
+    local s = sched.new()
+    s:spawn(function()
+      -- nor in a coroutine of a task
+      ok, err = coroutine.resume(coroutine.create(function()
+        sched.sleep(10)
+      end))
+    end)
+    s:run()
+    assert.is_false(ok)
+    assert.is_not_nil(err:find('not called from a task', 1, true))
+    assert.has_error(function()
+      s:after(10)
+    end)
+  end)
+end)
@@ -3,6 +3,7 @@ local IS_CI = not not os.getenv('GITHUB_ACTIONS')
 describe("#sleep", function()
   local sleep = require 'std.sleep'
   local stopwatch = require 'std.stopwatch'
+  local time = require 'std.time'
 
   if not IS_CI then
     it("should return immediately (s)", function()
@@ -30,4 +31,46 @@ describe("#sleep", function()
     local dt = sw:get_elapsed_time_ms()
     assert.is_true(dt >= 250)
   end)
+  for _, mode in ipairs({'sleep', 'hybrid', 'spin'}) do
+    it("should sleep for the specified amount of time (ns, " .. mode .. ")", function()
+      local sw = stopwatch.start()
+      assert.are_equal(0, sleep.sleep_ns(2000000, mode))
+      assert.is_true(sw:get_elapsed_time_ns() >= 2000000)
+    end)
+    it("should sleep until a deadline (" .. mode .. ")", function()
+      local deadline = time.monotonic_ns() + 2000000
+      local overshoot = sleep.until_ns(deadline, mode)
+      assert.is_true(overshoot >= 0)
+      assert.is_true(time.monotonic_ns() >= deadline)
+    end)
+  end
+  it("should not drift when sleeping until periodic deadlines", function()
+    local t0 = time.monotonic_ns()
+    local deadline = t0
+    for _ = 1, 20 do
+      deadline = deadline + 5000000
+      sleep.until_ns(deadline)
+    end
+    assert.is_true(time.monotonic_ns() - t0 >= 100000000)
+  end)
+  it("should return at once when the deadline has passed", function()
+    local overshoot = sleep.until_ns(time.monotonic_ns() - 1000000)
+    assert.is_true(overshoot >= 1000000)
+  end)
+  it("should reject an invalid mode", function()
+    assert.has_error(function()
+      sleep.sleep_ns(1, 'nap')
+    end)
+  end)
+  it("should get and set the timer slack", function()
+    local slack, err = sleep.timer_slack()
+    if not slack then
+      assert.is_string(err) -- not supported
+      return
+    end
+    assert.is_true(sleep.set_timer_slack(1))
+    assert.are_equal(1, sleep.timer_slack())
+    assert.is_true(sleep.set_timer_slack(slack))
+    assert.are_equal(slack, sleep.timer_slack())
+  end)
 end)
@@ -26,6 +26,28 @@ describe("#system", function()
       assert.not_nil(system.cpu_endianness())
     end)
   end)
+  describe("allocator_stats", function()
+    it("should return the allocator counters", function()
+      local stats = system.allocator_stats()
+      for _, name in ipairs({'allocations', 'bytes_allocated', 'bytes_in_use', 'peak_bytes', 'fallbacks', 'pool_hits',
+                             'pooled_bytes', 'scratch_capacity', 'scratch_peak'}) do
+        assert.is_true(math.type(stats[name]) == 'integer')
+      end
+    end)
+    it("should reuse the scratch memory", function()
+      local path = require 'std.path'
+      local p = string.rep('abc/../d/', 500)
+      path.full_path(p)
+      local before = system.allocator_stats()
+      for _ = 1, 100 do
+        path.full_path(p)
+      end
+      local after = system.allocator_stats()
+      assert.is_true(after.allocations >= before.allocations + 100)
+      assert.are_equal(before.bytes_in_use, after.bytes_in_use)
+      assert.are_equal(before.fallbacks, after.fallbacks)
+    end)
+  end)
   describe("memory_total", function()
     it("should not be nil", function()
       assert.not_nil(system.memory_total())
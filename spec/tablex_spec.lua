@@ -215,6 +215,11 @@ describe("#tablex", function()
       assert.is_true(tablex.eq({}, {}))
       assert.is_true(tablex.eq(fixtures(), fixtures()))
     end)
+    it("should compare the contents of the values hashed by identity", function()
+      local mt = {__hash = function(x) return tostring(x) end}
+      local x, y = setmetatable({1}, mt), setmetatable({1}, mt)
+      assert.is_true(tablex.eq({x}, {y}))
+    end)
     it("should return false when the tables are not the same", function()
       assert.is_false(tablex.eq({}, nil))
       assert.is_false(tablex.eq(nil, {}))
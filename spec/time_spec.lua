@@ -30,4 +30,24 @@ describe("#time", function()
     sample_time('monotonic_ns', t, 1000 * 1000 * 1000)
     sample_time('perf_counter_ns', t, 1000 * 1000 * 1000)
   end
+
+  it("should count the cycles", function()
+    local frequency, source = time.cycles_frequency()
+    assert.is_true(frequency > 0)
+    assert.is_string(source)
+    local c0, t0 = time.cycles(), time.perf_counter_ns()
+    sleep.sleep(0.05)
+    local c1, t1 = time.cycles(), time.perf_counter_ns()
+    assert.is_true(c1 > c0)
+    -- accept values within 1% of the perf counter
+    local dt = time.cycles_to_ns(c1 - c0)
+    assert.is_true(math.abs(dt - (t1 - t0)) < (t1 - t0) * 0.01)
+  end)
+  it("should convert the cycles to nanoseconds", function()
+    local frequency = time.cycles_frequency()
+    assert.are_equal(0, time.cycles_to_ns(0))
+    assert.are_equal(1000000000, time.cycles_to_ns(frequency))
+    assert.are_equal(-1000000000, time.cycles_to_ns(-frequency))
+    assert.are_equal(3600 * 1000000000, time.cycles_to_ns(frequency * 3600))
+  end)
 end)
@@ -0,0 +1,146 @@
+describe("#trace", function()
+  local trace = require 'std.trace'
+  local sleep = require 'std.sleep'
+
+  it("should aggregate the spans by name", function()
+    local t = trace.new()
+    for _ = 1, 3 do
+      t:begin('outer')
+      t:begin('inner')
+      sleep.sleep_ms(2)
+      t:finish()
+      t:finish()
+    end
+    local stats = t:stats()
+    assert.are_equal(3, stats.outer.count)
+    assert.are_equal(3, stats.inner.count)
+    assert.is_true(stats.inner.min >= 2000000)
+    assert.is_true(stats.inner.min <= stats.inner.max)
+    assert.is_true(stats.inner.total >= 3 * stats.inner.min)
+    assert.is_true(stats.outer.total >= stats.inner.total)
+    local n = 0
+    for _, count in ipairs(stats.inner.histogram) do
+      n = n + count
+    end
+    assert.are_equal(3, n)
+  end)
+  it("should finish the scoped spans when they go out of scope", function()
+    local t = trace.new()
+    local function work(depth)
+      local _ <close> = t:span('work')
+      if depth > 0 then
+        work(depth - 1)
+      end
+    end
+    work(4)
+    assert.are_equal(5, t:stats().work.count)
+    -- the span is finished by errors too
+    pcall(function()
+      local _ <close> = t:span('failing')
+      error('boom')
+    end)
+    assert.are_equal(1, t:stats().failing.count)
+    t:begin('after')
+    t:finish()
+    assert.are_equal(1, t:stats().after.count)
+  end)
+  it("should finish the spans open in a scoped span with it", function()
+    local t = trace.new()
+    pcall(function()
+      local _ <close> = t:span('outer')
+      t:begin('inner')
+      error('boom')
+    end)
+    local stats = t:stats()
+    assert.are_equal(1, stats.outer.count)
+    assert.are_equal(1, stats.inner.count)
+    t:begin('root')
+    do
+      local _ <close> = t:span('scoped')
+    end
+    t:finish()
+    assert.are_equal(1, t:stats().scoped.count)
+    assert.are_equal(1, t:stats().root.count)
+    assert.has_error(function()
+      t:finish()
+    end)
+  end)
+  it("should export the self times of the stacks as folded stacks", function()
+    local t = trace.new()
+    t:begin('a')
+    sleep.sleep_ms(1)
+    t:begin('b')
+    sleep.sleep_ms(1)
+    t:finish()
+    t:begin('c;d')
+    sleep.sleep_ms(1)
+    t:finish()
+    t:finish()
+    local lines = {}
+    for stack, self in t:folded():gmatch('([^\n]+) (%d+)\n') do
+      lines[stack] = tonumber(self)
+    end
+    assert.are_same({'a', 'a;b', 'a;c;d'}, (function()
+      local stacks = {}
+      for stack in pairs(lines) do
+        stacks[#stacks + 1] = stack
+      end
+      table.sort(stacks)
+      return stacks
+    end)())
+    local stats = t:stats()
+    assert.are_equal(stats.a.total, lines['a'] + lines['a;b'] + lines['a;c;d'])
+  end)
+  it("should export the last spans as Chrome trace events", function()
+    local t = trace.new({capacity = 4})
+    for i = 1, 6 do
+      t:begin('span "' .. i .. '"')
+      t:finish()
+    end
+    local json, dropped = t:chrome()
+    assert.are_equal(2, dropped)
+    assert.is_nil(json:find('span \\"2\\"', 1, true))
+    assert.is_not_nil(json:find('{"name":"span \\"3\\"","ph":"X","ts":', 1, true))
+    local names = {}
+    for name in json:gmatch('"name":"span \\"(%d)\\""') do
+      names[#names + 1] = tonumber(name)
+    end
+    assert.are_same({3, 4, 5, 6}, names)
+    assert.are_equal('{"traceEvents":[]}', trace.new({capacity = 0}):chrome())
+  end)
+  it("should reset the statistics", function()
+    local t = trace.new()
+    t:begin('a')
+    assert.has_error(function()
+      t:reset()
+    end)
+    t:finish()
+    t:reset()
+    assert.are_same({}, t:stats())
+    assert.are_equal('', t:folded())
+    assert.are_equal('{"traceEvents":[]}', t:chrome())
+    t:begin('a')
+    t:finish()
+    assert.are_equal(1, t:stats().a.count)
+  end)
+  it("should raise errors on invalid calls", function()
+    local t = trace.new()
+    assert.has_error(function()
+      t:finish()
+    end)
+    assert.has_error(function()
+      t:begin(42)
+    end)
+    assert.has_error(function()
+      t.begin({}, 'a')
+    end)
+    assert.has_error(function()
+      trace.new({capacity = -1})
+    end)
+    assert.has_error(function()
+      for _ = 1, 257 do
+        t:begin('deep')
+      end
+    end)
+  end)
+end)
@@ -256,8 +256,10 @@ end
 --- Returns distinct elements from an array.
 -- @tparam table a the array to remove the duplicated elements from.
 -- @tparam[opt] function eq the function used to the the values for equality (see @{eq_comparer}).
+-- @tparam[optchain] function hasher a function returning a hash code for a value that is consistent with `eq`
+-- (e.g. `std.hash.deep`); when given, `eq` is only used to compare values with the same hash code.
 -- @treturn table a new array containing distinct elements from the input array.
-function distinct(a, eq)
+function distinct(a, eq, hasher)
   if #a == 0 then
     return {}
   end
@@ -276,6 +278,23 @@ function distinct(a, eq)
     return seen[x]
   end
 
+  if hasher then
+    eq = eq or Defaults.eq
+    for i = 1, #a do
+      local x = a[i]
+      local h = hasher(x)
+      local bucket = seen[h]
+      if not bucket then
+        seen[h] = {x}
+        r[#r + 1] = x
+      elseif not contains(bucket, x, 1, #bucket, eq) then
+        bucket[#bucket + 1] = x
+        r[#r + 1] = x
+      end
+    end
+    return r
+  end
+
   local contains = eq and contains_slow or contains_fast
 
   for i = 1, #a do
@@ -293,12 +312,26 @@ end
 -- @tparam table a an array whose elements that are not also in `a2` will be returned.
 -- @tparam table exclusions an array whose elements that also occur in `a1` will cause those
 -- elements to be removed from the returned sequence.
+-- @param[opt] set an empty set (e.g. a @{std.hashmap.Set}) used to collect the exclusions
+-- instead of a table; values are compared by `==` otherwise.
 -- @treturn table an array containing the set difference of the two input arrays.
-function except(a, exclusions)
+function except(a, exclusions, set)
   if #a == 0 then
     return {}
   end
-  local r, seen = {}, to_set(exclusions)
+  local r = {}
+  if set then
+    for i = 1, #exclusions do
+      set:add(exclusions[i])
+    end
+    for _, x in ipairs(a) do
+      if not set:has(x) then
+        r[#r + 1] = x
+      end
+    end
+    return r
+  end
+  local seen = to_set(exclusions)
   for _, x in ipairs(a) do
     if not seen[x] then
       r[#r + 1] = x
@@ -310,12 +343,29 @@ end
 --- Returns the set intersection of two arrays.
 -- @tparam table a1 an array whose distinct elements that also appear in `a2` will be returned.
 -- @tparam table a2 an array whose distinct elements that also appear in `a1` will be returned.
+-- @param[opt] map an empty map (e.g. a @{std.hashmap.Map}) used to count the elements of `a2`
+-- instead of a table; values are compared by `==` otherwise.
 -- @treturn table an array that contains the elements that appear in `a1` and `a2`.
-function intersect(a1, a2)
+function intersect(a1, a2, map)
   if #a1 == 0 or #a2 == 0 then
     return {}
   end
-  local r, seen = {}, to_bag(a2)
+  local r = {}
+  if map then
+    for i = 1, #a2 do
+      local x = a2[i]
+      map:put(x, (map:get(x) or 0) + 1)
+    end
+    for _, x in ipairs(a1) do
+      local n = map:get(x)
+      if n then
+        r[#r + 1] = x
+        map:put(x, n > 1 and n - 1 or nil)
+      end
+    end
+    return r
+  end
+  local seen = to_bag(a2)
   for _, x in ipairs(a1) do
     local n = seen[x]
     if n then
@@ -2,9 +2,13 @@
 -- @module std.func
 local M = {}
 
+local tablex = require 'std.tablex'
+
 local load = load
+local rawequal = rawequal
 local tbl_pack = table.pack
 local tbl_unpack = table.unpack
+local type = type
 
 local _ENV = M
 
@@ -95,13 +99,49 @@ local function mask_nil(v)
   return v
 end
 
+local function same(x, y)
+  if rawequal(x, y) then
+    return true
+  elseif rawequal(x, Nil) or rawequal(y, Nil) then
+    return false
+  elseif type(x) == 'table' and type(y) == 'table' then
+    return tablex.eq(x, y)
+  end
+  return x == y
+end
+
+-- Returns the cache key of an argument: with a hasher, the first argument seen equal to it, among
+-- those with the same hash, kept in `buckets`.
+local function cache_key(buckets, hasher, v)
+  v = mask_nil(v)
+  if not hasher then
+    return v
+  end
+  local h = mask_nil(hasher(v))
+  local bucket = buckets[h]
+  if not bucket then
+    buckets[h] = {v}
+    return v
+  end
+  for i = 1, #bucket do
+    if same(bucket[i], v) then
+      return bucket[i]
+    end
+  end
+  bucket[#bucket + 1] = v
+  return v
+end
+
 --- Memoizes a function with one argument.
 -- @tparam function f the function to be memoized.
+-- @tparam[opt] function hasher a function returning a hash code of each argument, like
+-- `std.hash.deep`, to memoize by value rather than by identity: the arguments with the same hash
+-- code are compared with `tablex.eq` if they are tables, otherwise with `==`.
 -- @treturn function the memoized function.
-function memoize1(f)
-  local cache = {}
+function memoize1(f, hasher)
+  local cache, buckets = {}, {}
   return function(arg1)
-    local k1 = mask_nil(arg1)
+    local k1 = cache_key(buckets, hasher, arg1)
     if not cache[k1] then
       cache[k1] = tbl_pack(f(arg1))
     end
@@ -111,11 +151,14 @@ end
 
 --- Memoizes a function with two arguments.
 -- @tparam function f the function to be memoized.
+-- @tparam[opt] function hasher a function returning a hash code of each argument, like
+-- `std.hash.deep`, to memoize by value rather than by identity: the arguments with the same hash
+-- code are compared with `tablex.eq` if they are tables, otherwise with `==`.
 -- @treturn function the memoized function.
-function memoize2(f)
-  local cache = {}
+function memoize2(f, hasher)
+  local cache, buckets = {}, {}
   return function(arg1, arg2)
-    local k1, k2 = mask_nil(arg1), mask_nil(arg2)
+    local k1, k2 = cache_key(buckets, hasher, arg1), cache_key(buckets, hasher, arg2)
     local cache2 = get_cache(cache, k1)
     if not cache2[k2] then
       cache2[k2] = tbl_pack(f(arg1, arg2))
@@ -126,11 +169,15 @@ end
 
 --- Memoizes a function with threw arguments.
 -- @tparam function f the function to be memoized.
+-- @tparam[opt] function hasher a function returning a hash code of each argument, like
+-- `std.hash.deep`, to memoize by value rather than by identity: the arguments with the same hash
+-- code are compared with `tablex.eq` if they are tables, otherwise with `==`.
 -- @treturn function the memoized function.
-function memoize3(f)
-  local cache = {}
+function memoize3(f, hasher)
+  local cache, buckets = {}, {}
   return function(arg1, arg2, arg3)
-    local k1, k2, k3 = mask_nil(arg1), mask_nil(arg2), mask_nil(arg3)
+    local k1, k2 = cache_key(buckets, hasher, arg1), cache_key(buckets, hasher, arg2)
+    local k3 = cache_key(buckets, hasher, arg3)
     local cache3 = get_cache(cache, k1, k2)
     if not cache3[k3] then
       cache3[k3] = tbl_pack(f(arg1, arg2, arg3))
@@ -141,11 +188,15 @@ end
 
 --- Memoizes a function with four arguments.
 -- @tparam function f the function to be memoized.
+-- @tparam[opt] function hasher a function returning a hash code of each argument, like
+-- `std.hash.deep`, to memoize by value rather than by identity: the arguments with the same hash
+-- code are compared with `tablex.eq` if they are tables, otherwise with `==`.
 -- @treturn function the memoized function.
-function memoize4(f)
-  local cache = {}
+function memoize4(f, hasher)
+  local cache, buckets = {}, {}
   return function(arg1, arg2, arg3, arg4)
-    local k1, k2, k3, k4 = mask_nil(arg1), mask_nil(arg2), mask_nil(arg3), mask_nil(arg4)
+    local k1, k2 = cache_key(buckets, hasher, arg1), cache_key(buckets, hasher, arg2)
+    local k3, k4 = cache_key(buckets, hasher, arg3), cache_key(buckets, hasher, arg4)
     local cache4 = get_cache(cache, k1, k2, k3)
     if not cache4[k4] then
       cache4[k4] = tbl_pack(f(arg1, arg2, arg3, arg4))
@@ -3,7 +3,14 @@
 
 local M = setmetatable({}, {__index = io})
 
+local native = require 'std.iox.native'
+
 local io_open = io.open
+local pcall = pcall
+local table_move = table.move
+
+-- io.lines reads in text mode, which only turns CRLF into LF on Windows
+local text_mode_crlf = package.config:sub(1, 1) == '\\'
 
 local _ENV = M
 
@@ -12,42 +19,19 @@ local _ENV = M
 -- @treturn table a string array containing all the lines of the file, or `nil` if the function fails.
 -- @treturn string err `nil` if the function succeeded; otherwise an error message describing why the function failed.
 function read_lines(filename)
-  local fh<close>, err = io_open(filename, 'r')
-  if not fh then
-    return nil, err
-  end
-
-  local t = {}
-  while true do
-    local line
-    line, err = fh:read('l')
-    if err or not line then
-      break
-    end
-    t[#t + 1] = line
-  end
-  return t, err
-end
-
---- Creates a new file, writes one or more strings to the file, and then closes the file.
--- @tparam string filename the name of the file to read.
--- @tparam table lines the lines to write to the file..
--- @treturn boolean `true` if the function succeeded, otherwise `false`.
--- @treturn string err `nil` if the function succeeded, otherwise an error message describing why the function failed.
-function write_lines(filename, lines)
-  local fh<close>, err = io_open(filename, 'w')
-  if not fh then
-    return false, err
+  local iter, state, init, closing = native.lines_chunked(filename, {batch = 1024, crlf = text_mode_crlf})
+  if not iter then
+    return nil, state
   end
 
-  local _
-  for i = 1, #lines do
-    _, err = fh:write(lines[i], '\n')
-    if err then
-      break
+  local t, n = {}, 0
+  local ok, err = pcall(function()
+    for lines, k in iter, state, init, closing do
+      table_move(lines, 1, k, n + 1, t)
+      n = n + k
     end
-  end
-  return not err, err
+  end)
+  return t, not ok and err or nil
 end
 
 local function read_file(filename, what)
@@ -78,21 +62,10 @@ function read_all(filename)
   return read_file(filename, 'a')
 end
 
---- Creates a new file, write the contents to the file, and then closes the file.
--- @tparam string filename the name of the file to write to.
--- @tparam string content the content to write to the file.
--- @treturn boolean `true` if the function succeeded, otherwise `false`.
--- @treturn string err `nil` if the function succeeded, otherwise an error message describing why the function failed.
-function write_all(filename, content)
-  local fh<close>, err = io_open(filename, 'w')
-  if not fh then
-    return false, err
-  end
-
-  local _
-  _, err = fh:write(content)
-  return not err, err
-end
+-- documented in csrc/mods/iox.c
+lines_chunked = native.lines_chunked
+write_all = native.write_all
+write_lines = native.write_lines
 
 return M
 
@@ -4,21 +4,47 @@
 local M = setmetatable({}, {__index = os})
 
 local io = require 'std.iox'
+local native = require 'std.osx.native'
 local path = require 'std.path'
+local system = require 'std.system'
 
+local error = error
+local ipairs = ipairs
 local os_execute = os.execute
 local os_getenv = os.getenv
 local os_remove = os.remove
 local tbl_concat = table.concat
+local tbl_move = table.move
+local type = type
+
+local spawn = native.spawn
 
 local _ENV = M
 
---- Executes a given command
--- @tparam CommandContext cmd the command to execute
--- @treturn boolean `true` if the function succeeded, otherwise `false`.
--- @treturn string the output of the command if the function succeeded, otherwise `nil`.
--- @treturn string the error output of the command if the function succeeded, otherwise `nil`.
-function exec(cmd)
+local function trim_output(s)
+  if s then
+    s = s:match('^(.-)%s*$')
+  end
+  if s and #s == 0 then
+    return nil
+  end
+  return s
+end
+
+-- Runs a command through the shell, capturing its outputs in temporary files: used where the
+-- commands cannot be spawned natively.
+local function exec_shell(cmd)
+  for _, field in ipairs({'env', 'cwd', 'timeout'}) do
+    if cmd[field] ~= nil then
+      error(("'%s' is not supported on this platform"):format(field), 4)
+    end
+  end
+  for _, field in ipairs({'stdout', 'stderr'}) do
+    if type(cmd[field]) == 'function' then
+      error(("a function as '%s' is not supported on this platform"):format(field), 4)
+    end
+  end
+
   local tmp_dir = os_getenv('TMP') or os_getenv('TEMP') or '.'
   local out_tmpfile, err_tmpfile
 
@@ -47,10 +73,7 @@ function exec(cmd)
 
   cmd_line = tbl_concat(cmd_line, ' ')
 
-  local ok = os_execute(cmd_line)
-  if not ok then
-    return false
-  end
+  local ok, what, code = os_execute(cmd_line)
 
   local function read_file(file_path)
     if not file_path then
@@ -59,27 +82,113 @@ function exec(cmd)
 
     local r = io.read_all(file_path)
     os_remove(file_path)
-    if r then
-      r = r:match('^(.-)%s*$')
-    end
-    if r and #r == 0 then
-      return nil
-    end
-    return r
+    return trim_output(r)
   end
 
   local out = read_file(out_tmpfile)
   local err = read_file(err_tmpfile)
-  return true, out, err
+  return {ok = not not ok, status = what, code = code, stdout = out, stderr = err}
+end
+
+-- Returns the command spawned for a command context: its arguments string through the shell, as
+-- `exec_shell` prefers it, or its argument list as it is.
+local function spawn_command(cmd)
+  local argv
+  if cmd.args or not cmd.arg_list then
+    argv = {'/bin/sh', '-c', cmd.args and cmd.name .. ' ' .. cmd.args or cmd.name}
+  else
+    argv = {cmd.name}
+    tbl_move(cmd.arg_list, 1, #cmd.arg_list, 2, argv)
+  end
+  return {
+    argv = argv,
+    env = cmd.env,
+    cwd = cmd.cwd,
+    timeout = cmd.timeout,
+    stdout = cmd.stdout,
+    stderr = cmd.stderr
+  }
+end
+
+local function run(cmds, concurrency)
+  if not spawn then
+    local results = {}
+    for i, cmd in ipairs(cmds) do
+      results[i] = exec_shell(cmd)
+    end
+    return results
+  end
+
+  local commands = {}
+  for i, cmd in ipairs(cmds) do
+    commands[i] = spawn_command(cmd)
+  end
+  return spawn(commands, concurrency)
+end
+
+--- Executes a given command.
+--
+-- The command is spawned without a shell if it has an argument list and no arguments string, and
+-- its output is read through pipes until it exits: the output written after by the processes it
+-- started is not read.
+-- @tparam CommandContext cmd the command to execute
+-- @treturn boolean `true` if the command exited with the status 0, otherwise `false`.
+-- @treturn string the output of the command, without its trailing spaces, or `nil` if empty.
+-- @treturn string the error output of the command, without its trailing spaces, or `nil` if
+-- empty; or the reason why the command could not be run.
+-- @treturn string how the command ended, `"exit"`, `"signal"` or `"timeout"`, as the second
+-- result of `os.execute`.
+-- @treturn integer the exit status or the number of the signal.
+-- @raise If the command uses an option not supported on this platform.
+function exec(cmd)
+  local r = run({cmd}, 1)[1]
+  if r.error then
+    return false, nil, r.error
+  end
+  return r.ok, trim_output(r.stdout), trim_output(r.stderr), r.status, r.code
+end
+
+--- Executes some commands, running a given number of them at once.
+-- @tparam table cmds an array of @{CommandContext}.
+-- @tparam[opt] table opts the options: `concurrency` (integer), the maximum number of commands
+-- running at once, the number of processors by default.
+-- @treturn table an array of the @{CommandResult} of each command, in the order of the commands.
+-- @raise If a command is not valid, or uses an option not supported on this platform.
+-- @usage
+-- local results = osx.exec_many({
+--   {name = 'git', arg_list = {'-C', 'a', 'pull'}},
+--   {name = 'git', arg_list = {'-C', 'b', 'pull'}, timeout = 60000},
+-- }, {concurrency = 2})
+function exec_many(cmds, opts)
+  local concurrency = opts and opts.concurrency or system.cpu_count() or 1
+  return run(cmds, concurrency)
 end
 
 return M
 
 --- The command context.
--- Contains the customization options for a CLI application.
+-- Contains the customization options for a CLI application. On Windows, where the commands are run
+-- through `os.execute`, `env`, `cwd`, `timeout` and the functions as `stdout` or `stderr` are not
+-- supported: running a command using them raises an error.
 -- @table CommandContext
--- @tfield string name the command to execute.
--- @tfield[opt] table arg_list a list of command-line arguments.
--- @tfield[opt] string args a string containing the command-line arguments.
--- @tfield[opt] boolean stdout if `true` the command's output will be captured (default: `true`).
--- @tfield[opt] boolean stderr if `true` the command's error output will be captured (default: `true`).
+-- @tfield string name the command to execute: a program looked up in `PATH` (the one of `env` if
+-- it sets it) if only `arg_list` is given, otherwise a command line run by the shell.
+-- @tfield[opt] table arg_list a list of command-line arguments, passed as they are.
+-- @tfield[opt] string args a string containing the command-line arguments, interpreted by the
+-- shell; preferred to `arg_list` if both are given.
+-- @tfield[opt] boolean|function stdout if `true` the command's output will be captured
+-- (default: `true`); if `false`, left to the output of the process; if a function, called with
+-- each chunk of the output.
+-- @tfield[opt] boolean|function stderr as `stdout`, for the command's error output.
+-- @tfield[opt] table env the environment variables to set, or to unset if `false`.
+-- @tfield[opt] string cwd the working directory of the command.
+-- @tfield[opt] integer timeout the number of milliseconds after which the command is killed.
+
+--- The result of a command run by @{exec_many}.
+-- @table CommandResult
+-- @tfield boolean ok `true` if the command exited with the status 0 in time.
+-- @tfield string status how the command ended: `"exit"`, `"signal"` or `"timeout"`.
+-- @tfield integer code the exit status or the number of the signal.
+-- @tfield string stdout the output captured.
+-- @tfield string stderr the error output captured.
+-- @tfield string error the reason why the command could not be run, if it could not.
@@ -53,6 +53,11 @@ function prototype:get_elapsed_time()
   return self:get_elapsed_time_ns() / 1e9
 end
 
+-- Records the elapsed time in nanoseconds into a std.histogram histogram.
+function prototype:record(histogram)
+  return histogram:record(self:get_elapsed_time_ns())
+end
+
 local mt = {
   __index = prototype,
   __tostring = function(self)